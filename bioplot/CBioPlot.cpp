@@ -31,8 +31,10 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
 #include <cstdio>
+#include <cmath>
 
 #include <vector>
+#include <algorithm>
 
 #include <assert.h>
 
@@ -60,8 +62,10 @@ using std::vector;
 
 //! left margin of the graph (space reserved for tick labels)
 #define MARGIN 64
-//! maximum number of samples to store
+//! initial number of samples to store per curve
 #define MAX_SIZE 12000
+//! maximum number of samples to store per curve
+#define MAX_BUFFER_SIZE (1<<22)
 
 //! colours to use for different curves
 static const char * const curve_colors[BIOPLOT_MAX_CURVES] = {
@@ -83,6 +87,8 @@ CBioPlot::CBioPlot( const size_t num_curves, const double ival_len,
 	, ScaleXAxisProgressive ( true     )
 	, theTimeRange   ( ival_len )
 	, theSkipFraction( 0.2      )
+	, theXMin        ( 0.0      )
+	, theXMax        ( ival_len )
 {
 	// create the plot, axes, etc
 	SetupPlot(title);
@@ -233,9 +239,10 @@ void CBioPlot::AddCurve( int pen_width )
 	curve->setPen( *pen );
 
 	// add a data set for this curve and bind it to the curve
-	theDataX.push_back( data_t() );
-	theDataY.push_back( data_t() );
-	curve->setData( theDataX[curve_num], theDataY[curve_num] );
+	theData.push_back( shared_ptr<CCurveBuffer>( new CCurveBuffer( MAX_SIZE ) ) );
+	curve->setData( CCurveData( theData[curve_num] ) );
+	theQueues.push_back( shared_ptr<queue_t>( new queue_t ) );
+	theDropCount.push_back( 0 );
 
 	// change style or quality of the curve
 	//curve->setStyle( QwtPlotCurve::Dots );
@@ -289,18 +296,18 @@ void CBioPlot::SetAxisScale()
 	const double move_time = theSkipFraction*theTimeRange;
 
 	// nothing defined yet
-	if ( theDataX.size() == 0 )  return;
+	if ( theData.size() == 0 )  return;
 
 	// find the maximum over all curves
 	float max = 0;
 	{
 		boost::mutex::scoped_lock lock(data_lock);
 
-		for ( size_t c = 0; c < theDataX.size(); c++ )
+		for ( size_t c = 0; c < theData.size(); c++ )
 		{
-			if ( theDataX[c].size() > 0 )
+			if ( theData[c]->Size() > 0 )
 			{
-				if (theDataX[c].back() > max) max = theDataX[c].back();
+				if (theData[c]->BackX() > max) max = theData[c]->BackX();
 			}
 		}
 	}
@@ -318,6 +325,8 @@ void CBioPlot::SetAxisScale()
 
 	//cerr << "Axisscale to " << min << "," << max << endl;
 	thePlot->setAxisScale( QwtPlot::xBottom, min, max );
+	theXMin = min;
+	theXMax = max;
 
 	// if we've stored too many samples, get rid of some old ones
 	min -= 0.1*theSkipFraction; // small margin at the left of graph
@@ -325,15 +334,7 @@ void CBioPlot::SetAxisScale()
 	{
 		boost::mutex::scoped_lock lock(data_lock);
 
-		if ( theDataX[c].size()>0 && theDataX[c].at(0) < min  )
-		{
-			// find out how many points to remove
-			int i = 0;
-			while ( i < theDataX[c].size() && theDataX[c].at(i) < min ) { i++; }
-
-			theDataX[c].erase( theDataX[c].begin(), theDataX[c].begin()+i );
-			theDataY[c].erase( theDataY[c].begin(), theDataY[c].begin()+i );
-		}
+		theData[c]->DropBefore( min );
 	}
 }
 
@@ -350,10 +351,41 @@ void CBioPlot::Clear( const size_t num_curve )
 	// sanity check
 	if ( num_curve >= NumCurves() ) return;
 
+	// the queued blocks belong to the old data: the GUI thread is the consumer
+	SampleBlock block;
+	while ( theQueues[num_curve]->pop( block ) ) {}
+	theDropCount[num_curve] = 0;
+
 	boost::mutex::scoped_lock lock(data_lock);
 
-	theDataX[num_curve].clear();
-	theDataY[num_curve].clear();
+	theData[num_curve]->Clear();
+}
+
+void CBioPlot::SetSampleRate( const double fs )
+{
+	// interval length plus the part that is skipped at an axis shift
+	size_t size = (size_t) ( fs*theTimeRange*(1.0+2*theSkipFraction) ) + 1;
+	if ( size > MAX_BUFFER_SIZE ) size = MAX_BUFFER_SIZE;
+
+	boost::mutex::scoped_lock lock(data_lock);
+
+	for ( size_t c = 0; c < NumCurves(); c++ )
+	{
+		theData[c]->Reserve( size );
+	}
+}
+
+/** Grow the buffer when it is full but doesn't hold the interval length yet,
+ *  should be called with 'data_lock' locked
+ */
+void CBioPlot::GrowBuffer( CCurveBuffer & buf )
+{
+	if ( buf.Size() < buf.Capacity() || buf.Capacity() >= MAX_BUFFER_SIZE ) return;
+
+	if ( !ScaleXAxisProgressive || buf.BackX() - buf.X(0) < theTimeRange*(1.0+theSkipFraction) )
+	{
+		buf.Reserve( std::min<size_t>( 2*buf.Capacity(), MAX_BUFFER_SIZE ) );
+	}
 }
 
 void CBioPlot::AddSample( const float time, const float sample, const size_t curve_num )
@@ -361,54 +393,107 @@ void CBioPlot::AddSample( const float time, const float sample, const size_t cur
 	// sanity check
 	if ( curve_num >= NumCurves() ) return;
 
+	boost::mutex::scoped_lock lock(data_lock);
+
+	AppendSample( time, sample, curve_num );
+}
+
+void CBioPlot::AppendSample( const double time, const float sample, const size_t curve_num )
+{
 	//assert( time>=0 );
 	if (time < -1e-7) {
 		fprintf(stderr,"t %.3f < 0.0 sample %f curve_num %u!!!\n",time,sample,curve_num);
 		return;
 	}
 
-	boost::mutex::scoped_lock lock(data_lock);
+	CCurveBuffer & buf = *theData[curve_num];
 
         //fprintf(stderr,"# AddSample t %f sample %f curve %d\n",time,sample,curve_num);
         
 	// add empty points if necessary (i.e., if packets were lost)
-	if ( theDataX[curve_num].size() > 2 )
+	if ( buf.Size() > 2 )
 	{
-		double delta_t = theDataX[curve_num].at(1) - theDataX[curve_num].at(0);
+		double delta_t = buf.X(1) - buf.X(0);
 
 		size_t num_missing = 0;
-		if (theDataX[curve_num].back() + 1.5*delta_t < time ) {
-		  //fprintf(stderr,"# Missing %.3f [s]",time - theDataX[curve_num].back()) ;
+		if (buf.BackX() + 1.5*delta_t < time ) {
+		  //fprintf(stderr,"# Missing %.3f [s]",time - buf.BackX()) ;
 		}
-		while ( theDataX[curve_num].back() + 1.5*delta_t < time )
+		while ( buf.BackX() + 1.5*delta_t < time )
 		{
-			assert( theDataX[curve_num].size() < 1e6 );
-			//if ( num_missing>500 ) {
-			//	cerr << "# Warning: more than 500 missing samples; bailing out" <<endl;
-			//	//abort();  // too strong reaction
-			//}
-
-			theDataX[curve_num].push_back( theDataX[curve_num].back()+delta_t );
-			theDataY[curve_num].push_back( theDataY[curve_num].back()         );
+			// more points would overwrite the ones just inserted
+			if ( num_missing >= buf.Capacity() ) break;
+
+			GrowBuffer( buf );
+			buf.Push( buf.BackX()+delta_t, buf.BackY() );
 			num_missing++;
 		}
 		//if (num_missing>0) cerr << "# Inserted " << num_missing << " points" << endl;
 	}
 
-	if ( theDataX[curve_num].size()>0 && time < theDataX[curve_num].back() )
+	if ( buf.Size()>0 && time < buf.BackX() )
 	{
 		cerr << "# WARNING: data points for curve "<< curve_num<<" are going back in time (last time=" 
-			<< theDataX[curve_num].back() << ", new time=" << time << ")!!!" << endl;
-		theDataX[curve_num].clear();
-		theDataY[curve_num].clear();
+			<< buf.BackX() << ", new time=" << time << ")!!!" << endl;
+		buf.Clear();
 	}
 
 	// save the time and the sample
-	theDataX[curve_num].push_back(time);
-	theDataY[curve_num].push_back(sample);
+	GrowBuffer( buf );
+	buf.Push( time, sample );
 
 }
 
+size_t CBioPlot::AddSamples( const double t0, const double dt, const float * samples, 
+	const size_t num, const size_t curve_num )
+{
+	// sanity check
+	if ( curve_num >= NumCurves() ) return 0;
+
+	queue_t & queue = *theQueues[curve_num];
+	SampleBlock block;
+
+	size_t i = 0;
+	while ( i < num )
+	{
+		block.t0  = t0 + i*dt;
+		block.dt  = dt;
+		block.num = std::min<size_t>( num-i, BIOPLOT_BLOCK_SIZE );
+		std::copy( &samples[i], &samples[i+block.num], block.sample );
+		if ( !queue.push( block ) )
+		{
+			// the GUI thread is behind: drop samples, never wait for it
+			if ( theDropCount[curve_num] == 0 ) 
+			{
+				cerr << "# Warning: plot queue of curve " << curve_num << " full, dropping samples" << endl;
+			}
+			theDropCount[curve_num] += num-i;
+			break;
+		}
+		i += block.num;
+	}
+	return i;
+}
+
+/** move the queued blocks into the curve buffers
+ */
+void CBioPlot::DrainQueues()
+{
+	SampleBlock block;
+
+	for ( size_t c = 0; c < theQueues.size(); c++ )
+	{
+		while ( theQueues[c]->pop( block ) )
+		{
+			for ( size_t i = 0; i < block.num; i++ )
+			{
+				if ( std::isnan( block.sample[i] ) ) continue;
+				AppendSample( block.t0+i*block.dt, block.sample[i], c );
+			}
+		}
+	}
+}
+
 void CBioPlot::SetSamples( const std::vector<double> & Xvalues, const std::vector<double> & Yvalues,
 		const size_t num_curve )
 {
@@ -425,8 +510,9 @@ void CBioPlot::SetSamples( const std::vector<double> & Xvalues, const std::vecto
 	{
 		boost::mutex::scoped_lock lock(data_lock);
 
-		theDataX[num_curve] = QVector<double>::fromStdVector( Xvalues );
-		theDataY[num_curve] = QVector<double>::fromStdVector( Yvalues );
+		const size_t num = std::min( Xvalues.size(), Yvalues.size() );
+		theData[num_curve]->Reserve( num );
+		for (size_t i = 0; i < num; i++) theData[num_curve]->Push( Xvalues[i], Yvalues[i] );
 	}
 
 	Update();
@@ -449,14 +535,10 @@ void CBioPlot::SetSamples(
 	{
 		boost::mutex::scoped_lock lock(data_lock);
 
-		assert( theDataX[num_curve].size()==0 );
-		assert( theDataY[num_curve].size()==0 );
-
-		theDataX[num_curve].reserve( num );
-		for (size_t i = 0; i < num; i++) theDataX[num_curve].append( Xvalues[i] );
+		assert( theData[num_curve]->Size()==0 );
 
-		theDataY[num_curve].reserve( num );
-		for (size_t i = 0; i < num; i++) theDataY[num_curve].append( Yvalues[i] );
+		theData[num_curve]->Reserve( num );
+		for (size_t i = 0; i < num; i++) theData[num_curve]->Push( Xvalues[i], Yvalues[i] );
 	}
 
 	Update();
@@ -472,17 +554,41 @@ void CBioPlot::Update()
 		return;
 	}
 
-	// set the new data
-	for ( size_t i = 0; i < NumCurves(); i++ )
+	// add the samples queued by AddSamples()
 	{
-		theCurves[i]->setData( theDataX[i], theDataY[i] );
+		boost::mutex::scoped_lock lock(data_lock);
+		DrainQueues();
 	}
 
 	// rescale
 	SetAxisScale();
 
-	// replot
 	boost::mutex::scoped_lock lock(data_lock);
+
+	// the curves read a copy of their buffer: at most 2 points per pixel, 
+	// made here in the GUI thread, so repaints on resize or expose never 
+	// read the samples that are being appended
+	const int npix = thePlot->canvas()->width();
+	for ( size_t i = 0; i < NumCurves(); i++ )
+	{
+		CCurveBuffer & buf = *theData[i];
+
+		if ( ScaleXAxisProgressive )
+		{
+			buf.UpdateView( theXMin, theXMax, npix );
+		}
+		else if ( buf.Size() > 0 )
+		{
+			buf.UpdateView( buf.X(0), buf.BackX(), npix );
+		}
+		else
+		{
+			// empty view
+			buf.UpdateView( 0.0, 0.0, npix );
+		}
+	}
+
+	// replot
 	thePlot->replot();
 }
 
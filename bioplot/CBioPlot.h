@@ -41,9 +41,16 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <qwt-qt4/qwt_plot_curve.h>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "CCurveData.h"
 
 //! maximum number of curves
 #define BIOPLOT_MAX_CURVES 8
+//! number of samples in a block of AddSamples()
+#define BIOPLOT_BLOCK_SIZE 64
+//! number of blocks queued per curve
+#define BIOPLOT_MAX_BLOCKS 1024
 
 /** \file CBioPlot.cpp
  * implements class to plot a simple graph
@@ -75,6 +82,24 @@ public:
 	 */
 	void AddSample( const float time, const float sample, const size_t num_curve = 0 );
 
+	/** record equidistant samples without waiting for the GUI thread
+	 *  the samples are queued and added on the next Update(), NaN samples 
+	 *  are skipped; only one thread should add samples to a curve
+	 * @param[in] t0        The time coordinate of the first sample
+	 * @param[in] dt        The time between two samples
+	 * @param[in] samples   The values of the samples to record
+	 * @param[in] num       The number of samples
+	 * @param[in] num_curve The number of the curve the samples should be added to
+	 * @return number of samples queued, less than 'num' when the queue is full
+	 */
+	size_t AddSamples( const double t0, const double dt, const float * samples, 
+	                   const size_t num, const size_t num_curve = 0 );
+
+	/** size the sample buffers of all curves for the interval length
+	 * @param[in] fs        The sample rate [Hz] of the curves
+	 */
+	void SetSampleRate( const double fs );
+
 	/** replace the currently recorded samples by the ones specified
 	 * @param[in] Xvalues     The X coordinates of the samples
 	 * @param[in] YValues     The Y coordinates of the samples
@@ -94,12 +119,13 @@ public:
 			const double Xvalues[], const double Yvalues[], const size_t num,
 			const size_t num_curve = 0 );
 
-	/** remove all data and clears the graph 
+	/** remove all data and clears the graph, including the samples queued
+	 *  by AddSamples(); call it on the GUI thread
 	 *  does not reset the axis settings etc
 	 */
 	void Clear();
 
-	/** remove all data for a specific curve
+	/** remove all data for a specific curve, including its queued samples
 	 *  does not reset the axis settings etc
 	 */
 	void Clear( const size_t num_curve );
@@ -159,14 +185,37 @@ private:
 	void AddCurve( int pen_width );
 	/** Return the nuber of curves present 
 	 */
-	size_t NumCurves() const { return theDataX.size(); };
+	size_t NumCurves() const { return theData.size(); };
+	/** Grow the buffer of a curve when it can't hold the interval length
+	 */
+	void GrowBuffer( CCurveBuffer & buf );
+	/** Add a sample to a curve, with 'data_lock' locked
+	 */
+	void AppendSample( const double time, const float sample, const size_t num_curve );
+	/** Add the queued blocks of all curves, with 'data_lock' locked
+	 */
+	void DrainQueues();
 
 	QTimer * theTimer; //!< Timer to trigger updating of the graph
 
-	typedef QwtArray<double> data_t; //!< Type for the data 
-
-	std::vector<data_t> theDataX; //!< For each curve, the x (==time) data
-	std::vector<data_t> theDataY; //!< For each curve, the y (==sample) data
+	//! For each curve, the time and sample data
+	std::vector< shared_ptr<CCurveBuffer> > theData;
+
+	//! a block of equidistant samples queued by AddSamples()
+	struct SampleBlock
+	{
+		double t0;                         //!< time of the first sample
+		double dt;                         //!< time between samples
+		size_t num;                        //!< number of samples
+		float  sample[BIOPLOT_BLOCK_SIZE]; //!< sample values
+	};
+	typedef boost::lockfree::spsc_queue< SampleBlock, 
+		boost::lockfree::capacity<BIOPLOT_MAX_BLOCKS> > queue_t;
+
+	//! For each curve, the blocks from the producer thread to the GUI thread
+	std::vector< shared_ptr<queue_t> > theQueues;
+	//! For each curve, the number of samples dropped because its queue was full
+	std::vector<size_t> theDropCount;
 
 	QwtPlot      *thePlot;                //!< the actual plot to draw 
 	std::vector<QwtPlotCurve*> theCurves; //!< the curves to plot in the graph
@@ -175,6 +224,8 @@ private:
 	bool   ScaleXAxisProgressive;  //!< set to tue to automatically sclae the X-axis
 	double theTimeRange;    //!< the lenght of the interval to show on the time axis
 	double theSkipFraction; //!< the fraction of the time scape that should skip
+	double theXMin;         //!< the start of the time axis
+	double theXMax;         //!< the end of the time axis
 
 	//! mutex to lock the data while it is being written
 	mutable boost::mutex data_lock;
@@ -0,0 +1,141 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "CCurveData.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::vector;
+
+/** \file CCurveData.cpp
+ * implements a ring buffer for the samples of one curve with a min/max
+ * decimated view for plotting, the view is a copy of at most 2 samples per pixel.
+ */
+
+/** constructor
+ */
+CCurveBuffer::CCurveBuffer( const size_t capacity )
+	: theX        ( std::max<size_t>( capacity, 1 ) )
+	, theY        ( std::max<size_t>( capacity, 1 ) )
+	, theHead     ( 0 )
+	, theSize     ( 0 )
+{
+}
+
+/** grow the buffer, the samples are moved to the start of the new ring
+ */
+void CCurveBuffer::Reserve( const size_t capacity )
+{
+	if ( capacity <= theX.size() ) return;
+
+	vector<double> new_x( capacity );
+	vector<double> new_y( capacity );
+	for ( size_t i = 0; i < theSize; i++ )
+	{
+		new_x[i] = X(i);
+		new_y[i] = Y(i);
+	}
+	theX.swap( new_x );
+	theY.swap( new_y );
+	theHead = 0;
+}
+
+/** binary search, the times in the buffer are increasing
+ */
+size_t CCurveBuffer::Find( const double t ) const
+{
+	size_t lo = 0, hi = theSize;
+	while ( lo < hi )
+	{
+		size_t mid = lo + (hi-lo)/2;
+		if ( X(mid) < t ) lo = mid+1; else hi = mid;
+	}
+	return lo;
+}
+
+void CCurveBuffer::DropBefore( const double t )
+{
+	size_t n = Find( t );
+	if ( n == 0 ) return;
+
+	theHead = Index( n );
+	theSize -= n;
+}
+
+void CCurveBuffer::UpdateView( const double x0, const double x1, const int npix )
+{
+	theViewX.clear();
+	theViewY.clear();
+
+	// visible samples plus one at each side, so the line runs to the edges
+	size_t first = Find( x0 );
+	size_t last  = Find( x1 );
+	if ( first > 0 )       first--;
+	if ( last  < theSize ) last++;
+
+	if ( npix <= 0 || last - first <= 2*(size_t)npix || x1 <= x0 ) 
+	{
+		// few samples: copy them all
+		for ( size_t i = first; i < last; i++ )
+		{
+			theViewX.push_back( X(i) );
+			theViewY.push_back( Y(i) );
+		}
+		return;
+	}
+
+	// keep the minimum and maximum of every pixel column in time order
+	const double scale = npix / (x1 - x0);
+	theViewX.reserve( 2*npix + 4 );
+	theViewY.reserve( 2*npix + 4 );
+
+	size_t i = first;
+	while ( i < last )
+	{
+		const long col = (long) floor( (X(i) - x0) * scale );
+		size_t imin = i, imax = i;
+		for ( i++; i < last && (long) floor( (X(i) - x0) * scale ) == col; i++ )
+		{
+			if ( Y(i) < Y(imin) ) imin = i;
+			if ( Y(i) > Y(imax) ) imax = i;
+		}
+		const size_t ia = std::min( imin, imax );
+		const size_t ib = std::max( imin, imax );
+		theViewX.push_back( X(ia) );
+		theViewY.push_back( Y(ia) );
+		if ( ib != ia )
+		{
+			theViewX.push_back( X(ib) );
+			theViewY.push_back( Y(ib) );
+		}
+	}
+}
@@ -0,0 +1,171 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _CCURVEDATA_H_
+#define _CCURVEDATA_H_
+
+#include <vector>
+
+#include <qwt-qt4/qwt_data.h>
+#include <boost/shared_ptr.hpp>
+
+using boost::shared_ptr;
+
+/** \file CCurveData.cpp
+ * implements a fixed capacity ring buffer for the samples of one curve and 
+ * a QwtData adaptor that shows a (min/max decimated) view on it.
+ *
+ * The view is a copy made by UpdateView(), so a plot can repaint it at any 
+ * time in the GUI thread while other threads append to the ring.
+ */
+
+/** ring buffer with the time and sample values of one curve
+ *   the oldest samples are overwritten when the buffer is full
+ */
+class CCurveBuffer
+{
+public:
+	//! construct a buffer for 'capacity' samples
+	CCurveBuffer( const size_t capacity = 1 );
+
+	//! grow the buffer to 'capacity' samples, keeping all samples
+	void Reserve( const size_t capacity );
+
+	//! add a sample, overwrite the oldest one when the buffer is full
+	void Push( const double x, const double y )
+	{
+		size_t idx;
+		if ( theSize < theX.size() )
+		{
+			idx = Index( theSize++ );
+		}
+		else
+		{
+			idx = theHead;
+			if ( ++theHead == theX.size() ) theHead = 0;
+		}
+		theX[idx] = x;
+		theY[idx] = y;
+	}
+
+	//! remove all samples, the view is kept until the next UpdateView()
+	void Clear() { theHead = theSize = 0; }
+
+	//! number of samples in the buffer
+	size_t Size() const { return theSize; }
+
+	//! number of samples the buffer can hold
+	size_t Capacity() const { return theX.size(); }
+
+	//! time of sample 'i', 0 is the oldest sample
+	double X( const size_t i ) const { return theX[Index(i)]; }
+
+	//! value of sample 'i', 0 is the oldest sample
+	double Y( const size_t i ) const { return theY[Index(i)]; }
+
+	//! time of the newest sample
+	double BackX() const { return X(theSize-1); }
+
+	//! value of the newest sample
+	double BackY() const { return Y(theSize-1); }
+
+	//! index of the first sample at or after time 't' (times should be increasing)
+	size_t Find( const double t ) const;
+
+	//! remove all samples before time 't'
+	void DropBefore( const double t );
+
+	/** copy the samples between time 'x0' and 'x1' into the view for a plot 
+	 *  of 'npix' pixels wide, more than 2 samples per pixel are reduced to 
+	 *  the minimum and maximum per pixel
+	 */
+	void UpdateView( const double x0, const double x1, const int npix );
+
+	//! number of samples in the view
+	size_t ViewSize() const { return theViewX.size(); }
+
+	//! time of sample 'i' of the view
+	double ViewX( const size_t i ) const { return theViewX[i]; }
+
+	//! value of sample 'i' of the view
+	double ViewY( const size_t i ) const { return theViewY[i]; }
+
+protected:
+	//! position in 'theX' and 'theY' of sample 'i'
+	size_t Index( const size_t i ) const 
+	{
+		size_t idx = theHead + i;
+		return ( idx >= theX.size() ) ? idx - theX.size() : idx;
+	}
+
+	std::vector<double> theX;  //!< ring of sample times
+	std::vector<double> theY;  //!< ring of sample values
+	size_t theHead;            //!< position of the oldest sample
+	size_t theSize;            //!< number of samples
+
+	std::vector<double> theViewX; //!< view times, at most 2 per pixel
+	std::vector<double> theViewY; //!< view values, at most 2 per pixel
+};
+
+/** QwtData adaptor that lets a QwtPlotCurve read the view of a CCurveBuffer,
+ *  it never touches the ring that is written by the acquisition thread
+ */
+class CCurveData : public QwtData
+{
+public:
+	//! construct an adaptor on 'buffer'
+	CCurveData( shared_ptr<CCurveBuffer> buffer ) 
+		: QwtData(), theBuffer( buffer ) {};
+
+	//! destructor is empty
+	~CCurveData() {};
+
+	//! copy method is needed by QwtPlotCurve, the copy shares the buffer
+	virtual QwtData * copy() const { return new CCurveData( theBuffer ); };
+
+	//! number of points to plot
+	virtual size_t size() const { return theBuffer->ViewSize(); };
+
+	//! time of point 'i'
+	virtual double x( size_t i ) const { return theBuffer->ViewX(i); };
+
+	//! value of point 'i'
+	virtual double y( size_t i ) const { return theBuffer->ViewY(i); };
+
+protected:
+	// note: a shared_ptr is used, because the curve gets a copy of the 
+	// object, while the data will be updated all the time.
+
+	//! shared pointer to the samples
+	shared_ptr<CCurveBuffer> theBuffer;
+};
+
+#endif
@@ -30,45 +30,69 @@ THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "CSpectrumData.h"
-
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <cmath>
 
 using std::cerr;
 using std::endl;
 using std::vector;
 
-
-
 /** \file CSpectrumData.cpp
  * implements a class to hold spectral data as a function of time and frequency.
+ * The spectra are kept log10 scaled in a preallocated circular raster, so a
+ * render pass copies the raster once instead of locking it for every pixel.
+ */
+
+//! log10 value stored for empty bins: the bottom of range()
+#define LOG_MIN (-6.0f)
+
+/** return the log10 value at time t and frequency f out of 'n' rows of 'bins' 
+ *  bins with times t0 + i*dt and 'hz' Hertz per bin, 0 outside the data
  */
+static inline float lookup( const float *rows, size_t n, size_t bins, 
+	float t0, float dt, float hz, double t, double f )
+{
+	if ( t < 0 || f < 0 ) return 0;
+	if ( n < 2 || dt <= 0 || hz <= 0 ) return 0;
+	if ( t < t0 || t > t0 + (n-1)*dt ) return 0;
+
+	/* we assume that the time step is constant! */
+	size_t i = (size_t) ( (t-t0)/dt );
+
+	//! frequency is simply in Hertz, so bin is found by rounding downwards
+	size_t j = (size_t) ( f/hz );
+
+	if ( i >= n )    return 0;
+	if ( j >= bins ) return 0;
+
+	return rows[i*bins+j];
+}
 
 /** default constructor
  */
 CSpectrumData::CSpectrumData()
 	: QwtRasterData()
+	, theRaster     ( new raster_t )
+	, theRowCount   ( 0 )
+	, theBins       ( 0 )
+	, theStartTime  ( 0 )
+	, theTimeStep   ( 0 )
+	, theHertzPerBin( -1 )
 {
-	shared_ptr< vector<spectrum_t> > data_spectrum( new vector<spectrum_t> );
-	shared_ptr< vector<float>      > data_time    ( new vector<float>      );
-	shared_ptr< float              > binsize      ( new float(-1)          );
-
-	theDataSpectrum = data_spectrum;
-	theDataTime     = data_time;
-	theHertzPerBin  = binsize;
 }
 
 /** copy constructor
  */
-CSpectrumData::CSpectrumData( 
-	shared_ptr< std::vector<spectrum_t> > power_data,
-	shared_ptr< std::vector<float>      > data_x,
-	shared_ptr< float                   > binsize
-)
+CSpectrumData::CSpectrumData( shared_ptr< raster_t > raster )
 	: QwtRasterData()
-	, theDataSpectrum( power_data )
-	, theDataTime    ( data_x     )
-	, theHertzPerBin ( binsize )
+	, theRaster     ( raster )
+	, theRowCount   ( 0 )
+	, theBins       ( 0 )
+	, theStartTime  ( 0 )
+	, theTimeStep   ( 0 )
+	, theHertzPerBin( -1 )
 {
 }
 
@@ -76,7 +100,7 @@ CSpectrumData::CSpectrumData(
  */  
 QwtRasterData * CSpectrumData::copy() const
 {
-	CSpectrumData * a_copy = new CSpectrumData( theDataSpectrum, theDataTime, theHertzPerBin );
+	CSpectrumData * a_copy = new CSpectrumData( theRaster );
 	return a_copy;
 }
 
@@ -89,103 +113,222 @@ void CSpectrumData::AddSpectrum(
 	const float binsize     //!< [in] Hertz per spectrogram bin
 )
 {
-	if ( theDataTime==NULL) return;
-	if ( theDataSpectrum==NULL) return;
+	if ( theRaster==NULL || num==0 ) return;
+	raster_t &r = *theRaster;
 
-	// add empty points if necessary (i.e., if we have lost some packets/sampel points)
-	if ( theDataTime->size() >= 2)
+	/* normalize the spectrum, outside the lock */
+	double total = 0;
+	for ( size_t i = 0; i < num; i++ ) {
+		total += spectrum[i];
+	}
+	if ( total <= 0 ) total = 1;
+
+	boost::mutex::scoped_lock lock(r.lock);
+
+	// store the resolution of the vertical axis (i.e., number of Herz
+	// represented by each FFT bin) and allocate the raster once
+	if ( r.binsize < 0 )  
+	{
+		r.binsize = binsize;
+		r.rows    = MaxSpectra;
+		r.bins    = num;
+		r.power.assign( r.rows*r.bins, LOG_MIN );
+		r.time.assign ( r.rows, 0.0f );
+	}
+	else
 	{
-		boost::mutex::scoped_lock lock(data_lock);
+		if ( binsize != r.binsize || num != r.bins )
+		{
+			// the raster is laid out for the first spectrum: drop this one
+			cerr << "Spectral binsize changes, spectrum at t=" << t << " dropped!" << endl;
+			return;
+		}
+	}
 
-		float delta_t = theDataTime->at(1) - theDataTime->at(0);
+	// add empty points if necessary (i.e., if we have lost some packets/sampel points)
+	if ( r.count >= 2 )
+	{
+		size_t last = (r.head + r.rows - 1) % r.rows;
+		float  t_last = r.time[last];
 		size_t num_missing = 0;
-		while ( theDataTime->back() + 1.5*delta_t < t )
+		while ( t_last + 1.5*r.dt < t )
 		{
 			// fill in missing sample with copy of last spectrum
-			theDataTime->push_back(  theDataTime->back()+delta_t );
-			theDataSpectrum->push_back( theDataSpectrum->back()   );
+			t_last += r.dt;
+			r.time[r.head] = t_last;
+			std::copy( &r.power[last*r.bins], &r.power[last*r.bins]+r.bins, &r.power[r.head*r.bins] );
+			last = r.head;
+			r.head = (r.head + 1) % r.rows;
+			if ( r.count < r.rows ) r.count++;
 			num_missing++;
 		}
 		//if ( num_missing>0 ) cerr << "Inserted " << num_missing << " spectrum points" << endl;
-
 	}
-
-	// store the resolution of the vertical axis (i.e., number of Herz
-	// represented by each FFT bin)
-	if ( *theHertzPerBin < 0 )  
-		*theHertzPerBin = binsize;
-	else
+	else if ( r.count == 1 )
 	{
-		if ( binsize != *theHertzPerBin )
-		{
-			cerr << "Spectral binsize changes!" << endl;
-			throw;
-		}
+		r.dt = t - r.time[0];
 	}
 
-	/* copy the spectrum into a vector, and normalize! */
-	std::vector<float> spec;
-	double total = 0;
-	for ( size_t i = 0; i < num; i++ ) {
-		total += spectrum[i];
-	}
+	/* save the time and the log10 of the normalized spectrum */
+	float *row = &r.power[r.head*r.bins];
 	for ( size_t i = 0; i < num; i++ ) {
-		spec.push_back( spectrum[i]/total );
+		float val = (float) (spectrum[i]/total);
+		row[i] = ( val > 1e-6f ) ? log10f(val) : LOG_MIN;
 	}
+	r.time[r.head] = t;
+	r.head = (r.head + 1) % r.rows;
+	if ( r.count < r.rows ) r.count++;
+}
 
-	/* save the time and spectrum */
-	{
-		boost::mutex::scoped_lock lock(data_lock);
+/** return the first time we have data for
+ */
+float CSpectrumData::GetMinTime() const
+{
+	if ( theRaster==NULL ) return 0.0f;
+	boost::mutex::scoped_lock lock(theRaster->lock);
+	const raster_t &r = *theRaster;
+	if ( r.count==0 ) return 0.0f;
+	return r.time[(r.head + r.rows - r.count) % r.rows];
+}
 
-		theDataTime->push_back( t );
-		theDataSpectrum->push_back( spec );
-	}
+/** return the last time we have data for
+ */
+float CSpectrumData::GetMaxTime() const
+{
+	if ( theRaster==NULL ) return 0.0f;
+	boost::mutex::scoped_lock lock(theRaster->lock);
+	const raster_t &r = *theRaster;
+	if ( r.count==0 ) return 0.0f;
+	return r.time[(r.head + r.rows - 1) % r.rows];
+}
 
-	/* remove some elements if the data becomes too large */
-	while ( theDataTime->size() > 250 ) 
-	{
-		const size_t del_num = 25;
+/** Copy all spectra, oldest first, into 'rows' with two block copies
+ *  @return the number of spectra
+ */
+size_t CSpectrumData::GetRows(
+	std::vector<float> &rows, //!< [out] spectra of 'bins' log10 values each
+	float &t0,                //!< [out] time of the first spectrum
+	float &dt,                //!< [out] time step between spectra
+	size_t &bins,             //!< [out] number of bins per spectrum
+	float &binsize            //!< [out] number of Hertz per bin
+) const
+{
+	if ( theRaster==NULL ) return 0;
+	boost::mutex::scoped_lock lock(theRaster->lock);
+	const raster_t &r = *theRaster;
+
+	bins = r.bins; dt = r.dt; binsize = r.binsize; t0 = 0;
+	if ( r.count==0 ) return 0;
+
+	size_t first = (r.head + r.rows - r.count) % r.rows;
+	size_t n1 = std::min( r.count, r.rows - first );
+	rows.resize( r.count*r.bins );
+	std::copy( r.power.begin() + first*r.bins, r.power.begin() + (first+n1)*r.bins, rows.begin() );
+	std::copy( r.power.begin(), r.power.begin() + (r.count-n1)*r.bins, rows.begin() + n1*r.bins );
+	t0 = r.time[first];
+	return r.count;
+}
 
-		boost::mutex::scoped_lock lock(data_lock);
+/** take a snapshot of the raster, so that value() doesn't need the lock
+ */
+void CSpectrumData::initRaster( const QwtDoubleRect &, const QSize & )
+{
+	theRowCount = GetRows( theRows, theStartTime, theTimeStep, theBins, theHertzPerBin );
+}
 
-		theDataTime->erase( theDataTime->begin(), theDataTime->begin()+del_num );
-		theDataSpectrum->erase( theDataSpectrum->begin(), theDataSpectrum->begin()+del_num );
-	}
+/** release the snapshot of the raster
+ */
+void CSpectrumData::discardRaster()
+{
+	theRowCount = 0;
 }
 
 /** return the value at time t and frequency f
  */
 double CSpectrumData::value( double t, double f ) const
 {
-	if ( t < 0 ) return 0;
-	if ( f < 0 ) return 0;
-
-	boost::mutex::scoped_lock lock( data_lock);
-
-	if ( theDataTime == NULL || theDataTime->size()<2 ) return 0;
-	if ( t < GetMinTime()  ||  t > GetMaxTime() ) return 0;
-
-	if ( *theHertzPerBin < 0 ) 
+	/* within a render pass: use the snapshot */
+	if ( theRowCount > 0 )
 	{
-		cerr << "Spectum binsize was not initialized yet! This can't happen" << endl;
-		throw;
+		return lookup( &theRows[0], theRowCount, theBins, 
+			theStartTime, theTimeStep, theHertzPerBin, t, f );
 	}
 
-	/* calculate the correct index in the time dimension
-	 * we assume that the time step is constant!
-	 */
-	double t_stepsize = theDataTime->at(1)-theDataTime->at(0);
-	double t_start    = theDataTime->at(0);
-	size_t i = (size_t) ( (t-t_start)/t_stepsize );
-
-	//! frequency is simply in Hertz, so bin is found by rounding downwards
-	size_t j = (size_t) ( f / *theHertzPerBin );
-
-	if ( i >= theDataSpectrum->size() )      return 0;
-	if ( j >= (*theDataSpectrum)[i].size() ) return 0;
+	if ( theRaster==NULL ) return 0;
+	boost::mutex::scoped_lock lock(theRaster->lock);
+	const raster_t &r = *theRaster;
+	if ( r.count < 2 ) return 0;
+
+	/* look up the row in the circular raster */
+	size_t first = (r.head + r.rows - r.count) % r.rows;
+	float  t0 = r.time[first];
+	if ( t < t0 || t > t0 + (r.count-1)*r.dt ) return 0;
+	if ( r.dt <= 0 || t < 0 || f < 0 ) return 0;
+	size_t i = (first + (size_t) ((t-t0)/r.dt)) % r.rows;
+	size_t j = (size_t) ( f/r.binsize );
+	if ( j >= r.bins ) return 0;
+	return r.power[i*r.bins+j];
+}
 
-	float val = theDataSpectrum->at(i).at(j);
+/** Render the pixels at times 't' (columns) and frequencies 'f' (rows) into an
+ *  indexed image with color table 'colors' spanning range(): the raster is 
+ *  copied once and each pixel is a table lookup.
+ *  @return image of t.size() x f.size() pixels
+ */
+QImage CSpectrumData::RenderImage( 
+	const std::vector<double> &t, //!< [in] time of each column
+	const std::vector<double> &f, //!< [in] frequency of each row
+	const QVector<QRgb> &colors   //!< [in] color table of the value range
+) const
+{
+	QImage image( (int) t.size(), (int) f.size(), QImage::Format_Indexed8 );
+	if ( image.isNull() || colors.size()==0 ) return image;
+	image.setColorTable( colors );
+
+	vector<float> rows;
+	float  t0, dt, hz;
+	size_t bins;
+	size_t n = GetRows( rows, t0, dt, bins, hz );
+
+	/* color index of each column and row: -1 is outside the data */
+	const QwtDoubleInterval r = range();
+	const int   nc    = colors.size() - 1;
+	const float scale = nc / (r.maxValue() - r.minValue());
+	const unsigned char outside = (unsigned char) nc; /* value 0: top of range() */
+	vector<int> col( t.size(), -1 );
+	vector<int> bin( f.size(), -1 );
+	if ( n >= 2 && dt > 0 && hz > 0 )
+	{
+		for ( size_t x = 0; x < t.size(); x++ ) {
+			if ( t[x] >= t0 && t[x] <= t0 + (n-1)*dt ) col[x] = (int) ( (t[x]-t0)/dt );
+			if ( col[x] >= (int) n ) col[x] = -1;
+		}
+		for ( size_t y = 0; y < f.size(); y++ ) {
+			if ( f[y] >= 0 ) bin[y] = (int) ( f[y]/hz );
+			if ( bin[y] >= (int) bins ) bin[y] = -1;
+		}
+	}
 
-	return log10f(val);
+	/* precompute the color index of every stored value, once per bin row */
+	vector<unsigned char> index( n );
+	for ( size_t y = 0; y < f.size(); y++ )
+	{
+		unsigned char *line = image.scanLine( (int) y );
+		if ( bin[y] < 0 ) 
+		{
+			memset( line, outside, t.size() );
+			continue;
+		}
+		if ( y == 0 || bin[y] != bin[y-1] )
+		{
+			for ( size_t i = 0; i < n; i++ ) {
+				float v = ( rows[i*bins+bin[y]] - r.minValue() ) * scale;
+				index[i] = (unsigned char) ( v < 0 ? 0 : ( v > nc ? nc : v + 0.5f ) );
+			}
+		}
+		for ( size_t x = 0; x < t.size(); x++ ) {
+			line[x] = ( col[x] < 0 ) ? outside : index[col[x]];
+		}
+	}
+	return image;
 }
-
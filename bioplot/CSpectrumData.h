@@ -32,6 +32,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _CSPECTRUMDATA_H_
 #define _CSPECTRUMDATA_H_
 
+#include <vector>
+#include <QImage>
+#include <QVector>
 #include <qwt-qt4/qwt_raster_data.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
@@ -43,63 +46,79 @@ using boost::shared_ptr;
 class CSpectrumData : public QwtRasterData
 {
 public:
-	typedef std::vector<float> spectrum_t;
+	//! number of spectra kept in the history
+	static const size_t MaxSpectra = 250;
+
+	/** circular time x bins raster of log10 normalized spectra, shared by all copies */
+	struct raster_t
+	{
+		raster_t() : rows(0), bins(0), head(0), count(0), dt(0.0f), binsize(-1.0f) {};
+
+		size_t rows;               //!< number of spectra that fit in the raster
+		size_t bins;               //!< number of bins per spectrum
+		size_t head;               //!< row of the next spectrum
+		size_t count;              //!< number of stored spectra
+		float  dt;                 //!< time step between spectra
+		float  binsize;            //!< number of Hertz per bin
+		std::vector<float> power;  //!< rows*bins log10 of the normalized spectra
+		std::vector<float> time;   //!< time of each row
+		boost::mutex lock;         //!< locks the raster while it is being written
+	};
 
 	//! default constructor
 	CSpectrumData();
 	//! copy constructor
-	CSpectrumData( 
-		shared_ptr< std::vector<spectrum_t> > power_data,
-		shared_ptr< std::vector<float>      > data_t,
-		shared_ptr< float                   > binsize
-	);
+	CSpectrumData( shared_ptr< raster_t > raster );
 
-	//! destructor is empty:w
+	//! destructor is empty
 	~CSpectrumData() {};
 
 	//! copy method is needed by QwtSpectrumPlot
 	virtual QwtRasterData * copy() const;
 
-	//! add a spectrum at time t
+	//! add a spectrum at time t, a spectrum with another layout than the first one is dropped
 	void AddSpectrum( const float t, const float * spectrum, const size_t num, const float binsize );
 
 	//! return the first time we have data for
-	float GetMinTime() const 
-	{ 
-		if ( theDataTime==NULL || theDataTime->size()==0 )  return 0.0f;
-		float min = theDataTime->front();
-		return min;
-	}
+	float GetMinTime() const;
 
 	//! return the last time we have data for
-	float GetMaxTime() const 
-	{ 
-		if ( theDataTime==NULL || theDataTime->size()==0 )  return 0.0f;
-		float max = theDataTime->back();
-		return max;
-	}
+	float GetMaxTime() const;
+
+	//! copy all spectra, oldest first, into 'rows'; return the number of spectra
+	size_t GetRows( std::vector<float> &rows, float &t0, float &dt, size_t &bins, float &binsize ) const;
 
 	//! return the frequency range we can handle (note: we're returning logarithms!)
 	QwtDoubleInterval range() const { return QwtDoubleInterval(-6,0); };
 
+	//! take a snapshot of the raster before a render pass
+	virtual void initRaster( const QwtDoubleRect &area, const QSize &raster );
+
+	//! release the snapshot after a render pass
+	virtual void discardRaster();
+
 	//! return the value at time t and frequency f
 	double value( double t, double f ) const;
 
+	//! render the pixels at times 't' and frequencies 'f' with 'colors' into an image
+	QImage RenderImage( const std::vector<double> &t, const std::vector<double> &f, 
+		const QVector<QRgb> &colors ) const;
 
 protected:
 	// note: we have to use shared_ptrs here, because the spectogram plotting
 	// function gets a copy of the object, which will be made once, while the
 	// data will be updated all the time.
 
-	//! shared pointers to the sprectrum data and x coordinates of each point
-	shared_ptr< std::vector<spectrum_t> > theDataSpectrum;
-	shared_ptr< std::vector<float>      > theDataTime;
-
-	//! the number of Hertz per bin in the spectrums
-	shared_ptr<float> theHertzPerBin;
+	//! shared pointer to the spectrum raster
+	shared_ptr< raster_t > theRaster;
 
-	//! mutex to lock the data while it is being written
-	mutable boost::mutex data_lock;
+	//! snapshot of the raster taken by initRaster, used by value()
+	std::vector<float> theRows;
+	size_t theRowCount;   //!< number of spectra in the snapshot, 0 if there is none
+	size_t theBins;       //!< number of bins per spectrum in the snapshot
+	float  theStartTime;  //!< time of the first spectrum in the snapshot
+	float  theTimeStep;   //!< time step between spectra in the snapshot
+	float  theHertzPerBin;//!< number of Hertz per bin in the snapshot
 };
 
 
@@ -70,7 +70,7 @@ CSpectrumPlot::CSpectrumPlot(const char * title, float HzMin, float HzMax)
 
 	// initialize the spectrum data and the actual plot
 	theData = new CSpectrumData();
-	theSpectrogram = new QwtPlotSpectrogram();
+	theSpectrogram = new CSpectrogram();
 	theSpectrogram->setData( *theData );
 	theSpectrogram->attach( thePlot );
 
@@ -186,6 +186,29 @@ void CSpectrumPlot::SetAxisScale()
 
 
 
+/** Render the spectrogram image of 'area': the pixel times and frequencies are
+ *  mapped once and CSpectrumData fills the image from one copy of its raster.
+ */
+QImage CSpectrogram::renderImage( const QwtScaleMap &xMap, const QwtScaleMap &yMap, 
+	const QwtDoubleRect &area ) const
+{
+	const CSpectrumData *spec = dynamic_cast<const CSpectrumData *>( &data() );
+	if ( spec == NULL || area.isEmpty() )
+		return QwtPlotSpectrogram::renderImage( xMap, yMap, area );
+
+	const QRect rect = transform( xMap, yMap, area );
+	if ( rect.isEmpty() ) return QImage();
+
+	std::vector<double> t( rect.width()  );
+	std::vector<double> f( rect.height() );
+	for ( int x = 0; x < rect.width(); x++ )
+		t[x] = xMap.invTransform( rect.left() + x );
+	for ( int y = 0; y < rect.height(); y++ )
+		f[y] = yMap.invTransform( rect.top() + y );
+
+	return spec->RenderImage( t, f, colorMap().colorTable( spec->range() ) );
+}
+
 void CSpectrumPlot::update()
 {
 	if (thePlot==NULL) return;
@@ -40,6 +40,15 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CSpectrumData.h"
 
+/** spectrogram that renders CSpectrumData in one pass over its raster */
+class CSpectrogram : public QwtPlotSpectrogram
+{
+protected:
+	/** render the image of 'area' in bulk, instead of one value() call per pixel */
+	virtual QImage renderImage( const QwtScaleMap &xMap, const QwtScaleMap &yMap, 
+		const QwtDoubleRect &area ) const;
+};
+
 class CSpectrumPlot : public QWidget
 {
 	Q_OBJECT
@@ -66,7 +75,7 @@ private:
 	void SetAxisScale();
 
 	QwtPlot            *thePlot;        /**< contains the actual plotting area */
-	QwtPlotSpectrogram *theSpectrogram; /**< contains the spectrogram plot */
+	CSpectrogram       *theSpectrogram; /**< contains the spectrogram plot */
 	CSpectrumData      *theData;        /**< contains the data to be plotted */
 
 	QTimer * theTimer; /**< timer to update the graph a few times per second */
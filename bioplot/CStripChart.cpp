@@ -0,0 +1,404 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+
+#include "CStripChart.h"
+
+using std::cerr;
+using std::endl;
+
+//! maximum number of samples per lane
+#define MAX_BUFFER_SIZE (1<<22)
+//! width of the titles and labels left of the lanes [pixels]
+#define LEFT_MARGIN   96
+//! height of the time axis below the lanes [pixels]
+#define BOTTOM_MARGIN 18
+//! space around the lanes [pixels]
+#define BORDER         4
+//! fraction of a lane that is kept free above and below the line
+#define LANE_PADDING  0.1
+
+//! line colors, repeated when there are more lanes
+static const QRgb LaneColors[] = {
+	0x0000C0, 0xC00000, 0x008000, 0x8000C0, 0xC06000, 0x008080, 0x404040
+};
+
+CStripChart::CStripChart( const size_t num_lanes, const double ival_len, 
+	const double update_freq, QWidget * parent ) 
+	: QWidget( parent ), theTimer( NULL ), theAxesDirty( true ), 
+	  theTimeRange( ival_len ), theXMax( 0.0 )
+{
+	const size_t ncol = sizeof(LaneColors)/sizeof(LaneColors[0]);
+
+	theLanes.resize( num_lanes );
+	for ( size_t i = 0; i < num_lanes; i++ )
+	{
+		Lane & lane = theLanes[i];
+		lane.queue.reset( new queue_t() );
+		lane.drops = 0;
+		lane.dt    = 0.0;
+		lane.color = QColor( LaneColors[i%ncol] );
+		lane.ymin  = lane.ymax = 0.0;
+	}
+
+	// everything is painted in paintEvent(), skip the background fill
+	setAttribute( Qt::WA_OpaquePaintEvent );
+	setMinimumSize( LEFT_MARGIN+100, BOTTOM_MARGIN+20*num_lanes );
+
+	// set a time to update the chart
+	theTimer = new QTimer();
+	connect(theTimer, SIGNAL(timeout()), this, SLOT(Update()));
+	SetUpdateFreq( update_freq );
+}
+
+CStripChart::~CStripChart()
+{
+	if (theTimer!=NULL) delete theTimer;
+}
+
+void CStripChart::SetTitle( const size_t lane, const char * title )
+{
+	if ( lane >= NumLanes() ) return;
+	theLanes[lane].title = QString( title );
+	theAxesDirty = true;
+}
+
+void CStripChart::SetColor( const size_t lane, const uint8_t R, const uint8_t G, const uint8_t B )
+{
+	if ( lane >= NumLanes() ) return;
+	theLanes[lane].color = QColor( R, G, B );
+	theAxesDirty = true;
+}
+
+void CStripChart::SetUpdateFreq( const double freq )
+{
+	theTimer->stop();
+	if ( freq > 0.0 ) theTimer->start( std::max( 1, (int)( 1000.0/freq ) ) );
+}
+
+void CStripChart::SetSampleRate( const double fs, const size_t lane )
+{
+	if ( lane >= NumLanes() || fs <= 0.0 ) return;
+
+	size_t size = (size_t) ( fs*theTimeRange*1.1 ) + 2;
+	if ( size > MAX_BUFFER_SIZE ) size = MAX_BUFFER_SIZE;
+	theLanes[lane].buf.Reserve( size );
+}
+
+void CStripChart::Clear()
+{
+	SampleBlock block;
+
+	for ( size_t i = 0; i < NumLanes(); i++ )
+	{
+		// the queued blocks belong to the old data: the GUI thread is the consumer
+		while ( theLanes[i].queue->pop( block ) ) {}
+		theLanes[i].drops = 0;
+		theLanes[i].buf.Clear();
+		theLanes[i].lines.resize( 0 );
+	}
+	update();
+}
+
+size_t CStripChart::AddSamples( const double t0, const double dt, const float * samples, 
+	const size_t num, const size_t lane )
+{
+	// sanity check
+	if ( lane >= NumLanes() ) return 0;
+
+	queue_t & queue = *theLanes[lane].queue;
+	SampleBlock block;
+
+	size_t i = 0;
+	while ( i < num )
+	{
+		block.t0  = t0 + i*dt;
+		block.dt  = dt;
+		block.num = std::min<size_t>( num-i, STRIPCHART_BLOCK_SIZE );
+		std::copy( &samples[i], &samples[i+block.num], block.sample );
+		if ( !queue.push( block ) )
+		{
+			// the GUI thread is behind: drop samples, never wait for it
+			if ( theLanes[lane].drops == 0 ) 
+			{
+				cerr << "# Warning: strip chart queue of lane " << lane << " full, dropping samples" << endl;
+			}
+			theLanes[lane].drops += num-i;
+			break;
+		}
+		i += block.num;
+	}
+	return i;
+}
+
+/** move the queued blocks into the sample buffers
+ */
+void CStripChart::DrainQueues()
+{
+	SampleBlock block;
+
+	for ( size_t c = 0; c < NumLanes(); c++ )
+	{
+		Lane & lane = theLanes[c];
+		while ( lane.queue->pop( block ) )
+		{
+			// the blocks carry the sample rate: size the buffer on a change
+			if ( block.dt > 0.0 && lane.dt != block.dt )
+			{
+				lane.dt = block.dt;
+				SetSampleRate( 1.0/block.dt, c );
+			}
+			for ( size_t i = 0; i < block.num; i++ )
+			{
+				if ( std::isnan( block.sample[i] ) ) continue;
+				AppendSample( block.t0+i*block.dt, block.sample[i], c );
+			}
+		}
+	}
+}
+
+void CStripChart::AppendSample( const double time, const float sample, const size_t lane )
+{
+	CCurveBuffer & buf = theLanes[lane].buf;
+
+	if ( buf.Size()>0 && time < buf.BackX() )
+	{
+		cerr << "# WARNING: data points for lane "<< lane <<" are going back in time (last time=" 
+			<< buf.BackX() << ", new time=" << time << ")!!!" << endl;
+		buf.Clear();
+	}
+
+	// grow the buffer when it is full but doesn't hold the interval length yet
+	if ( buf.Size() == buf.Capacity() && buf.Capacity() < MAX_BUFFER_SIZE &&
+	     ( buf.Size() < 2 || buf.BackX() - buf.X(0) < theTimeRange*1.1 ) )
+	{
+		buf.Reserve( std::min<size_t>( 2*buf.Capacity(), MAX_BUFFER_SIZE ) );
+	}
+	buf.Push( time, sample );
+}
+
+/** expand the range of a lane at once when the samples leave it, shrink it 
+ *  only when the samples use less than a quarter of it; this keeps the 
+ *  labels, and so the cached axes, stable for most frames
+ */
+bool CStripChart::ScaleLane( const size_t c )
+{
+	Lane & lane = theLanes[c];
+	const size_t n = lane.buf.ViewSize();
+	if ( n == 0 ) return false;
+
+	double vmin = lane.buf.ViewY(0), vmax = vmin;
+	for ( size_t i = 1; i < n; i++ )
+	{
+		const double y = lane.buf.ViewY(i);
+		if ( y < vmin ) vmin = y;
+		if ( y > vmax ) vmax = y;
+	}
+
+	const double range = lane.ymax - lane.ymin;
+	if ( range > 0.0 && vmin >= lane.ymin && vmax <= lane.ymax && 
+	     vmax - vmin >= 0.25*range ) return false;
+
+	// a flat line gets a range around its value
+	double pad = LANE_PADDING*( vmax - vmin );
+	if ( pad <= 0.0 ) pad = std::max( 0.5*fabs( vmax ), 1e-6 );
+
+	lane.ymin = vmin - pad;
+	lane.ymax = vmax + pad;
+	return true;
+}
+
+void CStripChart::Update()
+{
+	// add the samples queued by AddSamples()
+	DrainQueues();
+
+	// the time axis ends at the newest sample of all lanes
+	double xmax = -std::numeric_limits<double>::infinity();
+	for ( size_t c = 0; c < NumLanes(); c++ )
+	{
+		if ( theLanes[c].buf.Size() > 0 ) xmax = std::max( xmax, theLanes[c].buf.BackX() );
+	}
+	if ( std::isinf( xmax ) ) return;
+	theXMax = xmax;
+
+	// the lanes read the view of their buffer: at most 2 points per pixel
+	const int npix = PlotRect().width();
+	for ( size_t c = 0; c < NumLanes(); c++ )
+	{
+		theLanes[c].buf.UpdateView( theXMax-theTimeRange, theXMax, npix );
+		if ( ScaleLane( c ) ) theAxesDirty = true;
+	}
+
+	update();
+}
+
+QRect CStripChart::PlotRect() const
+{
+	return QRect( LEFT_MARGIN, BORDER, 
+		std::max( 1, width()-LEFT_MARGIN-BORDER ), 
+		std::max( 1, height()-BORDER-BOTTOM_MARGIN ) );
+}
+
+/** map the view of a lane to line segments, one segment per pair of 
+ *  neighbouring samples, the line is broken where samples are missing
+ */
+void CStripChart::BuildLines( const size_t c )
+{
+	Lane & lane = theLanes[c];
+	const CCurveBuffer & buf = lane.buf;
+	const QRect r = PlotRect();
+	const double h = (double) r.height() / NumLanes();
+	const size_t n = buf.ViewSize();
+
+	lane.lines.reserve( 2*r.width() + 4 );
+	lane.lines.resize( 0 );
+	if ( n < 2 || lane.ymax <= lane.ymin ) return;
+
+	const double x0 = theXMax - theTimeRange;
+	const double sx = r.width() / theTimeRange;
+	const double sy = h / ( lane.ymax - lane.ymin );
+	const double top = r.top() + c*h;
+	// more than 2 missing samples, but never within a pixel column
+	const double gap = std::max( 2.5*lane.dt, 2.0/sx );
+
+	double px = r.left() + ( buf.ViewX(0) - x0 )*sx;
+	double py = top + ( lane.ymax - buf.ViewY(0) )*sy;
+	for ( size_t i = 1; i < n; i++ )
+	{
+		const double qx = r.left() + ( buf.ViewX(i) - x0 )*sx;
+		const double qy = top + ( lane.ymax - buf.ViewY(i) )*sy;
+		if ( lane.dt <= 0.0 || buf.ViewX(i) - buf.ViewX(i-1) <= gap )
+		{
+			lane.lines.append( QLineF( px, py, qx, qy ) );
+		}
+		px = qx; py = qy;
+	}
+}
+
+/** format a label of the value axis with about 3 significant digits
+ */
+static QString AxisLabel( const double v )
+{
+	return QString::number( v, 'g', 3 );
+}
+
+void CStripChart::RenderAxes()
+{
+	const QRect r = PlotRect();
+	const double h = (double) r.height() / NumLanes();
+
+	theAxes = QPixmap( size() );
+	theAxes.fill( palette().color( QPalette::Window ) );
+
+	QPainter painter( &theAxes );
+	const QFontMetrics fm = painter.fontMetrics();
+
+	// lanes with alternating background, title and value range
+	for ( size_t c = 0; c < NumLanes(); c++ )
+	{
+		const Lane & lane = theLanes[c];
+		const int top = r.top() + (int) ( c*h );
+		const int bot = r.top() + (int) ( (c+1)*h );
+
+		painter.fillRect( r.left(), top, r.width(), bot-top, 
+			( c%2 == 0 ) ? QColor( 255, 255, 255 ) : QColor( 244, 244, 244 ) );
+
+		painter.setPen( lane.color );
+		painter.drawText( QRect( BORDER, top, LEFT_MARGIN-2*BORDER, bot-top ), 
+			Qt::AlignLeft | Qt::AlignVCenter, lane.title );
+
+		if ( lane.ymax > lane.ymin && bot-top > 2*fm.height() )
+		{
+			painter.setPen( Qt::darkGray );
+			painter.drawText( QRect( BORDER, top, LEFT_MARGIN-2*BORDER, fm.height() ), 
+				Qt::AlignRight | Qt::AlignTop, AxisLabel( lane.ymax ) );
+			painter.drawText( QRect( BORDER, bot-fm.height(), LEFT_MARGIN-2*BORDER, fm.height() ), 
+				Qt::AlignRight | Qt::AlignBottom, AxisLabel( lane.ymin ) );
+		}
+	}
+
+	// time axis relative to the newest sample: 1, 2 or 5 times a power of 10
+	double step = pow( 10.0, floor( log10( theTimeRange/10.0 ) ) );
+	if ( theTimeRange/step > 10.0 ) step *= 2.0;
+	if ( theTimeRange/step > 10.0 ) step *= 2.5;
+
+	const double sx = r.width() / theTimeRange;
+	painter.setPen( QPen( Qt::gray, 0, Qt::DotLine ) );
+	for ( double t = 0.0; t <= theTimeRange + 1e-9; t += step )
+	{
+		const int x = r.right() - (int) ( t*sx );
+		painter.drawLine( x, r.top(), x, r.bottom() );
+	}
+	painter.setPen( Qt::black );
+	for ( double t = 0.0; t <= theTimeRange + 1e-9; t += step )
+	{
+		const int x = r.right() - (int) ( t*sx );
+		const QString label = ( t == 0.0 ) ? QString( "0 s" ) : AxisLabel( -t );
+		const int w = fm.width( label );
+		painter.drawText( std::min( x-w/2, width()-w ), r.bottom()+fm.ascent()+2, label );
+	}
+	painter.drawRect( r.adjusted( 0, 0, -1, -1 ) );
+
+	theAxesDirty = false;
+}
+
+void CStripChart::resizeEvent( QResizeEvent * event )
+{
+	theAxesDirty = true;
+	QWidget::resizeEvent( event );
+}
+
+void CStripChart::paintEvent( QPaintEvent * )
+{
+	if ( theAxesDirty || theAxes.size() != size() ) RenderAxes();
+
+	QPainter painter( this );
+	painter.drawPixmap( 0, 0, theAxes );
+	painter.setClipRect( PlotRect() );
+
+	// one call per lane, all segments of a lane share the pen
+	for ( size_t c = 0; c < NumLanes(); c++ )
+	{
+		BuildLines( c );
+		if ( theLanes[c].lines.isEmpty() ) continue;
+		painter.setPen( QPen( theLanes[c].color, 0 ) );
+		painter.drawLines( theLanes[c].lines );
+	}
+}
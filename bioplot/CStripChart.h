@@ -0,0 +1,182 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CSTRIPCHART_H_
+#define CSTRIPCHART_H_
+
+#include <vector>
+
+#include <QWidget>
+#include <QTimer>
+#include <QPixmap>
+#include <QVector>
+#include <QLineF>
+#include <QColor>
+#include <QString>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "CCurveData.h"
+
+//! number of samples in a block of AddSamples()
+#define STRIPCHART_BLOCK_SIZE 64
+//! number of blocks queued per lane
+#define STRIPCHART_MAX_BLOCKS 1024
+
+/** \file CStripChart.cpp
+ * implements a strip chart that draws many channels in one widget
+ */
+
+/** strip chart with one horizontal lane per channel
+ *   all lanes are drawn in one paint pass: the axes, labels and lane frames
+ *   are cached in a pixmap and every lane is a single drawLines() call on 
+ *   its min/max decimated view, so the cost per frame does not depend on 
+ *   the sample rate but on the width of the widget
+ */
+class CStripChart : public QWidget
+{
+	Q_OBJECT
+	
+public:
+	/** construct a strip chart
+	 * @param[in] num_lanes        The number of channels to plot
+	 * @param[in] ival_len         The length of the time interval to display [s]
+	 * @param[in] update_freq      Update frequency of the chart [Hz]
+	 * @param[in] parent           The parent widget
+	 */
+	CStripChart( const size_t num_lanes = 1, const double ival_len = 5.0, 
+	             const double update_freq = 60.0, QWidget * parent = 0 );
+	~CStripChart();
+
+	/** record equidistant samples without waiting for the GUI thread
+	 *  the samples are queued and added on the next Update(), NaN samples 
+	 *  are skipped; only one thread should add samples to a lane; the 
+	 *  sample buffer of the lane is sized for 'dt' on the GUI thread
+	 * @param[in] t0        The time coordinate of the first sample
+	 * @param[in] dt        The time between two samples
+	 * @param[in] samples   The values of the samples to record
+	 * @param[in] num       The number of samples
+	 * @param[in] lane      The lane the samples should be added to
+	 * @return number of samples queued, less than 'num' when the queue is full
+	 */
+	size_t AddSamples( const double t0, const double dt, const float * samples, 
+	                   const size_t num, const size_t lane = 0 );
+
+	/* set the title of a lane, shown left of the lane */
+	void SetTitle( const size_t lane, const char * title );
+
+	/* set the color of a lane */
+	void SetColor( const size_t lane, const uint8_t R, const uint8_t G, const uint8_t B );
+
+	/** Set the update frequency of the chart (in Hz)
+	 */
+	void SetUpdateFreq( const double freq = 60.0 );
+
+	/** remove all data of all lanes, including the samples queued by
+	 *  AddSamples(); call it on the GUI thread
+	 */
+	void Clear();
+
+	/** Return the number of lanes
+	 */
+	size_t NumLanes() const { return theLanes.size(); };
+
+public slots:
+	/** add the queued samples and schedule a repaint
+	 */
+	void Update();
+
+protected:
+	//! draw the cached axes and the lines of all lanes
+	void paintEvent( QPaintEvent * event );
+	//! the cached axes are redrawn at the new size
+	void resizeEvent( QResizeEvent * event );
+
+private:
+	/** Add the queued blocks of all lanes
+	 */
+	void DrainQueues();
+	/** Size the sample buffer of a lane for the interval length at sample 
+	 *  rate 'fs' [Hz], only on the GUI thread
+	 */
+	void SetSampleRate( const double fs, const size_t lane );
+	/** Add a sample to a lane
+	 */
+	void AppendSample( const double time, const float sample, const size_t lane );
+	/** Follow the range of the samples in view, returns true when it changed
+	 */
+	bool ScaleLane( const size_t lane );
+	/** Build the line segments of a lane for the current view
+	 */
+	void BuildLines( const size_t lane );
+	/** Draw the axes, lane frames and labels into 'theAxes'
+	 */
+	void RenderAxes();
+	/** The rectangle of the lanes in widget coordinates
+	 */
+	QRect PlotRect() const;
+
+	//! a block of equidistant samples queued by AddSamples()
+	struct SampleBlock
+	{
+		double t0;                            //!< time of the first sample
+		double dt;                            //!< time between samples
+		size_t num;                           //!< number of samples
+		float  sample[STRIPCHART_BLOCK_SIZE]; //!< sample values
+	};
+	typedef boost::lockfree::spsc_queue< SampleBlock, 
+		boost::lockfree::capacity<STRIPCHART_MAX_BLOCKS> > queue_t;
+
+	//! everything that is kept for one channel
+	struct Lane
+	{
+		CCurveBuffer      buf;     //!< time and sample data
+		shared_ptr<queue_t> queue; //!< blocks from the producer thread
+		size_t            drops;   //!< samples dropped because the queue was full
+		double            dt;      //!< time between samples, 0 when unknown
+		QString           title;   //!< shown left of the lane
+		QColor            color;   //!< color of the line
+		double            ymin;    //!< bottom of the lane
+		double            ymax;    //!< top of the lane
+		QVector<QLineF>   lines;   //!< line segments of the current view
+	};
+
+	QTimer * theTimer;          //!< Timer to trigger updating of the chart
+	std::vector<Lane> theLanes; //!< the channels
+
+	QPixmap theAxes;            //!< cached frames, labels and axes
+	bool    theAxesDirty;       //!< 'theAxes' must be redrawn
+
+	double theTimeRange;        //!< the length of the interval to show on the time axis
+	double theXMax;             //!< the end of the time axis
+};
+
+#endif // CSTRIPCHART_H_
@@ -142,6 +142,7 @@ int32_t main(int32_t argc, char *argv[]) {
   char        oname[MNCN];  /**< output EDF/BDF file */
   char        txt[MNCN];    /**< annotation text */
   edf_annot_t *ap=NULL;      /**< annotation array */
+  edf_annot_idx_t *ai;      /**< annotation index */
   int32_t     na=0;         /**< number of annotations in array 'p' */
   int32_t     i;            /**< general index */
   edf_t       edf;          /**< EDF/BDF structure */
@@ -225,8 +226,14 @@ int32_t main(int32_t argc, char *argv[]) {
     }
   }
 
+  /* sort annotations on onset, 'edf_add_annot' inserts them in record order */
+  if ((ai=edf_annot_idx_new(ap,na,edf.NrOfDataRecords,NULL,edf.RecordDuration))==NULL) {
+    return(-1);
+  }
+
   /* add 'na' annotations in 'p' into 'edf' */
-  edf_add_annot(&edf,ap,na);
+  edf_add_annot(&edf,ai->p,ai->n);
+  edf_annot_idx_free(ai);
   
   /* write EDF/BDF headers and samples */
   fprintf(stderr,"# Write annotated EDF/BDF file %s\n",oname);
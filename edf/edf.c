@@ -458,26 +458,16 @@ int32_t edf_set_record_cnt(FILE *fp, int32_t rec_cnt) {
   return(0);
 }
 
-/** Read EDF/BDF signal headers from file 'fp' into 'sig' 
- *   by using info of 'edf'.
+/** Parse EDF/BDF signal headers out of 'buf' of 256*NrOfSignals characters
+ *   into the already allocated signals of 'edf'.
  * @return number of characters parsed.
 */
-int32_t edf_rd_signal_hdr(FILE *fp, edf_t *edf) {
+int32_t edf_parse_signal_hdr(char *buf, edf_t *edf) {
 
-  const size_t buf_size = sizeof(char) * 256*edf->NrOfSignals;
-  char *buf = alloca( buf_size ); /**< character buffer */
-  size_t br;                      /**< character read */
   int32_t idx=0;        /**< character pointer in 'buf' */
   int32_t i,j;          /**< signal and item counter */
   edf_signal_t *sig=edf->signal;
 
-  assert(sizeof(char)==1);
-  
-  if ((br=fread(buf,1,buf_size,fp))!=buf_size) {
-    fprintf(stderr,"# EDF/BDF signal header too small %zd\n",br);
-    return(-1);
-  }
-  
   for (j=0; j<10; j++) {
     for (i=0; i<edf->NrOfSignals; i++) {
       switch (j) {
@@ -515,6 +505,28 @@ int32_t edf_rd_signal_hdr(FILE *fp, edf_t *edf) {
       }
     }
   }
+  return(idx);
+}
+
+/** Read EDF/BDF signal headers from file 'fp' into 'sig' 
+ *   by using info of 'edf'.
+ * @return number of characters parsed.
+*/
+int32_t edf_rd_signal_hdr(FILE *fp, edf_t *edf) {
+
+  const size_t buf_size = sizeof(char) * 256*edf->NrOfSignals;
+  char *buf = alloca( buf_size ); /**< character buffer */
+  size_t br;                      /**< character read */
+  int32_t idx=0;        /**< character pointer in 'buf' */
+
+  assert(sizeof(char)==1);
+  
+  if ((br=fread(buf,1,buf_size,fp))!=buf_size) {
+    fprintf(stderr,"# EDF/BDF signal header too small %zd\n",br);
+    return(-1);
+  }
+  
+  idx=edf_parse_signal_hdr(buf,edf);
 
   if (edf->NrOfDataRecords<=0) {
     fprintf(stderr,"# Warning: NrOfDataRecord %d <= 0\n",edf->NrOfDataRecords);
@@ -524,21 +536,15 @@ int32_t edf_rd_signal_hdr(FILE *fp, edf_t *edf) {
   return(idx);
 }
 
-/** Read EDF/BDF main + signal headers from file 'fp' into 'edf'
+/** Parse EDF/BDF main header out of the 256 characters of 'buf' into 'edf'
+ * @note the signal headers are not allocated
  * @return number of characters parsed.
 */
-int32_t edf_rd_hdr(FILE *fp, edf_t *edf) {
+int32_t edf_parse_hdr(char *buf, edf_t *edf) {
 
-  char    buf[256];  /**< character buffer */
-  int64_t br=-1;     /**< bytes read */
   int32_t idx=1;     /**< character index, skip first character */
   struct  tm cal;    /**< broken calendar time */
   
-  if ((br=fread(buf,1,sizeof(buf),fp))!=sizeof(buf)) {
-    fprintf(stderr,"# EDF/BDF header too small %"PRIu64"d\n",br);
-    return(-1);
-  }
-  
 //  edf_get_str(buf,&idx,edf->Version,7); /**< will kill leading spaces */
   strncpy(edf->Version,&buf[idx],7); edf->Version[7]='\0'; idx+=7;
 
@@ -576,6 +582,27 @@ int32_t edf_rd_hdr(FILE *fp, edf_t *edf) {
   edf->NrOfDataRecords=edf_get_int(buf,&idx,8);
   edf->RecordDuration=edf_get_double(buf,&idx,8);
   edf->NrOfSignals=edf_get_int(buf,&idx,4);
+  edf->rts=NULL;
+  edf->sum=NULL;
+  
+  return(idx);
+}
+
+/** Read EDF/BDF main + signal headers from file 'fp' into 'edf'
+ * @return number of characters parsed.
+*/
+int32_t edf_rd_hdr(FILE *fp, edf_t *edf) {
+
+  char    buf[256];  /**< character buffer */
+  int64_t br=-1;     /**< bytes read */
+  int32_t idx=0;     /**< character index */
+  
+  if ((br=fread(buf,1,sizeof(buf),fp))!=sizeof(buf)) {
+    fprintf(stderr,"# EDF/BDF header too small %"PRIu64"d\n",br);
+    return(-1);
+  }
+  
+  idx=edf_parse_hdr(buf,edf);
 
   /* allocate space for all signals */
   edf->signal=(edf_signal_t *)calloc(edf->NrOfSignals,sizeof(edf_signal_t));
@@ -597,6 +624,10 @@ void edf_free( edf_t * edf )
     if ( edf->signal[j].data != NULL ) free( edf->signal[j].data );
   }
   if ( edf->signal != NULL )  free( edf->signal );
+  if ( edf->rts != NULL )  free( edf->rts );
+  edf->rts=NULL;
+  edf_sum_free(edf->sum);
+  edf->sum=NULL;
 }
 
 /** Write EDF/BDF main header 'edf' to file 'fp' 
@@ -833,9 +864,9 @@ int32_t edf_wr_samples(FILE *fp, edf_t *edf, int32_t first, int32_t last) {
   for (k=first; k<=last; k++) {
     for (j=0; j<edf->NrOfSignals; j++) {
       if (j==acn) {
-        idx=k*ANNOTRECSIZE/4;
-        tsc+=fwrite(&(edf->signal[j].data[idx]),1,
-               edf->signal[j].NrOfSamplesPerRecord*sampleSize,fp);
+        /* all annotation bytes of a record follow each other */
+        tsc+=fwrite((char *)edf->signal[j].data+(size_t)k*edf->signal[j].NrOfSamplesPerRecord*sampleSize,
+               1,edf->signal[j].NrOfSamplesPerRecord*sampleSize,fp);
       } else {
         idx=k*edf->signal[j].NrOfSamplesPerRecord;
         for (i=0; i<edf->signal[j].NrOfSamplesPerRecord; i++) {
@@ -884,28 +915,68 @@ int32_t edf_wr_file(char *fname, edf_t *edf, int32_t first, int32_t last) {
   return(nc);
 }
 
+/** selected channels and print modes of edf_prt_hex_samples() */
+typedef struct EDF_PRT_T {
+  edf_t   *edf;
+  uint64_t chn;         /**< selected channels */
+  uint64_t hex;         /**< hexadecimal channels */
+  uint64_t val;         /**< float channels */
+  float    gain[64];    /**< physical units per digital unit */
+} edf_prt_t;
+
+/** Format sample 'i' of all selected channels of 'arg' into 's'
+ * @return number of characters in 's'
+*/
+static int32_t edf_prt_row(char *s, int64_t i, void *arg) {
+
+  edf_prt_t *p=(edf_prt_t *)arg;
+  int32_t j;
+  int32_t n=0;
+  int32_t yi;           /**< integer representation of sample 'y' */
+  int32_t ovf;          /**< sample overflow bit */
+
+  s[n++]=' '; n+=edf_fmt_int(&s[n],i,8);
+  for (j=0; j<p->edf->NrOfSignals; j++) {
+    if (p->chn&(1LL<<j)) {
+      /* get integer value and overflow bit of sample 'i' in channel 'j' */
+      yi = edf_get_integer_overflow_value(p->edf, j, (int32_t)i, &ovf);
+      s[n++]=' ';
+      if (p->val&(1LL<<j)) {
+        n+=edf_fmt_fixed(&s[n],p->gain[j]*yi,8,2);
+      } else
+      if (p->hex&(1LL<<j)) {
+        n+=edf_fmt_hex(&s[n],(uint32_t)yi,8);
+      } else {
+        n+=edf_fmt_int(&s[n],yi,8);
+      }
+    }
+  }
+  s[n++]='\n';
+  return(n);
+}
+
 /** Print EDF/BDF integer samples of selected channels 'chn'
  *   hexadecimal mode 'hex' and float printing mode 'val'
  *   print header hdr==1, no header hdr==0
+ * @note rows are formatted by the threads set with edf_fmt_set_nt()
  * @return number of printed characters
 */
 int32_t edf_prt_hex_samples(FILE *fp, edf_t *edf, uint64_t chn, uint64_t hex, uint64_t val, int32_t hdr) {
  
   int32_t j;            /**< sample counter per block */
-  int32_t i;
   int32_t nc=0;
+  int32_t nsel=0;       /**< number of selected channels */
   uint8_t FirstChannel;
-  int32_t yi;           /**< integer representation of sample 'y' */
-  int32_t ovf;          /**< sample overflow bit */
-  float   gain[64];
+  edf_prt_t p;
   
   /* print all signal labels */
   if (hdr) { nc+=fprintf(fp," %8s","sc"); }
   for (j=0; j<edf->NrOfSignals; j++) {
-    gain[j] = (float) ((edf->signal[j].PhysicalMax - edf->signal[j].PhysicalMin) /
-                       (edf->signal[j].DigitalMax  - edf->signal[j].DigitalMin));
+    p.gain[j] = (float) ((edf->signal[j].PhysicalMax - edf->signal[j].PhysicalMin) /
+                         (edf->signal[j].DigitalMax  - edf->signal[j].DigitalMin));
     if (chn&(1LL<<j)) {
       if (hdr) { nc+=fprintf(fp," %8s",edf->signal[j].Label); }
+      nsel++;
     }
   }
   if (hdr) { nc+=fprintf(fp,"\n"); }
@@ -915,24 +986,11 @@ int32_t edf_prt_hex_samples(FILE *fp, edf_t *edf, uint64_t chn, uint64_t hex, ui
   while ( ( chn & (1LL<<FirstChannel) ) == 0 ) { FirstChannel++; }
 
   /* print all samples */
-  for (i=0; i<edf->signal[FirstChannel].NrOfSamples; i++) {
-    nc+=fprintf(fp," %8d",i);
-    for (j=0; j<edf->NrOfSignals; j++) {
-      if (chn&(1LL<<j)) {
-        /* get integer value and overflow bit of sample 'i' in channel 'j' */
-        yi = edf_get_integer_overflow_value(edf, j, i, &ovf);
-        if (val&(1LL<<j)) {
-          nc+=fprintf(fp," %8.2f",gain[j]*yi);
-        } else
-        if (hex&(1LL<<j)) {
-          nc+=fprintf(fp," %08X",yi);
-        } else {
-          nc+=fprintf(fp," %8d",yi);
-        }
-      }
-    }
-    nc+=fprintf(fp,"\n");
-  }
+  p.edf=edf; p.chn=chn; p.hex=hex; p.val=val;
+  /* a row holds at most 'nsel' float samples and 'sc', the last number needs 
+     EDFFMTMAXW characters of scratch space */
+  nc+=(int32_t)edf_fmt_rows(fp,edf_prt_row,&p,edf->signal[FirstChannel].NrOfSamples,
+    (nsel+1)*(EDFFMTFLTW+1)+EDFFMTMAXW+9+1,0);
 
   return(nc);
 }
@@ -1020,13 +1078,29 @@ int32_t edf_cpy_chn(edf_t *edf, char *name, char *newname) {
   return(flt);
 }
 
+/** Get summary of record 'r' of signal 'chn' out of 'edf->sum'
+ * @return pointer to record summary, NULL when not summarized
+*/
+static const edf_sum_t *edf_rec_sum(const edf_t *edf, int32_t chn, int32_t r) {
+
+  const edf_sum_idx_t *si=edf->sum;  /**< summary index */
+
+  if ((si==NULL) || (chn<0) || (chn>=si->ns) || (r<0) || (r>=si->nr[0])) {
+    return(NULL);
+  }
+  return(&si->sum[0][r*si->ns+chn]);
+}
+
 /* Check range of all 'EEG' channels of a nexus recording
  * @return number of channels with more than 5% overflow problems
  * @note 'edf' struct appended with overflow bit per sample at bit position 30 = 1<<30
+ * @note only records out of range in the summary 'edf->sum' are checked when loaded
 */
 int32_t edf_range_chk(edf_t *edf) {
   
   int32_t  i,j;       /**< channel numbers */
+  int32_t  spr;       /**< samples per record */
+  const edf_sum_t *rs; /**< summary of the current record */
   float    gain;      /**< channel gain */
   int32_t  yi;        /**< integer representation of sample 'y' */
   float    y;         /**< sample */
@@ -1046,9 +1120,17 @@ int32_t edf_range_chk(edf_t *edf) {
       gain = (float) ((edf->signal[j].PhysicalMax - edf->signal[j].PhysicalMin) /
                       (edf->signal[j].DigitalMax  - edf->signal[j].DigitalMin));
       cnt=0;
+      spr=edf->signal[j].NrOfSamplesPerRecord;
       for (i=0; i < edf->signal[j].NrOfSamples; i++) {
+        /* skip records with summary 'min' and 'max' in range */
+        if ((spr>0) && (i%spr==0) && ((rs=edf_rec_sum(edf,j,i/spr))!=NULL) &&
+            (gain*rs->min >= ymin) && (gain*rs->min <= ymax) &&
+            (gain*rs->max >= ymin) && (gain*rs->max <= ymax)) {
+          i+=spr-1;
+          continue;
+        }
         /* get integer sample 'i' of channel 'j' */
-        yi = edf_get_integer_value(edf, j, i);
+        yi = edf_sample(&edf->signal[j], i, edf->bdf);
         /* convert to float value */
         y = gain * yi;
         if ((y < ymin) || (y > ymax)) { 
@@ -1083,7 +1165,7 @@ int32_t edf_range_cnt(edf_t *edf) {
       cnt=0;
       for (i=0; i < edf->signal[j].NrOfSamples; i++) {
         /* check overflow bit of sample 'i' in channel 'j' */
-        if (edf_get_overflow_value(edf, j, i) == OVERFLOWBIT) { cnt ++; } 
+        if (edf_sample_ovf(&edf->signal[j], i) == OVERFLOWBIT) { cnt ++; } 
       }
       if (cnt>0) {
         err = (float) ((100.0*cnt)/edf->signal[j].NrOfSamples);
@@ -1161,8 +1243,52 @@ int32_t edf_quantile(edf_t *edf, int32_t k, float *q, int32_t n, int32_t *a) {
   return(fnd);
 }
 
+/** Find minimum 'mini' and maximum 'maxi' of samples 'i0' up to 'i1' (excluded)
+ *   of signal 'k' in 'edf', out of summary 'edf->sum' when the samples are whole records
+*/
+static void edf_fnd_min_max(edf_t *edf, int32_t k, int32_t i0, int32_t i1,
+  int32_t *mini, int32_t *maxi) {
+
+  int32_t spr=edf->signal[k].NrOfSamplesPerRecord; /**< samples per record */
+  int32_t i;          /**< sample index */
+  int32_t sample;     /**< integer data sample */
+  edf_sum_t s;        /**< summary of the records */
+
+  if ((spr>0) && (i0%spr==0) && (i1%spr==0) && (edf_rec_sum(edf,k,i1/spr-1)!=NULL) &&
+      (edf_sum_range(edf->sum,k,i0/spr,i1/spr,&s)>0)) {
+    (*mini)=s.min; (*maxi)=s.max;
+    return;
+  }
+  (*mini)=edf_get_integer_value(edf, k, i0);
+  (*maxi)=(*mini);
+  for (i=i0; i<i1; i++) {
+    sample = edf_get_integer_value(edf, k, i);
+    if (sample < (*mini)) { (*mini)=sample; } else
+    if (sample > (*maxi)) { (*maxi)=sample; }
+  }
+}
+
+/** Check whether record 'r' of signal 'k' in 'edf' has no rising edge through 'thr'
+ *   according to summary 'edf->sum'
+ * @return 1 when the record can be skipped, 0 otherwise
+*/
+static int32_t edf_no_edge(edf_t *edf, int32_t k, int32_t r, int32_t thr) {
+
+  const edf_sum_t *rs;  /**< summary of record 'r' */
+  const edf_sum_t *ps;  /**< summary of record 'r-1' */
+
+  if ((rs=edf_rec_sum(edf,k,r))==NULL) { return(0); }
+  /* all samples below or all samples and the preceding sample above threshold */
+  if (rs->max < thr) { return(1); }
+  if ((rs->min >= thr) && ((r==0) || (((ps=edf_rec_sum(edf,k,r-1))!=NULL) && (ps->min >= thr)))) {
+    return(1);
+  }
+  return(0);
+}
+
 /** Find corresponding threshold for "binair" signal 'k' in 'edf' data
  *   by dividing whole recording period in 'nb' blocks
+ * @note block ranges and edges are taken from the summary 'edf->sum' when loaded
  * @return number of epochs analyzed 
 */
 int32_t edf_fnd_thr(edf_t *edf, int32_t k, int32_t nb) {
@@ -1177,7 +1303,8 @@ int32_t edf_fnd_thr(edf_t *edf, int32_t k, int32_t nb) {
   int32_t mean;       /**< mean per block */
   int32_t i,i0;       /**< sample index */
   int32_t j;          /**< block index */
-  int32_t sample;     /**< integer data sample */
+  int32_t i1;         /**< end of block */
+  int32_t spr;        /**< samples per record */
   int32_t thr=0;      /**< threshold value */
   int32_t diff,pdiff; /**< intersample difference */
   int32_t overload=0; /**< overload counter */
@@ -1196,15 +1323,10 @@ int32_t edf_fnd_thr(edf_t *edf, int32_t k, int32_t nb) {
 
   i=0; j=0; cnt=0; mean=0; p2p=0;
   while (i<edf->signal[k].NrOfSamples) {
-    /* get integer value and overflow bit of sample 'i' in channel 'k' */
-    mini = edf_get_integer_value(edf, k, i);
-    maxi = mini;
-    while ((i<(j+1)*ns) && (i<edf->signal[k].NrOfSamples)) {
-      sample = edf_get_integer_value(edf, k, i);
-      if (sample < mini) { mini=sample; } else
-      if (sample > maxi) { maxi=sample; }
-      i++;
-    }
+    /* minimum and maximum of block 'j' in channel 'k' */
+    i1=((j+1)*ns < edf->signal[k].NrOfSamples) ? (j+1)*ns : edf->signal[k].NrOfSamples;
+    edf_fnd_min_max(edf, k, i, i1, &mini, &maxi);
+    i=i1;
     if (((maxi-mini)>p2p_ok) && ((maxi-mini)<10*p2p_ok)) {
       /* this block has light on and off states */
       mean+=(maxi+mini)/2;
@@ -1236,8 +1358,14 @@ int32_t edf_fnd_thr(edf_t *edf, int32_t k, int32_t nb) {
   ns=(int32_t)round(edf->signal[k].NrOfSamplesPerRecord * EDGE_DURATION / edf->RecordDuration);
 
   /* check rising edge of stimuli (display) signal on overflow */
+  spr=edf->signal[k].NrOfSamplesPerRecord;
   i=1; j=0; 
   while (i<edf->signal[k].NrOfSamples) {
+    /* skip records without rising edge in the summary */
+    if ((spr>0) && ((i%spr==0) || (i==1)) && edf_no_edge(edf, k, i/spr, thr)) {
+      i=(i/spr+1)*spr;
+      continue;
+    }
     if ((edf_get_integer_value(edf, k, i-1) < thr) && (edf_get_integer_value(edf, k, i) >= thr)) {
       /* found rising edge */
       diff=0;
@@ -2154,6 +2282,207 @@ int32_t edf_remove_switching_backlight(edf_t *edf, double dt) {
   return(tcnt);
 }
 
+/** Get length of the run of samples equal to the first of 'n' samples 'x'
+ * @return run length 1..n (0 when n<1)
+*/
+int32_t edf_flat_len(const int32_t *x, int32_t n) {
+
+  int32_t i=1,k;    /**< sample index */
+  int32_t d;        /**< difference bits of a block */
+  int32_t x0;       /**< first sample */
+
+  if (n<1) { return(0); }
+  x0=x[0];
+  /* compare blocks of 8 samples at once (vectorized by the compiler) */
+  while (i+8 <= n) {
+    d=0;
+    for (k=0; k<8; k++) { d |= (x[i+k]^x0); }
+    if (d!=0) { break; }
+    i+=8;
+  }
+  while ((i<n) && (x[i]==x0)) { i++; }
+  return(i);
+}
+
+/** Add run of 'len' samples starting at sample 'start' to run list 'rl'
+ *   merging it with the last run when they touch or overlap.
+ * @return number of runs in 'rl', <0 on failure
+*/
+int32_t edf_runs_add(edf_runs_t *rl, int32_t start, int32_t len) {
+
+  edf_run_t *last;  /**< last run in 'rl' */
+
+  if (len<1) { return(rl->n); }
+  if (rl->n>0) {
+    last=&rl->r[rl->n-1];
+    if ((start >= last->start) && (start <= last->start+last->len)) {
+      if (start+len > last->start+last->len) { last->len = start+len-last->start; }
+      return(rl->n);
+    }
+  }
+  /* check available storage space */
+  if (rl->n>=rl->size) {
+    rl->size+=CHUNKSIZE;
+    if ((rl->r=(edf_run_t *)realloc(rl->r,rl->size*sizeof(edf_run_t)))==NULL) {
+      fprintf(stderr,"# Error: not enough memory to allocate %d runs!!!\n",rl->size);
+      rl->n=0; rl->size=0;
+      return(-1);
+    }
+  }
+  rl->r[rl->n].start=start; rl->r[rl->n].len=len;
+  rl->n++;
+  return(rl->n);
+}
+
+/** Free all runs in run list 'rl'
+*/
+void edf_runs_free(edf_runs_t *rl) {
+
+  if (rl->r!=NULL) free(rl->r);
+  rl->r=NULL; rl->n=0; rl->size=0;
+}
+
+/** Find all runs of more than 'minrep' samples equal to their preceding sample
+ *   in 'n' samples 'x' and add them to 'rl' with sample offset 'ofs'.
+ * @note the first sample of a flat serie is not part of the run and a flat
+ *   serie up to the last sample is no run (e.g. an unused constant signal)
+ * @return number of runs found
+*/
+int32_t edf_fnd_flat_runs(const int32_t *x, int32_t n, int32_t minrep, int32_t ofs, edf_runs_t *rl) {
+
+  int32_t i=0;      /**< sample index */
+  int32_t len;      /**< length of flat serie */
+  int32_t cnt=0;    /**< number of found runs */
+
+  while (i<n) {
+    len=edf_flat_len(&x[i], n-i);
+    if ((len-1 > minrep) && (i+len < n)) {
+      edf_runs_add(rl, ofs+i+1, len-1);
+      cnt++;
+    }
+    i+=len;
+  }
+  return(cnt);
+}
+
+/** Merge run lists 'a' and 'b' (both sorted on start) into 'c'
+ * @return number of runs in 'c'
+*/
+int32_t edf_runs_merge(const edf_runs_t *a, const edf_runs_t *b, edf_runs_t *c) {
+
+  int32_t i=0,j=0;      /**< run index in 'a' and 'b' */
+  const edf_run_t *r;   /**< next run */
+
+  while ((i<a->n) || (j<b->n)) {
+    if ((j>=b->n) || ((i<a->n) && (a->r[i].start <= b->r[j].start))) {
+      r=&a->r[i++];
+    } else {
+      r=&b->r[j++];
+    }
+    if (edf_runs_add(c, r->start, r->len)<0) { break; }
+  }
+  return(c->n);
+}
+
+/** Find all runs of more than 'minrep' equal samples in signal 'k' of 'edf' like
+ *   edf_fnd_flat_runs() and add them to 'rl', only scanning the records around
+ *   records with a flat serie of at least half a run in summary 'edf->sum'.
+ * @note a longer run is split over at most two records or covers a whole
+ *   record, so the unflagged records next to a scanned window cut no runs
+ * @return number of runs found
+*/
+static int32_t edf_fnd_flat_runs_sum(edf_t *edf, int32_t k, int32_t minrep, edf_runs_t *rl) {
+
+  int32_t ns=edf->signal[k].NrOfSamples;            /**< number of samples */
+  int32_t spr=edf->signal[k].NrOfSamplesPerRecord;  /**< samples per record */
+  int32_t nr;         /**< number of records */
+  int32_t half;       /**< minimum flat serie of a record to scan */
+  int32_t r,r0,r1;    /**< record index and window */
+  int32_t cnt=0;      /**< number of found runs */
+
+  half=(minrep+3)/2;
+  nr=(spr>0) ? ns/spr : 0;
+  if ((spr<half) || (nr*spr!=ns) || (edf_rec_sum(edf,k,nr-1)==NULL)) {
+    return(edf_fnd_flat_runs(edf->signal[k].data, ns, minrep, 0, rl));
+  }
+  r=0;
+  while (r<nr) {
+    if (edf->sum->sum[0][r*edf->sum->ns+k].flat < half) { r++; continue; }
+    /* window of flagged records with one unflagged record on both sides */
+    r0=(r>0) ? r-1 : 0;
+    r1=r+1;
+    while ((r1<nr) && ((edf->sum->sum[0][r1*edf->sum->ns+k].flat >= half) ||
+           ((r1+1<nr) && (edf->sum->sum[0][(r1+1)*edf->sum->ns+k].flat >= half)))) { r1++; }
+    if (r1<nr) { r1++; }
+    cnt+=edf_fnd_flat_runs(&edf->signal[k].data[r0*spr], (r1-r0)*spr, minrep, r0*spr, rl);
+    r=r1;
+  }
+  return(cnt);
+}
+
+/** Find all missing packets in 'edf': runs of more than 7 equal samples in the
+ *   first 4 signals, the first and last 16 samples of the recording.
+ * @note the missing samples are returned as sample index runs in empty run list 'rl'
+ * @return percentage of missing samples
+*/
+double edf_fnd_miss(edf_t *edf, edf_runs_t *rl) {
+
+  int32_t  j,k;               /**< general index */
+  int32_t  ns;                /**< number of samples */
+  int32_t  spr;               /**< samples per record */
+  int32_t  tot=0;             /**< total number of missing samples */
+  edf_runs_t cr={NULL,0,0};   /**< runs of one channel */
+  edf_runs_t mr={NULL,0,0};   /**< merged runs */
+  edf_runs_t tmp;             /**< run list swap buffer */
+
+  /* channel with the most samples per record */
+  k=0;
+  for (j=1; j<edf->NrOfSignals; j++) {
+    if (edf->signal[j].NrOfSamplesPerRecord > edf->signal[k].NrOfSamplesPerRecord) { k=j; }
+  }
+  ns=edf->signal[k].NrOfSamples;
+  spr=edf->signal[k].NrOfSamplesPerRecord;
+
+  /* remove first 16 samples of recording to kill connection problems */
+  edf_runs_add(rl, 0, (ns<16) ? ns : 16);
+
+  /* EDF+D/BDF+D: missed packets are gaps between records, not flat samples */
+  if ((edf->rts==NULL) && (strcmp(&edf->DataFormatVersion[1],"DF+D")==0)) { edf_get_rts(edf); }
+  if ((edf->rts!=NULL) && (strcmp(&edf->DataFormatVersion[1],"DF+D")==0)) {
+    /* remove first 16 samples after a gap to kill reconnection problems */
+    for (j=1; j<edf->NrOfDataRecords; j++) {
+      if (edf_rts_gap(edf,j) != 0.0) { edf_runs_add(rl, j*spr, 16); }
+    }
+  } else {
+    /* check for missed packets in first 4 EEG signals */
+    for (j=0; (j<4) && (j<edf->NrOfSignals); j++) {
+      cr.n=0;
+      edf_fnd_flat_runs_sum(edf, j, 7, &cr);
+      mr.n=0;
+      edf_runs_merge(rl, &cr, &mr);
+      tmp=(*rl); (*rl)=mr; mr=tmp;
+    }
+  }
+
+  /* remove last 16 samples of recording to kill disconnection problems */
+  if (ns>16) {
+    cr.n=0;
+    edf_runs_add(&cr, ns-16, 16);
+    mr.n=0;
+    edf_runs_merge(rl, &cr, &mr);
+    tmp=(*rl); (*rl)=mr; mr=tmp;
+  }
+  edf_runs_free(&cr);
+  edf_runs_free(&mr);
+
+  for (j=0; j<rl->n; j++) {
+    /* clip runs on the recording length */
+    if (rl->r[j].start+rl->r[j].len > ns) { rl->r[j].len = ns-rl->r[j].start; }
+    if (rl->r[j].len > 0) { tot += rl->r[j].len; }
+  }
+  return((ns>0) ? (100.0*tot)/ns : 0.0);
+}
+
 /** Add extra signal 'RejectedEpochs' for missing packets in 'edf'
  *   or delta overflow of more than 2 succeeding samples 
  * @return percentage of Rejected Epochs or delta overflow samples
@@ -2162,9 +2491,9 @@ double edf_chk_miss(edf_t *edf) {
   
   int32_t  i,j,k;   /**< general index */
   double   fs;      /**< sampling frequency */
-  int32_t  rl;      /**< run length */
-  int32_t  dy;      /**< delta between 2 succeeding samples */
   int32_t  rep;     /**< channel number of rejected epochs */
+  edf_runs_t rl={NULL,0,0}; /**< runs of missing samples */
+  double   err;     /**< percentage of missing samples */
   
   fprintf(stderr,"# Info: edf check for missing packets 1\n");
   
@@ -2197,91 +2526,30 @@ double edf_chk_miss(edf_t *edf) {
     edf->NrOfSignals++;
   } 
   
-  /* reset all overflow samples to 0: 'no problem' */
-  //for (i=0; i<edf->signal[rep].NrOfSamples; i++) { edf->signal[rep].data[i] = 0; }  
-  
-  /* check for missed packets in first 4 EEG signals */
-  for (j=0; j<4; j++) {
-    rl=0;
-    for (i=1; i<edf->signal[j].NrOfSamples; i++) {
-      if (edf->signal[j].data[i] == edf->signal[j].data[i-1]) {
-        rl++;
-      } else {
-        if (rl>7) {
-          for (k=0; k<rl; k++) {
-            edf->signal[rep].data[i-k-1]++;
-          }
-        }
-        rl=0;
-      }
-    }
-  }
+  /* find missing packets as runs of missing samples */
+  err=edf_fnd_miss(edf, &rl);
 
-  /* check for missing data in first 4 channels */
-  for (i=0; i<edf->signal[rep].NrOfSamples; i++) {
-    if (edf->signal[rep].data[i]>0) {
+  /* mark missing samples with -1 and all other samples with 0 */
+  memset(edf->signal[rep].data, 0, edf->signal[rep].NrOfSamples*sizeof(int32_t));
+  for (j=0; j<rl.n; j++) {
+    for (i=rl.r[j].start; (i<rl.r[j].start+rl.r[j].len) && (i<edf->signal[rep].NrOfSamples); i++) {
       edf->signal[rep].data[i]=-1;
-    } else {
-      edf->signal[rep].data[i]=0;
     }
   }
    
   if (vb&0x200) {
     /* show missing packet info */
     fs=edf->signal[rep].NrOfSamplesPerRecord / edf->RecordDuration;
-    rl=0; k=0; 
-    for (i=0; i<edf->signal[rep].NrOfSamples; i++) {
-      if (edf->signal[rep].data[i] == -1) {
-        rl++;
-      } else {
-        if (rl>7) {
-          if (k==0) {
-            fprintf(stderr,"# missing packets info\n");
-            fprintf(stderr,"# %3s %9s %9s\n","nr","t","dt");
-          } 
-          fprintf(stderr,"# %3d %9.3f %9.3f\n",k,(i-rl)/fs,rl/fs);
-          k++;
-        }
-        rl=0;
-      }
+    fprintf(stderr,"# missing packets info\n");
+    fprintf(stderr,"# %3s %9s %9s\n","nr","t","dt");
+    for (j=0; j<rl.n; j++) {
+      fprintf(stderr,"# %3d %9.3f %9.3f\n",j,rl.r[j].start/fs,rl.r[j].len/fs);
     }
   }
+  edf_runs_free(&rl);
 
-  /* Mark all delta overflows in first 4 EEG signals */
-  for (j=0; j<4; j++) {
-    rl=0;
-    for (i=1; i<edf->signal[j].NrOfSamples; i++) {
-      dy=abs(edf->signal[j].data[i] - edf->signal[j].data[i-1]);
-      if (dy==((1<<15)-1)) {
-        rl++;
-      } else {
-        if (rl>1) {
-          for (k=0; k<rl; k++) {
-//            edf->signal[rep].data[i-k-1]=-2;
-          }
-        }
-        rl=0;
-      }
-    }
-  }
-  
-  /* remove first 16 samples of recording to kill connection problems */
-  for (i=0; i<16 && i<edf->signal[rep].NrOfSamples; i++) {
-    edf->signal[rep].data[i]=-1;
-  }
-  
-  /* remove last 16 samples of recording to kill disconnection problems */
-  for (i=edf->signal[rep].NrOfSamples-16; i<edf->signal[rep].NrOfSamples; i++) {
-    edf->signal[rep].data[i]=-1;
-  }
-
-  k=0;
-  for (i=0; i<edf->signal[rep].NrOfSamples; i++) {
-    if (edf->signal[rep].data[i]<0) { k++; }
-  }
-    
   /* return number of missed packets */
-  return((100.0*k)/edf->signal[rep].NrOfSamples);
+  return(err);
 }
 
 /** Mark all samples from 't0' to 't1' [s] as useless
@@ -2663,6 +2931,20 @@ int32_t edf_add_annot(edf_t *edf, edf_annot_t *p, int32_t n) {
   return(rv);
 }
 
+/** Compare onset of two annotations (passed by reference); used by qsort()
+ * @return 0 if a and b are equal, -1 if a is earlier, 1 if a is later than b
+ */
+static int annot_comp_func(const void* ap, const void* bp) {
+
+  const edf_annot_t *a = (const edf_annot_t *) ap;
+  const edf_annot_t *b = (const edf_annot_t *) bp;
+
+  if (a->sec < b->sec) { return(-1); } else
+  if (a->sec > b->sec) { return( 1); } else
+  if (a->sc  < b->sc ) { return(-1); } else
+  if (a->sc  > b->sc ) { return( 1); } else { return(0); }
+}
+
 /** Get annotation from edf structure 'edf' 
  * @return array pointer to annotation array
  * @note the number of annotation is returned in 'n'.
@@ -2683,12 +2965,12 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
   char     txt[ANNOTRECSIZE];
   int32_t  tnc=0;       /**< number of annotation character in current record */
   int32_t  bs=0;        /**< block size */
-  int32_t  idx;         /**< block index */
+  int32_t  rb=0;        /**< annotation bytes per record */
+  int64_t  idx;         /**< block index [byte] */
   int32_t  imsr;        /**< index of channel with most samples per record */
   char     token[ANNOTRECSIZE];       /**< token for parsing line */
   int32_t  st,tc,cnt;   /**< parse state, token counter, annotation counter */
   char     aname[32];   /**< EDF/BDF Annotation name */
-  edf_annot_t tmp;
   
   fprintf(stderr,"# Info: get EDF/BDF annotations\n");
   
@@ -2709,9 +2991,6 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
   }
   
   if (acn>=0) {
-    /* byte per annotation block in internal edf data structure */
-    //bs=edf->signal[acn].NrOfSamplesPerRecord*bps;
-    bs=ANNOTRECSIZE;
     /* channel with the most samples per record determines the samplerate */
     imsr=0; 
     for (j=1; j<edf->NrOfSignals; j++) {
@@ -2734,6 +3013,7 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
     }
     
     /* allocate space for timestamp of all records */
+    if (edf->rts!=NULL) { free(edf->rts); }
     if ((edf->rts=(double *)calloc(edf->NrOfDataRecords,sizeof(double)))==NULL) {
       fprintf(stderr,"# Error not enough memory to allocate %d record timestamp!!!\n",
                 edf->NrOfDataRecords);
@@ -2744,10 +3024,14 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
     
     fprintf(stderr,"# Info: annotation channel nr %d\n", acn);
      
+    /* byte per annotation block in internal edf data structure, ANNOTRECSIZE 
+       after edf_rd_samples(), only the first ANNOTRECSIZE are parsed */
+    rb=edf->signal[acn].NrOfSamplesPerRecord*((edf->bdf==1) ? 3 : 2);
+    bs=(rb<ANNOTRECSIZE) ? rb : ANNOTRECSIZE;
     dp=edf->signal[acn].data; idx=0;
     for (k=0; k<edf->NrOfDataRecords; k++) {
       /* get characters */
-      memcpy(buf, (char *)&dp[idx], bs);
+      memcpy(buf, (char *)dp+idx, bs);
       
       if (vb&0x2000) {
         prt_char_buf(stderr, "# buf", buf, bs);
@@ -2818,8 +3102,7 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
         i++;
       }
       
-      //idx+=edf->signal[acn].NrOfSamplesPerRecord;
-      idx += bs/4;
+      idx += rb;
     } 
 
     fprintf(stderr,"# Info: found %d annotations\n", tnc);
@@ -2836,9 +3119,14 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
       
   }
   
+  /* no annotation channel: no record timestamps */
+  if ((p==NULL) && (edf->rts!=NULL)) {
+    free(edf->rts); edf->rts=NULL;
+  }
+
   /* check timestamps of all records */
   tc = 0;
-  for (i=1; i < edf->NrOfDataRecords; i++) {
+  for (i=1; (p!=NULL) && (i < edf->NrOfDataRecords); i++) {
     if (fabs((edf->rts[i] - edf->rts[i-1] - edf->RecordDuration)/edf->RecordDuration) > 0.0001) {
       if (vb&0x2000) {
         fprintf(stderr,"#Warning: time axis gap at record %d on t %.1f [s] of %.1f [s] long\n",
@@ -2863,16 +3151,266 @@ edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n) {
   }
 
   /* sort all annotations */
-  for (i=0; i<tnc-1; i++) {
-    for (j=i+1; j<tnc; j++) {
-      if (p[i].sec > p[j].sec) {
-        tmp = p[i]; p[i]=p[j]; p[j]=tmp;
-      }
-    }
+  if (tnc>1) {
+    qsort(p, tnc, sizeof(edf_annot_t), annot_comp_func);
   }
   (*n)=tnc;
   return(p);
 }
 
+/** Get record time stamps of 'edf' out of the time keeping annotation at the start
+ *   of the first annotation signal in every record into 'edf->rts', cheaper than
+ *   parsing all annotations with edf_get_annot()
+ * @note without annotation signal 'edf->rts' is NULL: records follow each other
+ * @return number of records with a time stamp, <0 on failure
+*/
+int32_t edf_get_rts(edf_t *edf) {
+
+  int32_t  k;                /**< record index */
+  int32_t  acn;              /**< channel number of EDF/BDF Annotations */
+  int32_t  cnt=0;            /**< records with a time stamp */
+  char     buf[ANNOTRECSIZE+1];
+  char    *end;              /**< end of time stamp in 'buf' */
+  int32_t  rb,bs;            /**< annotation bytes per record and in 'buf' */
+  const char *aname=(edf->bdf==1) ? "BDF Annotations" : "EDF Annotations";
 
+  if (edf->rts!=NULL) { free(edf->rts); edf->rts=NULL; }
+  for (acn=0; acn<edf->NrOfSignals; acn++) {
+    if (strcmp(edf->signal[acn].Label,aname)==0) { break; }
+  }
+  if ((acn>=edf->NrOfSignals) || (edf->signal[acn].data==NULL) || (edf->NrOfDataRecords<1)) {
+    return(0);
+  }
+  if ((edf->rts=(double *)calloc(edf->NrOfDataRecords,sizeof(double)))==NULL) {
+    fprintf(stderr,"# Error not enough memory to allocate %d record timestamp!!!\n",
+              edf->NrOfDataRecords);
+    return(-1);
+  }
+  /* ANNOTRECSIZE bytes per record after edf_rd_samples() */
+  rb=edf->signal[acn].NrOfSamplesPerRecord*((edf->bdf==1) ? 3 : 2);
+  bs=(rb<ANNOTRECSIZE) ? rb : ANNOTRECSIZE;
+  buf[bs]='\0';
+  for (k=0; k<edf->NrOfDataRecords; k++) {
+    /* annotation bytes of record 'k' start with '+onset\x14\x14' */
+    memcpy(buf, (char *)edf->signal[acn].data+(size_t)k*rb, bs);
+    edf->rts[k]=k*edf->RecordDuration;
+    if ((buf[0]=='+') || (buf[0]=='-')) {
+      edf->rts[k]=strtod(buf,&end);
+      if ((end!=buf) && (*end==20)) { cnt++; } else { edf->rts[k]=k*edf->RecordDuration; }
+    }
+  }
+  return(cnt);
+}
 
+/** Get the gap [s] before record 'k' of 'edf' out of its record time stamps
+ * @return gap duration [s], 0.0 when record 'k' follows its predecessor
+*/
+double edf_rts_gap(const edf_t *edf, int32_t k) {
+
+  double dt;    /**< time between the starts of record 'k-1' and 'k' */
+
+  if ((edf->rts==NULL) || (k<1) || (k>=edf->NrOfDataRecords)) { return(0.0); }
+  dt=edf->rts[k]-edf->rts[k-1]-edf->RecordDuration;
+  if (fabs(dt/edf->RecordDuration) > 0.0001) { return(dt); }
+  return(0.0);
+}
+
+/** Find first index in record timestamps 'rts' of 'nr' records with a start after 't' [s]
+ * @return record index 0..nr
+*/
+static int32_t annot_idx_fnd_rec(const double *rts, int32_t nr, double t) {
+
+  int32_t lo=0, hi=nr, mid;
+
+  while (lo<hi) {
+    mid=lo+(hi-lo)/2;
+    if (rts[mid] <= t) { lo=mid+1; } else { hi=mid; }
+  }
+  return(lo);
+}
+
+/** Make annotation index of 'n' annotations in 'p' for 'nr' records
+ *   starting at 'rts' or, when 'rts' is NULL, every 'dur' [s].
+ * @note the index takes ownership of 'p' which is sorted on onset.
+ * @return pointer to annotation index, NULL on failure
+*/
+edf_annot_idx_t *edf_annot_idx_new(edf_annot_t *p, int32_t n, int32_t nr, double *rts, double dur) {
+
+  edf_annot_idx_t *ai; /**< annotation index */
+  int32_t k;           /**< record counter */
+
+  if ((ai=(edf_annot_idx_t *)calloc(1,sizeof(edf_annot_idx_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate annotation index!!!\n");
+    return(NULL);
+  }
+  if (n<0)  { n=0;  }
+  if (nr<0) { nr=0; }
+  
+  ai->p=p; ai->n=n; ai->size=n;
+  if ((ai->p==NULL) && ((ai->p=(edf_annot_t *)calloc(CHUNKSIZE,sizeof(edf_annot_t)))!=NULL)) {
+    ai->n=0; ai->size=CHUNKSIZE;
+  }
+  ai->nr=nr; ai->rsize=nr+CHUNKSIZE;
+  ai->rts=(double  *)calloc(ai->rsize,  sizeof(double));
+  ai->rec=(int32_t *)calloc(ai->rsize+1,sizeof(int32_t));
+  if ((ai->p==NULL) || (ai->rts==NULL) || (ai->rec==NULL)) {
+    fprintf(stderr,"# Error: not enough memory to allocate annotation index of %d records!!!\n",nr);
+    edf_annot_idx_free(ai);
+    return(NULL);
+  }
+
+  /* sort all annotations on onset */
+  if (ai->n>1) {
+    qsort(ai->p, ai->n, sizeof(edf_annot_t), annot_comp_func);
+  }
+
+  /* record start times and first annotation of each record */
+  for (k=0; k<nr; k++) {
+    ai->rts[k] = (rts!=NULL) ? rts[k] : k*dur;
+    ai->rec[k] = edf_annot_idx_fnd(ai, ai->rts[k]);
+  }
+  /* annotations before the first record belong to the first record */
+  if (nr>0) { ai->rec[0]=0; }
+  ai->rec[nr]=ai->n;
+
+  if (vb&0x2000) {
+    fprintf(stderr,"# Info: annotation index of %d annotations in %d records\n",ai->n,ai->nr);
+  }
+  return(ai);
+}
+
+/** Parse all annotations of 'edf' once into an annotation index
+ * @return pointer to annotation index, NULL on failure
+*/
+edf_annot_idx_t *edf_get_annot_idx(edf_t *edf) {
+
+  edf_annot_t *p; /**< annotation array */
+  int32_t      n; /**< number of annotations */
+
+  p=edf_get_annot(edf,&n);
+  return(edf_annot_idx_new(p, n, edf->NrOfDataRecords, edf->rts, edf->RecordDuration));
+}
+
+/** Free annotation index 'ai' and its annotations
+*/
+void edf_annot_idx_free(edf_annot_idx_t *ai) {
+
+  if (ai==NULL) return;
+  if (ai->p   != NULL) free(ai->p);
+  if (ai->rts != NULL) free(ai->rts);
+  if (ai->rec != NULL) free(ai->rec);
+  free(ai);
+}
+
+/** Find first annotation in 'ai' with an onset at or after 't' [s]
+ * @return annotation index 0..ai->n (ai->n when none found)
+*/
+int32_t edf_annot_idx_fnd(const edf_annot_idx_t *ai, double t) {
+
+  int32_t lo=0, hi=ai->n, mid;
+
+  while (lo<hi) {
+    mid=lo+(hi-lo)/2;
+    if (ai->p[mid].sec < t) { lo=mid+1; } else { hi=mid; }
+  }
+  return(lo);
+}
+
+/** Find all annotations in 'ai' with an onset in [t0, t1) [s]
+ * @note index of the first found annotation is returned in 'first'
+ * @return number of found annotations
+*/
+int32_t edf_annot_idx_range(const edf_annot_idx_t *ai, double t0, double t1, int32_t *first) {
+
+  int32_t i0,i1; /**< first and last+1 annotation index */
+
+  i0=edf_annot_idx_fnd(ai,t0);
+  i1=(t1>t0) ? edf_annot_idx_fnd(ai,t1) : i0;
+  (*first)=i0;
+  return(i1-i0);
+}
+
+/** Find all annotations in 'ai' with an onset in record 'rec'
+ * @note index of the first found annotation is returned in 'first'
+ * @return number of found annotations, <0 on invalid record
+*/
+int32_t edf_annot_idx_rec(const edf_annot_idx_t *ai, int32_t rec, int32_t *first) {
+
+  if ((rec<0) || (rec>=ai->nr)) {
+    (*first)=ai->n;
+    return(-1);
+  }
+  (*first)=ai->rec[rec];
+  return(ai->rec[rec+1]-ai->rec[rec]);
+}
+
+/** Append record starting at 'ts' [s] to annotation index 'ai' (live recordings)
+ * @return number of records, <0 on failure
+*/
+int32_t edf_annot_idx_add_rec(edf_annot_idx_t *ai, double ts) {
+
+  int32_t k=ai->nr; /**< new record index */
+  int32_t size;     /**< new storage size */
+  double  *rts;     /**< grown record start times */
+  int32_t *rec;     /**< grown record offsets */
+
+  /* check available storage space, keep the old arrays on failure */
+  if (k>=ai->rsize) {
+    size=ai->rsize+CHUNKSIZE;
+    if ((rts=(double *)realloc(ai->rts,size*sizeof(double)))==NULL) {
+      fprintf(stderr,"# Error: not enough memory to allocate %d annotation records!!!\n",size);
+      return(-1);
+    }
+    ai->rts=rts;
+    if ((rec=(int32_t *)realloc(ai->rec,(size+1)*sizeof(int32_t)))==NULL) {
+      fprintf(stderr,"# Error: not enough memory to allocate %d annotation records!!!\n",size);
+      return(-1);
+    }
+    ai->rec=rec;
+    ai->rsize=size;
+  }
+  ai->rts[k]=ts;
+  ai->rec[k]=(k==0) ? 0 : edf_annot_idx_fnd(ai,ts);
+  ai->nr++;
+  ai->rec[ai->nr]=ai->n;
+  return(ai->nr);
+}
+
+/** Insert annotation 'a' into annotation index 'ai' (live recordings)
+ * @note appending in onset order costs O(1), other inserts O(n)
+ * @return index of inserted annotation, <0 on failure
+*/
+int32_t edf_annot_idx_add(edf_annot_idx_t *ai, const edf_annot_t *a) {
+
+  int32_t i;      /**< insert position */
+  int32_t k;      /**< record counter */
+  edf_annot_t *p; /**< grown annotation array */
+
+  /* check available storage space, keep the old array on failure */
+  if (ai->n>=ai->size) {
+    if ((p=(edf_annot_t *)realloc(ai->p,(ai->size+CHUNKSIZE)*sizeof(edf_annot_t)))==NULL) {
+      fprintf(stderr,"# Error: not enough memory to allocate %d annotations!!!\n",ai->size+CHUNKSIZE);
+      return(-1);
+    }
+    ai->p=p;
+    ai->size+=CHUNKSIZE;
+  }
+
+  /* find insert position: behind all annotations with the same onset */
+  if ((ai->n==0) || (annot_comp_func(a,&ai->p[ai->n-1]) >= 0)) {
+    i=ai->n;
+  } else {
+    i=edf_annot_idx_fnd(ai,a->sec);
+    while ((i<ai->n) && (annot_comp_func(a,&ai->p[i]) >= 0)) { i++; }
+    memmove(&ai->p[i+1], &ai->p[i], (ai->n-i)*sizeof(edf_annot_t));
+  }
+  ai->p[i]=*a;
+  ai->n++;
+
+  /* shift first annotation of all later records */
+  for (k=annot_idx_fnd_rec(ai->rts,ai->nr,a->sec); k<ai->nr; k++) {
+    if (k>0) { ai->rec[k]++; }
+  }
+  ai->rec[ai->nr]=ai->n;
+  return(i);
+}
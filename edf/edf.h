@@ -9,6 +9,7 @@
 #endif
 
 #include <time.h>
+#include <math.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +48,7 @@ typedef struct edf_t {
  int32_t NrOfSignals          ;
 edf_signal_t  *signal         ;      
  double *rts;                    /**< record time stamp: available in EDF+C, EDF+D, BDF+C, BDF+D */
+ struct EDF_SUM_IDX_T *sum;      /**< summary sidecar index: available after edf_sum_load() */
 } edf_t;
 
 /** Set verbose value in module EDF
@@ -98,6 +100,36 @@ int32_t edf_get_integer_overflow_value(edf_t *edf, int32_t chn, int32_t idx, int
 */
 int32_t edf_set_integer_overflow_value(edf_t *edf, float ynew, int32_t ovf, int32_t chn, int32_t idx, float gain);
 
+/** Get integer sample value of sample 'idx' of signal 's' in a 'bdf' (1) or EDF (0) file
+ *   without range checks, for tight loops.
+ * @return integer value
+*/
+static inline int32_t edf_sample(const edf_signal_t *s, int32_t idx, int32_t bdf) {
+  int32_t shl = (bdf==1) ? 8 : 16;
+  return((int32_t)((uint32_t)s->data[idx]<<shl)>>shl);
+}
+
+/** Get overflow value of sample 'idx' of signal 's' without range checks
+ * @return 0 on no overflow, OVERFLOWBIT on overflow
+*/
+static inline int32_t edf_sample_ovf(const edf_signal_t *s, int32_t idx) {
+  return(s->data[idx] & OVERFLOWBIT);
+}
+
+/** Set sample 'idx' of signal 's' in a 'bdf' (1) or EDF (0) file to physical value 'y'
+ *   with 'gain' and overflow 'ovf' like edf_set_integer_overflow_value() without range checks
+ * @return new integer value
+*/
+static inline int32_t edf_sample_set_phys(edf_signal_t *s, int32_t idx, float y, int32_t ovf,
+ float gain, int32_t bdf) {
+  int32_t yi;
+  if (y < s->PhysicalMin) { y = (float) s->PhysicalMin; ovf |= OVERFLOWBIT; } else
+  if (y > s->PhysicalMax) { y = (float) s->PhysicalMax; ovf |= OVERFLOWBIT; }
+  yi = (int32_t)round(y/gain);
+  s->data[idx] = ovf | (yi & ((bdf==1) ? 0xFFFFFF : 0xFFFF));
+  return(yi);
+}
+
 /** Translate 'labels' to selection bitvector 
  * @return selection bitvector as uint64_t
 */
@@ -129,6 +161,18 @@ int32_t edf_set_record_cnt(FILE *fp, int32_t rec_cnt);
 */
 int32_t edf_fix_hdr_version(FILE *fp);
 
+/** Parse EDF/BDF main header out of the 256 characters of 'buf' into 'edf'
+ * @note the signal headers are not allocated
+ * @return number of characters parsed.
+*/
+int32_t edf_parse_hdr(char *buf, edf_t *edf);
+
+/** Parse EDF/BDF signal headers out of 'buf' of 256*NrOfSignals characters
+ *   into the already allocated signals of 'edf'.
+ * @return number of characters parsed.
+*/
+int32_t edf_parse_signal_hdr(char *buf, edf_t *edf);
+
 /** Read EDF/BDF signal headers from file 'fp' into 'sig' 
  *   by using info of 'edf'.
  * @return number of characters parsed.
@@ -204,6 +248,7 @@ int32_t edf_fnd_chn_nr(edf_t *edf, const char *name);
 /* Check range of all 'EEG' channels of a nexus recording
  * @return number of channels with more than 5% overflow problems
  * @note 'edf' struct appended with overflow bit per sample at bit position 30 = 1<<30
+ * @note only records out of range in the summary 'edf->sum' are checked when loaded
 */
 int32_t edf_range_chk(edf_t *edf);
   
@@ -298,6 +343,7 @@ int32_t edf_quantile(edf_t *edf, int32_t k, float *q, int32_t n, int32_t *a);
 
 /** Find corresponding threshold for "binair" signal 'k' in 'edf' data
  *   by dividing whole recording period in 'nb' blocks
+ * @note block ranges and edges are taken from the summary 'edf->sum' when loaded
  * @return number of epochs analyzed 
 */
 int32_t edf_fnd_thr(edf_t *edf, int32_t k, int32_t nb);
@@ -388,6 +434,56 @@ int32_t edf_show_tasks(FILE *fp, task_t *task, int32_t nt, int32_t ppw, char *fn
 */
 int32_t edf_remove_switching_backlight(edf_t *edf, double dt);
 
+/** run of samples */
+typedef struct EDF_RUN_T {
+ int32_t start;             /**< index of first sample */
+ int32_t len;               /**< number of samples */
+} edf_run_t;
+
+/** list of runs sorted on start */
+typedef struct EDF_RUNS_T {
+ edf_run_t *r;              /**< runs */
+ int32_t    n;              /**< number of runs */
+ int32_t    size;           /**< allocated number of runs */
+} edf_runs_t;
+
+/** Get length of the run of samples equal to the first of 'n' samples 'x'
+ * @return run length 1..n (0 when n<1)
+*/
+int32_t edf_flat_len(const int32_t *x, int32_t n);
+
+/** Add run of 'len' samples starting at sample 'start' to run list 'rl'
+ *   merging it with the last run when they touch or overlap.
+ * @return number of runs in 'rl', <0 on failure
+*/
+int32_t edf_runs_add(edf_runs_t *rl, int32_t start, int32_t len);
+
+/** Free all runs in run list 'rl'
+*/
+void edf_runs_free(edf_runs_t *rl);
+
+/** Find all runs of more than 'minrep' samples equal to their preceding sample
+ *   in 'n' samples 'x' and add them to 'rl' with sample offset 'ofs'.
+ * @note the first sample of a flat serie is not part of the run and a flat
+ *   serie up to the last sample is no run (e.g. an unused constant signal)
+ * @return number of runs found
+*/
+int32_t edf_fnd_flat_runs(const int32_t *x, int32_t n, int32_t minrep, int32_t ofs, edf_runs_t *rl);
+
+/** Merge run lists 'a' and 'b' (both sorted on start) into 'c'
+ * @return number of runs in 'c'
+*/
+int32_t edf_runs_merge(const edf_runs_t *a, const edf_runs_t *b, edf_runs_t *c);
+
+/** Find all missing packets in 'edf': runs of more than 7 equal samples in the
+ *   first 4 signals or, in EDF+D/BDF+D, the first 16 samples after a gap in the
+ *   record time stamps, the first and last 16 samples of the recording.
+ * @note the missing samples are returned as sample index runs in empty run list 'rl'
+ * @note only records with flat series in the summary 'edf->sum' are scanned when loaded
+ * @return percentage of missing samples
+*/
+double edf_fnd_miss(edf_t *edf, edf_runs_t *rl);
+
 /** Add extra signal 'RejectedEpochs' for missing packets in 'edf'
  *   or delta overflow of more than 2 succeeding samples 
  * @return percentage of Rejected Epochs or delta overflow samples
@@ -444,6 +540,724 @@ int32_t edf_add_annot(edf_t *edf, edf_annot_t *p, int32_t n);
 */
 edf_annot_t *edf_get_annot(edf_t *edf, int32_t *n);
 
+/** Get record time stamps of 'edf' out of the time keeping annotation at the start
+ *   of the first annotation signal in every record into 'edf->rts', cheaper than
+ *   parsing all annotations with edf_get_annot()
+ * @note without annotation signal 'edf->rts' is NULL: records follow each other
+ * @return number of records with a time stamp, <0 on failure
+*/
+int32_t edf_get_rts(edf_t *edf);
+
+/** Get the gap [s] before record 'k' of 'edf' out of its record time stamps
+ * @return gap duration [s], 0.0 when record 'k' follows its predecessor
+*/
+double edf_rts_gap(const edf_t *edf, int32_t k);
+
+/** EDF/BDF annotation index: annotations sorted on onset with a record map */
+typedef struct EDF_ANNOT_IDX_T {
+ edf_annot_t *p;            /**< annotations sorted on onset [s] */
+ int32_t  n;                /**< number of annotations */
+ int32_t  size;             /**< allocated number of annotations in 'p' */
+ int32_t  nr;               /**< number of records */
+ int32_t  rsize;            /**< allocated number of records */
+ double  *rts;              /**< start time [s] of each record */
+ int32_t *rec;              /**< index of first annotation of each record, rec[nr]==n */
+} edf_annot_idx_t;
+
+/** Make annotation index of 'n' annotations in 'p' for 'nr' records
+ *   starting at 'rts' or, when 'rts' is NULL, every 'dur' [s].
+ * @note the index takes ownership of 'p' which is sorted on onset.
+ * @return pointer to annotation index, NULL on failure
+*/
+edf_annot_idx_t *edf_annot_idx_new(edf_annot_t *p, int32_t n, int32_t nr, double *rts, double dur);
+
+/** Parse all annotations of 'edf' once into an annotation index
+ * @return pointer to annotation index, NULL on failure
+*/
+edf_annot_idx_t *edf_get_annot_idx(edf_t *edf);
+
+/** Free annotation index 'ai' and its annotations
+*/
+void edf_annot_idx_free(edf_annot_idx_t *ai);
+
+/** Find first annotation in 'ai' with an onset at or after 't' [s]
+ * @return annotation index 0..ai->n (ai->n when none found)
+*/
+int32_t edf_annot_idx_fnd(const edf_annot_idx_t *ai, double t);
+
+/** Find all annotations in 'ai' with an onset in [t0, t1) [s]
+ * @note index of the first found annotation is returned in 'first'
+ * @return number of found annotations
+*/
+int32_t edf_annot_idx_range(const edf_annot_idx_t *ai, double t0, double t1, int32_t *first);
+
+/** Find all annotations in 'ai' with an onset in record 'rec'
+ * @note index of the first found annotation is returned in 'first'
+ * @return number of found annotations, <0 on invalid record
+*/
+int32_t edf_annot_idx_rec(const edf_annot_idx_t *ai, int32_t rec, int32_t *first);
+
+/** Append record starting at 'ts' [s] to annotation index 'ai' (live recordings)
+ * @return number of records, <0 on failure
+*/
+int32_t edf_annot_idx_add_rec(edf_annot_idx_t *ai, double ts);
+
+/** Insert annotation 'a' into annotation index 'ai' (live recordings)
+ * @note appending in onset order costs O(1), other inserts O(n)
+ * @return index of inserted annotation, <0 on failure
+*/
+int32_t edf_annot_idx_add(edf_annot_idx_t *ai, const edf_annot_t *a);
+
+
+/** EDF/BDF packed sample plane functions (edf_plane.c) */
+
+/** samples of one signal packed as in the file plus a separate overflow bitmap */
+typedef struct EDF_PLANE_T {
+ int32_t   n;               /**< number of samples */
+ int32_t   bps;             /**< bytes per sample: 2 (EDF) or 3 (BDF) */
+ uint8_t  *data;            /**< little endian samples of 'bps' bytes each */
+ uint32_t *ovf;             /**< overflow bitmap, bit 'i%32' of word 'i/32', NULL: no overflow */
+} edf_plane_t;
+
+/** Allocate overflow bitmap of plane 'p'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_plane_ovf_alloc(edf_plane_t *p);
+
+/** Get integer sample value of sample 'idx' in plane 'p'
+ * @return integer value
+*/
+static inline int32_t edf_plane_get(const edf_plane_t *p, int32_t idx) {
+  const uint8_t *b = &p->data[idx*p->bps];
+  if (p->bps==3) {
+    return((int32_t)(((uint32_t)b[0]<<8) | ((uint32_t)b[1]<<16) | ((uint32_t)b[2]<<24))>>8);
+  }
+  return((int16_t)(b[0] | (b[1]<<8)));
+}
+
+/** Get overflow value of sample 'idx' in plane 'p'
+ * @return 0 on no overflow, OVERFLOWBIT on overflow
+*/
+static inline int32_t edf_plane_get_ovf(const edf_plane_t *p, int32_t idx) {
+  if (p->ovf==NULL) { return(0); }
+  return(((p->ovf[idx>>5] >> (idx&31)) & 1) ? OVERFLOWBIT : 0);
+}
+
+/** Set integer sample value 'yi' and overflow 'ovf' of sample 'idx' in plane 'p'
+*/
+static inline void edf_plane_set(edf_plane_t *p, int32_t idx, int32_t yi, int32_t ovf) {
+  uint8_t *b = &p->data[idx*p->bps];
+  b[0] = (uint8_t)yi; b[1] = (uint8_t)(yi>>8);
+  if (p->bps==3) { b[2] = (uint8_t)(yi>>16); }
+  if (ovf) {
+    if ((p->ovf!=NULL) || (edf_plane_ovf_alloc(p)==0)) { p->ovf[idx>>5] |= (1u<<(idx&31)); }
+  } else if (p->ovf!=NULL) {
+    p->ovf[idx>>5] &= ~(1u<<(idx&31));
+  }
+}
+
+/** Set sample 'idx' in plane 'p' to physical value 'y' with 'gain' clipped on the
+ *   physical range of signal 's' like edf_set_integer_overflow_value()
+ * @return new integer value
+*/
+static inline int32_t edf_plane_set_phys(edf_plane_t *p, const edf_signal_t *s, int32_t idx,
+ float y, int32_t ovf, float gain) {
+  int32_t yi;
+  if (y < s->PhysicalMin) { y = (float) s->PhysicalMin; ovf |= OVERFLOWBIT; } else
+  if (y > s->PhysicalMax) { y = (float) s->PhysicalMax; ovf |= OVERFLOWBIT; }
+  yi = (int32_t)round(y/gain);
+  edf_plane_set(p, idx, yi, ovf);
+  return(yi);
+}
+
+/** Allocate plane 'p' for 'n' samples of 'bps' bytes
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_plane_alloc(edf_plane_t *p, int32_t n, int32_t bps);
+
+/** Free samples and overflow bitmap of plane 'p'
+*/
+void edf_plane_free(edf_plane_t *p);
+
+/** Get span of 'n' integer sample values starting at 'idx' in plane 'p' into 'y'
+ * @return number of samples in 'y'
+*/
+int32_t edf_plane_span(const edf_plane_t *p, int32_t idx, int32_t n, int32_t *y);
+
+/** Pack samples and overflow bits of signal 's' in a 'bdf' (1) or EDF (0) file into plane 'p'
+ * @note annotation channels are not packed
+ * @return number of packed samples, <0 on failure
+*/
+int32_t edf_plane_from_signal(edf_plane_t *p, const edf_signal_t *s, int32_t bdf);
+
+/** Unpack plane 'p' into the samples with overflow bits of signal 's'
+ * @return number of unpacked samples, <0 on failure
+*/
+int32_t edf_plane_to_signal(const edf_plane_t *p, edf_signal_t *s);
+
+/** Read all EDF/BDF samples from file 'fp' into planes, one per signal of 'edf'
+ *   reading a whole signal record at once.
+ * @note a file that ends early sets 'edf->NrOfDataRecords' to the number of
+ *   complete records read, the planes only hold those records
+ * @return array of 'edf->NrOfSignals' planes, NULL on failure
+*/
+edf_plane_t *edf_rd_planes(FILE *fp, edf_t *edf);
+
+
+/** EDF/BDF summary sidecar functions (edf_sum.c) */
+
+#define EDFSUMLVL   (3)   /**< number of summary levels: 1, 10 and 100 records */
+#define EDFSUMFAC  (10)   /**< records per entry factor between summary levels */
+
+/** summary of one signal over one or more records */
+typedef struct EDF_SUM_T {
+ int32_t min;               /**< minimum integer sample value */
+ int32_t max;               /**< maximum integer sample value */
+ float   mean;              /**< mean integer sample value */
+ int32_t ovf;               /**< number of samples with overflow bit */
+ int32_t flat;              /**< longest serie of equal samples within one record */
+} edf_sum_t;
+
+/** multi-resolution summary of all signals of all records */
+typedef struct EDF_SUM_IDX_T {
+ int32_t    ns;             /**< number of signals */
+ double     RecordDuration; /**< record duration [s] */
+ int32_t    nr  [EDFSUMLVL];/**< number of entries per level */
+ int32_t    size[EDFSUMLVL];/**< allocated number of entries per level */
+ edf_sum_t *sum [EDFSUMLVL];/**< entries per level: sum[lvl][idx*ns+chn] */
+ edf_sum_t *acc [EDFSUMLVL];/**< partial entry under construction per level */
+ int32_t    cnt [EDFSUMLVL];/**< number of finer entries in 'acc' */
+ FILE      *fp;             /**< sidecar file to append new entries to */
+ int64_t    fsize;          /**< EDF/BDF file size [byte] when stamped */
+ int64_t    mtime;          /**< EDF/BDF modification time when stamped, 0 when not stamped */
+ int32_t    nrec;           /**< EDF/BDF number of records when stamped */
+} edf_sum_idx_t;
+
+/** Make empty summary index for 'ns' signals with records of 'dur' [s]
+ * @return pointer to summary index, NULL on failure
+*/
+edf_sum_idx_t *edf_sum_new(int32_t ns, double dur);
+
+/** Free summary index 'si' and close its sidecar file
+*/
+void edf_sum_free(edf_sum_idx_t *si);
+
+/** Make sidecar summary file name 'sname' out of EDF/BDF file name 'fname'
+ * @return number of characters in 'sname'
+*/
+int32_t edf_sum_name(char *sname, const char *fname);
+
+/** Summarize 'ns' samples 'data' of a 'bdf' (1) or EDF (0) signal into 's'
+*/
+void edf_sum_samples(edf_sum_t *s, const int32_t *data, int32_t ns, int32_t bdf);
+
+/** Add summary 'rec' of all signals of the next record to 'si' and roll it up
+ *   into the coarser levels; completed entries are appended to the sidecar file.
+ * @return number of records in 'si', <0 on failure
+*/
+int32_t edf_sum_add_rec(edf_sum_idx_t *si, const edf_sum_t *rec);
+
+/** Build summary index of all records in 'edf' (samples should be read)
+ * @return pointer to summary index, NULL on failure
+*/
+edf_sum_idx_t *edf_sum_build(edf_t *edf);
+
+/** Open sidecar summary file 'fname' for writing and append all entries
+ *   already in 'si'; later records added with edf_sum_add_rec() are appended.
+ * @return number of bytes written, <0 on failure
+*/
+int32_t edf_sum_wr(edf_sum_idx_t *si, const char *fname);
+
+/** Read sidecar summary file 'fname'
+ * @return pointer to summary index, NULL on failure
+*/
+edf_sum_idx_t *edf_sum_rd(const char *fname);
+
+/** Stamp summary 'si' with size and modification time of the finished EDF/BDF
+ *   file 'ename' with 'nrec' records, also in its sidecar file when open.
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_sum_stamp(edf_sum_idx_t *si, const char *ename, int32_t nrec);
+
+/** Load sidecar summary of EDF/BDF file 'ename' into 'edf->sum' when it still
+ *   matches the file: stamped summaries on size, modification time and number
+ *   of records, unstamped (live) summaries on the number of records.
+ * @note the summary holds the samples as read, load it before changing them
+ * @return number of summarized records, <0 on a missing or outdated summary
+*/
+int32_t edf_sum_load(edf_t *edf, const char *ename);
+
+/** Get summary 's' of signal 'chn' in 'si' over records 'r0' up to 'r1' (excluded)
+ *   using the coarsest levels that fit.
+ * @return number of summary entries used, <0 on failure
+*/
+int32_t edf_sum_range(const edf_sum_idx_t *si, int32_t chn, int32_t r0, int32_t r1, edf_sum_t *s);
+
+/** Get overview of signal 'chn' in 'si' over records 'r0' up to 'r1' (excluded)
+ *   in 'n' equally sized bins 's'.
+ * @return number of filled bins
+*/
+int32_t edf_sum_overview(const edf_sum_idx_t *si, int32_t chn, int32_t r0, int32_t r1,
+ int32_t n, edf_sum_t *s);
+
+
+/** EDF/BDF header catalog functions (edf_cat.c) */
+
+#define EDFCATNAMESIZE   (256)   /**< maximum file name size in a catalog entry */
+#define EDFCATLBLSIZE    (512)   /**< maximum size of comma separated labels */
+
+#define EDFCAT_HDR     (0x01)    /**< header could not be read or parsed */
+#define EDFCAT_VERSION (0x02)    /**< first character of version needs fix */
+#define EDFCAT_RECCNT  (0x04)    /**< record count in header does not match file size */
+#define EDFCAT_PARTIAL (0x08)    /**< file ends with a partial record */
+#define EDFCAT_HDRSIZE (0x10)    /**< header size does not match number of signals */
+
+/** catalog entry: header summary of one EDF/BDF file */
+typedef struct EDF_CAT_T {
+    char name   [EDFCATNAMESIZE];  /**< file name */
+    char subject[17];              /**< subject: file name up to '-' or '_' */
+    char chair  [17];              /**< chair: file name between '-' and '_' */
+    char PatientId[81];            /**< patient id of header */
+  time_t StartDateTime;            /**< start of recording */
+  double RecordDuration;           /**< record duration [s] */
+ int32_t NrOfDataRecords;          /**< record count in header */
+ int32_t NrOfRecords;              /**< record count by file size */
+ int32_t NrOfSignals;              /**< number of signals */
+ int32_t bdf;                      /**< 0:EDF, 1:BDF, -1:unknown */
+ int64_t size;                     /**< file size [byte] */
+ int32_t flags;                    /**< EDFCAT_* problems found, 0:file is OK */
+    char labels [EDFCATLBLSIZE];   /**< comma separated signal labels */
+} edf_cat_t;
+
+/** Read header summary of EDF/BDF file 'fname' into 'c' with positioned
+ *   reads of the main and signal headers only.
+ * @return 0 when the file is OK, EDFCAT_* flags on problems
+*/
+int32_t edf_cat_rd_file(const char *fname, edf_cat_t *c);
+
+/** Read header summaries of the 'n' files 'fname' with 'nt' threads
+ * @return array of 'n' catalog entries in order of 'fname', an empty array
+ *   when 'n'<=0, NULL on failure
+*/
+edf_cat_t *edf_cat_scan(char **fname, int32_t n, int32_t nt);
+
+/** Read header summaries of all *.bdf and *.edf files in directory 'dir'
+ *   with 'nt' threads, the number of files is returned in 'n'.
+ * @return array of catalog entries sorted on file name, NULL on failure
+*/
+edf_cat_t *edf_cat_scan_dir(const char *dir, int32_t nt, int32_t *n);
+
+/** Write 'n' catalog entries 'c' as text lines to file 'fp'
+ * @return number of characters printed.
+*/
+int32_t edf_cat_wr(FILE *fp, const edf_cat_t *c, int32_t n);
+
+/** Read catalog file 'fname' as written by edf_cat_wr(), the number of entries
+ *   is returned in 'n'.
+ * @return array of catalog entries, an empty array for an empty catalog, NULL on failure
+*/
+edf_cat_t *edf_cat_rd(const char *fname, int32_t *n);
+
+/** Check catalog entry 'c' on 'subject', 'chair' and signal 'label' (NULL or
+ *   empty: any) and an overlap with [t0, t1] (t1<=t0: any time).
+ * @return 1 on match, 0 otherwise
+*/
+int32_t edf_cat_match(const edf_cat_t *c, const char *subject, const char *chair,
+ const char *label, time_t t0, time_t t1);
+
+/** EDF/BDF filter functions (edf_filt.c) */
+
+#define EDFFILTORD     (4)  /**< Butterworth order of filter specifications */
+#define EDFFILTNQ   (30.0)  /**< notch quality (f0/bandwidth) of filter specifications */
+#define EDFFILTNH      (3)  /**< number of notched harmonics of filter specifications */
+
+/** biquad section, normalized on a0: y = b0*x + b1*x[-1] + b2*x[-2] - a1*y[-1] - a2*y[-2] */
+typedef struct EDF_BIQUAD_T {
+ float b0, b1, b2;          /**< numerator */
+ float a1, a2;              /**< denominator */
+} edf_biquad_t;
+
+/** cascade of biquad sections with the state of 'nchn' channels */
+typedef struct EDF_FILT_T {
+ int32_t       nchn;        /**< number of channels per frame */
+ int32_t       nsec;        /**< number of biquad sections */
+ edf_biquad_t *sec;         /**< biquad sections */
+ float        *z;           /**< state z1,z2 of section 's' and channel 'c' at [(2*s+k)*nchn+c] */
+} edf_filt_t;
+
+/** decimating FIR filter with the state of 'nchn' channels */
+typedef struct EDF_DEC_T {
+ int32_t  nchn;             /**< number of channels per frame */
+ int32_t  m;                /**< decimation factor */
+ int32_t  ntap;             /**< number of taps */
+ float   *h;                /**< symmetric taps */
+ float   *d;                /**< delay line of 'ntap' frames, stored twice */
+ int32_t  pos;              /**< next frame in delay line */
+ int32_t  ph;               /**< number of frames since last output */
+} edf_dec_t;
+
+/** Make empty filter for 'nchn' channels: passes all samples unchanged
+ * @return pointer to filter, NULL on failure
+*/
+edf_filt_t *edf_filt_new(int32_t nchn);
+
+/** Free filter 'f'
+*/
+void edf_filt_free(edf_filt_t *f);
+
+/** Append 'nsec' biquad sections 'sec' to filter 'f', the state of 'f' is reset
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add(edf_filt_t *f, const edf_biquad_t *sec, int32_t nsec);
+
+/** Append Butterworth low-pass of 'order' at 'fc' [Hz] for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_lowpass(edf_filt_t *f, int32_t order, double fs, double fc);
+
+/** Append Butterworth high-pass of 'order' at 'fc' [Hz] for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_highpass(edf_filt_t *f, int32_t order, double fs, double fc);
+
+/** Append band-pass from 'f0' to 'f1' [Hz] as Butterworth high-pass and low-pass 
+ *   of 'order' each for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_bandpass(edf_filt_t *f, int32_t order, double fs, double f0, double f1);
+
+/** Append notch at 'f0' [Hz] with quality 'q' (f0/bandwidth) for sample frequency 'fs' [Hz]
+ *   to filter 'f', with 'nh'>1 the harmonics up to 'nh'*'f0' below fs/2 are notched as well.
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_notch(edf_filt_t *f, double fs, double f0, double q, int32_t nh);
+
+/** Add filters described by 'spec' for sample frequency 'fs' [Hz] to filter 'f'.
+ *   'spec' lists stages separated by '+':
+ *   'n<f0>' notch at f0 and harmonics, 'lp<fc>' low-pass, 'hp<fc>' high-pass,
+ *   'bp<f0>,<f1>' band-pass, all Butterworth of order 4, e.g. "n50+bp0.5,40".
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_spec(edf_filt_t *f, const char *spec, double fs);
+
+/** Reset state of filter 'f' to zero
+*/
+void edf_filt_reset(edf_filt_t *f);
+
+/** Set state of filter 'f' to its steady state for the constant input 'x0' of
+ *   each channel, which avoids the step response at the start of a signal
+*/
+void edf_filt_init(edf_filt_t *f, const float *x0);
+
+/** Filter block of 'n' frames 'x' (x[i*nchn+c]) in place with filter 'f',
+ *   the state is kept for the next block.
+*/
+void edf_filt_run(edf_filt_t *f, float *x, int32_t n);
+
+/** Zero phase filtering of the whole signal of 'n' frames 'x' in place: forward
+ *   and backward with filter 'f', both started in steady state of the edge frame.
+ *   The magnitude response of 'f' is squared.
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filtfilt(edf_filt_t *f, float *x, int32_t n);
+
+/** Make decimator by 'm' for 'nchn' channels with a linear phase low-pass FIR
+ *   of 'ntap' taps (Hamming windowed sinc) at 0.8 times the new Nyquist frequency.
+ *   Only the kept output samples are computed.
+ * @return pointer to decimator, NULL on failure
+*/
+edf_dec_t *edf_dec_new(int32_t nchn, int32_t m, int32_t ntap);
+
+/** Free decimator 'd'
+*/
+void edf_dec_free(edf_dec_t *d);
+
+/** Decimate 'n' frames 'x' (x[i*nchn+c]) with decimator 'd' into 'y', which
+ *   has room for n/m+1 frames; the state is kept for the next block.
+ * @return number of frames in 'y'
+*/
+int32_t edf_dec_run(edf_dec_t *d, const float *x, int32_t n, float *y);
+
+/** EDF/BDF streaming detector functions (edf_det.c) */
+
+#define EDFRSPEPOCH  (20.0)  /**< epoch [s] of adaptive respiration peak-to-peak */
+#define EDFRSPORD       (2)  /**< order of internal respiration low-pass */
+#define EDFRSPFC      (1.0)  /**< corner frequency [Hz] of internal respiration low-pass */
+#define EDFECGORD       (2)  /**< order of QRS band-pass */
+#define EDFECGF0      (5.0)  /**< lower corner frequency [Hz] of QRS band-pass */
+#define EDFECGF1     (15.0)  /**< upper corner frequency [Hz] of QRS band-pass */
+#define EDFECGWIN    (0.15)  /**< QRS energy moving average window [s] */
+#define EDFECGLEARN   (2.0)  /**< learning period of QRS threshold [s] */
+#define EDFECGTHR     (0.3)  /**< QRS threshold relative to the signal peak level */
+#define EDFECGREFR   (0.25)  /**< refractory period after a beat [s] */
+#define EDFECGQRS     (0.3)  /**< maximum QRS duration [s] */
+#define EDFECGLOST    (2.0)  /**< threshold is halved every second without beat after this [s] */
+
+#define EDFEVTRSP       (0)  /**< respiration extreme of unknown polarity */
+#define EDFEVTMAX       (1)  /**< respiration maximum */
+#define EDFEVTMIN       (2)  /**< respiration minimum */
+#define EDFEVTBEAT      (3)  /**< heart beat */
+
+/** detector event */
+typedef struct EDF_EVT_T {
+ int32_t type;              /**< event type EDFEVTRSP, EDFEVTMAX, EDFEVTMIN or EDFEVTBEAT */
+ int64_t sc;                /**< sample counter of the event */
+ double  sec;               /**< sample counter in seconds */
+ double  level;             /**< sample value at the event */
+ double  period;            /**< respiration: mean period [s], beat: inter beat interval [s] */
+ double  rate;              /**< mean rate per minute */
+} edf_evt_t;
+
+/** streaming respiration extreme detector */
+typedef struct EDF_RSP_T {
+ double  fs;                /**< sample frequency [Hz] */
+ edf_filt_t *flt;           /**< internal low-pass, NULL: none */
+ int32_t init;              /**< first sample seen */
+ int32_t fixed;             /**< fixed 'mindist' */
+ double  mindist;           /**< minimum distance between local minimum and maximum */
+ double  maxdist;           /**< maximum distance between local minimum and maximum */
+ int32_t ns;                /**< samples in current peak-to-peak epoch */
+ double  ymin, ymax;        /**< range of current peak-to-peak epoch */
+ double  p2pmin;            /**< smallest peak-to-peak of all epochs, <0: none yet */
+ double  tmpDist;           /**< distance of temporary breath extreme */
+ double  tmpExtreme;        /**< temporary breath extreme */
+ double  extreme;           /**< last extreme */
+ int64_t scExtreme;         /**< sample counter of last extreme */
+ int32_t toggle;            /**< half-beat toggle */
+ int64_t lastPeriod;        /**< previous beat slice period in samples */
+ double  filteredPeriod;    /**< current average breathing period [s] */
+ double  rate;              /**< current breathing rate per minute */
+ int64_t nxt;               /**< sample counter since last found local extreme */
+ int64_t idx;               /**< sample counter of last found local extreme */
+ double  level;             /**< sample value at 'idx' */
+ int32_t cnt;               /**< number of found extremes */
+} edf_rsp_t;
+
+/** streaming heart beat detector */
+typedef struct EDF_ECG_T {
+ double  fs;                /**< sample frequency [Hz] */
+ edf_filt_t *flt;           /**< QRS band-pass */
+ float  *win;               /**< squared band-passed samples of moving average */
+ int32_t nwin;              /**< moving average length */
+ int32_t wi;                /**< next position in 'win' */
+ double  sum;               /**< sum of 'win' */
+ int32_t init;              /**< first sample seen */
+ int64_t sc0;               /**< sample counter of first sample */
+ double  spk;               /**< signal peak level of moving average */
+ int32_t inq;               /**< inside QRS complex */
+ int64_t qstart;            /**< sample counter of start of QRS complex */
+ int64_t qsc;               /**< sample counter of largest band-passed sample in QRS complex */
+ double  qmax;              /**< largest band-passed sample in QRS complex */
+ double  qlvl;              /**< ECG sample at 'qsc' */
+ double  mmax;              /**< largest moving average in QRS complex */
+ int64_t lastBeat;          /**< sample counter of last beat */
+ int64_t lastDecay;         /**< sample counter of last threshold change */
+ double  filteredIbi;       /**< average inter beat interval [s] */
+ double  rate;              /**< heart rate per minute */
+ int32_t cnt;               /**< number of found beats */
+} edf_ecg_t;
+
+/** Get text of event 'e' as used in annotations
+ * @return event name
+*/
+const char *edf_evt_name(const edf_evt_t *e);
+
+/** Print event 'e' of channel 'chn' with time offset 't0' [s] into 'msg' of 
+ *   'size' characters as '<name> chn t level period rate'
+ * @return number of characters printed
+*/
+int32_t edf_evt_prt(char *msg, int32_t size, int32_t chn, double t0, const edf_evt_t *e);
+
+/** Make respiration detector for sample frequency 'fs' [Hz] with minimum
+ *   extreme distance 'mindist' ('mindist'<=0: 10% of the smallest peak-to-peak
+ *   of all EDFRSPEPOCH [s] epochs so far) and with 'flt'==1 an internal low-pass.
+ * @return pointer to respiration detector, NULL on failure
+*/
+edf_rsp_t *edf_rsp_new(double fs, double mindist, int32_t flt);
+
+/** Free respiration detector 'r'
+*/
+void edf_rsp_free(edf_rsp_t *r);
+
+/** Feed 'n' respiration samples 'x' starting at sample counter 'sc' to detector
+ *   'r', NaN samples are skipped. Found extremes are stored in 'e' of 'ne' events,
+ *   at most one per sample. The extremes are reported when the signal moved back
+ *   'mindist' from it.
+ * @return number of events in 'e'
+*/
+int32_t edf_rsp_run(edf_rsp_t *r, int64_t sc, const float *x, int32_t n, edf_evt_t *e, int32_t ne);
+
+/** Make heart beat detector for ECG with sample frequency 'fs' [Hz]
+ * @return pointer to heart beat detector, NULL on failure
+*/
+edf_ecg_t *edf_ecg_new(double fs);
+
+/** Free heart beat detector 'q'
+*/
+void edf_ecg_free(edf_ecg_t *q);
+
+/** Feed 'n' ECG samples 'x' starting at sample counter 'sc' to detector 'q',
+ *   NaN samples are skipped. QRS complexes are found on the moving average of
+ *   the squared band-passed ECG above an adaptive threshold, a beat is placed
+ *   at the largest band-passed sample of the complex and reported at its end.
+ *   Found beats are stored in 'e' of 'ne' events, at most one per sample.
+ * @return number of events in 'e'
+*/
+int32_t edf_ecg_run(edf_ecg_t *q, int64_t sc, const float *x, int32_t n, edf_evt_t *e, int32_t ne);
+
+/** EDF/BDF text formatting functions (edf_fmt.c) */
+
+#define EDFFMTSIZE  (1<<20)  /**< default text buffer size [byte] */
+#define EDFFMTMAXW    (352)  /**< characters needed by one number besides its width */
+#define EDFFMTFLTW     (48)  /**< characters of a float printed with at most 6 decimals */
+
+/** text buffer written to file 'fp' in blocks of 'size' bytes */
+typedef struct EDF_FMT_T {
+ FILE    *fp;               /**< output file */
+ char    *buf;              /**< text buffer */
+ int32_t  size;             /**< size of 'buf' [byte] */
+ int32_t  n;                /**< used bytes in 'buf' */
+ int64_t  nc;               /**< number of characters written to 'fp' */
+} edf_fmt_t;
+
+/** row formatter: format row 'i' of 'arg' into 's'
+ * @return number of characters in 's'
+*/
+typedef int32_t (*edf_fmt_row_t)(char *s, int64_t i, void *arg);
+
+/** Set number of threads used by edf_fmt_rows() when called with 'nthr'<1
+ * @return previous number of threads
+*/
+int32_t edf_fmt_set_nt(int32_t new_nt);
+
+/** Format 'a' as printf "%*.*f" with width 'w' and precision 'p' into 's', 
+ *   's' must hold at least EDFFMTMAXW+w characters, longer results are truncated.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_fixed(char *s, double a, int32_t w, int32_t p);
+
+/** Format 'a' as printf "%*lld" with width 'w' into 's', 
+ *   's' must hold at least EDFFMTMAXW+w characters.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_int(char *s, int64_t a, int32_t w);
+
+/** Format 'a' as printf "%0*X" with width 'w' into 's',
+ *   's' must hold at least EDFFMTMAXW+w characters.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_hex(char *s, uint32_t a, int32_t w);
+
+/** Format string 'a' as printf "%*s" with width 'w' into 's', 
+ *   's' must hold at least strlen(a)+w characters.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_str(char *s, const char *a, int32_t w);
+
+/** Make text buffer of 'size' bytes, EDFFMTSIZE when 'size'<1, for file 'fp'
+ * @return pointer to text buffer, NULL on failure
+*/
+edf_fmt_t *edf_fmt_new(FILE *fp, int32_t size);
+
+/** Write all buffered text of 'f' to its file
+ * @return 0 on success, -1 on write failure
+*/
+int32_t edf_fmt_flush(edf_fmt_t *f);
+
+/** Flush and free text buffer 'f'
+ * @return total number of characters written
+*/
+int64_t edf_fmt_free(edf_fmt_t *f);
+
+/** Append 'a' as printf "%*.*f" to text buffer 'f'
+*/
+void edf_fmt_put_fixed(edf_fmt_t *f, double a, int32_t w, int32_t p);
+
+/** Append 'a' as printf "%*lld" to text buffer 'f'
+*/
+void edf_fmt_put_int(edf_fmt_t *f, int64_t a, int32_t w);
+
+/** Append 'a' as printf "%0*X" to text buffer 'f'
+*/
+void edf_fmt_put_hex(edf_fmt_t *f, uint32_t a, int32_t w);
+
+/** Append string 'a' as printf "%*s" to text buffer 'f'
+*/
+void edf_fmt_put_str(edf_fmt_t *f, const char *a, int32_t w);
+
+/** Append character 'c' to text buffer 'f'
+*/
+void edf_fmt_put_chr(edf_fmt_t *f, char c);
+
+/** Format 'n' rows with 'fmt' into file 'fp', each row has at most 'maxrow' 
+ *   characters. Chunks of rows are formatted by 'nthr' threads (the number set 
+ *   by edf_fmt_set_nt() when 'nthr'<1) and written in row order.
+ * @return number of characters written, -1 on failure
+*/
+int64_t edf_fmt_rows(FILE *fp, edf_fmt_row_t fmt, void *arg, int64_t n, int32_t maxrow, int32_t nthr);
+
+/** EDF/BDF compressed archive functions (edf_pack.c) */
+
+#define EDFPACKRPC     (64)  /**< default records per chunk */
+#define EDFPACKBLK     (64)  /**< samples per bit-packed block */
+
+/** packed EDF/BDF file opened for reading */
+typedef struct EDF_PACK_T {
+ FILE    *fp;               /**< packed file */
+ edf_t    edf;              /**< headers, the signals hold the records read last */
+ uint8_t *hdr;              /**< EDF/BDF header bytes */
+ int32_t  nh;               /**< size of 'hdr' [byte] */
+ int32_t  ss;               /**< bytes per sample */
+ int32_t  rs;               /**< record size [byte] */
+ int32_t *spr;              /**< samples per record of each signal */
+ int32_t *sofs;             /**< offset of each signal in a record [byte] */
+ int32_t *ann;              /**< signal is an annotation signal */
+ int32_t  rpc;              /**< records per chunk */
+ int32_t  nr;               /**< number of whole records */
+ int32_t  ntail;            /**< bytes of an incomplete last record */
+ int32_t  nc;               /**< number of chunks */
+ int64_t *ofs;              /**< file offset of each chunk */
+ int32_t *size;             /**< packed size of each chunk [byte] */
+ double  *t;                /**< start time [s] of each chunk */
+ int32_t  k0;               /**< first record in the signals of 'edf' */
+ int32_t  nt;               /**< number of threads */
+} edf_pack_t;
+
+/** Pack EDF/BDF file 'iname' losslessly into file 'oname' with 'rpc' records 
+ *   per chunk (EDFPACKRPC when 'rpc'<1) using 'nt' threads (one per cpu when 'nt'<1)
+ * @return size of 'oname' [byte], <0 on failure
+*/
+int64_t edf_pack(const char *iname, const char *oname, int32_t rpc, int32_t nt);
+
+/** Unpack packed EDF/BDF file 'iname' into EDF/BDF file 'oname' with 'nt' threads,
+ *   only the records from time 't0' up to 't1' [s] since the start when 't1'>'t0'
+ * @return size of 'oname' [byte], <0 on failure
+*/
+int64_t edf_unpack(const char *iname, const char *oname, double t0, double t1, int32_t nt);
+
+/** Open packed EDF/BDF file 'fname' for reading with 'nt' threads (one per cpu when 'nt'<1)
+ * @return pointer to packed file, NULL on failure
+*/
+edf_pack_t *edf_pack_open(const char *fname, int32_t nt);
+
+/** Close packed EDF/BDF file 'p' and free all its memory
+*/
+void edf_pack_close(edf_pack_t *p);
+
+/** Find record of packed EDF/BDF file 'p' at time 't' [s] since the start 
+ *   of the recording out of the chunk index
+ * @return record index 0..p->nr-1, 0 when 'p' has no records
+*/
+int32_t edf_pack_fnd_rec(const edf_pack_t *p, double t);
+
+/** Read 'n' records starting at record 'k' of packed EDF/BDF file 'p' into 
+ *   the signals of 'p->edf' like edf_rd_samples(): 'p->edf.NrOfDataRecords' 
+ *   becomes the number of records read and 'p->k0' is set to 'k'. An annotation
+ *   signal keeps all its samples per record: each record has all its bytes.
+ * @return number of records read, <0 on failure
+*/
+int32_t edf_pack_rd_rec(edf_pack_t *p, int32_t k, int32_t n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -45,6 +45,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define ANTDEF "pp31_20090918T122951_00000004.ant"
 #define   MNCN     (1024)
 #define  MDDEF        (1)
+#define  T0DEF      (0.0)
+#define  T1DEF     (-1.0)
+#define  NSPAN     (1024)  /**< samples per span of a packed plane */
 
 int32_t  vb =  0x00;
 int32_t dbg =  0x00;
@@ -57,10 +60,13 @@ int32_t edf2ant_intro(FILE *fp) {
   int32_t nc=0;
   
   nc+=fprintf(fp,"%s\n",VERSION);
-  nc+=fprintf(fp,"Usage: edf2ant [-i <in>] [-o <ant>] [-m <md>] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"Usage: edf2ant [-i <in>] [-o <ant>] [-m <md>] [-b <t0>] [-e <t1>] [-c <ecg>] [-v <vb>] [-d <dbg>] [-h]\n");
   nc+=fprintf(fp,"in   : input EDF/BDF file (default=%s)\n",INDEF);
   nc+=fprintf(fp,"ant  : output annotation file (default=%s)\n",ANTDEF);
   nc+=fprintf(fp,"md   : report mode 0: t,ibi,sc,txt 1: t,ibi (kubios) 2: sc,txt (default=%d)\n",MDDEF);
+  nc+=fprintf(fp,"t0   : first annotation onset [s] (default=%.1f)\n",T0DEF);
+  nc+=fprintf(fp,"t1   : last annotation onset [s] (default=%.1f: end of recording)\n",T1DEF);
+  nc+=fprintf(fp,"ecg  : detect heart beats on ECG signal 'ecg' instead of reading annotations (default=none)\n");
   nc+=fprintf(fp,"h    : show this manual page\n");
   nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
   nc+=fprintf(fp," 0x01: show EDF header info\n");
@@ -70,13 +76,14 @@ int32_t edf2ant_intro(FILE *fp) {
 }
 
 /** reads the options from the command line */
-static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, int32_t *md) {
+static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, int32_t *md,
+  double *t0, double *t1, char *ecg) {
 
   int32_t i;
   char   *cp;          /**< character pointer */
   char    fname[MNCN]; /**< temp file output name */
  
-  strcpy(iname, INDEF); strcpy(oname,""); *md=MDDEF;
+  strcpy(iname, INDEF); strcpy(oname,""); *md=MDDEF; *t0=T0DEF; *t1=T1DEF; strcpy(ecg,"");
   
   for (i=1; i<argc; i++) {
     if (argv[i][0]!='-') {
@@ -86,6 +93,9 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, int3
         case 'i': strcpy(iname,argv[++i]); break;
         case 'o': strcpy(oname,argv[++i]); break;
         case 'm': *md=strtol(argv[++i],NULL,0); break;
+        case 'b': *t0=strtod(argv[++i],NULL); break;
+        case 'e': *t1=strtod(argv[++i],NULL); break;
+        case 'c': strcpy(ecg,argv[++i]); break;
         case 'v': vb=strtol(argv[++i],NULL,0); break;
         case 'd': dbg=strtol(argv[++i],NULL,0); break;
         case 'h': edf2ant_intro(stderr); exit(0);
@@ -106,20 +116,82 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, int3
   }
 } 
 
+/** Detect heart beats on ECG signal 'name' of 'edf' with the streaming 
+ *   beat detector, the number of beats is returned in 'n'.
+ * @return array of beat annotations, NULL on failure
+*/
+static edf_annot_t *ecg_detect(edf_t *edf, const edf_plane_t *pl, const char *name, int32_t *n) {
+
+  int32_t chn;                 /**< channel number of ECG signal */
+  int32_t i,j,k;               /**< sample indices */
+  int32_t m,ne;                /**< number of found and room for beats */
+  int32_t y[NSPAN];            /**< span of integer samples */
+  float   x[NSPAN];            /**< span of ECG samples */
+  double  fs;                  /**< sample frequency [Hz] */
+  double  gain;                /**< gain of channel 'chn' */
+  edf_evt_t *e=NULL,*tmp;      /**< found beats */
+  edf_annot_t *p;              /**< beat annotations */
+  edf_ecg_t *q;                /**< heart beat detector */
+
+  *n=0;
+  if ((chn=edf_fnd_chn_nr(edf,name))<0) {
+    fprintf(stderr,"# Error: missing ECG signal %s!!!\n",name);
+    return(NULL);
+  }
+  fs=edf->signal[chn].NrOfSamplesPerRecord / edf->RecordDuration;
+  gain=(edf->signal[chn].PhysicalMax - edf->signal[chn].PhysicalMin) /
+       (edf->signal[chn].DigitalMax  - edf->signal[chn].DigitalMin);
+  if ((q=edf_ecg_new(fs))==NULL) {
+    return(NULL);
+  }
+  /* the offline detector runs the same code as the streaming one, one span
+     of physical samples out of the packed plane at a time, the beats array
+     grows on demand with room for one beat per sample of the next span */
+  m=0; ne=0;
+  for (i=0; (k=edf_plane_span(&pl[chn],i,NSPAN,y))>0; i+=k) {
+    if (m+k>ne) {
+      if ((tmp=(edf_evt_t *)realloc(e,(2*ne+k)*sizeof(edf_evt_t)))==NULL) {
+        fprintf(stderr,"# Error: can't detect heart beats on signal %s!!!\n",name);
+        free(e); edf_ecg_free(q);
+        return(NULL);
+      }
+      e=tmp; ne=2*ne+k;
+    }
+    for (j=0; j<k; j++) { x[j]=gain*y[j]; }
+    m+=edf_ecg_run(q,i,x,k,&e[m],ne-m);
+  }
+  *n=m;
+  if ((p=(edf_annot_t *)calloc(*n+1,sizeof(edf_annot_t)))!=NULL) {
+    for (i=0; i<*n; i++) {
+      p[i].sc=e[i].sc; p[i].sec=e[i].sec;
+      strncpy(p[i].txt,edf_evt_name(&e[i]),ANNOTTXTLEN-1);
+    }
+  } else {
+    *n=0;
+  }
+  edf_ecg_free(q); free(e);
+  return(p);
+}
+
 /** main */
 int32_t main(int32_t argc, char *argv[]) {
 
   char    iname[MNCN];         /**< input file name */
   char    oname[MNCN];         /**< output ECG file name */
+  char    ecg[MNCN];           /**< ECG signal name for beat detection */
   FILE   *fp;                  /**< file pointer */
   edf_t   edf;                 /**< EDF/BDF struct */
+  edf_annot_idx_t *ai;         /**< annotation index */
+  edf_plane_t *pl=NULL;        /**< packed samples per signal for beat detection */
   edf_annot_t *p;              /**< pointer to annotations struct */
   int32_t n;                   /**< number of annotations */
   int32_t i;                   /**< general index */
+  int32_t first;               /**< index of first annotation in range */
+  double  t0,t1;               /**< annotation onset range [s] */
   double  ibi;                 /**< inter beat interval [s] */
   int32_t md;                  /**< report mode */
   
-  parse_cmd(argc,argv,iname,oname,&md);
+  parse_cmd(argc,argv,iname,oname,&md,&t0,&t1,ecg);
   
   fprintf(stderr,"# Open EDF/BDF file %s\n",iname);
   if ((fp=fopen(iname,"r"))==NULL) {
@@ -131,8 +203,16 @@ int32_t main(int32_t argc, char *argv[]) {
   /* read EDF/BDF main and signal headers */
   edf_rd_hdr(fp,&edf);
 
-  /* read EDF/BDF samples */
-  edf_rd_samples(fp,&edf);
+  /* read EDF/BDF samples, beat detection only needs the packed planes */
+  if ((strlen(ecg)==0) || (vb&0x02)) {
+    edf_rd_samples(fp,&edf);
+  }
+  if (strlen(ecg)>0) {
+    fseek(fp,edf.NrOfHeaderBytes,SEEK_SET);
+    if ((pl=edf_rd_planes(fp,&edf))==NULL) {
+      return(-1);
+    }
+  }
   
   fclose(fp);
 
@@ -145,9 +225,32 @@ int32_t main(int32_t argc, char *argv[]) {
     edf_prt_samples(stderr,&edf,0xFFFFFFFF);
   }
   
-  p=edf_get_annot(&edf,&n);
+  if (strlen(ecg)>0) {
+    /* detected beats instead of the annotations in the file */
+    p=ecg_detect(&edf,pl,ecg,&n);
+    for (i=0; i<edf.NrOfSignals; i++) { edf_plane_free(&pl[i]); }
+    free(pl);
+    if (p==NULL) {
+      return(-1);
+    }
+    if ((ai=edf_annot_idx_new(p,n,edf.NrOfDataRecords,NULL,edf.RecordDuration))==NULL) {
+      return(-1);
+    }
+    fprintf(stderr,"# found %d heart beats on signal %s\n",ai->n,ecg);
+  } else {
+    if ((ai=edf_get_annot_idx(&edf))==NULL) {
+      return(-1);
+    }
+    fprintf(stderr,"# found %d EDF/BDF annotations\n",ai->n);
+  }
   
-  fprintf(stderr,"# found %d EDF/BDF annotations\n",n);
+  /* select annotations in onset range [t0, t1) */
+  if ((t1<0) && (ai->n>0)) { t1=ai->p[ai->n-1].sec+1.0; }
+  n=edf_annot_idx_range(ai,t0,t1,&first);
+  p=&ai->p[first];
+  if (n!=ai->n) {
+    fprintf(stderr,"# selected %d EDF/BDF annotations from %.3f up to %.3f [s]\n",n,t0,t1);
+  }
   
   fprintf(stderr,"# Open annotation file %s\n",oname);
   if ((fp=fopen(oname,"w"))==NULL) {
@@ -156,7 +259,7 @@ int32_t main(int32_t argc, char *argv[]) {
   
   for (i=0; i<n; i++) {
     if (i==0) {
-      ibi=p[1].sec - p[  0].sec;
+      ibi=(n>1) ? p[1].sec - p[0].sec : 0.0;
     } else {
       ibi=p[i].sec - p[i-1].sec;
     }
@@ -171,5 +274,7 @@ int32_t main(int32_t argc, char *argv[]) {
   
   fclose(fp);
 
+  edf_annot_idx_free(ai);
+
   return(0);
 } 
@@ -55,9 +55,11 @@ int32_t edf2hdr_intro(FILE *fp) {
   int32_t nc=0;
   
   nc+=fprintf(fp,": %s\n",VERSION);
-  nc+=fprintf(fp,"Usage: edf2hdr [-i <in>] [-o <out>] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"Usage: edf2hdr [-i <in>] [-o <out>] [-s] [-v <vb>] [-d <dbg>] [-h]\n");
   nc+=fprintf(fp,"in   : input EDF/BDF file (default=%s)\n",INDEF);
   nc+=fprintf(fp,"out  : output EDF/BDF file (default=<in>.hdr)\n");
+  nc+=fprintf(fp,"s    : show signal min/max/mean/overflow from summary file <in>.sum\n");
+  nc+=fprintf(fp,"       (the summary file is made when it is missing)\n");
   nc+=fprintf(fp,"h    : show this manual page\n");
   nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
   nc+=fprintf(fp,"  0x01: show EDF header info\n");
@@ -66,11 +68,11 @@ int32_t edf2hdr_intro(FILE *fp) {
 }
 
 /** reads the options from the command line */
-static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname) {
+static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, int32_t *sum) {
 
   int32_t i;
  
-  strcpy(iname, INDEF); strcpy(oname,"");
+  strcpy(iname, INDEF); strcpy(oname,""); *sum=0;
   
   for (i=1; i<argc; i++) {
     if (argv[i][0]!='-') {
@@ -79,6 +81,7 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname) {
       switch (argv[i][1]) {
         case 'i': strcpy(iname,argv[++i]); break;
         case 'o': strcpy(oname,argv[++i]); break;
+        case 's': *sum=1; break;
         case 'v': vb=strtol(argv[++i],NULL,0); break;
         case 'd': dbg=strtol(argv[++i],NULL,0); break;
         case 'h': edf2hdr_intro(stderr); exit(0);
@@ -94,6 +97,44 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname) {
   }
 } 
 
+/** Print min/max/mean/overflow of all signals in 'edf' out of summary file
+ *   of EDF/BDF file 'iname', make summary file out of 'fp' when it is missing
+ *   or does not match 'iname' anymore.
+ * @return number of summarized records
+*/
+static int32_t edf2hdr_sum(FILE *fp, const char *iname, edf_t *edf) {
+
+  char sname[MNCN];          /**< summary file name */
+  edf_sum_idx_t *si;         /**< summary index */
+  edf_sum_t s;               /**< summary of one signal */
+  int32_t j;                 /**< signal index */
+  int32_t nr;                /**< number of summarized records */
+  double  gain;              /**< signal gain */
+
+  if (edf_sum_load(edf,iname)<0) {
+    edf_sum_name(sname,iname);
+    fprintf(stderr,"# Info: make summary file %s\n",sname);
+    edf_rd_samples(fp,edf);
+    if ((edf->sum=edf_sum_build(edf))==NULL) { return(0); }
+    edf_sum_stamp(edf->sum,iname,edf->NrOfDataRecords);
+    edf_sum_wr(edf->sum,sname);
+  }
+  si=edf->sum;
+  nr=si->nr[0];
+  
+  fprintf(stdout,"# %3s %16s %12s %12s %12s %9s %9s\n","nr","Label","min","max","mean","ovf","dim");
+  for (j=0; (j<si->ns) && (j<edf->NrOfSignals); j++) {
+    edf_sum_range(si,j,0,nr,&s);
+    gain = (edf->signal[j].PhysicalMax - edf->signal[j].PhysicalMin) /
+           (edf->signal[j].DigitalMax  - edf->signal[j].DigitalMin);
+    fprintf(stdout,"  %3d %16s %12.3f %12.3f %12.3f %9d %9s\n",j,edf->signal[j].Label,
+      gain*s.min,gain*s.max,gain*s.mean,s.ovf,edf->signal[j].PhysicalDimension);
+  }
+  edf_sum_free(si);
+  edf->sum=NULL;
+  return(nr);
+}
+
 /** main */
 int32_t main(int32_t argc, char *argv[]) {
 
@@ -102,8 +143,9 @@ int32_t main(int32_t argc, char *argv[]) {
   FILE *fp;
   edf_t edf;
   struct tm t0;
+  int32_t sum;               /**< show signal summary */
   
-  parse_cmd(argc,argv,iname,oname);
+  parse_cmd(argc,argv,iname,oname,&sum);
   
   fprintf(stderr,"# Open EDF/BDF file %s\n",iname);
   if ((fp=fopen(iname,"r"))==NULL) {
@@ -113,6 +155,10 @@ int32_t main(int32_t argc, char *argv[]) {
   /* read EDF/BDF main and signal headers */
   edf_rd_hdr(fp,&edf);
 
+  if (sum==1) {
+    edf2hdr_sum(fp,iname,&edf);
+  }
+
   fclose(fp);
 
 
@@ -37,6 +37,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <time.h>
 #include <errno.h>
 #include <math.h>
+#include <inttypes.h>
 
 #include "edf.h"
 
@@ -44,6 +45,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #define  INDEF "pp00_01_flanker_20090302T161501.bdf"
 #define  MNCN                (1024)  /**< maximum of characters in file name */
+#define  RSPORD                 (2)  /**< order of respiration low-pass */
+#define  RSPFC                (1.0)  /**< corner frequency [Hz] of respiration low-pass */
+#define  NSPAN               (1024)  /**< samples per detector run */
 
 int32_t  vb = 0x00;
 int32_t dbg = 0x00;
@@ -147,119 +151,64 @@ int32_t event_timing(FILE *fp, edf_t *edf, int32_t chn) {
   return(cnt);
 }
 
-/** Simple low-pass forward and backward filter (filtfilt) on 
- *   channel 'chn' of 'edf' struct.
- * @return 0 always
+/** Low-pass forward and backward filter (filtfilt) on channel 'chn' of 'edf' struct,
+ *   the filtered signal is made DC free.
+ * @return 0 on success, -1 on failure
 */
 int32_t rsp_filtfilt(edf_t *edf, int32_t chn) {
 
   double  fs;                 /**< sample frequency [Hz] */
   double  gain;               /**< gain of channel 'chn' */
-  int32_t lenShift1;          /**< length filter 1 */
-  int32_t iShift1 = 0;        /**< shift index filter 1 */
-  double  *Shift1 = NULL;     /**< shift register 1 */
-  double  Sum1 = 0.0;         /**< sum of all samples in 'Shift1' */
-  int32_t lenShift2;          /**< length filter 2 */
-  int32_t iShift2 = 0;        /**< shift index filter 2 */
-  double  *Shift2 = NULL;     /**< shift register 2 */
   int32_t i;                  /**< sample index */
-  int32_t yi;                 /**< integer representation of 'sample' */
-  int32_t ovf;                /**< overflow bit of 'sample' */
-  double  sample;             /**< respiration sample */
-  double  fsample;            /**< filtered respiration sample */
+  float  *x;                  /**< physical samples of channel 'chn' */
   double  smean;              /**< sample mean */
-  double  filtered = 0.0;     /**< sum of all samples in 'Shift2' */
+  edf_filt_t *flt;            /**< respiration low-pass */
+  edf_signal_t *sig = &edf->signal[chn];
+  int32_t ns = sig->NrOfSamples; /**< number of samples of channel 'chn' */
 
   /* sample frequency of channel 'chn'*/
   fs=edf->signal[chn].NrOfSamplesPerRecord / edf->RecordDuration;
    
-  /* set filter lengths */
-  lenShift1 = (int32_t)round(fs/2);
-  lenShift2 = (int32_t)round(fs/3);
-  /* allocate space for shift registers and initialize to zero */
-  Shift1=(double *)calloc(lenShift1, sizeof(double));
-  Shift2=(double *)calloc(lenShift2, sizeof(double));
-  
   /* gain of channel 'chn' */
   gain=(float)(edf->signal[chn].PhysicalMax - edf->signal[chn].PhysicalMin) /
               (edf->signal[chn].DigitalMax  - edf->signal[chn].DigitalMin);
-  
-  /* forward filtering */
-  for (i=0; i < edf->signal[chn].NrOfSamples; i++) {
-
-    /* get integer value and overflow bit of sample 'i' in channel 'chn' */
-    yi = edf_get_integer_overflow_value(edf, chn, i, &ovf);
-    sample = gain*yi;
-
-    /* Low pass filter built from 2-stage summing and shift registers */
-    Sum1 -= Shift1[iShift1];
-    Shift1[iShift1] = sample;
-    Sum1 += sample;
-
-    filtered -= Shift2[iShift2];
-    Shift2[iShift2] = Sum1;
-    filtered += Sum1;
 
-    if (++iShift1 >= lenShift1) { iShift1 = 0; }
-    if (++iShift2 >= lenShift2) { iShift2 = 0; }
-    
-    fsample = filtered/(lenShift1*lenShift2);
-    if (vb&0x02) {
-      fprintf(stderr,"#f %5d %.1f %.1f\n",i, sample, fsample/gain);
-    }
-
-    /* set new integer value with previous overflow bit */
-    edf_set_integer_overflow_value(edf, fsample, ovf, chn, i, gain);
+  /* respiration low-pass: 2nd order Butterworth, squared by filtfilt */
+  if (((flt=edf_filt_new(1))==NULL) || (edf_filt_add_lowpass(flt,RSPORD,fs,RSPFC)<0) ||
+      ((x=(float *)malloc(ns*sizeof(float)))==NULL)) {
+    fprintf(stderr,"# Error: can't make respiration filter of channel %d!!!\n",chn);
+    edf_filt_free(flt);
+    return(-1);
   }
   
-  /* sample mean */
-  smean = 0.0;
-  /* backward filtering to make result phase neutral */
-  for (i=edf->signal[chn].NrOfSamples-1; i>=0; i--) {
-
-    /* get integer value and overflow bit of sample 'i' in channel 'chn' */
-    yi = edf_get_integer_overflow_value(edf, chn, i, &ovf);
-    sample = gain*yi;
-
-    /* Low pass filter built from 2-stage summing and shift registers */
-    Sum1 -= Shift1[iShift1];
-    Shift1[iShift1] = sample;
-    Sum1 += sample;
-
-    filtered -= Shift2[iShift2];
-    Shift2[iShift2] = Sum1;
-    filtered += Sum1;
-
-    if (++iShift1 >= lenShift1) { iShift1 = 0; }
-    if (++iShift2 >= lenShift2) { iShift2 = 0; }
-
-    fsample = filtered/(lenShift1*lenShift2);
+  /* physical samples of channel 'chn': unchecked inline access, no copy */
+  for (i=0; i < ns; i++) {
+    x[i] = gain*edf_sample(sig, i, edf->bdf);
+  }
 
-    smean += fsample;
+  /* forward and backward filtering to make result phase neutral */
+  edf_filtfilt(flt, x, ns);
 
-    if (vb&0x02) {
-      fprintf(stderr,"#b %5d %.1f %.1f\n",i, sample, fsample/gain);
-    }
-    
-    /* set new integer value with previous overflow bit */
-    edf_set_integer_overflow_value(edf, fsample, ovf, chn, i, gain);
+  /* sample mean */
+  smean = 0.0;
+  for (i=0; i < ns; i++) {
+    smean += x[i];
   }
-  smean /= edf->signal[chn].NrOfSamples;
+  smean /= ns;
   
   /* make filtered respiration signal DC free */
-  for (i=0; i < edf->signal[chn].NrOfSamples; i++) {
-    /* get integer value and overflow bit of sample 'i' in channel 'chn' */
-    sample = gain*edf_get_integer_overflow_value(edf, chn, i, &ovf);
-    /* subtract mean value */
-    sample -= smean;
+  for (i=0; i < ns; i++) {
+    if (vb&0x02) {
+      fprintf(stderr,"#f %5d %.1f %.1f\n",i, gain*edf_sample(sig, i, edf->bdf), x[i]-smean);
+    }
     /* set new integer value with previous overflow bit */
-    edf_set_integer_overflow_value(edf, sample, ovf, chn, i, gain);
+    edf_sample_set_phys(sig, i, x[i]-smean, edf_sample_ovf(sig, i), gain, edf->bdf);
   }
 
   fprintf(stderr,"# Info: fs %9.3f [Hz] mean %12.3f [uV]\n", fs, smean);
 
-  free(Shift1); 
-  free(Shift2);
+  free(x);
+  edf_filt_free(flt);
   
   return(0);
 }
@@ -348,7 +297,7 @@ double rsp_p2p(edf_t *edf, int32_t chn, double dt) {
 
 
 /** Check for respiration minima or maxima on respiration channel 'name'
- * @returns 1 on even extreme, -1 on odd extreme and else 0
+ * @returns number of found extremes
 */
 int32_t rsp_detect(FILE *fp, edf_t *edf, char *name) {
 
@@ -356,30 +305,15 @@ int32_t rsp_detect(FILE *fp, edf_t *edf, char *name) {
   int32_t chn;                 /**< channel number of respiration signal */
   double  fs;                  /**< sample frequency [Hz] */
   double  gain;                /**< gain of channel 'chn' */
-  int32_t i;                   /**< sample index */
-  int32_t yi;                  /**< integer representation of 'filtered' */
-  int32_t ovf;                 /**< overflow bit of 'filtered' */
-  double  filtered = 0.0;      /**< sum of all samples in 'Shift2' */
-
-  double  mindist =  1500.0;   /**< minimum distance between local minimum and maximum */
-  double  maxdist = 10000.0;   /**< maximum distance between local minimum and maximum */
-
-  double  tmpDist = 0.0;       // Angular distance of tmporary breath extreme
-  double  tmpExtreme = 0.0;    // tmporary breath extreme
-  double  extreme = 0.0;       // Last extreme
-  int32_t period = -1;         // Current sample offset from last extreme, -1 triggers init
-  int32_t toggle = 1;          // Half-beat toggle
-  int32_t lastPeriod = 0;      // Previous beat slice period in samples
-  double  filteredPeriod = 0;  // Current average breathing period
-  double  rate;                // Current breathing rate per minute (available, but not used)
-
-  double  dist;                /**< distance (from extreme or from tmpExtreme) */
+  int32_t i,j,k;               /**< sample indices */
+  int32_t ne = 0;              /**< room for extremes in 'e' */
+  double  mindist;             /**< minimum distance between local minimum and maximum */
+  edf_rsp_t *r;                /**< respiration detector */
+  edf_evt_t *e = NULL, *tmp;   /**< found extremes */
   edf_annot_t *p = NULL;       /**< EDF/BDF annotation array */
-  int32_t chunksize = 32;      /**< chunk size of growing annotation array 'p' */
-  int32_t maxsize = chunksize; /**< maximum size 'p' */
+  float   x[NSPAN];            /**< span of filtered respiration samples */
+  int32_t ns;                  /**< number of samples of channel 'chn' */
   int32_t cnt = 0;             /**< annotation counter */
-  int32_t nxt = 0;             /**< sample counter since last found local extreme */
-  int32_t idx = 0;             /**< index of last found local extreme */
   double  dt;                  /**< respiration period [s] */
   
   /* make new signal name */
@@ -402,83 +336,44 @@ int32_t rsp_detect(FILE *fp, edf_t *edf, char *name) {
 
   /* get median p2p of all 20 [sec] epochs */
   mindist =  0.1*rsp_p2p(edf, chn, 20.0);
-  maxdist = 10.0*mindist;
   
-  fprintf(stderr,"# Info: mindist %9.3f [uV] maxdist %9.3f [uV]\n", mindist, maxdist);
+  fprintf(stderr,"# Info: mindist %9.3f [uV] maxdist %9.3f [uV]\n", mindist, 10.0*mindist);
   
-  /* allocate space for the annotation array 'p' */
-  p = (edf_annot_t *)calloc(maxsize, sizeof(edf_annot_t));
-
-  if (vb&0x08) { 
-    fprintf(stderr," %6s %6s %6s %12s %12s %12s %12s %12s %6s\n", 
-     "i", "nxt", "period", "filtered", "extreme", "dist", "tmpExtreme", "tmpDist", "state"); 
+  /* filtered respiration samples */
+  ns = edf->signal[chn].NrOfSamples;
+  if ((r = edf_rsp_new(fs, mindist, 0)) == NULL) {
+    return(0);
   }
-  /* check all respiration samples */
-  cnt=0;
-  for (i=0; i < edf->signal[chn].NrOfSamples; i++) {
 
-    /* get integer value and overflow bit of sample 'i' in channel 'chn' */
-    yi = edf_get_integer_overflow_value(edf, chn, i, &ovf);
-    filtered = gain*yi;
+  /* the offline detector runs the same code as the streaming one, one span at
+     a time, the extremes array grows on demand with room for one extreme per
+     sample of the next span */
+  for (i=0; i < ns; i+=k) {
+    k = (ns-i < NSPAN) ? ns-i : NSPAN;
+    if (cnt+k > ne) {
+      if ((tmp = (edf_evt_t *)realloc(e, (2*ne+k)*sizeof(edf_evt_t))) == NULL) {
+        fprintf(stderr,"# Error: can't detect respiration on channel %s!!!\n", newname);
+        free(e); edf_rsp_free(r);
+        return(0);
+      }
+      e = tmp; ne = 2*ne+k;
+    }
+    for (j=0; j < k; j++) {
+      x[j] = gain*edf_sample(&edf->signal[chn], i+j, edf->bdf);
+    }
+    cnt += edf_rsp_run(r, i, x, k, &e[cnt], ne-cnt);
+  }
+  edf_rsp_free(r);
 
+  /* allocate space for the annotation array 'p' */
+  p = (edf_annot_t *)calloc(cnt+1, sizeof(edf_annot_t));
+  for (i=0; i<cnt; i++) {
+    p[i].sc = e[i].sc; 
+    p[i].sec = e[i].sec; 
+    strncpy(p[i].txt, edf_evt_name(&e[i]), ANNOTTXTLEN-1);
     if (vb&0x08) { 
-      fprintf(stderr," %6d %6d %6d %12.3f %12.3f %12.3f %12.3f %12.3f", 
-       i, nxt, period, filtered, extreme, dist, tmpExtreme, tmpDist); 
-    }
-    if (++period == 0) { // On first round
-      extreme = filtered;
-      tmpDist = -1; // Force tmpExtreme update on next sample 
-      if (vb&0x08) { fprintf(stderr," first\n"); }
-    } else {
-      dist = fabs(filtered - extreme);
-      if (dist > tmpDist) { // Typical: still moving away from extreme, move tmpExtreme
-        tmpExtreme = filtered;
-        tmpDist = dist;
-        if (vb&0x08) { fprintf(stderr," move\n"); }
-        nxt = 0;
-     } else { // Moving backwards
-        dist = fabs(filtered - tmpExtreme);
-        if (dist > mindist) { // Moved back more than mindist from tmpExtreme: new extreme found
-          if (tmpDist < maxdist) { // Discard big motion artifacts for rate
-            // Full period consists of 2 slices (typically unequal length in- and exhale):
-            // So add previous slice period and filter a bit further:
-            filteredPeriod += 0.2*((double)(period + lastPeriod)/fs - filteredPeriod);
-            rate = 60.0/filteredPeriod;
-            lastPeriod = period;
-          }
-          if (vb&0x08) { fprintf(stderr," fnd\n"); }
-         
-          /* check available storage space */
-          if (cnt>=maxsize) {
-            /* extend with 'chunksize' items */
-            maxsize += chunksize;
-            p = (edf_annot_t *)realloc(p, maxsize*sizeof(edf_annot_t));
-          }
-          
-          /* store new found extreme */
-          p[cnt].sc = idx; 
-          p[cnt].sec = idx/fs; 
-          if (cnt==0) { 
-            strncpy(p[cnt].txt, "unkRSP", ANNOTTXTLEN-1); 
-          } else {
-            strncpy(p[cnt].txt, 
-             (toggle == 1
-             ? "maxRSP" : "minRSP"), ANNOTTXTLEN-1);
-          }
-          cnt++;
-         
-          period = 0; // Shift time base
-          extreme = tmpExtreme; // Remember new extreme
-          tmpExtreme = filtered; // Move tmpExtreme
-          tmpDist = dist;
-
-          toggle *= -1;
-        } else {
-          if (nxt==0) { idx=i; }
-          if (vb&0x08) { fprintf(stderr," next\n"); }
-          nxt++;
-        }
-      }
+      fprintf(stderr," %6" PRId64 " %12.3f %9s %9.3f %9.3f\n", 
+       e[i].sc, e[i].level, p[i].txt, e[i].period, e[i].rate); 
     }
   }
 
@@ -488,10 +383,7 @@ int32_t rsp_detect(FILE *fp, edf_t *edf, char *name) {
   fprintf(fp, " %3s %9s %9s %9s %12s %7s\n", "nr","sc","t","annot","level","dt");
 
   for (i=0; i<cnt; i++) {    
-    /* get integer value and overflow bit of sample 'i' in channel 'chn' */
-    yi = edf_get_integer_overflow_value(edf, chn, p[i].sc, &ovf);
-
-    fprintf(fp," %3d %9lld %9.3f %9s %12.3f", i, p[i].sc, p[i].sec, p[i].txt, gain*yi);
+    fprintf(fp," %3d %9" PRId64 " %9.3f %9s %12.3f", i, p[i].sc, p[i].sec, p[i].txt, e[i].level);
     if (i>1) {
       dt = p[i].sec - p[i-2].sec;
       fprintf(fp," %7.3f\n", dt);
@@ -500,8 +392,9 @@ int32_t rsp_detect(FILE *fp, edf_t *edf, char *name) {
     }
   }
   
-  /* free annotation array */
+  /* free annotation and event arrays */
   free(p);
+  free(e);
   
   return(cnt);
 }
@@ -534,6 +427,9 @@ int32_t main(int32_t argc, char *argv[]) {
   
   fclose(fp);
   
+  /* use summary sidecar file for the range check */
+  edf_sum_load(&edf,iname);
+  
   /* chech ranges on all channels */
   edf_range_chk(&edf);
   /* show range check results */
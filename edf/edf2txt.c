@@ -60,7 +60,7 @@ int32_t edf2txt_intro(FILE *fp) {
   int32_t nc=0;
   
   nc+=fprintf(fp,": %s\n",VERSION);
-  nc+=fprintf(fp,"Usage: edf2txt [-i <in>] [-o <out>] [-c <chn>] [-L <lbs>] [-H <hex>] [-V <val>] [-k <hdr>] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"Usage: edf2txt [-i <in>] [-o <out>] [-c <chn>] [-L <lbs>] [-H <hex>] [-V <val>] [-k <hdr>] [-j <nt>] [-v <vb>] [-d <dbg>] [-h]\n");
   nc+=fprintf(fp,"in   : input EDF/BDF file (default=%s)\n",INDEF);
   nc+=fprintf(fp,"out  : output EDF/BDF file (default=<in>.txt)\n");
   nc+=fprintf(fp,"chn  : channel switch (default=0x%04X)\n",CHNDEF);
@@ -68,6 +68,7 @@ int32_t edf2txt_intro(FILE *fp) {
   nc+=fprintf(fp,"val  : channel selection for float output (default=%s)\n",VALDEF);
   nc+=fprintf(fp,"hex  : channel selection for hex integer representation output (default=%s)\n",LBHEXDEF);
   nc+=fprintf(fp,"hdr  : show header in txt output file (0:off 1:on) (default=%d)\n",hdr);
+  nc+=fprintf(fp,"nt   : number of threads formatting the txt output file (default=1)\n");
   nc+=fprintf(fp,"h    : show this manual page\n");
   nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
   nc+=fprintf(fp,"  0x01: show EDF header info\n");
@@ -95,6 +96,7 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname,
         case 'o': strcpy(oname,argv[++i]); break;
         case 'c': *chn=strtoll(argv[++i],NULL,0); break;
         case 'k': hdr=strtoll(argv[++i],NULL,0); break;
+        case 'j': edf_fmt_set_nt(strtol(argv[++i],NULL,0)); break;
         case 'L': strncpy(lbs,argv[++i],MNCN-1); break;
         case 'V': strncpy(val,argv[++i],MNCN-1); break;
         case 'H': strncpy(lbhex,argv[++i],MNCN-1); break;
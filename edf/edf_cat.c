@@ -0,0 +1,451 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file edf_cat.c
+ * Catalog of EDF/BDF recordings made out of their headers only.
+ *  The main and signal headers are read with positioned reads by a few
+ *  threads at once, so a directory with hundreds of recordings is scanned
+ *  without reading any samples.
+ */
+
+#ifndef _XOPEN_SOURCE
+  #define _XOPEN_SOURCE  700 // for pread(), strdup()
+#endif
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "edf.h"
+
+#define EDFCATMAGIC "# edfcat 1"  /**< catalog file identification */
+#define EDFCATMAXNS       (512)  /**< maximum number of signals accepted */
+
+/** work shared by the catalog scanner threads */
+typedef struct EDF_CAT_WORK_T {
+  char          **fname;   /**< file names */
+  edf_cat_t      *c;       /**< catalog entry per file name */
+  int32_t         n;       /**< number of files */
+  int32_t         next;    /**< next file to scan */
+  pthread_mutex_t mutex;   /**< protects 'next' */
+} edf_cat_work_t;
+
+/** Copy at most 'n'-1 characters of 'src' into 'dst' and terminate it
+*/
+static void edf_cat_strcpy(char *dst, const char *src, size_t n) {
+  strncpy(dst,src,n-1);
+  dst[n-1]='\0';
+}
+
+/** Set subject and chair of 'c' out of its file name:
+ *   <subject>-<chair>_YYYYMMDDTHHMMSS.bdf or <subject>_YYYYMMDDTHHMMSS.bdf
+*/
+static void edf_cat_name(edf_cat_t *c) {
+
+  const char *b;     /**< base name */
+  const char *e;     /**< end of subject and chair */
+  const char *d;     /**< subject and chair separator */
+  size_t len;        /**< number of characters */
+
+  b=strrchr(c->name,'/');
+  b=(b==NULL) ? c->name : b+1;
+  if ((e=strrchr(b,'_'))==NULL) {
+    e=strrchr(b,'.');
+  }
+  if (e==NULL) { e=b+strlen(b); }
+  if (((d=strchr(b,'-'))==NULL) || (d>e)) {
+    d=e;
+  }
+  len=d-b;
+  if (len>=sizeof(c->subject)) { len=sizeof(c->subject)-1; }
+  memcpy(c->subject,b,len); c->subject[len]='\0';
+  if (d<e) {
+    len=e-d-1;
+    if (len>=sizeof(c->chair)) { len=sizeof(c->chair)-1; }
+    memcpy(c->chair,d+1,len); c->chair[len]='\0';
+  }
+}
+
+/** Read header summary of EDF/BDF file 'fname' into 'c' with positioned
+ *   reads of the main and signal headers only.
+ * @return 0 when the file is OK, EDFCAT_* flags on problems
+*/
+int32_t edf_cat_rd_file(const char *fname, edf_cat_t *c) {
+
+  char    buf[256];  /**< main header */
+  char   *sbuf;      /**< signal headers */
+  int     fd;        /**< file descriptor */
+  struct  stat st;   /**< file status */
+  edf_t   edf;       /**< EDF/BDF headers */
+  int32_t recordSize;/**< record size [byte] */
+  int64_t len;       /**< data size [byte] */
+  size_t  nc;        /**< number of characters in 'labels' */
+  int32_t i;         /**< signal index */
+
+  memset(c,0,sizeof(edf_cat_t));
+  edf_cat_strcpy(c->name,fname,sizeof(c->name));
+  edf_cat_name(c);
+  c->bdf=-1;
+
+  if ((fd=open(fname,O_RDONLY))<0) {
+    perror(fname);
+    c->flags=EDFCAT_HDR;
+    return(c->flags);
+  }
+  if ((fstat(fd,&st)!=0) || (pread(fd,buf,sizeof(buf),0)!=sizeof(buf))) {
+    close(fd);
+    c->flags=EDFCAT_HDR;
+    return(c->flags);
+  }
+  c->size=st.st_size;
+
+  memset(&edf,0,sizeof(edf));
+  edf_parse_hdr(buf,&edf);
+  c->bdf=edf.bdf;
+  if ((edf.bdf<0) || (edf.NrOfSignals<=0) || (edf.NrOfSignals>EDFCATMAXNS)) {
+    close(fd);
+    c->flags=EDFCAT_HDR;
+    return(c->flags);
+  }
+  if (((edf.bdf==1) && ((unsigned char)buf[0]!=0xFF)) || ((edf.bdf==0) && (buf[0]!='0'))) {
+    c->flags|=EDFCAT_VERSION;
+  }
+  if (edf.NrOfHeaderBytes!=256*(edf.NrOfSignals+1)) {
+    c->flags|=EDFCAT_HDRSIZE;
+  }
+  edf_cat_strcpy(c->PatientId,edf.PatientId,sizeof(c->PatientId));
+  c->StartDateTime  =edf.StartDateTime;
+  c->RecordDuration =edf.RecordDuration;
+  c->NrOfDataRecords=edf.NrOfDataRecords;
+  c->NrOfSignals    =edf.NrOfSignals;
+
+  sbuf=(char *)malloc(256*edf.NrOfSignals);
+  edf.signal=(edf_signal_t *)calloc(edf.NrOfSignals,sizeof(edf_signal_t));
+  if ((sbuf==NULL) || (edf.signal==NULL) ||
+      (pread(fd,sbuf,256*edf.NrOfSignals,256)!=256*edf.NrOfSignals)) {
+    c->flags|=EDFCAT_HDR;
+  } else {
+    edf_parse_signal_hdr(sbuf,&edf);
+    /* labels as far as they fit */
+    for (i=0, nc=0; i<edf.NrOfSignals; i++) {
+      if (nc+strlen(edf.signal[i].Label)+2>sizeof(c->labels)) { break; }
+      nc+=sprintf(&c->labels[nc],"%s%s",(i>0) ? "," : "",edf.signal[i].Label);
+    }
+    /* validate record count against file size */
+    recordSize=edf_get_record_size(&edf);
+    len=c->size-edf.NrOfHeaderBytes;
+    if ((recordSize>0) && (len>=0)) {
+      c->NrOfRecords=(int32_t)(len/recordSize);
+      if (len%recordSize!=0) { c->flags|=EDFCAT_PARTIAL; }
+      if (c->NrOfRecords!=c->NrOfDataRecords) { c->flags|=EDFCAT_RECCNT; }
+    } else {
+      c->flags|=EDFCAT_HDR;
+    }
+  }
+  if (sbuf!=NULL) free(sbuf);
+  if (edf.signal!=NULL) free(edf.signal);
+  close(fd);
+
+  return(c->flags);
+}
+
+/** Catalog scanner thread: scan files of 'arg' until all are done
+ * @return NULL
+*/
+static void *edf_cat_thread(void *arg) {
+
+  edf_cat_work_t *w=(edf_cat_work_t *)arg;
+  int32_t i;         /**< file index */
+
+  for (;;) {
+    pthread_mutex_lock(&w->mutex);
+    i=w->next++;
+    pthread_mutex_unlock(&w->mutex);
+    if (i>=w->n) { break; }
+    edf_cat_rd_file(w->fname[i],&w->c[i]);
+  }
+  return(NULL);
+}
+
+/** Read header summaries of the 'n' files 'fname' with 'nt' threads
+ * @return array of 'n' catalog entries in order of 'fname', an empty array
+ *   when 'n'<=0, NULL on failure
+*/
+edf_cat_t *edf_cat_scan(char **fname, int32_t n, int32_t nt) {
+
+  edf_cat_work_t w;  /**< shared work */
+  pthread_t *tid;    /**< thread ids */
+  int32_t i;         /**< thread index */
+  int32_t nstarted=0;/**< number of started threads */
+
+  /* no files is an empty catalog, not an error */
+  if ((w.c=(edf_cat_t *)calloc(n>0 ? n : 1,sizeof(edf_cat_t)))==NULL) {
+    fprintf(stderr,"# Error: edf_cat_scan memory allocation problem\n");
+    return(NULL);
+  }
+  if (n<=0) { return(w.c); }
+  w.fname=fname; w.n=n; w.next=0;
+  pthread_mutex_init(&w.mutex,NULL);
+
+  if (nt<=0) { nt=(int32_t)sysconf(_SC_NPROCESSORS_ONLN)*2; }
+  if (nt>n)  { nt=n; }
+  if ((tid=(pthread_t *)calloc(nt,sizeof(pthread_t)))!=NULL) {
+    for (i=0; i<nt; i++) {
+      if (pthread_create(&tid[i],NULL,edf_cat_thread,&w)!=0) { break; }
+      nstarted++;
+    }
+  }
+  /* the calling thread helps, and does all work when no thread started */
+  edf_cat_thread(&w);
+  for (i=0; i<nstarted; i++) {
+    pthread_join(tid[i],NULL);
+  }
+  if (tid!=NULL) free(tid);
+  pthread_mutex_destroy(&w.mutex);
+
+  return(w.c);
+}
+
+/** Compare file names for qsort()
+ * @return <0, 0, >0
+*/
+static int edf_cat_comp_func(const void *ap, const void *bp) {
+  return(strcmp(*(char * const *)ap,*(char * const *)bp));
+}
+
+/** Read header summaries of all *.bdf and *.edf files in directory 'dir'
+ *   with 'nt' threads, the number of files is returned in 'n'.
+ * @return array of catalog entries sorted on file name, NULL on failure
+*/
+edf_cat_t *edf_cat_scan_dir(const char *dir, int32_t nt, int32_t *n) {
+
+  DIR    *dp;          /**< directory */
+  struct  dirent *de;  /**< directory entry */
+  char  **fname=NULL;  /**< file names */
+  char  **tmp;         /**< reallocated file names */
+  int32_t size=0;      /**< allocated number of file names */
+  const char *ext;     /**< file name extension */
+  char    path[EDFCATNAMESIZE]; /**< file name with directory */
+  edf_cat_t *c;        /**< catalog */
+  int32_t i;           /**< file index */
+
+  *n=0;
+  if ((dp=opendir(dir))==NULL) {
+    perror(dir); return(NULL);
+  }
+  while ((de=readdir(dp))!=NULL) {
+    if (((ext=strrchr(de->d_name,'.'))==NULL) ||
+        ((strcmp(ext,".bdf")!=0) && (strcmp(ext,".edf")!=0))) {
+      continue;
+    }
+    if (*n>=size) {
+      size+=256;
+      if ((tmp=(char **)realloc(fname,size*sizeof(char *)))==NULL) {
+        fprintf(stderr,"# Error: edf_cat_scan_dir memory allocation problem\n");
+        break;
+      }
+      fname=tmp;
+    }
+    if (snprintf(path,sizeof(path),"%s/%s",dir,de->d_name)>=(int)sizeof(path)) {
+      fprintf(stderr,"# Warning: skip too long file name %s\n",de->d_name);
+      continue;
+    }
+    if ((fname[*n]=strdup(path))!=NULL) { (*n)++; }
+  }
+  closedir(dp);
+
+  qsort(fname,*n,sizeof(char *),edf_cat_comp_func);
+  c=edf_cat_scan(fname,*n,nt);
+  for (i=0; i<*n; i++) {
+    free(fname[i]);
+  }
+  if (fname!=NULL) free(fname);
+  return(c);
+}
+
+/** Write 'n' catalog entries 'c' as text lines to file 'fp'
+ * @return number of characters printed.
+*/
+int32_t edf_cat_wr(FILE *fp, const edf_cat_t *c, int32_t n) {
+
+  int32_t nc=0;
+  struct  tm t0;
+  int32_t i;
+
+  nc+=fprintf(fp,"%s\n",EDFCATMAGIC);
+  nc+=fprintf(fp,"# name\tsubject\tchair\tstart\tduration\tRecordDuration\tNrOfSignals"
+    "\tNrOfDataRecords\tNrOfRecords\tbdf\tsize\tflags\tPatientId\tlabels\n");
+  for (i=0; i<n; i++) {
+    t0=*localtime(&c[i].StartDateTime);
+    nc+=fprintf(fp,"%s\t%s\t%s\t%04d-%02d-%02dT%02d:%02d:%02d\t%.3f\t%g\t%d\t%d\t%d\t%d\t%" PRId64 "\t0x%02X\t%s\t%s\n",
+      c[i].name,(c[i].subject[0]=='\0') ? "-" : c[i].subject,(c[i].chair[0]=='\0') ? "-" : c[i].chair,
+      1900+t0.tm_year,t0.tm_mon+1,t0.tm_mday,t0.tm_hour,t0.tm_min,t0.tm_sec,
+      c[i].NrOfRecords*c[i].RecordDuration,c[i].RecordDuration,c[i].NrOfSignals,
+      c[i].NrOfDataRecords,c[i].NrOfRecords,c[i].bdf,c[i].size,c[i].flags,
+      (c[i].PatientId[0]=='\0') ? "-" : c[i].PatientId,c[i].labels);
+  }
+  return(nc);
+}
+
+/** Get next tab separated field out of 'line' at 'p' into 'dst' of 'n' characters,
+ *   a single '-' is an empty field.
+ * @return 0 on success, -1 when no field is left
+*/
+static int32_t edf_cat_field(char **p, char *dst, size_t n) {
+
+  char *s=*p;        /**< start of field */
+  char *e;           /**< end of field */
+
+  if (s==NULL) { dst[0]='\0'; return(-1); }
+  if ((e=strchr(s,'\t'))!=NULL) {
+    *e='\0'; *p=e+1;
+  } else {
+    if ((e=strchr(s,'\n'))!=NULL) { *e='\0'; }
+    *p=NULL;
+  }
+  edf_cat_strcpy(dst,(strcmp(s,"-")==0) ? "" : s,n);
+  return(0);
+}
+
+/** Read catalog file 'fname' as written by edf_cat_wr(), the number of entries
+ *   is returned in 'n'.
+ * @return array of catalog entries, an empty array for an empty catalog, NULL on failure
+*/
+edf_cat_t *edf_cat_rd(const char *fname, int32_t *n) {
+
+  FILE   *fp;
+  char    line[EDFCATNAMESIZE+EDFCATLBLSIZE+512]; /**< catalog line */
+  char    fld[EDFCATNAMESIZE];   /**< numeric field */
+  char   *p;                     /**< parse position */
+  edf_cat_t *c=NULL;             /**< catalog */
+  edf_cat_t *tmp;                /**< reallocated catalog */
+  int32_t size=0;                /**< allocated number of entries */
+  struct  tm cal;                /**< broken calendar time */
+  int32_t i;                     /**< field index */
+
+  *n=0;
+  if ((fp=fopen(fname,"r"))==NULL) {
+    perror(fname); return(NULL);
+  }
+  if ((fgets(line,sizeof(line),fp)==NULL) || (strncmp(line,EDFCATMAGIC,strlen(EDFCATMAGIC))!=0)) {
+    fprintf(stderr,"# Error: unknown catalog file format %s\n",fname);
+    fclose(fp);
+    return(NULL);
+  }
+  while (fgets(line,sizeof(line),fp)!=NULL) {
+    if (line[0]=='#') { continue; }
+    if (*n>=size) {
+      size+=256;
+      if ((tmp=(edf_cat_t *)realloc(c,size*sizeof(edf_cat_t)))==NULL) {
+        fprintf(stderr,"# Error: edf_cat_rd memory allocation problem\n");
+        break;
+      }
+      c=tmp;
+    }
+    memset(&c[*n],0,sizeof(edf_cat_t));
+    p=line;
+    edf_cat_field(&p,c[*n].name,sizeof(c[*n].name));
+    edf_cat_field(&p,c[*n].subject,sizeof(c[*n].subject));
+    edf_cat_field(&p,c[*n].chair,sizeof(c[*n].chair));
+    for (i=0; i<9; i++) {
+      if (edf_cat_field(&p,fld,sizeof(fld))<0) { break; }
+      switch (i) {
+        case 0:
+          memset(&cal,0,sizeof(cal));
+          sscanf(fld,"%d-%d-%dT%d:%d:%d",&cal.tm_year,&cal.tm_mon,&cal.tm_mday,
+            &cal.tm_hour,&cal.tm_min,&cal.tm_sec);
+          cal.tm_year-=1900; cal.tm_mon-=1; cal.tm_isdst=-1;
+          c[*n].StartDateTime=mktime(&cal);
+          break;
+        case 1: break; /* duration follows from record count */
+        case 2: c[*n].RecordDuration =strtod(fld,NULL); break;
+        case 3: c[*n].NrOfSignals    =strtol(fld,NULL,10); break;
+        case 4: c[*n].NrOfDataRecords=strtol(fld,NULL,10); break;
+        case 5: c[*n].NrOfRecords    =strtol(fld,NULL,10); break;
+        case 6: c[*n].bdf            =strtol(fld,NULL,10); break;
+        case 7: c[*n].size           =strtoll(fld,NULL,10); break;
+        case 8: c[*n].flags          =strtol(fld,NULL,0); break;
+      }
+    }
+    edf_cat_field(&p,c[*n].PatientId,sizeof(c[*n].PatientId));
+    edf_cat_field(&p,c[*n].labels,sizeof(c[*n].labels));
+    (*n)++;
+  }
+  fclose(fp);
+  if ((c==NULL) && ((c=(edf_cat_t *)calloc(1,sizeof(edf_cat_t)))==NULL)) {
+    fprintf(stderr,"# Error: edf_cat_rd memory allocation problem\n");
+  }
+  return(c);
+}
+
+/** Check catalog entry 'c' on 'subject', 'chair' and signal 'label' (NULL or
+ *   empty: any) and an overlap with [t0, t1] (t1<=t0: any time).
+ * @return 1 on match, 0 otherwise
+*/
+int32_t edf_cat_match(const edf_cat_t *c, const char *subject, const char *chair,
+ const char *label, time_t t0, time_t t1) {
+
+  const char *p;     /**< label position in 'labels' */
+  size_t len;        /**< label length */
+  time_t te;         /**< end of recording */
+
+  if ((subject!=NULL) && (subject[0]!='\0') && (strcmp(subject,c->subject)!=0)) {
+    return(0);
+  }
+  if ((chair!=NULL) && (chair[0]!='\0') && (strcmp(chair,c->chair)!=0)) {
+    return(0);
+  }
+  if ((label!=NULL) && (label[0]!='\0')) {
+    len=strlen(label);
+    for (p=strstr(c->labels,label); p!=NULL; p=strstr(p+1,label)) {
+      /* whole label only */
+      if (((p==c->labels) || (p[-1]==',')) && ((p[len]=='\0') || (p[len]==','))) {
+        break;
+      }
+    }
+    if (p==NULL) { return(0); }
+  }
+  if (t1>t0) {
+    te=c->StartDateTime+(time_t)(c->NrOfRecords*c->RecordDuration);
+    if ((te<t0) || (c->StartDateTime>t1)) { return(0); }
+  }
+  return(1);
+}
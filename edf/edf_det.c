@@ -0,0 +1,311 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+/** \file edf_det.c
+ * Streaming respiration and heart beat detectors: all state is kept per
+ *  sample in the detector, so blocks of any size can be fed from the 
+ *  acquisition loop and the found events are reported with bounded latency.
+ *  The offline tools feed whole signals through the same code.
+ */
+
+#ifdef _MSC_VER
+  #include "../nexus/inc/win32_compat.h"
+  #include "../nexus/inc/stdint_win32.h"
+#else
+  #include <stdint.h>
+  #include <inttypes.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "edf.h"
+
+/** event names of the event types */
+static const char *edf_evt_txt[] = { "unkRSP", "maxRSP", "minRSP", "beat" };
+
+/** Get text of event 'e' as used in annotations
+ * @return event name
+*/
+const char *edf_evt_name(const edf_evt_t *e) {
+
+  if ((e->type<0) || (e->type>EDFEVTBEAT)) { return("unknown"); }
+  return(edf_evt_txt[e->type]);
+}
+
+/** Print event 'e' of channel 'chn' with time offset 't0' [s] into 'msg' of 
+ *   'size' characters as '<name> chn t level period rate'
+ * @return number of characters printed
+*/
+int32_t edf_evt_prt(char *msg, int32_t size, int32_t chn, double t0, const edf_evt_t *e) {
+
+  return(snprintf(msg,size,"%s %d %.6f %.3f %.3f %.2f\n",edf_evt_name(e),chn,
+   t0+e->sec,e->level,e->period,e->rate));
+}
+
+/** Store event of 'type' at sample 'sc' of detector with sample frequency 'fs' 
+ *   in 'e' of 'ne' events, when there is room for it.
+ * @return number of events in 'e'
+*/
+static int32_t edf_evt_add(edf_evt_t *e, int32_t n, int32_t ne, int32_t type, int64_t sc,
+ double fs, double level, double period, double rate) {
+
+  if (n>=ne) {
+    fprintf(stderr,"# Warning: no room for %s event at %.3f [s]\n",edf_evt_txt[type],sc/fs);
+    return(n);
+  }
+  e[n].type=type; e[n].sc=sc; e[n].sec=sc/fs;
+  e[n].level=level; e[n].period=period; e[n].rate=rate;
+  return(n+1);
+}
+
+/** Make respiration detector for sample frequency 'fs' [Hz] with minimum
+ *   extreme distance 'mindist' ('mindist'<=0: 10% of the smallest peak-to-peak
+ *   of all EDFRSPEPOCH [s] epochs so far) and with 'flt'==1 an internal low-pass.
+ * @return pointer to respiration detector, NULL on failure
+*/
+edf_rsp_t *edf_rsp_new(double fs, double mindist, int32_t flt) {
+
+  edf_rsp_t *r;
+
+  if ((r=(edf_rsp_t *)calloc(1,sizeof(edf_rsp_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate respiration detector!!!\n");
+    return(NULL);
+  }
+  r->fs=fs; r->toggle=1; r->p2pmin=-1.0;
+  if (mindist>0.0) {
+    r->fixed=1; r->mindist=mindist; r->maxdist=10.0*mindist;
+  } else {
+    r->mindist=INFINITY; r->maxdist=INFINITY;
+  }
+  if (flt) {
+    if (((r->flt=edf_filt_new(1))==NULL) || (edf_filt_add_lowpass(r->flt,EDFRSPORD,fs,EDFRSPFC)<0)) {
+      edf_rsp_free(r);
+      return(NULL);
+    }
+  }
+  return(r);
+}
+
+/** Free respiration detector 'r'
+*/
+void edf_rsp_free(edf_rsp_t *r) {
+
+  if (r==NULL) { return; }
+  edf_filt_free(r->flt);
+  free(r);
+}
+
+/** Update minimum extreme distance of 'r' with the peak-to-peak of each epoch */
+static void edf_rsp_p2p(edf_rsp_t *r, float x) {
+
+  double p2p;
+
+  if (r->fixed) { return; }
+  if ((r->ns==0) || (x<r->ymin)) { r->ymin=x; }
+  if ((r->ns==0) || (x>r->ymax)) { r->ymax=x; }
+  if (++r->ns < (int32_t)round(EDFRSPEPOCH*r->fs)) { return; }
+  /* end of epoch reached: flat epochs are skipped */
+  p2p=r->ymax-r->ymin; r->ns=0;
+  if ((p2p>0.0) && ((r->p2pmin<0.0) || (p2p<r->p2pmin))) {
+    r->p2pmin=p2p;
+    r->mindist= 0.1*p2p;
+    r->maxdist=10.0*r->mindist;
+  }
+}
+
+/** Feed 'n' respiration samples 'x' starting at sample counter 'sc' to detector
+ *   'r', NaN samples are skipped. Found extremes are stored in 'e' of 'ne' events,
+ *   at most one per sample. The extremes are reported when the signal moved back
+ *   'mindist' from it.
+ * @return number of events in 'e'
+*/
+int32_t edf_rsp_run(edf_rsp_t *r, int64_t sc, const float *x, int32_t n, edf_evt_t *e, int32_t ne) {
+
+  int32_t i,m=0;
+  int32_t type;             /**< event type */
+  int64_t period;           /**< samples since last extreme */
+  double  dist;             /**< distance from extreme or from tmpExtreme */
+  float   filtered;         /**< respiration sample */
+
+  for (i=0; i<n; i++, sc++) {
+    filtered=x[i];
+    if (isnan(filtered)) { continue; }
+    if (r->flt!=NULL) {
+      if (r->init==0) { edf_filt_init(r->flt,&filtered); }
+      edf_filt_run(r->flt,&filtered,1);
+    }
+    edf_rsp_p2p(r,filtered);
+
+    if (r->init==0) { // On first round
+      r->extreme = filtered;
+      r->tmpDist = -1; // Force tmpExtreme update on next sample 
+      r->scExtreme = sc; r->init = 1;
+      continue;
+    }
+    period = sc - r->scExtreme;
+    dist = fabs(filtered - r->extreme);
+    if (dist > r->tmpDist) { // Typical: still moving away from extreme, move tmpExtreme
+      r->tmpExtreme = filtered;
+      r->tmpDist = dist;
+      r->nxt = 0;
+    } else { // Moving backwards
+      dist = fabs(filtered - r->tmpExtreme);
+      if (dist > r->mindist) { // Moved back more than mindist from tmpExtreme: new extreme found
+        if (r->tmpDist < r->maxdist) { // Discard big motion artifacts for rate
+          // Full period consists of 2 slices (typically unequal length in- and exhale):
+          // So add previous slice period and filter a bit further:
+          r->filteredPeriod += 0.2*((double)(period + r->lastPeriod)/r->fs - r->filteredPeriod);
+          r->rate = 60.0/r->filteredPeriod;
+          r->lastPeriod = period;
+        }
+        if (r->cnt==0) { 
+          type=EDFEVTRSP; 
+        } else {
+          type=(r->toggle==1) ? EDFEVTMAX : EDFEVTMIN;
+        }
+        m=edf_evt_add(e,m,ne,type,r->idx,r->fs,r->level,r->filteredPeriod,r->rate);
+        r->cnt++;
+       
+        r->scExtreme = sc; // Shift time base
+        r->extreme = r->tmpExtreme; // Remember new extreme
+        r->tmpExtreme = filtered; // Move tmpExtreme
+        r->tmpDist = dist;
+
+        r->toggle *= -1;
+      } else {
+        if (r->nxt==0) { r->idx=sc; r->level=filtered; }
+        r->nxt++;
+      }
+    }
+  }
+  return(m);
+}
+
+/** Make heart beat detector for ECG with sample frequency 'fs' [Hz]
+ * @return pointer to heart beat detector, NULL on failure
+*/
+edf_ecg_t *edf_ecg_new(double fs) {
+
+  edf_ecg_t *q;
+
+  if ((q=(edf_ecg_t *)calloc(1,sizeof(edf_ecg_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate heart beat detector!!!\n");
+    return(NULL);
+  }
+  q->fs=fs;
+  q->nwin=(int32_t)round(EDFECGWIN*fs); if (q->nwin<1) { q->nwin=1; }
+  if (((q->win=(float *)calloc(q->nwin,sizeof(float)))==NULL) || 
+      ((q->flt=edf_filt_new(1))==NULL) ||
+      (edf_filt_add_bandpass(q->flt,EDFECGORD,fs,EDFECGF0,EDFECGF1)<0)) {
+    fprintf(stderr,"# Error: can't make heart beat detector for %.1f [Hz]!!!\n",fs);
+    edf_ecg_free(q);
+    return(NULL);
+  }
+  return(q);
+}
+
+/** Free heart beat detector 'q'
+*/
+void edf_ecg_free(edf_ecg_t *q) {
+
+  if (q==NULL) { return; }
+  edf_filt_free(q->flt);
+  free(q->win);
+  free(q);
+}
+
+/** Feed 'n' ECG samples 'x' starting at sample counter 'sc' to detector 'q',
+ *   NaN samples are skipped. QRS complexes are found on the moving average of
+ *   the squared band-passed ECG above an adaptive threshold, a beat is placed
+ *   at the largest band-passed sample of the complex and reported at its end.
+ *   Found beats are stored in 'e' of 'ne' events, at most one per sample.
+ * @return number of events in 'e'
+*/
+int32_t edf_ecg_run(edf_ecg_t *q, int64_t sc, const float *x, int32_t n, edf_evt_t *e, int32_t ne) {
+
+  int32_t i,m=0;
+  float   y;                /**< band-passed ECG */
+  double  mi;               /**< moving average of squared 'y' */
+  double  ibi;              /**< inter beat interval [s] */
+
+  for (i=0; i<n; i++, sc++) {
+    if (isnan(x[i])) { continue; }
+    y=x[i];
+    if (q->init==0) { 
+      q->sc0=sc; q->lastBeat=sc; q->init=1; 
+      edf_filt_init(q->flt,&y);
+    }
+    edf_filt_run(q->flt,&y,1);
+    /* moving average of the energy */
+    q->sum += (double)y*y - q->win[q->wi];
+    q->win[q->wi] = y*y;
+    if (++q->wi>=q->nwin) { q->wi=0; }
+    mi = q->sum/q->nwin;
+
+    /* learn signal peak level */
+    if (sc - q->sc0 < (int64_t)round(EDFECGLEARN*q->fs)) {
+      if (mi > q->spk) { q->spk = mi; }
+      continue;
+    }
+    /* no beat for a while: lower threshold */
+    if ((q->inq==0) && (sc - q->lastBeat > (int64_t)round(EDFECGLOST*q->fs)) &&
+        (sc - q->lastDecay > (int64_t)round(q->fs))) {
+      q->spk *= 0.5; q->lastDecay = sc;
+    }
+    /* start of QRS complex after refractory period */
+    if ((q->inq==0) && (mi > EDFECGTHR*q->spk) &&
+        ((q->cnt==0) || (sc - q->lastBeat > (int64_t)round(EDFECGREFR*q->fs)))) {
+      q->inq=1; q->qsc=sc; q->qmax=fabs(y); q->qlvl=x[i]; q->qstart=sc; q->mmax=mi;
+    }
+    if (q->inq==0) { continue; }
+    if (fabs(y) > q->qmax) { q->qmax=fabs(y); q->qsc=sc; q->qlvl=x[i]; }
+    if (mi > q->mmax) { q->mmax=mi; }
+    /* end of QRS complex */
+    if ((mi < 0.5*EDFECGTHR*q->spk) || (sc - q->qstart > (int64_t)round(EDFECGQRS*q->fs))) {
+      if (q->cnt>0) {
+        ibi = (q->qsc - q->lastBeat)/q->fs;
+        q->filteredIbi = (q->cnt==1) ? ibi : q->filteredIbi + 0.2*(ibi - q->filteredIbi);
+        q->rate = 60.0/q->filteredIbi;
+      } else {
+        ibi = 0.0;
+      }
+      m=edf_evt_add(e,m,ne,EDFEVTBEAT,q->qsc,q->fs,q->qlvl,ibi,q->rate);
+      q->spk = 0.125*q->mmax + 0.875*q->spk;
+      q->lastBeat = q->qsc; q->lastDecay = sc;
+      q->cnt++; q->inq=0;
+    }
+  }
+  return(m);
+}
@@ -0,0 +1,435 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+/** \file edf_filt.c
+ * Streaming filters for blocks of float samples of 'nchn' channels stored
+ *  frame by frame (x[i*nchn+c]): cascades of biquads (low-pass, high-pass,
+ *  band-pass, notch) in transposed direct form II, zero phase filtfilt of
+ *  whole signals and decimating FIR filters. The inner loops run over the
+ *  channels, so the compiler can vectorize them.
+ */
+
+#ifdef _MSC_VER
+  #include "../nexus/inc/win32_compat.h"
+  #include "../nexus/inc/stdint_win32.h"
+#else
+  #include <stdint.h>
+  #include <inttypes.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "edf.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define EDFFILTMNS  (64)  /**< maximum number of biquad sections */
+
+/** Make empty filter for 'nchn' channels: passes all samples unchanged
+ * @return pointer to filter, NULL on failure
+*/
+edf_filt_t *edf_filt_new(int32_t nchn) {
+
+  edf_filt_t *f;
+
+  if (nchn<1) {
+    fprintf(stderr,"# Error: filter needs at least 1 channel not %d!!!\n",nchn);
+    return(NULL);
+  }
+  if ((f=(edf_filt_t *)calloc(1,sizeof(edf_filt_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate filter!!!\n");
+    return(NULL);
+  }
+  f->nchn=nchn;
+  return(f);
+}
+
+/** Free filter 'f'
+*/
+void edf_filt_free(edf_filt_t *f) {
+
+  if (f==NULL) { return; }
+  free(f->sec); free(f->z); free(f);
+}
+
+/** Append 'nsec' biquad sections 'sec' to filter 'f', the state of 'f' is reset
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add(edf_filt_t *f, const edf_biquad_t *sec, int32_t nsec) {
+
+  edf_biquad_t *s;
+  float *z;
+
+  if ((f->nsec+nsec)>EDFFILTMNS) {
+    fprintf(stderr,"# Error: more than %d filter sections!!!\n",EDFFILTMNS);
+    return(-1);
+  }
+  s=(edf_biquad_t *)realloc(f->sec,(f->nsec+nsec)*sizeof(edf_biquad_t));
+  if (s==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate %d filter sections!!!\n",f->nsec+nsec);
+    return(-1);
+  }
+  f->sec=s;
+  z=(float *)realloc(f->z,2*(f->nsec+nsec)*f->nchn*sizeof(float));
+  if (z==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate filter state!!!\n");
+    return(-1);
+  }
+  f->z=z;
+  memcpy(&f->sec[f->nsec],sec,nsec*sizeof(edf_biquad_t));
+  f->nsec+=nsec;
+  edf_filt_reset(f);
+  return(0);
+}
+
+/** Normalize analog prototype 'b0'..'a2' on 'a0' into biquad 'bq' */
+static void edf_biquad_set(edf_biquad_t *bq, double b0, double b1, double b2,
+ double a0, double a1, double a2) {
+
+  bq->b0=b0/a0; bq->b1=b1/a0; bq->b2=b2/a0;
+  bq->a1=a1/a0; bq->a2=a2/a0;
+}
+
+/** Check corner frequency 'fc' against sample frequency 'fs'
+ * @return 0 if 0 < fc < fs/2, -1 otherwise
+*/
+static int32_t edf_filt_chk_fc(double fs, double fc) {
+
+  if ((fc<=0.0) || (fc>=0.5*fs)) {
+    fprintf(stderr,"# Error: corner frequency %.3f [Hz] out of range (0, %.3f) [Hz]!!!\n",fc,0.5*fs);
+    return(-1);
+  }
+  return(0);
+}
+
+/** Append Butterworth low-pass ('hp'==0) or high-pass ('hp'==1) of 'order'
+ *   at corner frequency 'fc' [Hz] for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+static int32_t edf_filt_add_butter(edf_filt_t *f, int32_t hp, int32_t order, double fs, double fc) {
+
+  edf_biquad_t sec[EDFFILTMNS];
+  int32_t ns=0;             /**< number of sections */
+  int32_t k;                /**< section index */
+  double  w0,cw,alpha,q,K;
+
+  if (edf_filt_chk_fc(fs,fc)<0) { return(-1); }
+  if ((order<1) || (order>2*EDFFILTMNS)) {
+    fprintf(stderr,"# Error: filter order %d out of range [1, %d]!!!\n",order,2*EDFFILTMNS);
+    return(-1);
+  }
+  w0=2.0*M_PI*fc/fs; cw=cos(w0);
+  /* one biquad per complex pole pair of the Butterworth prototype */
+  for (k=0; k<order/2; k++) {
+    q=1.0/(2.0*sin(M_PI*(2*k+1)/(2.0*order)));
+    alpha=sin(w0)/(2.0*q);
+    if (hp) {
+      edf_biquad_set(&sec[ns++],(1+cw)/2,-(1+cw),(1+cw)/2,1+alpha,-2*cw,1-alpha);
+    } else {
+      edf_biquad_set(&sec[ns++],(1-cw)/2, (1-cw),(1-cw)/2,1+alpha,-2*cw,1-alpha);
+    }
+  }
+  /* odd order: first order section of the real pole */
+  if (order&1) {
+    K=tan(w0/2);
+    if (hp) {
+      edf_biquad_set(&sec[ns++],1,-1,0,1+K,K-1,0);
+    } else {
+      edf_biquad_set(&sec[ns++],K, K,0,1+K,K-1,0);
+    }
+  }
+  return(edf_filt_add(f,sec,ns));
+}
+
+/** Append Butterworth low-pass of 'order' at 'fc' [Hz] for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_lowpass(edf_filt_t *f, int32_t order, double fs, double fc) {
+
+  return(edf_filt_add_butter(f,0,order,fs,fc));
+}
+
+/** Append Butterworth high-pass of 'order' at 'fc' [Hz] for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_highpass(edf_filt_t *f, int32_t order, double fs, double fc) {
+
+  return(edf_filt_add_butter(f,1,order,fs,fc));
+}
+
+/** Append band-pass from 'f0' to 'f1' [Hz] as Butterworth high-pass and low-pass 
+ *   of 'order' each for sample frequency 'fs' [Hz] to filter 'f'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_bandpass(edf_filt_t *f, int32_t order, double fs, double f0, double f1) {
+
+  if (f0>=f1) {
+    fprintf(stderr,"# Error: band-pass %.3f - %.3f [Hz] is empty!!!\n",f0,f1);
+    return(-1);
+  }
+  if (edf_filt_add_butter(f,1,order,fs,f0)<0) { return(-1); }
+  return(edf_filt_add_butter(f,0,order,fs,f1));
+}
+
+/** Append notch at 'f0' [Hz] with quality 'q' (f0/bandwidth) for sample frequency 'fs' [Hz]
+ *   to filter 'f', with 'nh'>1 the harmonics up to 'nh'*'f0' below fs/2 are notched as well.
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_notch(edf_filt_t *f, double fs, double f0, double q, int32_t nh) {
+
+  edf_biquad_t sec[EDFFILTMNS];
+  int32_t ns=0;             /**< number of sections */
+  int32_t k;                /**< harmonic */
+  double  w0,cw,alpha;
+
+  if (edf_filt_chk_fc(fs,f0)<0) { return(-1); }
+  if (q<=0.0) { 
+    fprintf(stderr,"# Error: notch quality %.3f should be > 0!!!\n",q);
+    return(-1);
+  }
+  for (k=1; (k==1) || ((k<=nh) && (k*f0<0.5*fs) && (ns<EDFFILTMNS)); k++) {
+    w0=2.0*M_PI*k*f0/fs; cw=cos(w0);
+    alpha=sin(w0)/(2.0*q);
+    edf_biquad_set(&sec[ns++],1,-2*cw,1,1+alpha,-2*cw,1-alpha);
+  }
+  return(edf_filt_add(f,sec,ns));
+}
+
+/** Add filters described by 'spec' for sample frequency 'fs' [Hz] to filter 'f'.
+ *   'spec' lists stages separated by '+':
+ *   'n<f0>' notch at f0 and harmonics, 'lp<fc>' low-pass, 'hp<fc>' high-pass,
+ *   'bp<f0>,<f1>' band-pass, all Butterworth of order 4, e.g. "n50+bp0.5,40".
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filt_add_spec(edf_filt_t *f, const char *spec, double fs) {
+
+  const char *cp=spec;      /**< parsing pointer */
+  char   *ep;               /**< end of number */
+  double  f0,f1;
+  int32_t rtn;
+
+  while ((cp!=NULL) && (*cp!='\0')) {
+    if (strncmp(cp,"n",1)==0) {
+      f0=strtod(cp+1,&ep);
+      rtn=edf_filt_add_notch(f,fs,f0,EDFFILTNQ,EDFFILTNH);
+    } else
+    if (strncmp(cp,"lp",2)==0) {
+      f0=strtod(cp+2,&ep);
+      rtn=edf_filt_add_lowpass(f,EDFFILTORD,fs,f0);
+    } else
+    if (strncmp(cp,"hp",2)==0) {
+      f0=strtod(cp+2,&ep);
+      rtn=edf_filt_add_highpass(f,EDFFILTORD,fs,f0);
+    } else
+    if ((strncmp(cp,"bp",2)==0) && ((f0=strtod(cp+2,&ep)), *ep==',')) {
+      f1=strtod(ep+1,&ep);
+      rtn=edf_filt_add_bandpass(f,EDFFILTORD,fs,f0,f1);
+    } else {
+      ep=(char *)cp; rtn=-1;
+    }
+    if ((rtn<0) || ((*ep!='+') && (*ep!='\0'))) {
+      fprintf(stderr,"# Error: can't understand filter %s at %s!!!\n",spec,cp);
+      return(-1);
+    }
+    cp = (*ep=='+') ? ep+1 : NULL;
+  }
+  return(0);
+}
+
+/** Reset state of filter 'f' to zero
+*/
+void edf_filt_reset(edf_filt_t *f) {
+
+  if (f->z!=NULL) { memset(f->z,0,2*f->nsec*f->nchn*sizeof(float)); }
+}
+
+/** Set state of filter 'f' to its steady state for the constant input 'x0' of
+ *   each channel, which avoids the step response at the start of a signal
+*/
+void edf_filt_init(edf_filt_t *f, const float *x0) {
+
+  int32_t s,c;
+  double  v,y,h;
+  const edf_biquad_t *bq;
+
+  for (c=0; c<f->nchn; c++) {
+    v=x0[c];
+    for (s=0; s<f->nsec; s++) {
+      bq=&f->sec[s];
+      h=(bq->b0+bq->b1+bq->b2)/(1.0+bq->a1+bq->a2);   /* DC gain */
+      y=h*v;
+      f->z[(2*s+0)*f->nchn+c]=y-bq->b0*v;
+      f->z[(2*s+1)*f->nchn+c]=(bq->b2-bq->a2*h)*v;
+      v=y;
+    }
+  }
+}
+
+/** Filter frame 'x' of 'nch' channels in place with section 'bq' and state 'z1', 'z2' */
+static inline void edf_biquad_frame(const edf_biquad_t *bq, float * restrict x,
+ float * restrict z1, float * restrict z2, int32_t nch) {
+
+  const float b0=bq->b0, b1=bq->b1, b2=bq->b2, a1=bq->a1, a2=bq->a2;
+  int32_t c;
+  float   y;
+
+  for (c=0; c<nch; c++) {
+    y    =b0*x[c]+z1[c];
+    z1[c]=b1*x[c]-a1*y+z2[c];
+    z2[c]=b2*x[c]-a2*y;
+    x[c] =y;
+  }
+}
+
+/** Filter 'n' frames 'x' in place with filter 'f', keeping its state for the next block.
+ *   With 'rev'==1 the frames are filtered from last to first.
+*/
+static void edf_filt_frames(edf_filt_t *f, float *x, int32_t n, int32_t rev) {
+
+  const int32_t nch=f->nchn;
+  int32_t i,s;
+  float  *xi;
+
+  for (i=0; i<n; i++) {
+    xi = rev ? &x[(n-1-i)*nch] : &x[i*nch];
+    for (s=0; s<f->nsec; s++) {
+      edf_biquad_frame(&f->sec[s],xi,&f->z[(2*s+0)*nch],&f->z[(2*s+1)*nch],nch);
+    }
+  }
+}
+
+/** Filter block of 'n' frames 'x' (x[i*nchn+c]) in place with filter 'f',
+ *   the state is kept for the next block.
+*/
+void edf_filt_run(edf_filt_t *f, float *x, int32_t n) {
+
+  edf_filt_frames(f,x,n,0);
+}
+
+/** Zero phase filtering of the whole signal of 'n' frames 'x' in place: forward
+ *   and backward with filter 'f', both started in steady state of the edge frame.
+ *   The magnitude response of 'f' is squared.
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_filtfilt(edf_filt_t *f, float *x, int32_t n) {
+
+  if (n<1) { return(0); }
+  if (f->nsec<1) { return(0); }
+  edf_filt_init(f,&x[0]);
+  edf_filt_frames(f,x,n,0);
+  edf_filt_init(f,&x[(n-1)*f->nchn]);
+  edf_filt_frames(f,x,n,1);
+  return(0);
+}
+
+/** Make decimator by 'm' for 'nchn' channels with a linear phase low-pass FIR
+ *   of 'ntap' taps (Hamming windowed sinc) at 0.8 times the new Nyquist frequency.
+ *   Only the kept output samples are computed.
+ * @return pointer to decimator, NULL on failure
+*/
+edf_dec_t *edf_dec_new(int32_t nchn, int32_t m, int32_t ntap) {
+
+  edf_dec_t *d;
+  int32_t k;
+  double  fc,x,sum=0.0;
+
+  if ((nchn<1) || (m<1) || (ntap<1)) {
+    fprintf(stderr,"# Error: decimator of %d channels by %d with %d taps!!!\n",nchn,m,ntap);
+    return(NULL);
+  }
+  if ((d=(edf_dec_t *)calloc(1,sizeof(edf_dec_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate decimator!!!\n");
+    return(NULL);
+  }
+  d->nchn=nchn; d->m=m; d->ntap=ntap;
+  d->h=(float *)calloc(ntap,sizeof(float));
+  d->d=(float *)calloc(2*ntap*nchn,sizeof(float));
+  if ((d->h==NULL) || (d->d==NULL)) {
+    fprintf(stderr,"# Error: not enough memory to allocate decimator of %d taps!!!\n",ntap);
+    edf_dec_free(d);
+    return(NULL);
+  }
+  /* symmetric taps: linear phase */
+  fc=0.4/m;
+  for (k=0; k<ntap; k++) {
+    x=k-0.5*(ntap-1);
+    d->h[k] = (x==0.0) ? 2.0*fc : sin(2.0*M_PI*fc*x)/(M_PI*x);
+    if (ntap>1) { d->h[k] *= 0.54-0.46*cos(2.0*M_PI*k/(ntap-1)); }
+    sum+=d->h[k];
+  }
+  for (k=0; k<ntap; k++) { d->h[k]/=sum; }
+  return(d);
+}
+
+/** Free decimator 'd'
+*/
+void edf_dec_free(edf_dec_t *d) {
+
+  if (d==NULL) { return; }
+  free(d->h); free(d->d); free(d);
+}
+
+/** Decimate 'n' frames 'x' (x[i*nchn+c]) with decimator 'd' into 'y', which
+ *   has room for n/m+1 frames; the state is kept for the next block.
+ * @return number of frames in 'y'
+*/
+int32_t edf_dec_run(edf_dec_t *d, const float *x, int32_t n, float *y) {
+
+  const int32_t nch=d->nchn;
+  int32_t i,k,c,ny=0;
+  float  *dl;               /**< delay line of the last 'ntap' frames, oldest first */
+  float  *yo;               /**< output frame */
+
+  for (i=0; i<n; i++) {
+    /* the delay line is stored twice, so the last 'ntap' frames are contiguous */
+    memcpy(&d->d[d->pos*nch],&x[i*nch],nch*sizeof(float));
+    memcpy(&d->d[(d->pos+d->ntap)*nch],&x[i*nch],nch*sizeof(float));
+    if (++d->pos>=d->ntap) { d->pos=0; }
+    if (++d->ph<d->m) { continue; }
+    d->ph=0;
+    /* symmetric taps: the newest frame can be multiplied by h[ntap-1] as well as h[0] */
+    dl=&d->d[d->pos*nch]; yo=&y[ny*nch];
+    for (c=0; c<nch; c++) { yo[c]=0.0f; }
+    for (k=0; k<d->ntap; k++) {
+      for (c=0; c<nch; c++) {
+        yo[c]+=d->h[k]*dl[k*nch+c];
+      }
+    }
+    ny++;
+  }
+  return(ny);
+}
@@ -0,0 +1,385 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+
+/** \file edf_fmt.c
+ * Fast text output of samples: fixed point, integer and hexadecimal numbers
+ *  are formatted without printf into large buffers that are written with one
+ *  fwrite per block. The output equals that of printf "%*.*f", "%*lld" and
+ *  "%0*X"; the rare values for which the rounding can't be decided from a
+ *  double (exact ties, |a|*10^p >= 2^53, NaN, Inf) are passed to snprintf.
+ *  Rows of a table can be formatted by several threads, chunk after chunk,
+ *  and written in order.
+ */
+
+#ifdef _MSC_VER
+  #include "../nexus/inc/win32_compat.h"
+  #include "../nexus/inc/stdint_win32.h"
+#else
+  #include <stdint.h>
+  #include <inttypes.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "edf.h"
+
+#define EDFFMTMAXP    (9)      /**< maximum precision of the fast fixed point path */
+#define EDFFMTMAXX    (9.0e15) /**< maximum scaled value of the fast fixed point path */
+#define EDFFMTEPS     (4.5e-16)/**< relative error bound of the scaled value (2 ulp) */
+
+static int32_t nt = 1;         /**< number of formatting threads */
+
+static const double p10[EDFFMTMAXP+1]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9};
+static const uint32_t i10[EDFFMTMAXP+1]={1,10,100,1000,10000,100000,1000000,
+  10000000,100000000,1000000000};
+
+/** digit pairs "00" ... "99" */
+static const char d2[201]=
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/** Set number of threads used by edf_fmt_rows() when called with 'nthr'<1
+ * @return previous number of threads
+*/
+int32_t edf_fmt_set_nt(int32_t new_nt) {
+
+  int32_t old_nt=nt;
+
+  nt=(new_nt<1) ? 1 : new_nt;
+  return(old_nt);
+}
+
+/** Write exactly 'n' decimal digits of 'v' backwards ending before 'q'
+ * @return pointer to the first digit
+*/
+static char *edf_fmt_digits(char *q, uint32_t v, int32_t n) {
+
+  for (; n>=2; n-=2, v/=100) { q-=2; memcpy(q,&d2[2*(v%100)],2); }
+  if (n>0) { *--q=(char)('0'+v%10); }
+  return(q);
+}
+
+/** Write decimal digits of 'v' backwards ending before 'q', at least one digit
+ * @return pointer to the first digit
+*/
+static char *edf_fmt_u64(char *q, uint64_t v) {
+
+  uint32_t u;
+
+  while (v>=100000000) { q=edf_fmt_digits(q,(uint32_t)(v%100000000),8); v/=100000000; }
+  for (u=(uint32_t)v; u>=100; u/=100) { q-=2; memcpy(q,&d2[2*(u%100)],2); }
+  if (u>=10) { q-=2; memcpy(q,&d2[2*u],2); } else { *--q=(char)('0'+u); }
+  return(q);
+}
+
+/** Right align the 'n' characters 'p' in a field of width 'w' into 's'
+ * @return number of characters in 's'
+*/
+static int32_t edf_fmt_align(char *s, const char *p, int32_t n, int32_t w) {
+
+  int32_t k=0;
+
+  for (; k<w-n; k++) { s[k]=' '; }
+  memcpy(&s[k],p,n);
+  return(k+n);
+}
+
+/** Format 'a' as printf "%*.*f" with width 'w' and precision 'p' into 's', 
+ *   's' must hold at least EDFFMTMAXW+w characters, longer results are truncated.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_fixed(char *s, double a, int32_t w, int32_t p) {
+
+  char     tmp[32];           /**< digits, filled from the end */
+  char    *q=&tmp[sizeof(tmp)];
+  double   x,r,fr;
+  uint64_t v;
+  int32_t  n;
+
+  if ((p>=0) && (p<=EDFFMTMAXP)) {
+    x=fabs(a)*p10[p];
+    if (x<EDFFMTMAXX) {
+      r=floor(x); fr=x-r;
+      /* rounding is only certain when the fraction is clearly off one half */
+      if (fabs(fr-0.5)>x*EDFFMTEPS) {
+        v=(uint64_t)r+(fr>0.5);
+        if (p>0) { 
+          q=edf_fmt_digits(q,(uint32_t)(v%i10[p]),p); v/=i10[p];
+          *--q='.'; 
+        }
+        q=edf_fmt_u64(q,v);
+        if (signbit(a)) { *--q='-'; }
+        return(edf_fmt_align(s,q,(int32_t)(&tmp[sizeof(tmp)]-q),w));
+      }
+    }
+  }
+  n=snprintf(s,EDFFMTMAXW+(w>0 ? w : 0),"%*.*f",w,p,a);
+  return((n<EDFFMTMAXW+w) ? n : EDFFMTMAXW+w-1);
+}
+
+/** Format 'a' as printf "%*lld" with width 'w' into 's', 
+ *   's' must hold at least EDFFMTMAXW+w characters.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_int(char *s, int64_t a, int32_t w) {
+
+  char     tmp[24];
+  char    *q=&tmp[sizeof(tmp)];
+  uint64_t v=(a<0) ? 0-(uint64_t)a : (uint64_t)a;
+
+  q=edf_fmt_u64(q,v);
+  if (a<0) { *--q='-'; }
+  return(edf_fmt_align(s,q,(int32_t)(&tmp[sizeof(tmp)]-q),w));
+}
+
+/** Format 'a' as printf "%0*X" with width 'w' into 's',
+ *   's' must hold at least EDFFMTMAXW+w characters.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_hex(char *s, uint32_t a, int32_t w) {
+
+  static const char hex[16]="0123456789ABCDEF";
+  int32_t n=1,k;
+
+  while ((n<8) && (a>>(4*n))) { n++; }
+  if (n<w) { n=w; }
+  for (k=n-1; k>=0; k--, a>>=4) { s[k]=hex[a&0x0F]; }
+  return(n);
+}
+
+/** Format string 'a' as printf "%*s" with width 'w' into 's', 
+ *   's' must hold at least strlen(a)+w characters.
+ * @return number of characters in 's', 's' isn't '\0' terminated
+*/
+int32_t edf_fmt_str(char *s, const char *a, int32_t w) {
+
+  return(edf_fmt_align(s,a,(int32_t)strlen(a),w));
+}
+
+/** Make text buffer of 'size' bytes, EDFFMTSIZE when 'size'<1, for file 'fp'
+ * @return pointer to text buffer, NULL on failure
+*/
+edf_fmt_t *edf_fmt_new(FILE *fp, int32_t size) {
+
+  edf_fmt_t *f;
+
+  if (size<=0) { size=EDFFMTSIZE; }
+  if (size<4*EDFFMTMAXW) { size=4*EDFFMTMAXW; }
+  if ((f=(edf_fmt_t *)calloc(1,sizeof(edf_fmt_t)))==NULL) {
+    fprintf(stderr,"# Error: can't allocate text buffer!!!\n");
+    return(NULL);
+  }
+  if ((f->buf=(char *)malloc(size))==NULL) {
+    fprintf(stderr,"# Error: can't allocate text buffer of %d bytes!!!\n",size);
+    free(f);
+    return(NULL);
+  }
+  f->fp=fp; f->size=size;
+  return(f);
+}
+
+/** Write all buffered text of 'f' to its file
+ * @return 0 on success, -1 on write failure
+*/
+int32_t edf_fmt_flush(edf_fmt_t *f) {
+
+  int32_t rv=0;
+
+  if (f->n>0) {
+    if (fwrite(f->buf,1,f->n,f->fp)!=(size_t)f->n) { rv=-1; }
+    f->nc+=f->n; f->n=0;
+  }
+  return(rv);
+}
+
+/** Flush and free text buffer 'f'
+ * @return total number of characters written
+*/
+int64_t edf_fmt_free(edf_fmt_t *f) {
+
+  int64_t nc;
+
+  if (f==NULL) { return(0); }
+  edf_fmt_flush(f);
+  nc=f->nc;
+  free(f->buf); free(f);
+  return(nc);
+}
+
+/** Make room for 'n' characters in text buffer 'f'
+ * @return pointer to the free space
+*/
+static char *edf_fmt_room(edf_fmt_t *f, int32_t n) {
+
+  if (f->n+n>f->size) { edf_fmt_flush(f); }
+  return(&f->buf[f->n]);
+}
+
+/** Append 'a' as printf "%*.*f" to text buffer 'f'
+*/
+void edf_fmt_put_fixed(edf_fmt_t *f, double a, int32_t w, int32_t p) {
+
+  f->n+=edf_fmt_fixed(edf_fmt_room(f,EDFFMTMAXW+w),a,w,p);
+}
+
+/** Append 'a' as printf "%*lld" to text buffer 'f'
+*/
+void edf_fmt_put_int(edf_fmt_t *f, int64_t a, int32_t w) {
+
+  f->n+=edf_fmt_int(edf_fmt_room(f,EDFFMTMAXW+w),a,w);
+}
+
+/** Append 'a' as printf "%0*X" to text buffer 'f'
+*/
+void edf_fmt_put_hex(edf_fmt_t *f, uint32_t a, int32_t w) {
+
+  f->n+=edf_fmt_hex(edf_fmt_room(f,EDFFMTMAXW+w),a,w);
+}
+
+/** Append string 'a' as printf "%*s" to text buffer 'f'
+*/
+void edf_fmt_put_str(edf_fmt_t *f, const char *a, int32_t w) {
+
+  int32_t n=(int32_t)strlen(a);
+
+  if (n+w>f->size) {
+    /* too long to buffer */
+    edf_fmt_flush(f);
+    f->nc+=fprintf(f->fp,"%*s",w,a);
+    return;
+  }
+  f->n+=edf_fmt_str(edf_fmt_room(f,n+w),a,w);
+}
+
+/** Append character 'c' to text buffer 'f'
+*/
+void edf_fmt_put_chr(edf_fmt_t *f, char c) {
+
+  *edf_fmt_room(f,1)=c; f->n++;
+}
+
+/** shared state of the row formatting threads */
+typedef struct EDF_FMT_ROWS_T {
+  edf_fmt_row_t fmt;       /**< row formatter */
+  void    *arg;            /**< argument of row formatter */
+  int64_t  n;              /**< number of rows */
+  int64_t  rpc;            /**< rows per chunk */
+  int32_t  maxrow;         /**< maximum characters per row */
+} edf_fmt_rows_t;
+
+/** one chunk of rows formatted by one thread */
+typedef struct EDF_FMT_CHUNK_T {
+  edf_fmt_rows_t *r;
+  int64_t  i0;             /**< first row */
+  char    *buf;            /**< formatted rows */
+  int64_t  nc;             /**< characters in 'buf' */
+  pthread_t tid;           /**< formatting thread */
+  int32_t  thr;            /**< 1: formatted by thread 'tid' */
+} edf_fmt_chunk_t;
+
+/** Format all rows of chunk 'arg' 
+*/
+static void *edf_fmt_chunk(void *arg) {
+
+  edf_fmt_chunk_t *c=(edf_fmt_chunk_t *)arg;
+  edf_fmt_rows_t  *r=c->r;
+  int64_t i,i1=c->i0+r->rpc;
+
+  if (i1>r->n) { i1=r->n; }
+  c->nc=0;
+  for (i=c->i0; i<i1; i++) {
+    c->nc+=r->fmt(&c->buf[c->nc],i,r->arg);
+  }
+  return(NULL);
+}
+
+/** Format 'n' rows with 'fmt' into file 'fp', each row has at most 'maxrow' 
+ *   characters. Chunks of rows are formatted by 'nthr' threads (the number set 
+ *   by edf_fmt_set_nt() when 'nthr'<1) and written in row order.
+ * @return number of characters written, -1 on failure
+*/
+int64_t edf_fmt_rows(FILE *fp, edf_fmt_row_t fmt, void *arg, int64_t n, int32_t maxrow, int32_t nthr) {
+
+  edf_fmt_rows_t   r;
+  edf_fmt_chunk_t *c;
+  int64_t nc=0,i0;
+  int32_t k,nk,nb=0;
+
+  if (nthr<1) { nthr=nt; }
+  if (maxrow<1) { maxrow=1; }
+  r.fmt=fmt; r.arg=arg; r.n=n; r.maxrow=maxrow;
+  r.rpc=EDFFMTSIZE/maxrow;
+  if (r.rpc<1) { r.rpc=1; }
+  if ((nthr-1)*r.rpc>=n) { 
+    /* too few rows to keep all threads busy */
+    nthr=(int32_t)((n+r.rpc-1)/r.rpc);
+    if (nthr<1) { nthr=1; }
+  }
+  if ((c=(edf_fmt_chunk_t *)calloc(nthr,sizeof(edf_fmt_chunk_t)))!=NULL) {
+    for (nb=0; nb<nthr; nb++) {
+      c[nb].r=&r;
+      if ((c[nb].buf=(char *)malloc(r.rpc*maxrow))==NULL) { break; }
+    }
+  }
+  if (nb<1) {
+    fprintf(stderr,"# Error: can't allocate row format buffers!!!\n");
+    free(c);
+    return(-1);
+  }
+  /* fewer threads when not all buffers could be allocated */
+  nthr=nb;
+
+  for (i0=0; i0<n; i0+=nthr*r.rpc) {
+    /* format next chunks, the first one in this thread */
+    for (k=0, nk=0; (k<nthr) && (i0+k*r.rpc<n); k++, nk++) {
+      c[k].i0=i0+k*r.rpc;
+      c[k].thr=(k>0) && (pthread_create(&c[k].tid,NULL,edf_fmt_chunk,&c[k])==0);
+      if ((k>0) && (!c[k].thr)) { edf_fmt_chunk(&c[k]); }
+    }
+    edf_fmt_chunk(&c[0]);
+    /* write chunks in order */
+    for (k=0; k<nk; k++) {
+      if (c[k].thr) { pthread_join(c[k].tid,NULL); }
+      if (fwrite(c[k].buf,1,c[k].nc,fp)!=(size_t)c[k].nc) { nc=-1; }
+      if (nc>=0) { nc+=c[k].nc; }
+    }
+  }
+  for (k=0; k<nb; k++) { free(c[k].buf); }
+  free(c);
+  return(nc);
+}
@@ -0,0 +1,816 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file edf_pack.c
+ * Lossless compressed EDF/BDF archive with random access by record or time.
+ *  Records are packed in chunks of 'rpc' records. The samples of a signal in
+ *  a chunk are stored as the first sample followed by blocks of EDFPACKBLK
+ *  first or second order differences, whichever needs less bits, zigzag coded
+ *  and bit-packed with one width per block. Annotation signals are stored as
+ *  they are. An index of chunk offsets and start times at the end of the file
+ *  allows to read any range of records without unpacking the rest, chunks are
+ *  packed and unpacked by several threads.
+ *
+ *  File layout, all numbers little endian:
+ *   "EDFZ" version(4) nh(4) <nh bytes EDF/BDF header> rpc(4) nr(4) ntail(4)
+ *   <chunks> <ntail bytes after the last whole record>
+ *   <index of nc chunks: offset(8) size(4) start time(8)>
+ *   <index offset(8) nc(4) "EDFZ">
+ */
+
+#ifndef _XOPEN_SOURCE
+  #define _XOPEN_SOURCE  700 // for fseeko(), ftello()
+#endif
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "edf.h"
+
+#define EDFPACKMAGIC   "EDFZ"  /**< packed file identification */
+#define EDFPACKVERSION    (1)  /**< packed file format version */
+#define EDFPACKHDR       (12)  /**< bytes of magic, version and header size */
+#define EDFPACKIDX       (20)  /**< bytes per index entry */
+#define EDFPACKFOOT      (16)  /**< bytes of footer */
+#define EDFPACKBATCH      (4)  /**< chunks per thread in one batch */
+
+/** one chunk of 'nrec' records to pack or unpack */
+typedef struct EDF_PACK_JOB_T {
+ uint8_t *raw;              /**< EDF/BDF record bytes */
+ int32_t  nrec;             /**< number of records in 'raw' */
+ uint8_t *pk;               /**< packed chunk */
+ int32_t  npk;              /**< size of 'pk' [byte] */
+ int32_t  k;                /**< first record of the chunk */
+ int32_t  err;              /**< 0: OK, <0: corrupt chunk */
+} edf_pack_job_t;
+
+/** work shared by the packing threads */
+typedef struct EDF_PACK_WORK_T {
+ edf_pack_t     *p;         /**< record layout */
+ edf_pack_job_t *job;       /**< chunks */
+ int32_t         n;         /**< number of chunks */
+ int32_t         next;      /**< next chunk to do */
+ int32_t         k0,k1;     /**< records [k0,k1) to copy into 'p->edf', k1<=k0: none */
+ int32_t (*fn)(edf_pack_t *p, edf_pack_job_t *j); /**< pack or unpack function */
+ pthread_mutex_t mutex;     /**< protects 'next' */
+} edf_pack_work_t;
+
+/** bit stream of 'n' bytes in 'buf' */
+typedef struct EDF_PACK_BITS_T {
+ uint8_t *buf;              /**< bytes */
+ int32_t  n;                /**< size of 'buf' [byte] */
+ int32_t  i;                /**< next byte in 'buf' */
+ uint64_t acc;              /**< bits not yet in 'buf' or not yet used */
+ int32_t  nb;               /**< number of bits in 'acc' */
+} edf_pack_bits_t;
+
+/** Put 'w' <= 48 lowest bits of 'v' into bit stream 'b'
+*/
+static void pack_put(edf_pack_bits_t *b, uint64_t v, int32_t w) {
+
+  if (w<=0) { return; }
+  b->acc |= (v & ((w<64) ? ((((uint64_t)1)<<w)-1) : ~(uint64_t)0)) << b->nb;
+  b->nb += w;
+  while (b->nb>=8) {
+    b->buf[b->i++]=(uint8_t)(b->acc & 0xFF);
+    b->acc >>= 8; b->nb -= 8;
+  }
+}
+
+/** Write remaining bits of bit stream 'b' as a whole byte
+*/
+static void pack_flush(edf_pack_bits_t *b) {
+
+  if (b->nb>0) { b->buf[b->i++]=(uint8_t)(b->acc & 0xFF); }
+  b->acc=0; b->nb=0;
+}
+
+/** Get 'w' <= 48 bits out of bit stream 'b'
+ * @return bits, 'b->i' beyond 'b->n' when the stream is too short
+*/
+static uint64_t pack_get(edf_pack_bits_t *b, int32_t w) {
+
+  uint64_t v;
+
+  if (w<=0) { return(0); }
+  while (b->nb<w) {
+    if (b->i>=b->n) { b->i=b->n+1; return(0); }
+    b->acc |= ((uint64_t)b->buf[b->i++]) << b->nb;
+    b->nb += 8;
+  }
+  v = b->acc & ((((uint64_t)1)<<w)-1);
+  b->acc >>= w; b->nb -= w;
+  return(v);
+}
+
+/** Get number of bits needed for 'u'
+ * @return bits 0..64
+*/
+static int32_t pack_width(uint64_t u) {
+
+  int32_t w=0;
+
+  while (u!=0) { w++; u>>=1; }
+  return(w);
+}
+
+/** Get sample 'i' of signal 'j' out of 'nrec' records 'raw' of 'p' sign extended
+ * @return sample value
+*/
+static int32_t pack_sample(const edf_pack_t *p, const uint8_t *raw, int32_t j, int32_t i) {
+
+  const uint8_t *s=raw+(i/p->spr[j])*p->rs+p->sofs[j]+(i%p->spr[j])*p->ss;
+  uint32_t a;
+
+  if (p->ss==3) {
+    a=s[0] | (s[1]<<8) | ((uint32_t)s[2]<<16);
+    return((int32_t)(a<<8)>>8);
+  }
+  return((int16_t)(s[0] | (s[1]<<8)));
+}
+
+/** Pack 'j->nrec' records 'j->raw' with layout 'p' into 'j->pk'
+ * @return packed size [byte]
+*/
+static int32_t pack_chunk(edf_pack_t *p, edf_pack_job_t *j) {
+
+  edf_pack_bits_t b={j->pk,0,0,0,0};
+  int32_t  s;                /**< signal index */
+  int32_t  i,e,m;            /**< sample index, block end, samples in chunk */
+  int32_t  x1,x2,x;          /**< previous samples and current sample */
+  int64_t  d1,d2;            /**< first and second order difference */
+  uint64_t u1,u2;            /**< maximum zigzag coded differences */
+  int32_t  w,o;              /**< bit width and order of a block */
+  const uint8_t *a;          /**< annotation bytes */
+  int32_t  r;                /**< record index */
+
+  for (s=0; s<p->edf.NrOfSignals; s++) {
+    if (p->ann[s]) {
+      for (r=0; r<j->nrec; r++) {
+        a=j->raw+r*p->rs+p->sofs[s];
+        for (i=0; i<p->spr[s]*p->ss; i++) { pack_put(&b,a[i],8); }
+      }
+      continue;
+    }
+    m=j->nrec*p->spr[s];
+    if (m<1) { continue; }
+    x1=pack_sample(p,j->raw,s,0); x2=x1;
+    pack_put(&b,(uint32_t)x1,32);
+    for (i=1; i<m; i=e) {
+      e=(i+EDFPACKBLK<m) ? i+EDFPACKBLK : m;
+      /* widest difference of both orders in this block */
+      u1=0; u2=0; 
+      {
+        int32_t y1=x1,y2=x2,k;
+        for (k=i; k<e; k++) {
+          x=pack_sample(p,j->raw,s,k);
+          d1=(int64_t)x-y1; d2=d1-((int64_t)y1-y2);
+          u1|=((uint64_t)d1<<1)^(uint64_t)(d1>>63);
+          u2|=((uint64_t)d2<<1)^(uint64_t)(d2>>63);
+          y2=y1; y1=x;
+        }
+      }
+      o=(pack_width(u2)<pack_width(u1)) ? 2 : 1;
+      w=pack_width((o==2) ? u2 : u1);
+      pack_put(&b,(uint64_t)(((o-1)<<7)|w),8);
+      for (; i<e; i++) {
+        x=pack_sample(p,j->raw,s,i);
+        d1=(int64_t)x-x1; d2=d1-((int64_t)x1-x2);
+        d1=(o==2) ? d2 : d1;
+        pack_put(&b,((uint64_t)d1<<1)^(uint64_t)(d1>>63),w);
+        x2=x1; x1=x;
+      }
+    }
+    pack_flush(&b);
+  }
+  pack_flush(&b);
+  j->npk=b.i;
+  return(j->npk);
+}
+
+/** Unpack chunk 'j->pk' of 'j->npk' bytes with layout 'p' into 'j->nrec' records 'j->raw'
+ * @return 0 on success, <0 when the chunk is corrupt
+*/
+static int32_t unpack_chunk(edf_pack_t *p, edf_pack_job_t *j) {
+
+  edf_pack_bits_t b={j->pk,j->npk,0,0,0};
+  int32_t  s;                /**< signal index */
+  int32_t  i,e,m;            /**< sample index, block end, samples in chunk */
+  int32_t  x1,x2;            /**< previous samples */
+  int64_t  d;                /**< difference */
+  uint64_t u;                /**< zigzag coded difference */
+  int32_t  w,o,c;            /**< bit width, order and code of a block */
+  uint8_t *a;                /**< sample or annotation bytes */
+  int32_t  r;                /**< record index */
+
+  for (s=0; s<p->edf.NrOfSignals; s++) {
+    if (p->ann[s]) {
+      for (r=0; r<j->nrec; r++) {
+        a=j->raw+r*p->rs+p->sofs[s];
+        for (i=0; i<p->spr[s]*p->ss; i++) { a[i]=(uint8_t)pack_get(&b,8); }
+      }
+      continue;
+    }
+    m=j->nrec*p->spr[s];
+    if (m<1) { continue; }
+    x1=(int32_t)(uint32_t)pack_get(&b,32); x2=x1;
+    for (i=0; i<m; ) {
+      if (i>0) {
+        c=(int32_t)pack_get(&b,8); o=(c>>7)+1; w=c&0x7F;
+        e=(i+EDFPACKBLK<m) ? i+EDFPACKBLK : m;
+        if (w>48) { b.i=b.n+1; }
+      } else {
+        o=1; w=0; e=1;
+      }
+      for (; (i<e) && (b.i<=b.n); i++) {
+        if (i>0) {
+          u=pack_get(&b,w);
+          d=(int64_t)(u>>1)^-(int64_t)(u&1);
+          if (o==2) { d+=(int64_t)x1-x2; }
+          x2=x1; x1=(int32_t)((int64_t)x1+d);
+        }
+        a=j->raw+(i/p->spr[s])*p->rs+p->sofs[s]+(i%p->spr[s])*p->ss;
+        a[0]=(uint8_t)(x1 & 0xFF); a[1]=(uint8_t)((x1>>8) & 0xFF);
+        if (p->ss==3) { a[2]=(uint8_t)((x1>>16) & 0xFF); }
+      }
+      if (b.i>b.n) { break; }
+    }
+    b.acc=0; b.nb=0;
+    if (b.i>b.n) { break; }
+  }
+  j->err=(b.i>b.n) ? -1 : 0;
+  return(j->err);
+}
+
+/** Copy records of unpacked chunk 'j' within [k0,k1) into the signals of 'p->edf'
+ *   like edf_rd_samples() reads them, record 'k0' is the first
+*/
+static void unpack_copy(edf_pack_t *p, edf_pack_job_t *j, int32_t k0, int32_t k1) {
+
+  int32_t  r,s,i;            /**< record, signal and sample index */
+  int32_t  n;                /**< annotation bytes per record */
+  const uint8_t *a;          /**< record bytes */
+  int32_t *x;                /**< samples in 'p->edf' */
+
+  for (r=0; r<j->nrec; r++) {
+    if ((j->k+r<k0) || (j->k+r>=k1)) { continue; }
+    for (s=0; s<p->edf.NrOfSignals; s++) {
+      a=j->raw+r*p->rs+p->sofs[s];
+      if (p->ann[s]) {
+        n=p->spr[s]*p->ss;
+        memcpy((uint8_t *)p->edf.signal[s].data+(size_t)(j->k+r-k0)*n,a,n);
+        continue;
+      }
+      x=&p->edf.signal[s].data[(j->k+r-k0)*p->spr[s]];
+      for (i=0; i<p->spr[s]; i++, a+=p->ss) {
+        x[i]=(p->ss==3) ? (a[0] | (a[1]<<8) | (a[2]<<16)) : (a[0] | (a[1]<<8));
+      }
+    }
+  }
+}
+
+/** Packing thread: do chunks of 'arg' until all are done
+ * @return NULL
+*/
+static void *pack_thread(void *arg) {
+
+  edf_pack_work_t *w=(edf_pack_work_t *)arg;
+  int32_t i;         /**< chunk index */
+
+  for (;;) {
+    pthread_mutex_lock(&w->mutex);
+    i=w->next++;
+    pthread_mutex_unlock(&w->mutex);
+    if (i>=w->n) { break; }
+    if ((w->fn(w->p,&w->job[i])==0) && (w->k1>w->k0)) {
+      unpack_copy(w->p,&w->job[i],w->k0,w->k1);
+    }
+  }
+  return(NULL);
+}
+
+/** Do 'n' chunks 'job' with 'fn' by 'p->nt' threads and copy records [k0,k1)
+*/
+static void pack_run(edf_pack_t *p, edf_pack_job_t *job, int32_t n,
+  int32_t (*fn)(edf_pack_t *p, edf_pack_job_t *j), int32_t k0, int32_t k1) {
+
+  edf_pack_work_t w;       /**< shared work */
+  pthread_t tid[64];       /**< thread ids */
+  int32_t i;               /**< thread index */
+  int32_t nstarted=0;      /**< number of started threads */
+
+  w.p=p; w.job=job; w.n=n; w.next=0; w.k0=k0; w.k1=k1; w.fn=fn;
+  pthread_mutex_init(&w.mutex,NULL);
+  for (i=1; (i<p->nt) && (i<n) && (i<64); i++) {
+    if (pthread_create(&tid[nstarted],NULL,pack_thread,&w)!=0) { break; }
+    nstarted++;
+  }
+  /* the calling thread helps, and does all work when no thread started */
+  pack_thread(&w);
+  for (i=0; i<nstarted; i++) {
+    pthread_join(tid[i],NULL);
+  }
+  pthread_mutex_destroy(&w.mutex);
+}
+
+/** Put 'n' bytes of little endian 'a' into 'buf'
+*/
+static void pack_le(uint8_t *buf, uint64_t a, int32_t n) {
+
+  int32_t i;
+
+  for (i=0; i<n; i++) { buf[i]=(uint8_t)(a & 0xFF); a>>=8; }
+}
+
+/** Get 'n' bytes little endian number out of 'buf'
+ * @return number
+*/
+static uint64_t unpack_le(const uint8_t *buf, int32_t n) {
+
+  uint64_t a=0;
+  int32_t  i;
+
+  for (i=n-1; i>=0; i--) { a=(a<<8) | buf[i]; }
+  return(a);
+}
+
+/** Fill record layout of 'p' out of its headers 'p->edf' and use 'nt' threads
+ * @return record size [byte], <0 on failure
+*/
+static int32_t pack_layout(edf_pack_t *p, int32_t nt) {
+
+  int32_t j;
+  const char *aname=(p->edf.bdf==1) ? "BDF Annotations" : "EDF Annotations";
+
+  if ((p->edf.bdf<0) || (p->edf.NrOfSignals<1) || (p->edf.signal==NULL)) {
+    fprintf(stderr,"# Error: no EDF/BDF headers to pack!!!\n");
+    return(-1);
+  }
+  p->ss=(p->edf.bdf==1) ? 3 : 2;
+  p->spr =(int32_t *)calloc(p->edf.NrOfSignals,sizeof(int32_t));
+  p->sofs=(int32_t *)calloc(p->edf.NrOfSignals,sizeof(int32_t));
+  p->ann =(int32_t *)calloc(p->edf.NrOfSignals,sizeof(int32_t));
+  if ((p->spr==NULL) || (p->sofs==NULL) || (p->ann==NULL)) {
+    fprintf(stderr,"# Error: edf_pack memory allocation problem!!!\n");
+    return(-1);
+  }
+  p->rs=0;
+  for (j=0; j<p->edf.NrOfSignals; j++) {
+    p->spr[j]=p->edf.signal[j].NrOfSamplesPerRecord;
+    p->ann[j]=(strcmp(p->edf.signal[j].Label,aname)==0);
+    p->sofs[j]=p->rs;
+    p->rs+=p->spr[j]*p->ss;
+  }
+  if (p->rs<1) {
+    fprintf(stderr,"# Error: empty EDF/BDF records!!!\n");
+    return(-1);
+  }
+  if (nt<=0) { nt=(int32_t)sysconf(_SC_NPROCESSORS_ONLN); }
+  p->nt=(nt<1) ? 1 : ((nt>64) ? 64 : nt);
+  return(p->rs);
+}
+
+/** Get start time [s] since the start of the recording of the first of 'raw' 
+ *   records 'k' of 'p' out of the time keeping annotation, 'k' records otherwise
+ * @return time [s]
+*/
+static double pack_rec_time(const edf_pack_t *p, const uint8_t *raw, int32_t k) {
+
+  char     buf[ANNOTRECSIZE+1];
+  char    *end;              /**< end of time stamp in 'buf' */
+  int32_t  j,n;
+  double   t;
+
+  for (j=0; j<p->edf.NrOfSignals; j++) {
+    if (!p->ann[j]) { continue; }
+    n=p->spr[j]*p->ss; if (n>ANNOTRECSIZE) { n=ANNOTRECSIZE; }
+    memcpy(buf,raw+p->sofs[j],n); buf[n]='\0';
+    if ((buf[0]=='+') || (buf[0]=='-')) {
+      t=strtod(buf,&end);
+      if ((end!=buf) && (*end==20)) { return(t); }
+    }
+    break;
+  }
+  return(k*p->edf.RecordDuration);
+}
+
+/** Allocate 'n' chunk jobs of 'rpc' records of 'rs' bytes and a packed buffer
+ *   of 'npk' bytes each
+ * @return pointer to jobs, NULL on failure
+*/
+static edf_pack_job_t *pack_jobs(int32_t n, int32_t rpc, int32_t rs, int32_t npk) {
+
+  edf_pack_job_t *job;
+  int32_t i;
+
+  if ((job=(edf_pack_job_t *)calloc(n,sizeof(edf_pack_job_t)))==NULL) { return(NULL); }
+  for (i=0; i<n; i++) {
+    job[i].raw=(uint8_t *)malloc((size_t)rpc*rs);
+    job[i].pk =(uint8_t *)malloc(npk);
+    if ((job[i].raw==NULL) || (job[i].pk==NULL)) {
+      fprintf(stderr,"# Error: edf_pack memory allocation problem!!!\n");
+      for (; i>=0; i--) { free(job[i].raw); free(job[i].pk); }
+      free(job);
+      return(NULL);
+    }
+  }
+  return(job);
+}
+
+/** Free 'n' chunk jobs 'job'
+*/
+static void pack_jobs_free(edf_pack_job_t *job, int32_t n) {
+
+  int32_t i;
+
+  if (job==NULL) { return; }
+  for (i=0; i<n; i++) { free(job[i].raw); free(job[i].pk); }
+  free(job);
+}
+
+/** Get packed chunk size bound of 'rpc' records with layout 'p'
+ * @return size [byte]
+*/
+static int32_t pack_bound(const edf_pack_t *p, int32_t rpc) {
+
+  int64_t n=16;
+  int32_t j;
+  int64_t m;
+
+  for (j=0; j<p->edf.NrOfSignals; j++) {
+    m=(int64_t)rpc*p->spr[j];
+    n+=(p->ann[j]) ? m*p->ss : 5+(m/EDFPACKBLK+1)+(m*48+7)/8;
+  }
+  return((n<INT32_MAX) ? (int32_t)n : -1);
+}
+
+/** Pack EDF/BDF file 'iname' losslessly into file 'oname' with 'rpc' records 
+ *   per chunk (EDFPACKRPC when 'rpc'<1) using 'nt' threads (one per cpu when 'nt'<1)
+ * @return size of 'oname' [byte], <0 on failure
+*/
+int64_t edf_pack(const char *iname, const char *oname, int32_t rpc, int32_t nt) {
+
+  edf_pack_t p;              /**< record layout */
+  FILE    *fi=NULL,*fo=NULL; /**< input and output file */
+  uint8_t *hdr=NULL;         /**< EDF/BDF header bytes */
+  uint8_t  buf[EDFPACKIDX];
+  uint8_t *idx=NULL;         /**< chunk index */
+  edf_pack_job_t *job=NULL;  /**< chunks of one batch */
+  int32_t  nb;               /**< chunks per batch */
+  int32_t  c,i,n;            /**< chunk index, batch index, chunks in batch */
+  int64_t  size;             /**< input file size */
+  int64_t  ofs;              /**< output file offset */
+  int32_t  npk;              /**< packed chunk bound */
+  double   t;
+  int64_t  rv=-1;
+
+  memset(&p,0,sizeof(p));
+  if (rpc<1) { rpc=EDFPACKRPC; }
+  if ((fi=fopen(iname,"rb"))==NULL) { perror(iname); return(-1); }
+  if ((edf_rd_hdr(fi,&p.edf)<0) || (pack_layout(&p,nt)<0)) { goto done; }
+  p.nh=p.edf.NrOfHeaderBytes; p.rpc=rpc;
+  fseeko(fi,0,SEEK_END); size=ftello(fi);
+  if ((p.nh<256) || (size<p.nh)) {
+    fprintf(stderr,"# Error: %s has a bad EDF/BDF header size %d!!!\n",iname,p.nh);
+    goto done;
+  }
+  p.nr=(int32_t)((size-p.nh)/p.rs);
+  p.ntail=(int32_t)((size-p.nh)%p.rs);
+  p.nc=(p.nr+rpc-1)/rpc;
+  nb=p.nt*EDFPACKBATCH;
+  if (((npk=pack_bound(&p,rpc))<0) || ((hdr=(uint8_t *)malloc(p.nh))==NULL) || 
+      ((idx=(uint8_t *)calloc(p.nc+1,EDFPACKIDX))==NULL) || 
+      ((job=pack_jobs(nb,rpc,p.rs,npk))==NULL)) {
+    fprintf(stderr,"# Error: edf_pack memory allocation problem!!!\n");
+    goto done;
+  }
+  fseeko(fi,0,SEEK_SET);
+  if (fread(hdr,1,p.nh,fi)!=(size_t)p.nh) { perror(iname); goto done; }
+  if ((fo=fopen(oname,"wb"))==NULL) { perror(oname); goto done; }
+
+  /* magic, version, EDF/BDF header and record layout */
+  memcpy(buf,EDFPACKMAGIC,4); pack_le(buf+4,EDFPACKVERSION,4); pack_le(buf+8,p.nh,4);
+  fwrite(buf,1,EDFPACKHDR,fo);
+  fwrite(hdr,1,p.nh,fo);
+  pack_le(buf,rpc,4); pack_le(buf+4,p.nr,4); pack_le(buf+8,p.ntail,4);
+  fwrite(buf,1,12,fo);
+  ofs=EDFPACKHDR+p.nh+12;
+
+  /* pack a batch of chunks at once and write them in order */
+  for (c=0; c<p.nc; c+=n) {
+    n=(p.nc-c<nb) ? p.nc-c : nb;
+    for (i=0; i<n; i++) {
+      job[i].k=(c+i)*rpc;
+      job[i].nrec=(p.nr-job[i].k<rpc) ? p.nr-job[i].k : rpc;
+      if (fread(job[i].raw,p.rs,job[i].nrec,fi)!=(size_t)job[i].nrec) { 
+        perror(iname); goto done; 
+      }
+    }
+    pack_run(&p,job,n,pack_chunk,0,0);
+    for (i=0; i<n; i++) {
+      t=pack_rec_time(&p,job[i].raw,job[i].k);
+      pack_le(idx+(c+i)*EDFPACKIDX,ofs,8);
+      pack_le(idx+(c+i)*EDFPACKIDX+8,job[i].npk,4);
+      memcpy(buf,&t,8); memcpy(idx+(c+i)*EDFPACKIDX+12,buf,8);
+      if (fwrite(job[i].pk,1,job[i].npk,fo)!=(size_t)job[i].npk) { perror(oname); goto done; }
+      ofs+=job[i].npk;
+    }
+  }
+  /* bytes of an incomplete last record */
+  if (p.ntail>0) {
+    if (fread(job[0].raw,1,p.ntail,fi)!=(size_t)p.ntail) { perror(iname); goto done; }
+    fwrite(job[0].raw,1,p.ntail,fo);
+    ofs+=p.ntail;
+  }
+  /* chunk index and footer */
+  fwrite(idx,EDFPACKIDX,p.nc,fo);
+  pack_le(buf,ofs,8); pack_le(buf+8,p.nc,4); memcpy(buf+12,EDFPACKMAGIC,4);
+  fwrite(buf,1,EDFPACKFOOT,fo);
+  rv=ofs+(int64_t)p.nc*EDFPACKIDX+EDFPACKFOOT;
+  if (ferror(fo)) { perror(oname); rv=-1; }
+
+done:
+  if (fo!=NULL) { fclose(fo); }
+  fclose(fi);
+  pack_jobs_free(job,nb);
+  free(idx); free(hdr);
+  free(p.spr); free(p.sofs); free(p.ann);
+  edf_free(&p.edf);
+  return(rv);
+}
+
+/** Open packed EDF/BDF file 'fname' for reading with 'nt' threads (one per cpu when 'nt'<1)
+ * @return pointer to packed file, NULL on failure
+*/
+edf_pack_t *edf_pack_open(const char *fname, int32_t nt) {
+
+  edf_pack_t *p;
+  uint8_t  buf[EDFPACKIDX];
+  uint8_t *idx=NULL;         /**< chunk index */
+  int64_t  io;               /**< index offset */
+  int32_t  c;
+
+  if ((p=(edf_pack_t *)calloc(1,sizeof(edf_pack_t)))==NULL) { return(NULL); }
+  if ((p->fp=fopen(fname,"rb"))==NULL) { perror(fname); free(p); return(NULL); }
+  if ((fread(buf,1,EDFPACKHDR,p->fp)!=EDFPACKHDR) || (memcmp(buf,EDFPACKMAGIC,4)!=0) ||
+      (unpack_le(buf+4,4)!=EDFPACKVERSION)) {
+    fprintf(stderr,"# Error: %s is no packed EDF/BDF file!!!\n",fname);
+    goto fail;
+  }
+  p->nh=(int32_t)unpack_le(buf+8,4);
+  if ((p->hdr=(uint8_t *)malloc(p->nh))==NULL) { goto fail; }
+  if (fread(p->hdr,1,p->nh,p->fp)!=(size_t)p->nh) { goto fail; }
+  fseeko(p->fp,EDFPACKHDR,SEEK_SET);
+  if ((edf_rd_hdr(p->fp,&p->edf)<0) || (pack_layout(p,nt)<0)) { goto fail; }
+  fseeko(p->fp,EDFPACKHDR+p->nh,SEEK_SET);
+  if (fread(buf,1,12,p->fp)!=12) { goto fail; }
+  p->rpc=(int32_t)unpack_le(buf,4); p->nr=(int32_t)unpack_le(buf+4,4);
+  p->ntail=(int32_t)unpack_le(buf+8,4);
+
+  /* footer and chunk index */
+  fseeko(p->fp,-EDFPACKFOOT,SEEK_END);
+  if ((fread(buf,1,EDFPACKFOOT,p->fp)!=EDFPACKFOOT) || (memcmp(buf+12,EDFPACKMAGIC,4)!=0)) {
+    fprintf(stderr,"# Error: %s has no chunk index!!!\n",fname);
+    goto fail;
+  }
+  io=(int64_t)unpack_le(buf,8); p->nc=(int32_t)unpack_le(buf+8,4);
+  if ((p->rpc<1) || (p->nc!=(p->nr+p->rpc-1)/p->rpc)) {
+    fprintf(stderr,"# Error: %s has a corrupt chunk index!!!\n",fname);
+    goto fail;
+  }
+  p->ofs =(int64_t *)calloc(p->nc+1,sizeof(int64_t));
+  p->size=(int32_t *)calloc(p->nc+1,sizeof(int32_t));
+  p->t   =(double  *)calloc(p->nc+1,sizeof(double));
+  idx=(uint8_t *)calloc(p->nc+1,EDFPACKIDX);
+  if ((p->ofs==NULL) || (p->size==NULL) || (p->t==NULL) || (idx==NULL)) { goto fail; }
+  fseeko(p->fp,io,SEEK_SET);
+  if (fread(idx,EDFPACKIDX,p->nc,p->fp)!=(size_t)p->nc) { goto fail; }
+  for (c=0; c<p->nc; c++) {
+    p->ofs[c] =(int64_t)unpack_le(idx+c*EDFPACKIDX,8);
+    p->size[c]=(int32_t)unpack_le(idx+c*EDFPACKIDX+8,4);
+    memcpy(&p->t[c],idx+c*EDFPACKIDX+12,8);
+  }
+  /* incomplete last record follows the last chunk */
+  p->ofs[p->nc]=io-p->ntail;
+  free(idx);
+  return(p);
+
+fail:
+  fprintf(stderr,"# Error: can't read packed EDF/BDF file %s!!!\n",fname);
+  free(idx);
+  edf_pack_close(p);
+  return(NULL);
+}
+
+/** Close packed EDF/BDF file 'p' and free all its memory
+*/
+void edf_pack_close(edf_pack_t *p) {
+
+  if (p==NULL) { return; }
+  if (p->fp!=NULL) { fclose(p->fp); }
+  free(p->hdr); free(p->spr); free(p->sofs); free(p->ann);
+  free(p->ofs); free(p->size); free(p->t);
+  edf_free(&p->edf);
+  free(p);
+}
+
+/** Find record of packed EDF/BDF file 'p' at time 't' [s] since the start 
+ *   of the recording out of the chunk index
+ * @return record index 0..p->nr-1, 0 when 'p' has no records
+*/
+int32_t edf_pack_fnd_rec(const edf_pack_t *p, double t) {
+
+  int32_t lo=0,hi=p->nc,mid; /**< binary search range */
+  int32_t k,k1;              /**< record index, end of chunk */
+
+  if (p->nc<1) { return(0); }
+  /* last chunk starting at or before 't' */
+  while (hi-lo>1) {
+    mid=(lo+hi)/2;
+    if (p->t[mid] <= t) { lo=mid; } else { hi=mid; }
+  }
+  k=lo*p->rpc;
+  if (t>p->t[lo]) { k+=(int32_t)floor((t-p->t[lo])/p->edf.RecordDuration); }
+  k1=((lo+1)*p->rpc<p->nr) ? (lo+1)*p->rpc : p->nr;
+  return((k<k1) ? k : k1-1);
+}
+
+/** Unpack records [k0,k1) of 'p' into the signals of 'p->edf' or, when 'raw' 
+ *   isn't NULL, as EDF/BDF record bytes into 'raw'
+ * @return number of records unpacked, <0 on failure
+*/
+static int32_t unpack_rec(edf_pack_t *p, int32_t k0, int32_t k1, uint8_t *raw) {
+
+  edf_pack_job_t *job;       /**< chunks of the records */
+  int32_t  c0,c1,c;          /**< chunk range and index */
+  int32_t  n,i;
+  int32_t  rv;
+
+  c0=k0/p->rpc; c1=(k1+p->rpc-1)/p->rpc; n=c1-c0;
+  if ((job=(edf_pack_job_t *)calloc(n,sizeof(edf_pack_job_t)))==NULL) { return(-1); }
+  for (i=0, c=c0; c<c1; i++, c++) {
+    job[i].k=c*p->rpc;
+    job[i].nrec=(p->nr-job[i].k<p->rpc) ? p->nr-job[i].k : p->rpc;
+    job[i].npk=p->size[c];
+    job[i].raw=(raw!=NULL) && (job[i].k>=k0) && (job[i].k+job[i].nrec<=k1) ?
+      raw+(int64_t)(job[i].k-k0)*p->rs : (uint8_t *)malloc((size_t)job[i].nrec*p->rs);
+    job[i].pk=(uint8_t *)malloc(job[i].npk);
+    job[i].err=-1;
+    if ((job[i].raw==NULL) || (job[i].pk==NULL)) { n=i+1; break; }
+    fseeko(p->fp,p->ofs[c],SEEK_SET);
+    if (fread(job[i].pk,1,job[i].npk,p->fp)!=(size_t)job[i].npk) { n=i+1; break; }
+    job[i].err=0;
+  }
+  rv=k1-k0;
+  for (i=0; i<n; i++) { if (job[i].err<0) { rv=-1; } }
+  if (rv>=0) {
+    pack_run(p,job,n,unpack_chunk,(raw==NULL) ? k0 : 0,(raw==NULL) ? k1 : 0);
+    for (i=0; i<n; i++) {
+      if (job[i].err<0) { 
+        fprintf(stderr,"# Error: corrupt chunk %d!!!\n",c0+i); 
+        rv=-1; 
+      }
+      if ((raw!=NULL) && ((job[i].k<k0) || (job[i].k+job[i].nrec>k1))) {
+        /* partly needed chunk: copy the wanted records */
+        c=(job[i].k<k0) ? k0-job[i].k : 0;
+        memcpy(raw+(int64_t)(job[i].k+c-k0)*p->rs,job[i].raw+(int64_t)c*p->rs,
+          (size_t)(((job[i].k+job[i].nrec<k1) ? job[i].k+job[i].nrec : k1)-job[i].k-c)*p->rs);
+      }
+    }
+  }
+  for (i=0; i<n; i++) {
+    if ((raw==NULL) || (job[i].raw<raw) || (job[i].raw>=raw+(int64_t)(k1-k0)*p->rs)) {
+      free(job[i].raw);
+    }
+    free(job[i].pk);
+  }
+  free(job);
+  return(rv);
+}
+
+/** Read 'n' records starting at record 'k' of packed EDF/BDF file 'p' into 
+ *   the signals of 'p->edf' like edf_rd_samples(): 'p->edf.NrOfDataRecords' 
+ *   becomes the number of records read and 'p->k0' is set to 'k'. An annotation
+ *   signal keeps all its samples per record: each record has all its bytes.
+ * @return number of records read, <0 on failure
+*/
+int32_t edf_pack_rd_rec(edf_pack_t *p, int32_t k, int32_t n) {
+
+  int32_t j;
+
+  if (k<0) { k=0; }
+  if (k>p->nr) { k=p->nr; }
+  if (n>p->nr-k) { n=p->nr-k; }
+  if (n<0) { n=0; }
+  for (j=0; j<p->edf.NrOfSignals; j++) {
+    if (p->edf.signal[j].data!=NULL) { free(p->edf.signal[j].data); }
+    p->edf.signal[j].NrOfSamples=n*p->spr[j];
+    if (p->ann[j]) {
+      p->edf.signal[j].data=(int32_t *)calloc((size_t)n*p->spr[j]*p->ss/4+1,sizeof(int32_t));
+    } else {
+      p->edf.signal[j].data=(int32_t *)calloc((size_t)n*p->spr[j]+1,sizeof(int32_t));
+    }
+    if (p->edf.signal[j].data==NULL) {
+      fprintf(stderr,"# Error: not enough memory for %d records!!!\n",n);
+      return(-1);
+    }
+  }
+  if (p->edf.rts!=NULL) { free(p->edf.rts); p->edf.rts=NULL; }
+  p->edf.NrOfDataRecords=n; p->k0=k;
+  return((n>0) ? unpack_rec(p,k,k+n,NULL) : 0);
+}
+
+/** Unpack packed EDF/BDF file 'iname' into EDF/BDF file 'oname' with 'nt' threads,
+ *   only the records from time 't0' up to 't1' [s] since the start when 't1'>'t0'
+ * @return size of 'oname' [byte], <0 on failure
+*/
+int64_t edf_unpack(const char *iname, const char *oname, double t0, double t1, int32_t nt) {
+
+  edf_pack_t *p;             /**< packed input file */
+  FILE    *fo;               /**< output file */
+  uint8_t *raw=NULL;         /**< records of one batch */
+  int32_t  k0=0,k1,k,n;      /**< record range, record index, records in batch */
+  int32_t  nb;               /**< records per batch */
+  char     tmp[16];
+  time_t   ts;               /**< start time of the first record */
+  int32_t  j,ann=0;
+  int64_t  rv=-1;
+
+  if ((p=edf_pack_open(iname,nt))==NULL) { return(-1); }
+  k1=p->nr;
+  if (t1>t0) {
+    k0=edf_pack_fnd_rec(p,t0);
+    k1=edf_pack_fnd_rec(p,t1)+1;
+    /* record count and, without time keeping annotations, start time of the part */
+    sprintf(tmp,"%-8d",k1-k0); memcpy(p->hdr+236,tmp,8);
+    for (j=0; j<p->edf.NrOfSignals; j++) { ann|=p->ann[j]; }
+    if (!ann) {
+      ts=p->edf.StartDateTime+(time_t)floor(k0*p->edf.RecordDuration);
+      strftime(tmp,9,"%d.%m.%y",localtime(&ts)); memcpy(p->hdr+168,tmp,8);
+      strftime(tmp,9,"%H.%M.%S",localtime(&ts)); memcpy(p->hdr+176,tmp,8);
+    }
+  }
+  nb=p->rpc*p->nt*EDFPACKBATCH;
+  if ((fo=fopen(oname,"wb"))==NULL) { perror(oname); edf_pack_close(p); return(-1); }
+  if ((raw=(uint8_t *)malloc((size_t)nb*p->rs+p->ntail+1))==NULL) {
+    fprintf(stderr,"# Error: edf_unpack memory allocation problem!!!\n");
+    goto done;
+  }
+  fwrite(p->hdr,1,p->nh,fo);
+  rv=p->nh;
+  for (k=k0; k<k1; k+=n) {
+    n=(k1-k<nb) ? k1-k : nb;
+    if (unpack_rec(p,k,k+n,raw)<0) { rv=-1; goto done; }
+    rv+=fwrite(raw,p->rs,n,fo)*(int64_t)p->rs;
+  }
+  /* bytes of an incomplete last record */
+  if ((k1==p->nr) && (k0==0) && (p->ntail>0)) {
+    fseeko(p->fp,p->ofs[p->nc],SEEK_SET);
+    if (fread(raw,1,p->ntail,p->fp)!=(size_t)p->ntail) { rv=-1; goto done; }
+    rv+=fwrite(raw,1,p->ntail,fo);
+  }
+  if (ferror(fo)) { perror(oname); rv=-1; }
+
+done:
+  fclose(fo);
+  free(raw);
+  edf_pack_close(p);
+  return(rv);
+}
@@ -0,0 +1,197 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+/** \file edf_plane.c
+ * Packed EDF/BDF sample planes: samples are kept in 2 (EDF) or 3 (BDF) bytes
+ *  like in the file and overflow bits in a separate bitmap, which is only
+ *  allocated once a sample overflows.
+ */
+
+#ifdef _MSC_VER
+  #include "../nexus/inc/win32_compat.h"
+  #include "../nexus/inc/stdint_win32.h"
+#else
+  #include <stdint.h>
+  #include <inttypes.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "edf.h"
+
+/** Allocate overflow bitmap of plane 'p'
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_plane_ovf_alloc(edf_plane_t *p) {
+
+  if (p->ovf!=NULL) { return(0); }
+  if ((p->ovf=(uint32_t *)calloc((p->n+31)/32+1,sizeof(uint32_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate overflow bitmap of %d samples!!!\n",p->n);
+    return(-1);
+  }
+  return(0);
+}
+
+/** Allocate plane 'p' for 'n' samples of 'bps' bytes
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_plane_alloc(edf_plane_t *p, int32_t n, int32_t bps) {
+
+  p->n=n; p->bps=bps; p->ovf=NULL;
+  if ((p->data=(uint8_t *)calloc((size_t)n*bps,sizeof(uint8_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate %d samples!!!\n",n);
+    p->n=0;
+    return(-1);
+  }
+  return(0);
+}
+
+/** Free samples and overflow bitmap of plane 'p'
+*/
+void edf_plane_free(edf_plane_t *p) {
+
+  if (p==NULL) return;
+  if (p->data != NULL) free(p->data);
+  if (p->ovf  != NULL) free(p->ovf);
+  p->data=NULL; p->ovf=NULL; p->n=0;
+}
+
+/** Get span of 'n' integer sample values starting at 'idx' in plane 'p' into 'y'
+ * @return number of samples in 'y'
+*/
+int32_t edf_plane_span(const edf_plane_t *p, int32_t idx, int32_t n, int32_t *y) {
+
+  int32_t i;
+  const uint8_t *b;
+
+  if (idx<0) { n+=idx; idx=0; }
+  if (idx+n>p->n) { n=p->n-idx; }
+  if (n<=0) { return(0); }
+
+  b=&p->data[idx*p->bps];
+  if (p->bps==3) {
+    for (i=0; i<n; i++, b+=3) {
+      y[i]=(int32_t)(((uint32_t)b[0]<<8) | ((uint32_t)b[1]<<16) | ((uint32_t)b[2]<<24))>>8;
+    }
+  } else {
+    for (i=0; i<n; i++, b+=2) {
+      y[i]=(int16_t)(b[0] | (b[1]<<8));
+    }
+  }
+  return(n);
+}
+
+/** Pack samples and overflow bits of signal 's' in a 'bdf' (1) or EDF (0) file into plane 'p'
+ * @note annotation channels are not packed
+ * @return number of packed samples, <0 on failure
+*/
+int32_t edf_plane_from_signal(edf_plane_t *p, const edf_signal_t *s, int32_t bdf) {
+
+  int32_t i;
+
+  if ((s->data==NULL) || (strstr(s->Label,"Annotations")!=NULL)) {
+    return(-1);
+  }
+  if (edf_plane_alloc(p, s->NrOfSamples, (bdf==1) ? 3 : 2)<0) {
+    return(-1);
+  }
+  for (i=0; i<s->NrOfSamples; i++) {
+    edf_plane_set(p, i, s->data[i], s->data[i] & OVERFLOWBIT);
+  }
+  return(p->n);
+}
+
+/** Unpack plane 'p' into the samples with overflow bits of signal 's'
+ * @return number of unpacked samples, <0 on failure
+*/
+int32_t edf_plane_to_signal(const edf_plane_t *p, edf_signal_t *s) {
+
+  int32_t i;
+  int32_t msk=(1<<(8*p->bps))-1; /**< integer value mask */
+
+  if ((s->data==NULL) || (s->NrOfSamples<p->n)) {
+    return(-1);
+  }
+  for (i=0; i<p->n; i++) {
+    s->data[i] = (edf_plane_get(p,i) & msk) | edf_plane_get_ovf(p,i);
+  }
+  return(p->n);
+}
+
+/** Read all EDF/BDF samples from file 'fp' into planes, one per signal of 'edf'
+ *   reading a whole signal record at once.
+ * @note a file that ends early sets 'edf->NrOfDataRecords' to the number of
+ *   complete records read, the planes only hold those records
+ * @return array of 'edf->NrOfSignals' planes, NULL on failure
+*/
+edf_plane_t *edf_rd_planes(FILE *fp, edf_t *edf) {
+
+  edf_plane_t *p;           /**< plane per signal */
+  int32_t j,k;              /**< signal and record counter */
+  int32_t bps;              /**< bytes per sample */
+  size_t  nb;               /**< bytes per signal record */
+
+  bps = (edf->bdf==1) ? 3 : 2;
+  if ((p=(edf_plane_t *)calloc(edf->NrOfSignals,sizeof(edf_plane_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate %d planes!!!\n",edf->NrOfSignals);
+    return(NULL);
+  }
+  for (j=0; j<edf->NrOfSignals; j++) {
+    edf->signal[j].NrOfSamples=edf->NrOfDataRecords * edf->signal[j].NrOfSamplesPerRecord;
+    if (edf_plane_alloc(&p[j], edf->signal[j].NrOfSamples, bps)<0) {
+      while (j>=0) { edf_plane_free(&p[j]); j--; }
+      free(p);
+      return(NULL);
+    }
+  }
+
+  /* read all samples record by record */
+  for (k=0; k<edf->NrOfDataRecords; k++) {
+    for (j=0; j<edf->NrOfSignals; j++) {
+      nb=(size_t)edf->signal[j].NrOfSamplesPerRecord*bps;
+      if (fread(&p[j].data[k*nb],1,nb,fp)!=nb) { break; }
+    }
+    if (j<edf->NrOfSignals) { break; }
+  }
+  if (k<edf->NrOfDataRecords) {
+    /* keep the complete records only */
+    fprintf(stderr,"# Warning: EDF/BDF file ends at record %d of %d\n",k,edf->NrOfDataRecords);
+    edf->NrOfDataRecords=k;
+    for (j=0; j<edf->NrOfSignals; j++) {
+      edf->signal[j].NrOfSamples=k*edf->signal[j].NrOfSamplesPerRecord;
+      p[j].n=edf->signal[j].NrOfSamples;
+    }
+  }
+  return(p);
+}
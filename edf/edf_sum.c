@@ -0,0 +1,485 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file edf_sum.c
+ * Multi-resolution summary (min/max/mean/overflow count) of EDF/BDF records.
+ *  The summary is kept in a sidecar file next to the EDF/BDF file as a serie
+ *  of blocks, so the live BDF writer can append it record by record.
+ */
+
+#ifdef _MSC_VER
+  #include "../nexus/inc/win32_compat.h"
+  #include "../nexus/inc/stdint_win32.h"
+#else
+  #include <stdint.h>
+  #include <inttypes.h>
+  #include <alloca.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "edf.h"
+
+#define EDFSUMMAGIC "EDFSUM2"  /**< sidecar file identification */
+
+/** sidecar file header */
+typedef struct EDF_SUM_HDR_T {
+  char    magic[8];          /**< EDFSUMMAGIC */
+  int32_t ns;                /**< number of signals */
+  int32_t nlvl;              /**< number of levels */
+  int32_t fac;               /**< records per entry factor between levels */
+  int32_t nrec;              /**< EDF/BDF number of records when stamped */
+  double  RecordDuration;    /**< record duration [s] */
+  int64_t fsize;             /**< EDF/BDF file size [byte] when stamped */
+  int64_t mtime;             /**< EDF/BDF modification time when stamped, 0 when not stamped */
+} edf_sum_hdr_t;
+
+/** sidecar block header: followed by 'ns' edf_sum_t entries */
+typedef struct EDF_SUM_BLK_T {
+  int32_t lvl;               /**< summary level */
+  int32_t idx;               /**< entry index in this level */
+} edf_sum_blk_t;
+
+/** Reset summary of 'ns' signals in 's' to an empty summary
+*/
+static void edf_sum_clear(edf_sum_t *s, int32_t ns) {
+
+  int32_t j;
+
+  for (j=0; j<ns; j++) {
+    s[j].min = INT32_MAX; s[j].max = INT32_MIN; s[j].mean = 0.0f; s[j].ovf = 0; s[j].flat = 0;
+  }
+}
+
+/** Store level 'lvl' summary 'rec' of all signals as entry 'idx' of 'si'
+ * @return 0 on success, -1 on failure
+*/
+static int32_t edf_sum_store(edf_sum_idx_t *si, int32_t lvl, int32_t idx, const edf_sum_t *rec) {
+
+  int32_t size;    /**< new allocation size */
+  edf_sum_t *sum;  /**< new storage */
+
+  /* check available storage space */
+  if (idx>=si->size[lvl]) {
+    size=si->size[lvl];
+    while (idx>=size) { size+=CHUNKSIZE; }
+    sum=(edf_sum_t *)realloc(si->sum[lvl],(size_t)size*(size_t)si->ns*sizeof(edf_sum_t));
+    if (sum==NULL) {
+      fprintf(stderr,"# Error: not enough memory to allocate %d level %d summaries!!!\n",size,lvl);
+      return(-1);
+    }
+    si->sum[lvl]=sum; si->size[lvl]=size;
+  }
+  memcpy(&si->sum[lvl][(size_t)idx*si->ns], rec, si->ns*sizeof(edf_sum_t));
+  if (idx>=si->nr[lvl]) { si->nr[lvl]=idx+1; }
+  return(0);
+}
+
+/** Append block of level 'lvl' summary 'rec' as entry 'idx' to sidecar file 'fp'
+ * @return number of bytes written
+*/
+static int32_t edf_sum_wr_blk(FILE *fp, int32_t ns, int32_t lvl, int32_t idx, const edf_sum_t *rec) {
+
+  edf_sum_blk_t blk;  /**< block header */
+  int32_t nc=0;       /**< number of bytes written */
+
+  blk.lvl=lvl; blk.idx=idx;
+  nc+=fwrite(&blk,1,sizeof(blk),fp);
+  nc+=fwrite(rec,1,ns*sizeof(edf_sum_t),fp);
+  return(nc);
+}
+
+/** Merge summary 'b' of 'ns' signals into summary 'a' holding 'na' entries
+*/
+static void edf_sum_merge(edf_sum_t *a, int32_t na, const edf_sum_t *b, int32_t ns) {
+
+  int32_t j;
+
+  for (j=0; j<ns; j++) {
+    if (b[j].min < a[j].min) { a[j].min = b[j].min; }
+    if (b[j].max > a[j].max) { a[j].max = b[j].max; }
+    a[j].mean = (a[j].mean*na + b[j].mean)/(na+1);
+    a[j].ovf += b[j].ovf;
+    if (b[j].flat > a[j].flat) { a[j].flat = b[j].flat; }
+  }
+}
+
+/** Make empty summary index for 'ns' signals with records of 'dur' [s]
+ * @return pointer to summary index, NULL on failure
+*/
+edf_sum_idx_t *edf_sum_new(int32_t ns, double dur) {
+
+  edf_sum_idx_t *si; /**< summary index */
+  int32_t lvl;       /**< summary level */
+
+  if ((si=(edf_sum_idx_t *)calloc(1,sizeof(edf_sum_idx_t)))==NULL) {
+    fprintf(stderr,"# Error: not enough memory to allocate summary index!!!\n");
+    return(NULL);
+  }
+  si->ns=ns; si->RecordDuration=dur;
+  for (lvl=0; lvl<EDFSUMLVL; lvl++) {
+    if ((si->acc[lvl]=(edf_sum_t *)calloc(ns,sizeof(edf_sum_t)))==NULL) {
+      fprintf(stderr,"# Error: not enough memory to allocate summary index!!!\n");
+      edf_sum_free(si);
+      return(NULL);
+    }
+    edf_sum_clear(si->acc[lvl],ns);
+  }
+  return(si);
+}
+
+/** Free summary index 'si' and close its sidecar file
+*/
+void edf_sum_free(edf_sum_idx_t *si) {
+
+  int32_t lvl;
+
+  if (si==NULL) return;
+  if (si->fp!=NULL) { fclose(si->fp); }
+  for (lvl=0; lvl<EDFSUMLVL; lvl++) {
+    if (si->sum[lvl] != NULL) free(si->sum[lvl]);
+    if (si->acc[lvl] != NULL) free(si->acc[lvl]);
+  }
+  free(si);
+}
+
+/** Make sidecar summary file name 'sname' out of EDF/BDF file name 'fname'
+ * @return number of characters in 'sname'
+*/
+int32_t edf_sum_name(char *sname, const char *fname) {
+
+  return(sprintf(sname,"%s.sum",fname));
+}
+
+/** Add summary 'rec' of all signals of the next record to 'si' and roll it up
+ *   into the coarser levels; completed entries are appended to the sidecar file.
+ * @return number of records in 'si', <0 on failure
+*/
+int32_t edf_sum_add_rec(edf_sum_idx_t *si, const edf_sum_t *rec) {
+
+  int32_t lvl;       /**< summary level */
+  int32_t idx;       /**< entry index */
+  const edf_sum_t *s=rec; /**< summary to store in current level */
+
+  for (lvl=0; lvl<EDFSUMLVL; lvl++) {
+    idx=si->nr[lvl];
+    if (lvl>0) {
+      /* accumulate finer level entry */
+      edf_sum_merge(si->acc[lvl],si->cnt[lvl],s,si->ns);
+      si->cnt[lvl]++;
+      if (si->cnt[lvl] < EDFSUMFAC) { break; }
+      s=si->acc[lvl];
+    }
+    if (edf_sum_store(si,lvl,idx,s) < 0) { return(-1); }
+    if (si->fp!=NULL) { edf_sum_wr_blk(si->fp,si->ns,lvl,idx,s); }
+    if (lvl>0) {
+      edf_sum_clear(si->acc[lvl],si->ns); si->cnt[lvl]=0;
+      s=&si->sum[lvl][idx*si->ns];
+    }
+  }
+  return(si->nr[0]);
+}
+
+/** Summarize 'ns' samples 'data' of a 'bdf' (1) or EDF (0) signal into 's'
+*/
+void edf_sum_samples(edf_sum_t *s, const int32_t *data, int32_t ns, int32_t bdf) {
+
+  int32_t  i;
+  int32_t  yi;                     /**< integer sample value */
+  int32_t  shl=(bdf==1) ? 8 : 16;  /**< bits shift left to preserve sign */
+  double   sum=0.0;                /**< sum of samples */
+  int32_t  py=0;                   /**< previous integer sample value */
+  int32_t  len=0;                  /**< length of current flat serie */
+
+  edf_sum_clear(s,1);
+  for (i=0; i<ns; i++) {
+    if (data[i] & OVERFLOWBIT) { s->ovf++; }
+    yi = (int32_t)((uint32_t)data[i]<<shl)>>shl;
+    if (yi < s->min) { s->min=yi; }
+    if (yi > s->max) { s->max=yi; }
+    sum+=yi;
+    len = ((i>0) && (yi==py)) ? len+1 : 1;
+    if (len > s->flat) { s->flat=len; }
+    py=yi;
+  }
+  if (ns>0) {
+    s->mean=(float)(sum/ns);
+  } else {
+    s->min=0; s->max=0;
+  }
+}
+
+/** Build summary index of all records in 'edf' (samples should be read)
+ * @return pointer to summary index, NULL on failure
+*/
+edf_sum_idx_t *edf_sum_build(edf_t *edf) {
+
+  edf_sum_idx_t *si;   /**< summary index */
+  edf_sum_t *rec;      /**< summary of one record */
+  int32_t k;           /**< record counter */
+  int32_t j;           /**< signal counter */
+  int32_t nspr;        /**< number of samples per record */
+
+  if ((si=edf_sum_new(edf->NrOfSignals,edf->RecordDuration))==NULL) {
+    return(NULL);
+  }
+  if ((rec=(edf_sum_t *)calloc(edf->NrOfSignals,sizeof(edf_sum_t)))==NULL) {
+    edf_sum_free(si);
+    return(NULL);
+  }
+  for (k=0; k<edf->NrOfDataRecords; k++) {
+    for (j=0; j<edf->NrOfSignals; j++) {
+      /* annotation channels hold TAL characters, no samples */
+      nspr=edf->signal[j].NrOfSamplesPerRecord;
+      if ((edf->signal[j].data==NULL) || (strstr(edf->signal[j].Label,"Annotations")!=NULL)) {
+        nspr=0;
+      }
+      edf_sum_samples(&rec[j], &edf->signal[j].data[k*nspr], nspr, edf->bdf);
+    }
+    if (edf_sum_add_rec(si,rec)<0) { break; }
+  }
+  free(rec);
+  return(si);
+}
+
+/** Write header of summary 'si' to sidecar file 'fp'
+ * @return number of bytes written
+*/
+static int32_t edf_sum_wr_hdr(FILE *fp, const edf_sum_idx_t *si) {
+
+  edf_sum_hdr_t hdr;  /**< sidecar file header */
+
+  memset(&hdr,0,sizeof(hdr));
+  strcpy(hdr.magic,EDFSUMMAGIC);
+  hdr.ns=si->ns; hdr.nlvl=EDFSUMLVL; hdr.fac=EDFSUMFAC;
+  hdr.RecordDuration=si->RecordDuration;
+  hdr.nrec=si->nrec; hdr.fsize=si->fsize; hdr.mtime=si->mtime;
+  return(fwrite(&hdr,1,sizeof(hdr),fp));
+}
+
+/** Open sidecar summary file 'fname' for writing and append all entries
+ *   already in 'si'; later records added with edf_sum_add_rec() are appended.
+ * @return number of bytes written, <0 on failure
+*/
+int32_t edf_sum_wr(edf_sum_idx_t *si, const char *fname) {
+
+  int32_t lvl,idx;    /**< summary level and entry index */
+  int32_t nc=0;       /**< number of bytes written */
+
+  if (si->fp!=NULL) { fclose(si->fp); }
+  if ((si->fp=fopen(fname,"wb"))==NULL) {
+    fprintf(stderr,"# Error: can't open summary file %s\n",fname);
+    perror("");
+    return(-1);
+  }
+  nc+=edf_sum_wr_hdr(si->fp,si);
+
+  for (lvl=0; lvl<EDFSUMLVL; lvl++) {
+    for (idx=0; idx<si->nr[lvl]; idx++) {
+      nc+=edf_sum_wr_blk(si->fp,si->ns,lvl,idx,&si->sum[lvl][idx*si->ns]);
+    }
+  }
+  fflush(si->fp);
+  return(nc);
+}
+
+/** Read sidecar summary file 'fname'
+ * @return pointer to summary index, NULL on failure
+*/
+edf_sum_idx_t *edf_sum_rd(const char *fname) {
+
+  FILE *fp;            /**< sidecar file pointer */
+  edf_sum_hdr_t hdr;   /**< sidecar file header */
+  edf_sum_blk_t blk;   /**< block header */
+  edf_sum_idx_t *si;   /**< summary index */
+  edf_sum_t *rec;      /**< summary of all signals */
+  struct stat st;      /**< sidecar file status */
+  int64_t nblk;        /**< number of blocks in the sidecar file */
+
+  if ((fp=fopen(fname,"rb"))==NULL) {
+    return(NULL);
+  }
+  if ((fread(&hdr,1,sizeof(hdr),fp)!=sizeof(hdr)) || (strcmp(hdr.magic,EDFSUMMAGIC)!=0) ||
+      (hdr.nlvl!=EDFSUMLVL) || (hdr.fac!=EDFSUMFAC) || (hdr.ns<=0)) {
+    fprintf(stderr,"# Error: unknown summary file format %s\n",fname);
+    fclose(fp);
+    return(NULL);
+  }
+  if ((si=edf_sum_new(hdr.ns,hdr.RecordDuration))==NULL) {
+    fclose(fp);
+    return(NULL);
+  }
+  si->nrec=hdr.nrec; si->fsize=hdr.fsize; si->mtime=hdr.mtime;
+  rec=(edf_sum_t *)calloc(hdr.ns,sizeof(edf_sum_t));
+  /* no level can have more entries than the file has blocks */
+  nblk=0;
+  if (stat(fname,&st)==0) {
+    nblk=((int64_t)st.st_size-(int64_t)sizeof(hdr))/(int64_t)(sizeof(blk)+hdr.ns*sizeof(edf_sum_t));
+  }
+
+  /* a partial last block of a live recording is ignored */
+  while ((rec!=NULL) && (fread(&blk,1,sizeof(blk),fp)==sizeof(blk))) {
+    if (fread(rec,sizeof(edf_sum_t),hdr.ns,fp)!=(size_t)hdr.ns) { break; }
+    if ((blk.lvl<0) || (blk.lvl>=EDFSUMLVL) || (blk.idx<0) || (blk.idx>=nblk)) {
+      fprintf(stderr,"# Error: corrupt summary block in %s\n",fname);
+      break;
+    }
+    if (edf_sum_store(si,blk.lvl,blk.idx,rec)<0) { break; }
+  }
+  if (rec!=NULL) free(rec);
+  fclose(fp);
+  return(si);
+}
+
+/** Stamp summary 'si' with size and modification time of the finished EDF/BDF
+ *   file 'ename' with 'nrec' records, also in its sidecar file when open.
+ * @return 0 on success, -1 on failure
+*/
+int32_t edf_sum_stamp(edf_sum_idx_t *si, const char *ename, int32_t nrec) {
+
+  struct stat st;     /**< EDF/BDF file status */
+
+  if (stat(ename,&st)!=0) {
+    fprintf(stderr,"# Error: can't stamp summary of %s\n",ename);
+    perror("");
+    return(-1);
+  }
+  si->fsize=(int64_t)st.st_size; si->mtime=(int64_t)st.st_mtime; si->nrec=nrec;
+  if (si->fp!=NULL) {
+    /* rewrite header, entries are still appended at the end */
+    fseek(si->fp,0,SEEK_SET);
+    edf_sum_wr_hdr(si->fp,si);
+    fseek(si->fp,0,SEEK_END);
+    fflush(si->fp);
+  }
+  return(0);
+}
+
+/** Load sidecar summary of EDF/BDF file 'ename' into 'edf->sum' when it still
+ *   matches the file: stamped summaries on size, modification time and number
+ *   of records, unstamped (live) summaries on the number of records.
+ * @return number of summarized records, <0 on a missing or outdated summary
+*/
+int32_t edf_sum_load(edf_t *edf, const char *ename) {
+
+  char *sname;        /**< sidecar file name */
+  struct stat st;     /**< EDF/BDF file status */
+  edf_sum_idx_t *si;  /**< summary index */
+  int32_t ok;         /**< summary matches 'edf' */
+
+  if (edf->sum!=NULL) { edf_sum_free(edf->sum); edf->sum=NULL; }
+  sname=(char *)alloca(strlen(ename)+8);
+  edf_sum_name(sname,ename);
+  if ((si=edf_sum_rd(sname))==NULL) { return(-1); }
+
+  /* signals behind the summarized ones, like an EDF+ annotation signal, are not summarized */
+  ok=(si->ns<=edf->NrOfSignals) && (si->nr[0]==edf->NrOfDataRecords);
+  if (ok && (si->mtime!=0)) {
+    ok=(stat(ename,&st)==0) && ((int64_t)st.st_size==si->fsize) &&
+       ((int64_t)st.st_mtime==si->mtime) && (si->nrec==edf->NrOfDataRecords);
+  }
+  if (!ok) {
+    fprintf(stderr,"# Warning: summary file %s does not match %s\n",sname,ename);
+    edf_sum_free(si);
+    return(-1);
+  }
+  edf->sum=si;
+  return(si->nr[0]);
+}
+
+/** Get summary 's' of signal 'chn' in 'si' over records 'r0' up to 'r1' (excluded)
+ *   using the coarsest levels that fit.
+ * @return number of summary entries used, <0 on failure
+*/
+int32_t edf_sum_range(const edf_sum_idx_t *si, int32_t chn, int32_t r0, int32_t r1, edf_sum_t *s) {
+
+  int32_t lvl;       /**< summary level */
+  int32_t step;      /**< records per entry of level 'lvl' */
+  int32_t r=r0;      /**< current record */
+  int32_t cnt=0;     /**< number of entries used */
+  double  sum=0.0;   /**< record weighted sum of means */
+  int32_t nrec=0;    /**< number of records summarized */
+  const edf_sum_t *e; /**< summary entry */
+
+  if ((chn<0) || (chn>=si->ns)) {
+    fprintf(stderr,"# Error: edf_sum_range channel nr %d out of range\n",chn);
+    return(-1);
+  }
+  if (r0<0) { r=r0=0; }
+  if (r1>si->nr[0]) { r1=si->nr[0]; }
+
+  edf_sum_clear(s,1);
+  while (r<r1) {
+    /* coarsest level entry starting at 'r' that fits in [r, r1) */
+    step=1;
+    for (lvl=0; lvl<EDFSUMLVL-1; lvl++) {
+      if ((r%(step*EDFSUMFAC)!=0) || (r+step*EDFSUMFAC>r1) ||
+          ((r/(step*EDFSUMFAC))>=si->nr[lvl+1])) { break; }
+      step*=EDFSUMFAC;
+    }
+    e=&si->sum[lvl][(r/step)*si->ns+chn];
+    if (e->min < s->min) { s->min = e->min; }
+    if (e->max > s->max) { s->max = e->max; }
+    s->ovf += e->ovf;
+    sum += (double)e->mean*step; nrec+=step;
+    r+=step; cnt++;
+  }
+  if (nrec>0) {
+    s->mean=(float)(sum/nrec);
+  } else {
+    s->min=0; s->max=0;
+  }
+  return(cnt);
+}
+
+/** Get overview of signal 'chn' in 'si' over records 'r0' up to 'r1' (excluded)
+ *   in 'n' equally sized bins 's'.
+ * @return number of filled bins
+*/
+int32_t edf_sum_overview(const edf_sum_idx_t *si, int32_t chn, int32_t r0, int32_t r1,
+ int32_t n, edf_sum_t *s) {
+
+  int32_t i;         /**< bin index */
+  int32_t b0,b1;     /**< first and last+1 record of a bin */
+
+  if (r1>si->nr[0]) { r1=si->nr[0]; }
+  if ((n<=0) || (r1<=r0)) { return(0); }
+  for (i=0; i<n; i++) {
+    b0=r0+(int32_t)(((int64_t)(r1-r0)*i)/n);
+    b1=r0+(int32_t)(((int64_t)(r1-r0)*(i+1))/n);
+    if (b1<=b0) { b1=b0+1; }
+    if (edf_sum_range(si,chn,b0,b1,&s[i])<0) { return(i); }
+  }
+  return(n);
+}
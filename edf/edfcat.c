@@ -0,0 +1,196 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _XOPEN_SOURCE
+  #define _XOPEN_SOURCE  700 // for strptime()
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "edf.h"
+
+#define VERSION "edfcat 0.1 19/10/2026 12:00"
+
+#define  INDEF "."
+#define  CATDEF "edf.cat"
+#define  MNCN     (1024)
+#define  NTDEF       (0)
+
+int32_t  vb =  0x00;
+int32_t dbg =  0x00;
+
+/** edfcat usage
+ * @return number of printed characters.
+*/
+int32_t edfcat_intro(FILE *fp) {
+  
+  int32_t nc=0;
+  
+  nc+=fprintf(fp,"%s\n",VERSION);
+  nc+=fprintf(fp,"Usage: edfcat [-i <dir>] [-o <cat>] [-c <cat>] [-n <nt>] [-s <subject>] [-r <chair>]\n");
+  nc+=fprintf(fp,"              [-l <label>] [-b <t0>] [-e <t1>] [-f] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"dir  : directory with EDF/BDF files to scan (default=%s)\n",INDEF);
+  nc+=fprintf(fp,"cat  : output catalog file (default=<dir>/%s)\n",CATDEF);
+  nc+=fprintf(fp,"c    : query existing catalog file <cat> instead of scanning <dir>\n");
+  nc+=fprintf(fp,"nt   : number of scanner threads (default=%d: 2 per cpu)\n",NTDEF);
+  nc+=fprintf(fp,"subject, chair, label: only show recordings of this subject, chair or with this signal\n");
+  nc+=fprintf(fp,"t0,t1: only show recordings overlapping [t0,t1] as YYYY-mm-ddTHH:MM:SS\n");
+  nc+=fprintf(fp,"f    : only show recordings with header problems (run edffix)\n");
+  nc+=fprintf(fp,"h    : show this manual page\n");
+  nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
+  nc+=fprintf(fp," 0x01: show scan timing\n");
+  nc+=fprintf(fp,"dbg  : debug value (default=0x%02X)\n",dbg);
+  return(nc);
+}
+
+/** Convert 'a' as YYYY-mm-ddTHH:MM:SS to calendar time
+ * @return calendar time, 0 on failure
+*/
+static time_t edfcat_time(const char *a) {
+
+  struct tm cal;     /**< broken calendar time */
+
+  memset(&cal,0,sizeof(cal));
+  if (strptime(a,"%Y-%m-%dT%H:%M:%S",&cal)==NULL) {
+    fprintf(stderr,"# Error: can't understand time %s\n",a);
+    return(0);
+  }
+  cal.tm_isdst=-1;
+  return(mktime(&cal));
+}
+
+/** reads the options from the command line */
+static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, char *cname,
+  int32_t *nt, char *subject, char *chair, char *label, time_t *t0, time_t *t1, int32_t *fix) {
+
+  int32_t i;
+ 
+  strcpy(iname, INDEF); strcpy(oname,""); strcpy(cname,""); *nt=NTDEF;
+  strcpy(subject,""); strcpy(chair,""); strcpy(label,""); *t0=0; *t1=0; *fix=0;
+  
+  for (i=1; i<argc; i++) {
+    if (argv[i][0]!='-') {
+      fprintf(stderr,"missing - in argument %s\n",argv[i]);
+    } else {
+      switch (argv[i][1]) {
+        case 'i': strcpy(iname,argv[++i]); break;
+        case 'o': strcpy(oname,argv[++i]); break;
+        case 'c': strcpy(cname,argv[++i]); break;
+        case 'n': *nt=strtol(argv[++i],NULL,0); break;
+        case 's': strncpy(subject,argv[++i],16); subject[16]='\0'; break;
+        case 'r': strncpy(chair,argv[++i],16); chair[16]='\0'; break;
+        case 'l': strncpy(label,argv[++i],16); label[16]='\0'; break;
+        case 'b': *t0=edfcat_time(argv[++i]); break;
+        case 'e': *t1=edfcat_time(argv[++i]); break;
+        case 'f': *fix=1; break;
+        case 'v': vb=strtol(argv[++i],NULL,0); break;
+        case 'd': dbg=strtol(argv[++i],NULL,0); break;
+        case 'h': edfcat_intro(stderr); exit(0);
+        default : fprintf(stderr,"can't understand argument %s\n",argv[i]); 
+          exit(0);
+      }
+    }        
+  }
+
+  /* make 'oname' out of 'iname' */
+  if (strlen(oname)<1) {
+    sprintf(oname,"%s/%s",iname,CATDEF);
+  }
+  /* open end */
+  if ((*t0>0) && (*t1<=*t0)) {
+    *t1=INT32_MAX;
+  }
+} 
+
+/** main */
+int32_t main(int32_t argc, char *argv[]) {
+
+  char  iname[MNCN];         /**< input directory */
+  char  oname[MNCN];         /**< output catalog file name */
+  char  cname[MNCN];         /**< catalog file name to query */
+  char  subject[17];         /**< subject selection */
+  char  chair[17];           /**< chair selection */
+  char  label[17];           /**< signal label selection */
+  time_t t0,t1;              /**< time selection */
+  int32_t fix;               /**< only show files with problems */
+  int32_t nt;                /**< number of threads */
+  FILE *fp;
+  edf_cat_t *c;              /**< catalog */
+  edf_cat_t *sel;            /**< selected catalog entries */
+  int32_t n;                 /**< number of catalog entries */
+  int32_t m=0;               /**< number of selected catalog entries */
+  int32_t i;
+  struct timespec ts0,ts1;   /**< scan timing */
+  
+  parse_cmd(argc,argv,iname,oname,cname,&nt,subject,chair,label,&t0,&t1,&fix);
+  
+  if (strlen(cname)>0) {
+    fprintf(stderr,"# Open catalog file %s\n",cname);
+    if ((c=edf_cat_rd(cname,&n))==NULL) { return(-1); }
+  } else {
+    fprintf(stderr,"# Scan EDF/BDF files in %s\n",iname);
+    clock_gettime(CLOCK_MONOTONIC,&ts0);
+    if ((c=edf_cat_scan_dir(iname,nt,&n))==NULL) { return(-1); }
+    clock_gettime(CLOCK_MONOTONIC,&ts1);
+    if (vb&0x01) {
+      fprintf(stderr,"# Info: scanned %d files in %.3f [s]\n",n,
+        (ts1.tv_sec-ts0.tv_sec)+1e-9*(ts1.tv_nsec-ts0.tv_nsec));
+    }
+    fprintf(stderr,"# Open catalog file %s\n",oname);
+    if ((fp=fopen(oname,"w"))==NULL) {
+      perror(""); free(c); return(-1);
+    }
+    edf_cat_wr(fp,c,n);
+    fclose(fp);
+  }
+
+  /* show selection */
+  if ((sel=(edf_cat_t *)calloc(n>0 ? n : 1,sizeof(edf_cat_t)))==NULL) {
+    free(c); return(-1);
+  }
+  for (i=0; i<n; i++) {
+    if ((fix==1) && (c[i].flags==0)) { continue; }
+    if (edf_cat_match(&c[i],subject,chair,label,t0,t1)==1) {
+      sel[m++]=c[i];
+    }
+  }
+  edf_cat_wr(stdout,sel,m);
+  fprintf(stderr,"# Info: %d of %d recordings selected\n",m,n);
+  
+  free(sel);
+  free(c);
+  return(0);
+} 
@@ -155,16 +155,18 @@ int32_t edf_first_usefull_rec(edf_t *edf) {
 
   int32_t  chn;       /**<  channel */
   int32_t i,i0;       /**< general index */
+  const edf_signal_t *s; /**< RejectedEpochs signal */
 
   chn=edf_fnd_chn_nr(edf,"RejectedEpochs");
   if (chn<0) {
     fprintf(stderr,"# Error: missing Rejected Epochs channel\n");
     return(-1);
   }
+  s=&edf->signal[chn];
   i=1; i0=i-1;
-  while ((i<edf->signal[chn].NrOfSamples) && (edf_get_integer_value(edf, chn, i)<1)) { 
+  while ((i<s->NrOfSamples) && (edf_sample(s, i, edf->bdf)<1)) { 
     /* check for state change for overflow to ok */
-    if ((edf_get_integer_value(edf, chn, i-1) < 0) && (edf_get_integer_value(edf, chn, i) >= 0)) {
+    if ((edf_sample(s, i-1, edf->bdf) < 0) && (edf_sample(s, i, edf->bdf) >= 0)) {
       i0=i; 
     }
     i++; 
@@ -179,16 +181,18 @@ int32_t edf_last_usefull_rec(edf_t *edf) {
 
   int32_t  chn;       /**<  channel */
   int32_t i,i0;       /**< general index */
+  const edf_signal_t *s; /**< RejectedEpochs signal */
 
   chn=edf_fnd_chn_nr(edf,"RejectedEpochs");
   if (chn<0) {
     fprintf(stderr,"# Error: missing Rejected Epochs channel\n");
     return(-1);
   }
-  i=edf->signal[chn].NrOfSamples-1; i0=i;
-  while ((i>1) && (edf_get_integer_value(edf, chn, i) < 1)) { 
+  s=&edf->signal[chn];
+  i=s->NrOfSamples-1; i0=i;
+  while ((i>1) && (edf_sample(s, i, edf->bdf) < 1)) { 
     /* check for state change for overflow to ok */
-    if ((edf_get_integer_value(edf, chn, i) < 0) && (edf_get_integer_value(edf, chn, i-1) >= 0)) {
+    if ((edf_sample(s, i, edf->bdf) < 0) && (edf_sample(s, i-1, edf->bdf) >= 0)) {
       i0=i; 
     }
     i--; 
@@ -222,7 +226,7 @@ int32_t edf_thr_display(edf_t *edf, double thr, double smin, double smax) {
   fprintf(stderr,"# Info: Apply threshold %8.4f [uV] %d [-] on channel 'Disp' nr %d\n",thr,ithr,chn);
 
   for (i=0; i<edf->signal[chn].NrOfSamples; i++) {
-    if (edf_get_integer_value(edf, chn, i) < ithr) { 
+    if (edf_sample(&edf->signal[chn], i, edf->bdf) < ithr) { 
       edf_set_integer_overflow_value(edf, (float) smin, 0, chn, i, gain);
     } else { 
       edf_set_integer_overflow_value(edf, (float) smax, 0, chn, i, gain);
@@ -296,12 +300,12 @@ int32_t edf_chk_gsr(edf_t *edf, int32_t ssf) {
   
   /* quick and dirty subsampling of GSR signal with factor 8 */
   for (i=0; i<edf->signal[gsrc].NrOfSamples; i+=ssf) {
-    sample=gain*edf_get_integer_value(edf, gsrc, i);
+    sample=gain*edf_sample(&edf->signal[gsrc], i, edf->bdf);
     /* translate [uV] into [uSiemens] according Ger-Jan de Vries */
     /* sample represents GSR resistance in [kOhm] */
     gsr = (float) (724.64 / (sample/1000.0 + 3.116));
     j=(b*i)/a;
-    tsk=edf_get_integer_value(edf, tskc, j);
+    tsk=edf_sample(&edf->signal[tskc], j, edf->bdf);
     fprintf(stderr," %.4f %.2f %2d\n",(i/fs),gsr,tsk);
   }
 
@@ -366,7 +370,8 @@ float *edf_chk_ecg(edf_t *edf, double dt, int32_t *m) {
   cnt=0;
   /* check all rising edges of switch */
   for (j=n; j<edf->signal[swtc].NrOfSamples; j++) {
-    if (edf_get_integer_value(edf, swtc, j) > edf_get_integer_value(edf, swtc, j-1)) {
+    if (edf_sample(&edf->signal[swtc], j, edf->bdf) > edf_sample(&edf->signal[swtc], j-1, edf->bdf)) {
+      /* the ERP window may run past the end, keep the range checked access */
       smin=gain*edf_get_integer_value(edf, ecgc, j); smax=smin; imin=0; imax=0;
       for (i=-n; i<n; i++) {
         sample=gain*edf_get_integer_value(edf, ecgc, j+i);
@@ -475,6 +480,8 @@ int32_t main(int32_t argc, char *argv[]) {
     fprintf(stderr,"# Info: read data\n");
     /* read EDF/BDF signal headers */
     edf_rd_samples(fp,&edf);  
+    /* use summary sidecar file for the missing packet and threshold scans */
+    edf_sum_load(&edf,iname);
   }
 
   fclose(fp);
@@ -517,6 +524,10 @@ int32_t main(int32_t argc, char *argv[]) {
     /* apply new threshold to display signal */
     edf_thr_display(&edf, thr, -1000.0, 1000.0);
   }
+  if ((vb&0x06) && (edf.sum!=NULL)) {
+    /* summary does not match the changed display signal anymore */
+    edf_sum_free(edf.sum); edf.sum=NULL;
+  }
            
   dsc=edf_fnd_chn_nr(&edf,"Disp");
   if ((dsc>=0) && (edf.NrOfDataRecords>1)) {
@@ -0,0 +1,158 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file edfpack.c
+ * Pack EDF/BDF files losslessly into .edz archives with random access and
+ *  unpack them, completely or only the records of a time range.
+ */
+
+#ifndef _XOPEN_SOURCE
+  #define _XOPEN_SOURCE  700 // for clock_gettime()
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "edf.h"
+
+#define VERSION "edfpack 0.1 19/10/2026 12:00"
+
+#define  MNCN     (1024)
+#define  NTDEF       (0)
+#define  EXTDEF  ".edz"
+
+int32_t  vb =  0x00;
+int32_t dbg =  0x00;
+
+/** edfpack usage
+ * @return number of printed characters.
+*/
+int32_t edfpack_intro(FILE *fp) {
+  
+  int32_t nc=0;
+  
+  nc+=fprintf(fp,"%s\n",VERSION);
+  nc+=fprintf(fp,"Usage: edfpack -i <in> [-o <out>] [-u] [-r <rpc>] [-n <nt>] [-b <t0>] [-e <t1>]\n");
+  nc+=fprintf(fp,"               [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"in   : EDF/BDF file to pack or, with -u, packed file to unpack\n");
+  nc+=fprintf(fp,"out  : output file (default=<in>%s or, with -u, <in> without %s)\n",EXTDEF,EXTDEF);
+  nc+=fprintf(fp,"u    : unpack <in> into EDF/BDF file <out>\n");
+  nc+=fprintf(fp,"rpc  : records per chunk, the unit of random access (default=%d)\n",EDFPACKRPC);
+  nc+=fprintf(fp,"nt   : number of threads (default=%d: 1 per cpu)\n",NTDEF);
+  nc+=fprintf(fp,"t0,t1: only unpack the records from t0 up to t1 [s] since the start\n");
+  nc+=fprintf(fp,"h    : show this manual page\n");
+  nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
+  nc+=fprintf(fp," 0x01: show size and timing\n");
+  nc+=fprintf(fp,"dbg  : debug value (default=0x%02X)\n",dbg);
+  return(nc);
+}
+
+/** reads the options from the command line */
+static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname, int32_t *up,
+  int32_t *rpc, int32_t *nt, double *t0, double *t1) {
+
+  int32_t i;
+  size_t  n;
+ 
+  strcpy(iname,""); strcpy(oname,""); *up=0; *rpc=EDFPACKRPC; *nt=NTDEF; *t0=0.0; *t1=0.0;
+  
+  for (i=1; i<argc; i++) {
+    if (argv[i][0]!='-') {
+      fprintf(stderr,"missing - in argument %s\n",argv[i]);
+    } else {
+      switch (argv[i][1]) {
+        case 'i': strcpy(iname,argv[++i]); break;
+        case 'o': strcpy(oname,argv[++i]); break;
+        case 'u': *up=1; break;
+        case 'r': *rpc=strtol(argv[++i],NULL,0); break;
+        case 'n': *nt=strtol(argv[++i],NULL,0); break;
+        case 'b': *t0=strtod(argv[++i],NULL); break;
+        case 'e': *t1=strtod(argv[++i],NULL); break;
+        case 'v': vb=strtol(argv[++i],NULL,0); break;
+        case 'd': dbg=strtol(argv[++i],NULL,0); break;
+        case 'h': edfpack_intro(stderr); exit(0);
+        default : fprintf(stderr,"can't understand argument %s\n",argv[i]); 
+          exit(0);
+      }
+    }        
+  }
+  if (strlen(iname)<1) {
+    edfpack_intro(stderr); exit(0);
+  }
+
+  /* make 'oname' out of 'iname' */
+  if (strlen(oname)<1) {
+    strcpy(oname,iname);
+    n=strlen(oname);
+    if (*up==0) {
+      strcat(oname,EXTDEF);
+    } else 
+    if ((n>strlen(EXTDEF)) && (strcmp(&oname[n-strlen(EXTDEF)],EXTDEF)==0)) {
+      oname[n-strlen(EXTDEF)]='\0';
+    } else {
+      strcat(oname,".bdf");
+    }
+  }
+} 
+
+/** main */
+int32_t main(int32_t argc, char *argv[]) {
+
+  char  iname[MNCN];         /**< input file name */
+  char  oname[MNCN];         /**< output file name */
+  int32_t up;                /**< unpack */
+  int32_t rpc;               /**< records per chunk */
+  int32_t nt;                /**< number of threads */
+  double  t0,t1;             /**< time range [s] to unpack */
+  int64_t size;              /**< output file size */
+  struct timespec ts0,ts1;   /**< timing */
+  
+  parse_cmd(argc,argv,iname,oname,&up,&rpc,&nt,&t0,&t1);
+  
+  clock_gettime(CLOCK_MONOTONIC,&ts0);
+  if (up==0) {
+    fprintf(stderr,"# Pack %s into %s\n",iname,oname);
+    size=edf_pack(iname,oname,rpc,nt);
+  } else {
+    fprintf(stderr,"# Unpack %s into %s\n",iname,oname);
+    size=edf_unpack(iname,oname,t0,t1,nt);
+  }
+  clock_gettime(CLOCK_MONOTONIC,&ts1);
+  if (size<0) { return(-1); }
+  if (vb&0x01) {
+    fprintf(stderr,"# Info: wrote %"PRId64" bytes in %.3f [s]\n",size,
+      (ts1.tv_sec-ts0.tv_sec)+1e-9*(ts1.tv_nsec-ts0.tv_nsec));
+  }
+  return(0);
+}
@@ -37,10 +37,24 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 class Client {
  public:
+  // called by getMessages() for every message
+  typedef void (*MessageHandler)(void * arg, const char * message, size_t length);
+
   Client(const std::string & hostName, int port);
   virtual void addConnection(const std::string & hostName, int port);
   virtual bool hasMessage();
   virtual std::string getMessage();
+  /** Wait for the next message and point 'message' at it in the receive
+   *  buffer, without copying; the message includes its newline and stays
+   *  valid until the next call of hasMessage() or getMessage().
+   * @return length of the message
+   */
+  virtual size_t getMessage(const char ** message);
+  /** Wait for messages and pass all messages that were received so far, 
+   *  of all connections, to 'handler'.
+   * @return number of messages passed
+   */
+  virtual size_t getMessages(MessageHandler handler, void * arg);
   virtual ~Client();
   void sendMessage(char * message);
  private:
@@ -51,16 +65,32 @@ class Client {
     int port;
     int socket;
     bool connected;
+    bool connecting;          // non-blocking connect in progress
+    double retryTime;         // time of the next connect attempt
+    double backoff;           // delay after the next failed attempt [s]
+    std::vector<char> input;  // received bytes
+    size_t head;              // start of the first unread message in 'input'
+    size_t scan;              // 'input' before 'scan' has no newline after 'head'
+    size_t tail;              // end of the received bytes in 'input'
   } ConnectionData;
 
   void connectAll();
+  void startConnect(ConnectionData & connection, unsigned int index);
+  void finishConnect(ConnectionData & connection);
+  void waitForConnects(int timeout);
   unsigned long lookupAddress(const std::string & hostName);
   void fail(ConnectionData & connection, const std::string & errorMsg);
-  void waitForAnyReadableSocket();
+  int retryTimeout();
+  void waitForEvents(int timeout);
   void readMessage(ConnectionData & connection);
+  bool frameMessage(ConnectionData & connection);
+  bool nextMessage();
 
   std::vector<ConnectionData> connections_;
-  std::string message_;
+  int epoll_;
+  size_t next_;
+  const char * message_;
+  size_t messageSize_;
   bool hasMessage_;
 };
 
@@ -38,6 +38,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string>
 #include <vector>
+#include <set>
 
 #ifdef _MSC_VER
   #include <winsock.h>
@@ -46,17 +47,45 @@ THE POSSIBILITY OF SUCH DAMAGE.
   typedef int socket_t;
 #endif
 
+/** TCP text stream server: every subscriber may send a request line 
+ *  'rate <X><hz> ...' to get channel X at 'hz' [Hz] instead of the full rate,
+ *  subscribers with the same request share one stream. A subscriber that
+ *  closes its sending side keeps its stream until a send to it fails.
+ */
 class Server {
  public:
 
   Server(int port);
+  /** send 'message' to all subscribers */
   virtual void sendMessage(const std::string & message);
+  /** send 'size' characters of 'message' to all subscribers, without a copy */
+  virtual void sendMessage(const char * message, size_t size);
+  /** send 'message' to the subscribers with 'request' */
+  virtual void sendMessage(const std::string & request, const std::string & message);
+  /** accept new subscribers and read their requests */
+  void poll();
+  /** distinct requests of all subscribers, "" is the full rate stream */
+  std::set<std::string> requests() const;
   virtual ~Server();
  private:
   Server(const Server&);
   Server& operator=(const Server&);
+  /** send 'message' to subscriber 'i', drop it on failure
+   * @return false when the subscriber is dropped */
+  bool sendTo(size_t i, const std::string & message);
+  /** send 'size' characters of 'message' to subscriber 'i', drop it on failure
+   * @return false when the subscriber is dropped */
+  bool sendTo(size_t i, const char * message, size_t size);
+  /** close and forget subscriber 'i' */
+  void drop(size_t i);
+  /** parse request 'line' of a subscriber
+   * @return normalized request, "" for the full rate stream */
+  static std::string parseRequest(const std::string & line);
   socket_t serverSocket_;
   std::vector<socket_t> clientSockets_;
+  std::vector<std::string> clientRequests_;  /**< normalized request per subscriber */
+  std::vector<std::string> clientInput_;     /**< partial request line per subscriber */
+  std::vector<bool> clientEof_;              /**< no more requests from subscriber */
 };
 
 #endif //SERVER_H
@@ -0,0 +1,135 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TMS_CLK_H
+#define TMS_CLK_H
+
+#ifdef _MSC_VER
+  #include "win32_compat.h"
+  #include "stdint_win32.h"
+#else
+  #include <stdint.h>
+#endif
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TMSCLKNW         (256)  /**< default number of bins in the fit window */
+#define TMSCLKBIN        (1.0)  /**< bin duration [s]: the earliest arrival of a bin is fitted */
+#define TMSCLKMINSPAN   (10.0)  /**< minimum window span [s] to fit the drift */
+#define TMSCLKMAXDRIFT (2e-3)   /**< maximum accepted drift [s/s] */
+#define TMSCLKQUANTILE  (0.1)   /**< residual quantile of the latency floor */
+#define TMSCLKITER         (4)  /**< reweighting iterations of the robust fit */
+
+/** clock model of a device: host time 't' [s] of device sample 'sc' is
+ *   t = t0 + (sc-sc0)*dt, fitted on the earliest arrival of sample blocks
+ *   per bin of TMSCLKBIN [s] */
+typedef struct TMS_CLK_T {
+  double   fs;        /**< nominal sample frequency of the sample index [Hz] */
+  int32_t  nw;        /**< size of the fit window */
+  int32_t  n;         /**< number of bins in the window */
+  int32_t  i;         /**< next position in the window */
+  int64_t *sc;        /**< sample index of the earliest arrival of each bin */
+  double  *ta;        /**< host arrival time [s] of the earliest arrival of each bin */
+  double  *w;         /**< weights of the robust fit */
+  double  *r;         /**< residuals of the fit [s] */
+  int64_t  sc0;       /**< reference sample index */
+  double   t0;        /**< host time [s] of sample 'sc0' */
+  double   dt;        /**< host time per device sample [s] */
+  double   jit;       /**< robust scale of the arrival latency [s] */
+  int64_t  na;        /**< total number of arrivals */
+  int64_t  bsc;       /**< first sample index of the current bin */
+  int64_t  bmsc;      /**< sample index of the earliest arrival in the current bin */
+  double   bmta;      /**< host time [s] of the earliest arrival in the current bin */
+  int32_t  bn;        /**< number of arrivals in the current bin */
+} tms_clk_t;
+
+/** Get host monotonic time
+ * @return time [s]
+*/
+double tms_clk_now();
+
+/** Make clock model of a device with sample frequency 'fs' [Hz] that fits the
+ *   last 'nw' arrivals, TMSCLKNW when 'nw'<1.
+ * @return pointer to clock model, NULL on failure
+*/
+tms_clk_t *tms_clk_new(double fs, int32_t nw);
+
+/** Free clock model 'c'
+*/
+void tms_clk_free(tms_clk_t *c);
+
+/** Add arrival at host monotonic time 't' [s] of a block ending at sample 'sc'
+ *   to clock model 'c', the model is refitted when a bin is complete. Sample 
+ *   indices should increase without gaps other than missed packets.
+ * @return number of bins in the fit window, -1 when 'sc' doesn't increase
+*/
+int32_t tms_clk_add(tms_clk_t *c, int64_t sc, double t);
+
+/** Forget all arrivals of clock model 'c' after a break in the sample index,
+ *   the drift is kept.
+*/
+void tms_clk_break(tms_clk_t *c);
+
+/** Get host monotonic time of sample 'sc' of clock model 'c'
+ * @return time [s]
+*/
+double tms_clk_time(const tms_clk_t *c, int64_t sc);
+
+/** Get host wall clock time of sample 'sc' of clock model 'c'
+ * @return time [s] since 1970-01-01 00:00:00 UTC
+*/
+double tms_clk_wall(const tms_clk_t *c, int64_t sc);
+
+/** Get drift of device clock 'c': positive when the device clock is slow
+ * @return drift [ppm]
+*/
+double tms_clk_drift(const tms_clk_t *c);
+
+/** Get host monotonic time of sample 0 of clock model 'c'
+ * @return offset [s]
+*/
+double tms_clk_offset(const tms_clk_t *c);
+
+/** Print clock model 'c' at device time 't' [s] of sample 'sc' as 
+ *   'clock t host drift jitter' into 'msg' of 'size' bytes
+ * @return number of characters in 'msg'
+*/
+int32_t tms_clk_prt(char *msg, int32_t size, const tms_clk_t *c, double t, int64_t sc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TMS_CLK_H
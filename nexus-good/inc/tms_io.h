@@ -0,0 +1,129 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TMS_IO_H
+#define TMS_IO_H
+
+#ifdef _MSC_VER
+  #include "win32_compat.h"
+  #include "stdint_win32.h"
+#else
+  #include <stdint.h>
+  #include <sys/uio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TMSIONONE          (0)  /**< no transport: EDF/BDF or other input */
+#define TMSIORFCOMM        (1)  /**< bluetooth RFCOMM socket, e.g. 00:A0:96:1B:44:C6 */
+#define TMSIOTTY           (2)  /**< serial port, e.g. /dev/rfcomm0 or tty:/dev/ttyUSB0@115200 */
+#define TMSIOTCP           (3)  /**< TCP bridge or simulator, e.g. tcp:localhost:4000 */
+#define TMSIOFILE          (4)  /**< raw capture file, e.g. file:nexus.raw */
+#define TMSIONTYPE         (5)  /**< number of transport types */
+
+#define TMSIOBAUD     (115200)  /**< default serial port speed [baud] */
+
+struct TMS_IO_T;
+
+/** transport backend */
+typedef struct TMS_IO_OPS_T {
+  const char *name;                                                  /**< backend name */
+  int32_t (*open)(struct TMS_IO_T *io, const char *addr);            /**< open 'addr', set 'fd' */
+  int32_t (*readv)(struct TMS_IO_T *io, const struct iovec *iov, int32_t n); /**< non-blocking read */
+  int32_t (*write)(struct TMS_IO_T *io, const uint8_t *buf, int32_t n);      /**< write all of 'buf' */
+  int32_t (*fd)(const struct TMS_IO_T *io);                          /**< readiness fd for poll() */
+  void    (*close)(struct TMS_IO_T *io);                             /**< close the transport */
+} tms_io_ops_t;
+
+/** open transport to a device */
+typedef struct TMS_IO_T {
+  int32_t  type;              /**< transport type TMSIO... */
+  const tms_io_ops_t *ops;    /**< backend */
+  int32_t  fd;                /**< file descriptor, <0: closed */
+  void    *priv;              /**< backend data */
+  struct TMS_IO_T *next;      /**< next open transport */
+} tms_io_t;
+
+/** Set backend 'ops' of transport 'type', e.g. the RFCOMM backend of tmsi_bluez.
+ * @return 0 on success, -1 on unknown type
+*/
+int32_t tms_io_set_ops(int32_t type, const tms_io_ops_t *ops);
+
+/** Get transport type of device address 'addr'
+ * @return TMSIO... type, TMSIONONE when 'addr' isn't a device
+*/
+int32_t tms_io_type(const char *addr);
+
+/** Open transport to device address 'addr'
+ * @return pointer to transport, NULL on failure
+*/
+tms_io_t *tms_io_open(const char *addr);
+
+/** Get the open transport with file descriptor 'fd'
+ * @return pointer to transport, NULL when 'fd' isn't a transport
+*/
+tms_io_t *tms_io_get(int32_t fd);
+
+/** Read at most 'n' bytes into 'buf' from transport 'io' without blocking
+ * @return number of bytes read, 0 or <0 when nothing is available
+*/
+int32_t tms_io_read(tms_io_t *io, uint8_t *buf, int32_t n);
+
+/** Read into the 'n' buffers 'iov' from transport 'io' without blocking
+ * @return number of bytes read, 0 or <0 when nothing is available
+*/
+int32_t tms_io_readv(tms_io_t *io, const struct iovec *iov, int32_t n);
+
+/** Write 'n' bytes of 'buf' to transport 'io'
+ * @return number of bytes written, <0 on failure
+*/
+int32_t tms_io_write(tms_io_t *io, const uint8_t *buf, int32_t n);
+
+/** Get file descriptor to wait for data of transport 'io' with poll()/select()
+ * @return file descriptor, -1 on failure
+*/
+int32_t tms_io_fd(const tms_io_t *io);
+
+/** Close transport 'io' and free it
+*/
+void tms_io_close(tms_io_t *io);
+
+/** Close all open transports
+*/
+void tms_io_close_all();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TMS_IO_H
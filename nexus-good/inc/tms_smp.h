@@ -0,0 +1,142 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TMS_SMP_H
+#define TMS_SMP_H
+
+#ifdef _MSC_VER
+  #include "win32_compat.h"
+  #include "stdint_win32.h"
+#else
+  #include <stdint.h>
+#endif
+
+#include "tmsi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TMSSMPNCHN        (64)  /**< maximum number of channels in a config */
+#define TMSSMPMAXPERIOD (4096)  /**< maximum ticks before the schedule repeats */
+#define TMSSMPRECDUR     (0.5)  /**< minimum BDF record duration [s] */
+
+/** decoder of Mobi8/Nexus-10 SD-card measurement data (.SMP): the bytes of
+ *   all channels are interleaved per time tick, channel 'j' has a sample 
+ *   of 'delta' bytes on every tick that is a multiple of its 'period' */
+typedef struct TMS_SMP_T {
+  int32_t  nchn;               /**< number of channels in the config */
+  int32_t  period;             /**< ticks after which the schedule repeats */
+  int32_t  pbytes;             /**< bytes of one schedule period */
+  int32_t *tick;               /**< first entry of every tick, period+1 entries */
+  int32_t *tbytes;             /**< bytes of every tick */
+  uint8_t *chn;                /**< channel of every entry */
+  uint8_t *size;               /**< byte size of every entry: 1, 2 or 3 */
+  int32_t  per[TMSSMPNCHN];    /**< sample period per channel, 0 when not stored */
+  int32_t  delta[TMSSMPNCHN];  /**< storage delta per channel */
+  int32_t  ovf[TMSSMPNCHN];    /**< overflow value per channel */
+  int32_t  value[TMSSMPNCHN];  /**< current value per channel */
+  int32_t  cnt[TMSSMPNCHN];    /**< sample counter per channel */
+  int32_t  overflow[TMSSMPNCHN]; /**< overflow counter per channel */
+  int64_t  tc;                 /**< decoded time ticks */
+} tms_smp_t;
+
+/** Make decoder for the measurement data described by config 'cfg'.
+ * @return pointer to decoder, NULL on failure
+*/
+tms_smp_t *tms_smp_new(const tms_config_t *cfg);
+
+/** Free decoder 's'
+*/
+void tms_smp_free(tms_smp_t *s);
+
+/** Allocate channel data with one BDF record of at least TMSSMPRECDUR [s] for
+ *   decoder 's' with sample frequency 'fs' of the quickest channel. The record
+ *   has 'rt' time ticks, a multiple of the schedule period.
+ * @return pointer to channel data of s->nchn channels, NULL on failure
+*/
+tms_channel_data_t *tms_smp_alloc_channel_data(const tms_smp_t *s, float fs, int32_t *rt);
+
+/** Free channel data 'chd' of decoder 's'
+*/
+void tms_smp_free_channel_data(const tms_smp_t *s, tms_channel_data_t *chd);
+
+/** Decode at most 'nt' time ticks from the 'n' bytes of 'b' and append their
+ *   samples to channel data 'chd'; only complete ticks are decoded.
+ *  @return number of decoded ticks, 'used' is set to the number of used bytes
+*/
+int32_t tms_smp_run(tms_smp_t *s, const uint8_t *b, int32_t n, tms_channel_data_t *chd,
+  int32_t nt, int32_t *used);
+
+/** Pack the samples in 'chd' of the channels selected in 'cs' of the 'nchn' 
+ *   channels as one EDF (bdf==0) or BDF (bdf==1) record in 'rec', like
+ *   edfWriteSamples() writes them.
+ *  @return number of bytes in 'rec'
+*/
+int32_t tms_smp_pack_record(uint8_t *rec, int32_t bdf, const tms_channel_data_t *chd,
+  int32_t nchn, int32_t cs);
+
+/** Record callback of tms_smp_rd_records(): the 'nt' time ticks in 'chd' from 
+ *   tick 'tc' on of decoder 's', 'arg' is passed as is
+*/
+typedef void (*tms_smp_rec_t)(void *arg, const tms_smp_t *s, tms_channel_data_t *chd,
+  int64_t tc, int32_t nt);
+
+/** Decode the measurement data of 'fpi' from its current position with decoder
+ *   's' into records of 'rt' time ticks in 'chd' and write every complete record
+ *   of the channels selected in 'cs' of the first 'nchn' channels to BDF file 
+ *   'fpe'. When not NULL, 'cb' gets every complete record before it is written
+ *   and at last the incomplete record, which isn't written.
+ * @return number of BDF records written, <0 on failure
+*/
+int32_t tms_smp_rd_records(tms_smp_t *s, FILE *fpi, tms_channel_data_t *chd, int32_t rt,
+  FILE *fpe, int32_t nchn, int32_t cs, tms_smp_rec_t cb, void *arg);
+
+/** Read config and measurement header of SD-card measurement file 'iname' 
+ *   into 'cfg' and 'hdr', the sample rate is corrected for its divider.
+ * @return 0 on success, <0 on failure
+*/
+int32_t tms_smp_rd_hdr(const char *iname, tms_config_t *cfg, tms_measurement_hdr_t *hdr);
+
+/** Convert SD-card measurement file 'iname' into BDF file 'bname' with the
+ *   channels selected in 'cs', patient 'pid', message 'msg' and signal names
+ *   'chn_name', like tms_rd does. The duration [s] written is returned in 'dur'.
+ *   The BDF file is written as '<bname>.tmp' and renamed to 'bname' on success.
+ * @return number of BDF records written, <0 on failure
+*/
+int32_t tms_smp_cvt(const char *iname, const char *bname, int32_t cs, const char *pid,
+  const char *msg, const char **chn_name, double *dur);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TMS_SMP_H
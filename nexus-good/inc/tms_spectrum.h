@@ -0,0 +1,182 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TMS_SPECTRUM_H
+#define TMS_SPECTRUM_H
+
+#ifdef _MSC_VER
+  #include "win32_compat.h"
+  #include "stdint_win32.h"
+#else
+  #include <stdint.h>
+#endif
+
+#include "tmsi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TMSSPECNFFT    (512)  /**< default FFT length [samples] */
+#define TMSSPECNAVG      (8)  /**< default number of periodograms in Welch average */
+#define TMSSPECBLK      (64)  /**< samples per queued worker block */
+#define TMSSPECQ      (1024)  /**< queued worker blocks: power of 2 */
+#define TMSSPECNBAND     (6)  /**< number of default EEG/EMG bands */
+
+/** real FFT of 'n' samples: complex FFT of n/2 points plus split */
+typedef struct TMS_FFT_T {
+  int32_t  n;        /**< FFT length: power of 2 */
+  int32_t *rev;      /**< bit reversal table of n/2 points */
+  float   *cs;       /**< cos(2*pi*k/n) for k=0..n/2 */
+  float   *sn;       /**< sin(2*pi*k/n) for k=0..n/2 */
+  float   *re;       /**< work array real part of n/2+1 points */
+  float   *im;       /**< work array imaginary part of n/2+1 points */
+} tms_fft_t;
+
+/** frequency band */
+typedef struct TMS_BAND_T {
+  const char *name;  /**< band name */
+  float f0;          /**< lower frequency [Hz] */
+  float f1;          /**< upper frequency [Hz] (excluded) */
+} tms_band_t;
+
+/** default EEG bands plus an EMG band */
+extern const tms_band_t tms_eeg_bands[TMSSPECNBAND];
+
+/** streaming Welch power spectral density of one signal */
+typedef struct TMS_SPECTRUM_T {
+  double     fs;     /**< sample frequency [Hz] */
+  int32_t    nfft;   /**< segment length [samples] */
+  int32_t    hop;    /**< samples between segment starts: nfft - overlap */
+  int32_t    navg;   /**< number of periodograms averaged */
+  int32_t    nbin;   /**< number of frequency bins: nfft/2+1 */
+  tms_fft_t *fft;    /**< real FFT of 'nfft' samples */
+  float     *win;    /**< Hann window */
+  float      scale;  /**< periodogram scale 1/(fs*sum(win^2)) */
+  float     *x;      /**< ring of the last 'nfft' samples */
+  int32_t    xi;     /**< next write position in 'x' */
+  int32_t    xn;     /**< number of samples in 'x' */
+  int32_t    cnt;    /**< samples since last segment */
+  float     *seg;    /**< last 'navg' periodograms of 'nbin' bins */
+  int32_t    si;     /**< next periodogram slot in 'seg' */
+  int32_t    sn;     /**< number of periodograms in 'seg' */
+  double    *sum;    /**< sum of periodograms in 'seg' */
+  float     *psd;    /**< Welch PSD: mean periodogram [unit^2/Hz] */
+  float     *work;   /**< windowed segment */
+  float      last;   /**< last sample, replaces NaN samples */
+  int32_t    nspec;  /**< number of Welch PSDs made */
+} tms_spectrum_t;
+
+/** called by the spectrum worker for every new PSD of channel 'chn' at time 't' */
+typedef void (*tms_spectrum_cb_t)(void *arg, int32_t chn, double t, const tms_spectrum_t *s);
+
+/** spectrum worker: a thread computing the PSDs of the queued channel blocks */
+typedef struct TMS_SPECTRUM_WORKER_T tms_spectrum_worker_t;
+
+/** Make real FFT of 'n' samples, 'n' should be a power of 2 >= 4
+ * @return pointer to FFT, NULL on failure
+*/
+tms_fft_t *tms_fft_new(int32_t n);
+
+/** Free real FFT 'f'
+*/
+void tms_fft_free(tms_fft_t *f);
+
+/** Real FFT of 'n' samples 'x' into 'n'/2+1 bins 're' and 'im'
+*/
+void tms_rfft(tms_fft_t *f, const float *x, float *re, float *im);
+
+/** Make streaming Welch spectrum of segments of 'nfft' samples that start
+ *   every 'hop' samples, averaged over 'navg' segments at sample frequency 'fs'.
+ * @return pointer to spectrum, NULL on failure
+*/
+tms_spectrum_t *tms_spectrum_new(double fs, int32_t nfft, int32_t hop, int32_t navg);
+
+/** Free spectrum 's'
+*/
+void tms_spectrum_free(tms_spectrum_t *s);
+
+/** Add 'n' samples 'x' to spectrum 's', NaN samples repeat the previous sample
+ * @return number of new Welch PSDs in s->psd
+*/
+int32_t tms_spectrum_add(tms_spectrum_t *s, const float *x, int32_t n);
+
+/** Add the received samples of channel 'chn' to spectrum 's'
+ * @return number of new Welch PSDs in s->psd
+*/
+int32_t tms_spectrum_add_chn(tms_spectrum_t *s, const tms_channel_data_t *chn);
+
+/** Get power of spectrum 's' in band 'f0' up to 'f1' [Hz]
+ * @return band power [unit^2]
+*/
+float tms_spectrum_band(const tms_spectrum_t *s, float f0, float f1);
+
+/** Get power 'pwr' of spectrum 's' in all 'nb' bands 'band'
+ * @return number of bands
+*/
+int32_t tms_spectrum_bands(const tms_spectrum_t *s, const tms_band_t *band, int32_t nb, float *pwr);
+
+/** Print 'nb' band powers 'pwr' of channel 'chn' at time 't' and 'dt' steps
+ *   into 'msg' of 'size' characters as 'bands chn t dt nb pwr[0] ... pwr[nb-1]'
+ *   like tms_ip_send_array().
+ * @return number of characters printed
+*/
+int32_t tms_spectrum_prt_bands(char *msg, int32_t size, int32_t chn, double t, double dt,
+  const float *pwr, int32_t nb);
+
+/** Make spectrum worker for 'nchn' channels calling 'cb' with 'arg' for every new PSD
+ * @return pointer to worker, NULL on failure
+*/
+tms_spectrum_worker_t *tms_spectrum_worker_new(int32_t nchn, tms_spectrum_cb_t cb, void *arg);
+
+/** Enable spectrum 'nfft', 'hop', 'navg' of channel 'chn' with sample frequency 'fs'
+ *   in worker 'w', before its first block is pushed.
+ * @return 0 on success, <0 on failure
+*/
+int32_t tms_spectrum_worker_chn(tms_spectrum_worker_t *w, int32_t chn, double fs,
+  int32_t nfft, int32_t hop, int32_t navg);
+
+/** Queue the received samples of channel data 'c' of channel 'chn', starting 
+ *   at time 't' for worker 'w', never waits: one producer thread only.
+ * @return number of queued samples, less than c->rs when the queue is full
+*/
+int32_t tms_spectrum_worker_push(tms_spectrum_worker_t *w, int32_t chn, double t,
+  const tms_channel_data_t *c);
+
+/** Stop and free worker 'w' and its spectra
+*/
+void tms_spectrum_worker_free(tms_spectrum_worker_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //TMS_SPECTRUM_H
@@ -631,6 +631,12 @@ int32_t tms_chn_sel(char *a);
 */
 int32_t tms_init(int32_t fdd, int32_t sample_rate_div);
 
+/** Keep device profiles also in files in directory 'dir', NULL: memory only.
+ *   tms_init() skips the ID data of a device with a known profile.
+ * @return 0 on success, -1 on failure
+*/
+int32_t tms_set_profile_dir(const char *dir);
+
 /** Get elapsed time [s] of this tms_channel_data_t 'channel'.
 * @return -1 of failure, elapsed seconds in success.
 */
@@ -746,6 +752,32 @@ int32_t edfWriteHdr(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
 int32_t edfWriteSamples(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
  int32_t cs, int32_t mpc);
 
+/** write BDF+D headers to file 'fp' like edfWriteHdr() with an extra "BDF Annotations"
+ *   signal for the time keeping annotation of every record, see edfWriteSamplesPlus().
+ *   'id' follows the EDF+ patient subfields "X X X X", 'record' the recording 
+ *   subfields "Startdate dd-MMM-yyyy X X X".
+ * @return bytes written to 'fp'
+*/
+int32_t edfWriteHdrPlus(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
+ const char *id, const char *record, time_t *t, double dt, const char **chn_name);
+
+/** write samples in 'chd' like edfWriteSamples() to a file with headers of 
+ *   edfWriteHdrPlus(): every record ends with its time keeping annotation, 
+ *   'onset' [s] since the start time for 'chd' and 'dur' [s] less for every 
+ *   missed packet before it.
+ * @return number of bytes written
+*/
+int32_t edfWriteSamplesPlus(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
+ int32_t cs, int32_t mpc, double onset, double dur);
+
+/** Add summary of samples in 'chd' with channel selection switch 'cs' and 'mpc'
+ *   missed packets before this 'chd' to summary index 'si', like edfWriteSamples()
+ *   writes them: one record per packet. Flagged and missed samples count as overflow.
+ * @return number of records in 'si', <0 on failure
+*/
+int32_t edfSumSamples(edf_sum_idx_t *si, tms_channel_data_t *chd,
+ int32_t cs, int32_t mpc);
+
 /** Construct tms_channel_data_t out of 'edf' header info.
  * @return pointer to channel_data_t struct, NULL on failure.
  */
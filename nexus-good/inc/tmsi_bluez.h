@@ -44,16 +44,17 @@ THE POSSIBILITY OF SUCH DAMAGE.
 extern "C" {
 #endif 
 
-/** Open bluetooth device 'fname' to TMSi acquisition device
-  *  Nexus-10 or Mobi-8.
-  * @return socket >0 on success.
+/** Open device 'fname' to TMSi acquisition device Nexus-10 or Mobi-8:
+  *  a bluetooth MAC address, a serial port /dev/... or tty:<dev>[@<baud>],
+  *  a TCP bridge tcp:<host>:<port> or a capture file file:<name>.
+  * @return file descriptor >0 on success.
 */
 extern int32_t tms_open_port(char *fname);
 
-/** Close private file descriptor 'socket_fd'.
- * @return 0 on success, errno on failure.
+/** Close device transport with file descriptor 'fd', all transports when 'fd'<0.
+ * @return 0 on success, -1 on failure.
 */
-extern int32_t tms_close_port();
+extern int32_t tms_close_port(int32_t fd);
 
 #ifdef __cplusplus
 }
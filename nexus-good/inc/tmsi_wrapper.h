@@ -56,6 +56,13 @@ void tmsw_set_callback_function(CallbackInt f_button);
 
 void tmsw_measure_response(int32_t on);
 
+/** Enable respiration detector on channel 'rsp_chn' and heart beat detector
+ *   on ECG channel 'ecg_chn' (<0: none) of the opened device, their events
+ *   are sent on the IP port.
+ * @return 0 on success, -1 on failure
+*/
+int32_t tmsw_set_detectors(int32_t rsp_chn, int32_t ecg_chn);
+
 void tmsw_notify_on_switch();
 
 void tmsw_stop_notifying();
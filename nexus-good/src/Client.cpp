@@ -30,81 +30,99 @@ THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <poll.h>
+#include <time.h>
 #include <assert.h>
-#include <sstream>
 #include <errno.h>
 #include <iostream>
+#include <algorithm>
 #include <string.h>
 #include "Client.h"
 #include "Exception.h"
 
+#define CLIENT_BUFFER_SIZE (4096)     // initial receive buffer per connection
+#define CLIENT_MAX_MESSAGE (1<<20)    // longest message accepted
+#define CLIENT_MAX_EVENTS  (16)       // events handled per epoll_wait()
+#define CLIENT_MIN_BACKOFF (0.1)      // first reconnect delay [s]
+#define CLIENT_MAX_BACKOFF (5.0)      // longest reconnect delay [s]
+#define CLIENT_CONNECT_WAIT (1000)    // longest wait for connects in sendMessage() [ms]
+
 using namespace std;
 
+// monotonic time [s]
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
 Client::Client(const string & hostName, int port)
-: hasMessage_(false) {
+: epoll_(-1), next_(0), message_(NULL), messageSize_(0), hasMessage_(false) {
 
+  epoll_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_ == -1) {
+    throw Exception("epoll_create1() failed");
+  }
   addConnection(hostName, port);
 }
 
 void Client::addConnection(const std::string & hostName, int port) {
-  ConnectionData connection = { hostName, port, -1, false };
+  ConnectionData connection;
+  connection.hostName = hostName;
+  connection.port = port;
+  connection.socket = -1;
+  connection.connected = connection.connecting = false;
+  connection.retryTime = 0.0;
+  connection.backoff = CLIENT_MIN_BACKOFF;
+  connection.head = connection.scan = connection.tail = 0;
   connections_.push_back(connection);
   connectAll();
 }
 
 bool Client::hasMessage() {
-  if (!hasMessage_) {
-    connectAll();
-
-    bool retrying = false;
-    vector<ConnectionData>::iterator i = connections_.begin();
-    while (i != connections_.end()) {
-      if (i->connected) {
-        fd_set socketList;
-        struct timeval zeroWait = {0, 0};
-
-        FD_ZERO(&socketList);
-        FD_SET(i->socket, &socketList);
-
-        int result = select(i->socket + 1, &socketList, NULL, NULL, &zeroWait);
-        if (result < 0) {
-          throw Exception("select() failed");
-        }
-        if (result > 0) {
-          readMessage(*i);
-          if (hasMessage_) {
-            retrying = false;
-          } else {
-            retrying = !retrying;
-            if (retrying) {
-              connectAll();
-            }
-          }
-        }
-        if (!retrying) {
-          ++i;
-        }
-        retrying = false;
-      } else {
-        ++i;
-      }
-    }
+  if (nextMessage()) {
+    return true;
   }
-  return hasMessage_;
+  connectAll();
+  waitForEvents(0);
+  return nextMessage();
 }
 
 string Client::getMessage() {
-  while (!hasMessage()) {
-    waitForAnyReadableSocket();
+  const char * message;
+  size_t length = getMessage(&message);
+  return string(message, length);
+}
+
+size_t Client::getMessage(const char ** message) {
+  while (!nextMessage()) {
+    connectAll();
+    waitForEvents(retryTimeout());
   }
   assert(hasMessage_);
   hasMessage_ = false;
-  return message_;
+  *message = message_;
+  return messageSize_;
+}
+
+size_t Client::getMessages(MessageHandler handler, void * arg) {
+  size_t n = 0;
+  while (!nextMessage()) {
+    connectAll();
+    waitForEvents(retryTimeout());
+  }
+  // the messages stay in place until the next read of their connection
+  do {
+    hasMessage_ = false;
+    handler(arg, message_, messageSize_);
+    n++;
+  } while (nextMessage());
+  return n;
 }
 
 Client::~Client() {
@@ -112,38 +130,109 @@ Client::~Client() {
        i != connections_.end();
        ++i)
   {
-    close(i->socket);
+    if (i->socket != -1) {
+      close(i->socket);
+    }
   }
+  close(epoll_);
 }
 
 void Client::connectAll() {
-  for (vector<ConnectionData>::iterator i = connections_.begin();
-       i != connections_.end();
-       ++i)
-  {
-    if (!i->connected) {
-      unsigned long address = lookupAddress(i->hostName);
-      struct sockaddr_in sinRemote;
-      sinRemote.sin_family = AF_INET;
-      sinRemote.sin_port = htons((u_short) i->port);
-      sinRemote.sin_addr.s_addr = address;
-      i->socket = socket(AF_INET, SOCK_STREAM, 0);
-      if (i->socket == -1) {
-        throw Exception("Socket creation failed");
+  double t = -1.0;
+  for (size_t i = 0; i < connections_.size(); i++) {
+    ConnectionData & connection = connections_[i];
+    if (!connection.connected && !connection.connecting) {
+      if (t < 0.0) {
+        t = now();
       }
-      int result = -1;
-      while (result<0) {
-        result = ::connect(i->socket, (struct sockaddr *) &sinRemote, sizeof(sinRemote));
-        if (result<0) {
-          cout << "# Client: connection to " << i->hostName << ":" << i->port << " failed!" << endl;
-          usleep(5*1000*1000);
-        }
+      if (t >= connection.retryTime) {
+        startConnect(connection, i);
       }
-      if (result < 0) {
-        close(i->socket);
-       } else {
-        cout << "# Client: connected to " << i->hostName << ":" << i->port << endl;
-        i->connected = true;
+    }
+  }
+}
+
+/* start a non-blocking connect, it completes when the socket gets writable
+ */
+void Client::startConnect(ConnectionData & connection, unsigned int index) {
+  unsigned long address = lookupAddress(connection.hostName);
+  if (address == INADDR_NONE) {
+    fail(connection, "Can't resolve host name");
+    return;
+  }
+  struct sockaddr_in sinRemote;
+  memset(&sinRemote, 0, sizeof(sinRemote));
+  sinRemote.sin_family = AF_INET;
+  sinRemote.sin_port = htons((u_short) connection.port);
+  sinRemote.sin_addr.s_addr = address;
+  connection.socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (connection.socket == -1) {
+    throw Exception("Socket creation failed");
+  }
+
+  int result = ::connect(connection.socket, (struct sockaddr *) &sinRemote, sizeof(sinRemote));
+  if (result < 0 && errno != EINPROGRESS) {
+    fail(connection, "Connection failed");
+    return;
+  }
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = (result == 0) ? EPOLLIN : EPOLLOUT;
+  event.data.u32 = index;
+  if (epoll_ctl(epoll_, EPOLL_CTL_ADD, connection.socket, &event) == -1) {
+    throw Exception("epoll_ctl() failed");
+  }
+  connection.connecting = true;
+  if (result == 0) {
+    finishConnect(connection);
+  }
+}
+
+void Client::finishConnect(ConnectionData & connection) {
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(connection.socket, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0) {
+    fail(connection, "Connection failed");
+    return;
+  }
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u32 = &connection - &connections_[0];
+  if (epoll_ctl(epoll_, EPOLL_CTL_MOD, connection.socket, &event) == -1) {
+    throw Exception("epoll_ctl() failed");
+  }
+  cout << "# Client: connected to " << connection.hostName << ":" << connection.port << endl;
+  connection.connecting = false;
+  connection.connected = true;
+  connection.backoff = CLIENT_MIN_BACKOFF;
+}
+
+// wait at most 'timeout' ms until all connects in progress have finished
+void Client::waitForConnects(int timeout)
+{
+  double end = now() + timeout / 1000.0;
+  for (;;) {
+    vector<struct pollfd> pfd;
+    vector<size_t> index;
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      if (connections_[i].connecting) {
+        struct pollfd p = { connections_[i].socket, POLLOUT, 0 };
+        pfd.push_back(p);
+        index.push_back(i);
+      }
+    }
+    double left = end - now();
+    if (pfd.empty() || left <= 0.0) {
+      return;
+    }
+    int result = poll(&pfd[0], pfd.size(), (int)(left * 1000.0) + 1);
+    if (result < 0 && errno != EINTR) {
+      return;
+    }
+    for (size_t i = 0; result > 0 && i < pfd.size(); ++i) {
+      if (pfd[i].revents != 0) {
+        finishConnect(connections_[index[i]]);
       }
     }
   }
@@ -151,12 +240,28 @@ void Client::connectAll() {
 
 void Client::sendMessage(char * message)
 {
+  size_t length = strlen(message);
+  // connects are non-blocking: (re)connect and give them time to finish
+  connectAll();
+  waitForConnects(CLIENT_CONNECT_WAIT);
   for (vector<ConnectionData>::iterator i = connections_.begin();
        i != connections_.end();
        ++i)
   {
-    if (i->connected) {
-	write(i->socket, message, strlen(message));
+    size_t sent = 0;
+    while (i->connected && sent < length) {
+      ssize_t result = write(i->socket, message + sent, length - sent);
+      if (result >= 0) {
+        sent += result;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // the socket is non-blocking: wait until the server reads
+        struct pollfd pfd = { i->socket, POLLOUT, 0 };
+        if (poll(&pfd, 1, 1000) <= 0) {
+          fail(*i, "Send timeout");
+        }
+      } else if (errno != EINTR) {
+        fail(*i, "Socket write error");
+      }
     }
   }
 }
@@ -167,83 +272,148 @@ unsigned long Client::lookupAddress(const string & hostName)
   if (nRemoteAddr == INADDR_NONE)
   {
     /* hostname isn't a dotted IP, so resolve it through DNS */
-    struct hostent * hostentPtr = gethostbyname(hostName.c_str());
-    if (NULL == hostentPtr)
+    struct addrinfo hints;
+    struct addrinfo * info = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(hostName.c_str(), NULL, &hints, &info) == 0 && info != NULL)
     {
-      nRemoteAddr = INADDR_NONE;
+      nRemoteAddr = ((struct sockaddr_in *) info->ai_addr)->sin_addr.s_addr;
     }
-    else
+    if (info != NULL)
     {
-      nRemoteAddr = *((u_long*)hostentPtr->h_addr_list[0]);
+      freeaddrinfo(info);
     }
   }
   return nRemoteAddr;
 }
 
+/* close 'connection' and try again after the backoff delay, which doubles
+ * on every failure in a row
+ */
 void Client::fail(ConnectionData & connection, const string & errorMsg) {
-  cout << "# Error Client: " << errorMsg << " for " << connection.hostName << ":" << connection.port << endl;
-  close(connection.socket);
-  connection.connected = false;
-  connectAll();
+  if (connection.connected) {
+    cout << "# Error Client: " << errorMsg << " for " << connection.hostName << ":" << connection.port << endl;
+  } else {
+    cout << "# Client: connection to " << connection.hostName << ":" << connection.port 
+         << " failed, retry in " << connection.backoff << " [s]" << endl;
+  }
+  if (connection.socket != -1) {
+    close(connection.socket);
+    connection.socket = -1;
+  }
+  connection.connected = connection.connecting = false;
+  connection.head = connection.scan = connection.tail = 0;
+  connection.retryTime = now() + connection.backoff;
+  connection.backoff = min(2.0 * connection.backoff, CLIENT_MAX_BACKOFF);
 }
 
-void Client::waitForAnyReadableSocket()
-{
-  fd_set socketList;
-  FD_ZERO(&socketList);
-  struct timeval oneSecond = {1, 0};
-  int maxFd = 0;
-  bool notAllConnected = false;
+/* time until the first reconnect attempt [ms], -1 when all connections are up
+ */
+int Client::retryTimeout() {
+  double first = -1.0;
   for (vector<ConnectionData>::iterator i = connections_.begin();
        i != connections_.end();
        ++i)
   {
-    if (i->connected) {
-      FD_SET(i->socket, &socketList);
-      maxFd = max(maxFd, i->socket);
-    } else {
-      notAllConnected = true;
+    if (!i->connected && !i->connecting && (first < 0.0 || i->retryTime < first)) {
+      first = i->retryTime;
     }
   }
+  if (first < 0.0) {
+    return -1;
+  }
+  return max(0, (int) (1000.0 * (first - now())) + 1);
+}
 
-  int result = select(maxFd + 1, &socketList, NULL, NULL, notAllConnected ? &oneSecond : NULL);
-  if (result < 0) {
-    throw Exception("select() failed");
+/* wait at most 'timeout' [ms] for events on any connection and handle them all:
+ * completed connects and one read per readable connection
+ */
+void Client::waitForEvents(int timeout)
+{
+  struct epoll_event events[CLIENT_MAX_EVENTS];
+
+  int n = epoll_wait(epoll_, events, CLIENT_MAX_EVENTS, timeout);
+  if (n < 0) {
+    if (errno == EINTR) {
+      return;
+    }
+    throw Exception("epoll_wait() failed");
+  }
+  for (int k = 0; k < n; k++) {
+    ConnectionData & connection = connections_[events[k].data.u32];
+    if (connection.connecting) {
+      finishConnect(connection);
+    } else if (connection.connected) {
+      readMessage(connection);
+    }
   }
 }
 
 void Client::readMessage(ConnectionData & connection) {
-  char header[7];
-  int result = read(connection.socket, header, 6);
-  header[6] = 0;
-  if (result == 6) {
-    if (header[0] != '0' || header[1] != 'x') {
-      fail(connection, "Invalid header received");
-    }
-    istringstream headerStream(header + 2);
-    int length;
-    headerStream >> hex >> length;
-    char *buffer = new char[length];
-    int bytesRead = 0;
-    while (bytesRead < length) {
-      result = read(connection.socket, buffer + bytesRead, length - bytesRead);
-      if (result == 0) {
-        fail(connection, "Connection closed unexpectedly");
-      } else if (result < 0) {
-        fail(connection, "Socket read error");
-      }
-      bytesRead += result;
+  vector<char> & input = connection.input;
+
+  // drop the messages that were read, this invalidates the last message
+  if (connection.head > 0) {
+    memmove(&input[0], &input[connection.head], connection.tail - connection.head);
+    connection.tail -= connection.head;
+    connection.scan -= connection.head;
+    connection.head = 0;
+  }
+  // grow the buffer when a single message fills it
+  if (connection.tail == input.size()) {
+    if (input.size() >= CLIENT_MAX_MESSAGE) {
+      fail(connection, "Message too long");
+      return;
     }
-    message_ = string(buffer, length);
-    hasMessage_ = true;
-    delete[] buffer;
-  } else {
-    if (result < 0) {
+    input.resize(input.empty() ? CLIENT_BUFFER_SIZE : 2 * input.size());
+  }
+
+  ssize_t result = read(connection.socket, &input[connection.tail], input.size() - connection.tail);
+  if (result < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
       fail(connection, "Socket read error");
-    } else if (result == 0) {
-      fail(connection, "Server closed connection");
-    } else {
-      fail(connection, "Received incomplete header");
+    }
+  } else if (result == 0) {
+    fail(connection, "Server closed connection");
+  } else {
+    connection.tail += result;
+  }
+}
+
+/* make the first complete line in the receive buffer of 'connection' the 
+ * current message, the bytes before 'scan' are not searched again
+ */
+bool Client::frameMessage(ConnectionData & connection) {
+  if (connection.scan >= connection.tail) {
+    return false;
+  }
+  char * begin = &connection.input[0];
+  char * newline = (char *) memchr(begin + connection.scan, '\n', connection.tail - connection.scan);
+  if (newline == NULL) {
+    connection.scan = connection.tail;
+    return false;
+  }
+  message_ = begin + connection.head;
+  messageSize_ = newline + 1 - message_;
+  connection.head = connection.scan = newline + 1 - begin;
+  hasMessage_ = true;
+  return true;
+}
+
+/* take the next message that was already received, the connections take
+ * turns so a busy one doesn't starve the others
+ */
+bool Client::nextMessage() {
+  for (size_t k = 0; !hasMessage_ && k < connections_.size(); k++) {
+    ConnectionData & connection = connections_[next_];
+    if (++next_ >= connections_.size()) {
+      next_ = 0;
+    }
+    if (connection.connected) {
+      frameMessage(connection);
     }
   }
+  return hasMessage_;
 }
@@ -37,6 +37,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <cstdlib>
 
 #include "Server.h"
 #include "Exception.h"
@@ -135,7 +136,7 @@ Server::Server(int port) {
   cout << "# Server: now listing on port " << port << endl;
 }
 
-void Server::sendMessage(const string & message) {
+void Server::poll() {
   socket_t clientSocket = INVALID_SOCKET;
   do {
     struct sockaddr_in clientAddr;
@@ -153,6 +154,9 @@ void Server::sendMessage(const string & message) {
       }
     } else {
       clientSockets_.push_back(clientSocket);
+      clientRequests_.push_back("");
+      clientInput_.push_back("");
+      clientEof_.push_back(false);
       cout << "# Server: new connection from ";
       for (int i = 0; i < 4; i++) {
         cout << (clientAddr.sin_addr.s_addr & 0xFF) << (i == 3 ? ":" : ".");
@@ -162,24 +166,115 @@ void Server::sendMessage(const string & message) {
     }
   } while (clientSocket != INVALID_SOCKET);
 
-  ostringstream protocolMessageStream;
-  //protocolMessageStream << "0x" << hex << setw(4) << setfill('0') << message.size() << message;
-  protocolMessageStream << message;
-  string protocolMessage = protocolMessageStream.str();
-
-  for (size_t i = 0; i != clientSockets_.size(); i++) {
+  /* read request lines without waiting */
+  char buf[256];
+  for (size_t i = 0; i < clientSockets_.size(); i++) {
+    if (clientEof_[i]) {
+      continue;
+    }
 #ifdef _MSC_VER
-    // yeah, windows is rather braindead
-    if (protocolMessage.size()>_UI32_MAX) {
-      throw Exception("Protocolmessage size is too big!\n");
+    int n = recv(clientSockets_[i], buf, sizeof(buf), 0);
+#else
+    int n = recv(clientSockets_[i], buf, sizeof(buf), MSG_DONTWAIT);
+#endif
+    if (n == 0) {
+      /* the subscriber sends no more requests, it still gets its stream */
+      clientEof_[i] = true;
+      continue;
+    }
+    if (n < 0) {
+      continue;
+    }
+    clientInput_[i].append(buf, n);
+    size_t eol;
+    while ((eol = clientInput_[i].find('\n')) != string::npos) {
+      string line = clientInput_[i].substr(0, eol);
+      clientInput_[i].erase(0, eol + 1);
+      clientRequests_[i] = parseRequest(line);
+      cout << "# Server: request '" << clientRequests_[i] << "' of connection " << i << endl;
+    }
+    if (clientInput_[i].size() > sizeof(buf)) {
+      clientInput_[i].clear();
+    }
+  }
+}
+
+string Server::parseRequest(const string & line) {
+  istringstream in(line);
+  string cmd, token;
+  set<string> rates;
+
+  in >> cmd;
+  if (cmd != "rate") {
+    cout << "# Server: unknown request '" << line << "'" << endl;
+    return "";
+  }
+  /* sorted 'X<hz>' tokens, so equal requests share a stream */
+  while (in >> token) {
+    if ((token.size() > 1) && (token[0] >= 'A') && (token[0] <= 'Z') && (atof(token.c_str()+1) > 0.0)) {
+      rates.insert(token);
+    } else {
+      cout << "# Server: can't understand rate '" << token << "'" << endl;
     }
+  }
+  string request;
+  for (set<string>::const_iterator it = rates.begin(); it != rates.end(); ++it) {
+    if (!request.empty()) request += " ";
+    request += *it;
+  }
+  return request;
+}
+
+set<string> Server::requests() const {
+  return set<string>(clientRequests_.begin(), clientRequests_.end());
+}
+
+bool Server::sendTo(size_t i, const string & message) {
+  return sendTo(i, message.data(), message.size());
+}
+
+bool Server::sendTo(size_t i, const char * message, size_t size) {
+#ifdef _MSC_VER
+  // yeah, windows is rather braindead
+  if (size>_UI32_MAX) {
+    throw Exception("Protocolmessage size is too big!\n");
+  }
 #endif
-    size_t result = send(clientSockets_[i], protocolMessage.c_str(), (unsigned int) protocolMessage.size(),0);
-    if (result != protocolMessage.size()) {
-      closesocket(clientSockets_[i]);
-      clientSockets_.erase(clientSockets_.begin() + i);
+  size_t result = send(clientSockets_[i], message, (unsigned int) size,0);
+  if (result != size) {
+    drop(i);
+    return false;
+  }
+  return true;
+}
+
+void Server::drop(size_t i) {
+  closesocket(clientSockets_[i]);
+  clientSockets_.erase(clientSockets_.begin() + i);
+  clientRequests_.erase(clientRequests_.begin() + i);
+  clientInput_.erase(clientInput_.begin() + i);
+  clientEof_.erase(clientEof_.begin() + i);
+  cout << "# Server: connection dropped" << endl;
+}
+
+void Server::sendMessage(const string & message) {
+  sendMessage(message.data(), message.size());
+}
+
+void Server::sendMessage(const char * message, size_t size) {
+  poll();
+
+  for (size_t i = 0; i != clientSockets_.size(); i++) {
+    if (!sendTo(i, message, size)) {
+      i--;
+    }
+  }
+}
+
+void Server::sendMessage(const string & request, const string & message) {
+  for (size_t i = 0; i != clientSockets_.size(); i++) {
+    if ((clientRequests_[i] == request) && !sendTo(i, message)) {
       i--;
-      cout << "# Server: connection dropped" << endl;
     }
   }
 }
@@ -132,7 +132,7 @@ void sig_handler(int32_t sig)  {
   fprintf(stdout,"# Stop grabbing with signal %d\n",sig);
   tms_shutdown();
   /* close bluetooth socket */
-  tms_close_port();
+  tms_close_port(-1);
   tms_close_log();
   exit(sig);
 }
@@ -259,7 +259,7 @@ int32_t main(int32_t argc, char *argv[]) {
   /* shutdown bluetooth capture */
   tms_shutdown();
   /* close bluetooth socket */
-  tms_close_port();
+  tms_close_port(fd);
   /* close log file */
   tms_close_log();
 
@@ -4,7 +4,7 @@
  *
  * $Id:  $
  *
- * @brief Decode Poly5/TMS32 sample file to simple text.
+ * @brief Decode Poly5/TMS32 sample file to simple text, BDF+ or float32.
  *
  * $Log: $
 
@@ -48,15 +48,19 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <math.h>
 #include "tmsi.h"
 
-#define VERSION "$Revision: 0.1 $"
+#define VERSION "$Revision: 0.2 $"
 
 #define INDEF         "test1.s00"  /**< default input file */
 #define TMS32HDRSIZE        (218)  /**< Poly5/TMS32 header size [byte] */
 #define TMS32VERSION        (204)  /**< Poly5/TMS32 version nr */
 #define TMS32DESCSIZE       (136)  /**< Poly5/TMS32 channel description size [byte] */
 #define TMS32BLKHDRSIZE      (86)  /**< Poly5/TMS32 block header size [byte] */
+#define BDFDIGMIN      (-(1<<23))  /**< BDF digital minimum */
+#define BDFDIGMAX       ((1<<23)-1) /**< BDF digital maximum */
+#define BLKTIMETOL          (2.0)  /**< block time deviation change that is annotated [s] */
 
 static int32_t dbg = 0x0000;
 static int32_t vb  = 0x0000;
@@ -68,10 +72,12 @@ int32_t tms32_rd_intro(FILE *fp) {
   
   int32_t nc=0;
   
-  nc+=fprintf(fp,"Convert Poly5/TMS32 sample file to text: %s\n",VERSION);
-  nc+=fprintf(fp,"Usage: tms32_rd [-i <in>] [-o <out>] [-c <chn>] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"Convert Poly5/TMS32 sample file to text, BDF or float32: %s\n",VERSION);
+  nc+=fprintf(fp,"Usage: tms32_rd [-i <in>] [-o <out>] [-b <bdf>] [-f <f32>] [-c <chn>] [-v <vb>] [-d <dbg>] [-h]\n");
   nc+=fprintf(fp,"in   : Poly5/TMS32 sample file (default=%s)\n",INDEF);
-  nc+=fprintf(fp,"out  : text output file (default=<in>.txt)\n");
+  nc+=fprintf(fp,"out  : text output file (default=<in>.txt when neither <bdf> nor <f32> is given)\n");
+  nc+=fprintf(fp,"bdf  : BDF+ output file: calibrated 24 bits samples, one record per block\n");
+  nc+=fprintf(fp,"f32  : binary output file: calibrated little endian float32, one row per sample\n");
   nc+=fprintf(fp,"h    : show this manual page\n");
   nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
   nc+=fprintf(fp,"  0x01 : show header info\n");
@@ -83,13 +89,14 @@ int32_t tms32_rd_intro(FILE *fp) {
 }
 
 /** reads the options from the command line */
-static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname) {
+static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname,
+  char *bname, char *fname32) {
 
   int32_t i;
   char   *cp;          /**< character pointer */
   char   fname[MNCN];  /**< temp file output name */
  
-  strcpy(iname, INDEF); strcpy(oname,"");
+  strcpy(iname, INDEF); strcpy(oname,""); strcpy(bname,""); strcpy(fname32,"");
   
   for (i=1; i<argc; i++) {
     if (argv[i][0]!='-') {
@@ -98,6 +105,8 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname) {
       switch (argv[i][1]) {
         case 'i': strcpy(iname,argv[++i]); break;
         case 'o': strcpy(oname,argv[++i]); break;
+        case 'b': strcpy(bname,argv[++i]); break;
+        case 'f': strcpy(fname32,argv[++i]); break;
         case 'v': vb=strtol(argv[++i],NULL,0); break;
         case 'd': dbg=strtol(argv[++i],NULL,0); break;
         case 'h': tms32_rd_intro(stderr); exit(0);
@@ -112,18 +121,132 @@ static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname) {
   if ((cp=strstr(fname,".S00"))!=NULL) { *cp='\0'; }
 
   /* make 'oname' out of 'iname' without extension */
-  if (strlen(oname)<1) {
+  if ((strlen(oname)<1) && (strlen(bname)<1) && (strlen(fname32)<1)) {
     sprintf(oname,"%s.txt",fname);
   }
 } 
 
+/** Convert the 'np' sample periods of 'nrc' signals in block 'blk' into 'y' 
+ *   (np rows of nrc values) with 'y=a*x+b' per signal, where 'x' is the 
+ *   stored sample of 'size' bytes, and count the zero samples in 'zero'.
+ * @return number of bytes converted
+ */
+static int32_t blk_convert(const uint8_t *blk, int32_t np, int32_t nrc, const int32_t *size,
+  const float *a, const float *b, float *y, int32_t *zero) {
+
+  int32_t i,k;
+  int32_t bidx=0;
+  int32_t all4=1;     /**< all samples are float32 */
+  float   x;
+  int16_t w;
+
+  for (i=0; i<nrc; i++) { all4 = all4 && (size[i]==4); }
+  if (all4) {
+    /* block is a float32 matrix: copy it and scale rows in place */
+    memcpy(y,blk,(size_t)np*nrc*sizeof(float));
+    for (k=0; k<np; k++, y+=nrc) {
+      for (i=0; i<nrc; i++) {
+        zero[i]+=(y[i]==0.0f);
+        y[i]=a[i]*y[i]+b[i];
+      }
+    }
+    return(np*nrc*4);
+  }
+  for (k=0; k<np; k++, y+=nrc) {
+    for (i=0; i<nrc; i++) {
+      if (size[i]==4) {
+        memcpy(&x,&blk[bidx],4); bidx+=4;
+      } else {
+        memcpy(&w,&blk[bidx],2); bidx+=2; x=w;
+      }
+      zero[i]+=(x==0.0f);
+      y[i]=a[i]*x+b[i];
+    }
+  }
+  return(bidx);
+}
+
+/** Pack 'np' rows of 'nrc' digital values 'd' as one BDF record in 'rec'
+ *   signal after signal, followed by annotation 'annot' of ANNOTRECSIZE bytes.
+ * @return number of bytes in 'rec'
+ */
+static int32_t bdf_record(uint8_t *rec, const float *d, int32_t np, int32_t nrc, const char *annot) {
+
+  uint8_t *p=rec;
+  int32_t  i,k,v;
+
+  for (i=0; i<nrc; i++) {
+    for (k=0; k<np; k++) {
+      v=(int32_t)lrintf(d[k*nrc+i]);
+      if (v<BDFDIGMIN) { v=BDFDIGMIN; } else if (v>BDFDIGMAX) { v=BDFDIGMAX; }
+      *p++=(uint8_t)(v); *p++=(uint8_t)(v>>8); *p++=(uint8_t)(v>>16);
+    }
+  }
+  memcpy(p,annot,ANNOTRECSIZE); p+=ANNOTRECSIZE;
+  return((int32_t)(p-rec));
+}
+
+/** Write BDF+ headers of 'nrc' signals 'chn' with 'np' samples per record of 
+ *   'dt' [s] and an annotation signal to file 'fp'.
+ * @return bytes written to 'fp'
+*/
+static int32_t bdf_header(FILE *fp, const tms_hdr32_t *hdr, const tms_signal_desc32_t *chn,
+  int32_t nrc, int32_t np, double dt) {
+
+  edfMainHdr_t    mHdr;
+  edfSignalHdr_t *sHdr;
+  char    tmp[128];
+  char    pid[MNCN];
+  time_t  t=hdr->startTime;
+  int32_t i,nc;
+
+  sHdr=(edfSignalHdr_t *)calloc(nrc+1,sizeof(edfSignalHdr_t));
+  if (sHdr==NULL) { return(-1); }
+  snprintf(pid,sizeof(pid),"X X X X %.60s",hdr->measurement);
+  edfFillMainHdr(&mHdr,1,pid,"Startdate X X X Poly5/TMS32","",&t,
+    hdr->nrOfBlocks,dt,nrc+1);
+  /* BDF+ continuous with annotation signal */
+  sprintf(tmp,"%-44s","BDF+C"); memcpy(mHdr.DataFormatVersion,tmp,44);
+  for (i=0; i<nrc; i++) {
+    /* the ADC range maps to the digital range */
+    edfFillSignalHdr(&sHdr[i],chn[i].signalName,"",(char *)chn[i].unitName,
+      chn[i].unitLow,chn[i].unitHigh,BDFDIGMIN,BDFDIGMAX,"",np);
+  }
+  edfFillSignalHdr(&sHdr[nrc],"BDF Annotations","","",
+    -1,1,BDFDIGMIN,BDFDIGMAX,"",ANNOTRECSIZE/3);
+  nc=edfWriteHeaders(fp,&mHdr,sHdr,nrc+1);
+  free(sHdr);
+  return(nc);
+}
+
+/** Fill BDF+ annotation 'annot' of ANNOTRECSIZE bytes with the time keeping
+ *   annotation 'ts' and, when 'then' isn't empty, the block creation time.
+ * @return number of used bytes
+ */
+static int32_t bdf_annot(char *annot, double ts, const char *then) {
+
+  int32_t nc;
+
+  memset(annot,0,ANNOTRECSIZE);
+  nc=snprintf(annot,ANNOTRECSIZE,"+%.6f%c%c%c",ts,20,20,'\0');
+  if (strlen(then)>0) {
+    nc+=snprintf(&annot[nc],ANNOTRECSIZE-nc,"+%.6f%c%s%c%c",ts,20,then,20,'\0');
+  }
+  return(nc);
+}
+
 /** main */
 int32_t main(int32_t argc, char *argv[]) {
 
   char iname[MNCN];         /**< input file name */
   FILE   *fpi=NULL;         /**< input file pointer */
-  char oname[MNCN];         /**< output ECG file name */
-  FILE   *fpo=NULL;         /**< ecg file pointer */
+  char oname[MNCN];         /**< output text file name */
+  FILE   *fpo=NULL;         /**< text file pointer */
+  edf_fmt_t *txt=NULL;      /**< text buffer of 'fpo' */
+  char bname[MNCN];         /**< output BDF file name */
+  FILE   *fpb=NULL;         /**< BDF file pointer */
+  char fname32[MNCN];       /**< output float32 file name */
+  FILE   *fpf=NULL;         /**< float32 file pointer */
   uint8_t hdr_buf[TMS32HDRSIZE];   /**< header byte buffer */
   tms_hdr32_t hdr;          /**< Poly5/TMS32 sample file header */
   int64_t br,bp;            /**< number of bytes read/parsed */
@@ -131,17 +254,26 @@ int32_t main(int32_t argc, char *argv[]) {
   int32_t i,j,k;            /**< general index */
   uint8_t *desc_buf=NULL;   /**< Poly5/TMS32 channel description buffer */
   tms_signal_desc32_t *desc=NULL;   /**< Poly5/TMS32 channel descriptions */
-  float   sample;              /**< sample value as float */  
-  float   value;            /**< sample value after calibration */
-  uint8_t blk_hdr[TMS32BLKHDRSIZE]; /**< Poly5/TMS32 block header */
-  uint8_t *blk;             /**< Poly5/TMS32 block */
+  uint8_t *blk;             /**< Poly5/TMS32 block header and data */
+  int32_t np;               /**< sample periods in a block */
+  int32_t *size=NULL;       /**< sample size per signal */
+  int32_t *zero=NULL;       /**< zero sample count per signal */
+  float   *ua=NULL,*ub=NULL;  /**< unit scale and offset per signal */
+  float   *da=NULL,*db=NULL;  /**< BDF digital scale and offset per signal */
+  float   *y=NULL;          /**< calibrated block: np rows of nrc values */
+  uint8_t *rec=NULL;        /**< BDF record */
+  char    annot[ANNOTRECSIZE]; /**< BDF+ annotation of a record */
+  char    then[MNCN];       /**< block creation time */
+  double  ts;               /**< start of block [s] */
+  double  dev,dev0=0.0;     /**< block time deviation, last annotated deviation [s] */
+  int32_t rec_cnt=0;        /**< BDF record counter */
   int32_t cnt=0;            /**< sample counter */
   char    *cpl,*cph;        /**< (Lo) and (Hi) character pointers */
   int32_t nrc=0;            /**< number of real channels */
   tms_signal_desc32_t *chn; /**< signal channel info */
   tms_block_desc32_t blk_desc;      /**< block creation info */
   
-  parse_cmd(argc,argv,iname,oname);
+  parse_cmd(argc,argv,iname,oname,bname,fname32);
     
   /* open config file */
   fprintf(stderr,"# Read Poly5/TMS32 TMSi samples from file %s\n",iname); 
@@ -233,58 +365,114 @@ int32_t main(int32_t argc, char *argv[]) {
       tms_prt_desc32(stderr,&chn[i],(i==0));
     }
   }
- /* open output text file */  
-  fprintf(stderr,"# Write TMSi measurement samples to text file %s\n",oname);
-  if (strcmp(oname,"stdout")==0) { fpo=stdout; } else { fpo=fopen(oname,"w"); }
-  if (fpo==NULL) {
-    perror(""); exit(1);
+  /* per signal calibration: 'y=a*x+b' maps ADC range to unit or digital range */
+  size=(int32_t *)calloc(nrc,sizeof(int32_t));
+  zero=(int32_t *)calloc(2*nrc,sizeof(int32_t));
+  ua=(float *)calloc(4*nrc,sizeof(float)); ub=ua+nrc; da=ub+nrc; db=da+nrc;
+  for (i=0; i<nrc; i++) {
+    size[i]=chn[i].sampleSize;
+    if (chn[i].ADCHigh!=chn[i].ADCLow) {
+      ua[i]=(chn[i].unitHigh-chn[i].unitLow)/(chn[i].ADCHigh-chn[i].ADCLow);
+      da[i]=(1.0*BDFDIGMAX-BDFDIGMIN)/(chn[i].ADCHigh-chn[i].ADCLow);
+    } else {
+      fprintf(stderr,"# Warning: signal %s has no ADC range\n",chn[i].signalName);
+      ua[i]=1.0; da[i]=1.0;
+    }
+    ub[i]=chn[i].unitLow-chn[i].ADCLow*ua[i];
+    db[i]=BDFDIGMIN-chn[i].ADCLow*da[i];
+  }
+  
+  /* sample periods per block follow from the block size */
+  bidx=0;
+  for (i=0; i<nrc; i++) { bidx+=size[i]; }
+  np=(bidx>0) ? hdr.blockSize/bidx : 0;
+  if ((np<1) || (np*bidx!=hdr.blockSize)) {
+    fprintf(stderr,"# Error: block size %d isn't a multiple of %d bytes per sample period\n",
+      hdr.blockSize,bidx);
+    return(-1);
   }
- 
-  /* allocate block buffer */
-  blk=(uint8_t *)calloc(hdr.blockSize,sizeof(uint8_t));
 
-  /* print output header */
-  fprintf(fpo,"# %9s ","t[s]");
-  for (i=0; i<nrc; i++) {
-    fprintf(fpo," %7s[%s]",chn[i].signalName,chn[i].unitName);
+  if (strlen(oname)>0) {
+    /* open output text file */  
+    fprintf(stderr,"# Write TMSi measurement samples to text file %s\n",oname);
+    if (strcmp(oname,"stdout")==0) { fpo=stdout; } else { fpo=fopen(oname,"w"); }
+    if (fpo==NULL) {
+      perror(""); exit(1);
+    }
+    /* print output header */
+    fprintf(fpo,"# %9s ","t[s]");
+    for (i=0; i<nrc; i++) {
+      fprintf(fpo," %7s[%s]",chn[i].signalName,chn[i].unitName);
+    }
+    fprintf(fpo,"\n");
+    txt=edf_fmt_new(fpo,0);
+  }
+  if (strlen(bname)>0) {
+    fprintf(stderr,"# Write TMSi measurement samples to BDF file %s\n",bname);
+    if ((fpb=fopen(bname,"wb"))==NULL) {
+      perror(""); exit(1);
+    }
+    bdf_header(fpb,&hdr,chn,nrc,np,1.0*np/hdr.sampleRate);
+    rec=(uint8_t *)malloc(3*np*nrc+ANNOTRECSIZE);
   }
-  fprintf(fpo,"\n");
+  if (strlen(fname32)>0) {
+    fprintf(stderr,"# Write TMSi measurement samples to float32 file %s\n",fname32);
+    if ((fpf=fopen(fname32,"wb"))==NULL) {
+      perror(""); exit(1);
+    }
+  }
+ 
+  /* allocate block buffer: header and data are read at once */
+  blk=(uint8_t *)calloc(TMS32BLKHDRSIZE+hdr.blockSize,sizeof(uint8_t));
+  y=(float *)calloc(np*nrc,sizeof(float));
   
   j=0; cnt=0;
-  while ((!feof(fpi)) && (j<hdr.nrOfBlocks)) {
-    /* read Poly5/TMS32 block header */
-    br=fread(blk_hdr,1,TMS32BLKHDRSIZE,fpi);
+  while (j<hdr.nrOfBlocks) {
+    /* read Poly5/TMS32 block header and block data */
+    br=fread(blk,1,TMS32BLKHDRSIZE+hdr.blockSize,fpi);
+    if (br<TMS32BLKHDRSIZE+hdr.blockSize) { break; }
     bidx=0;
-    tms_get_blk32(blk_hdr,&bidx,&blk_desc);
+    tms_get_blk32(blk,&bidx,&blk_desc);
 
     if (vb&0x08) {
       tms_prt_blk32(stderr,&blk_desc);
     }
     
-    /* read Poly5/TMS32 block data */
-    br=fread(blk,1,hdr.blockSize,fpi);
-    bidx=0; 
-    while (bidx<hdr.blockSize) {
-      fprintf(fpo," %f",1.0*cnt/hdr.sampleRate);
-      for (i=0; i<nrc; i++) {
-        if (chn[i].sampleSize==4) {
-          sample=tms_get_float32(blk,&bidx);
-        } else {
-          sample=(int16_t)tms_get_int(blk,&bidx,chn[i].sampleSize);
-        }          
-        if (sample==0.0) { 
-          chn[i].zeroCnt++;
+    /* unit values for text and float32 */
+    if ((fpo!=NULL) || (fpf!=NULL)) {
+      blk_convert(&blk[TMS32BLKHDRSIZE],np,nrc,size,ua,ub,y,zero);
+      if (fpf!=NULL) {
+        fwrite(y,sizeof(float),np*nrc,fpf);
+      }
+      for (k=0; (txt!=NULL) && (k<np); k++) {
+        edf_fmt_put_chr(txt,' '); edf_fmt_put_fixed(txt,1.0*(cnt+k)/hdr.sampleRate,0,6);
+        for (i=0; i<nrc; i++) {
+          edf_fmt_put_chr(txt,' '); edf_fmt_put_fixed(txt,y[k*nrc+i],0,6);
         }
-        value=((sample-chn[i].ADCLow)/(chn[i].ADCHigh-chn[i].ADCLow))*(chn[i].unitHigh-chn[i].unitLow)+chn[i].unitLow;
-        fprintf(fpo," %f",value);
+        edf_fmt_put_chr(txt,'\n');
+      }
+    }
+    /* digital values for BDF, block time annotated when it is off */
+    if (fpb!=NULL) {
+      /* zeros are counted once, second half of 'zero' is scratch */
+      blk_convert(&blk[TMS32BLKHDRSIZE],np,nrc,size,da,db,y,((fpo!=NULL)||(fpf!=NULL)) ? zero+nrc : zero);
+      ts=1.0*cnt/hdr.sampleRate;
+      strcpy(then,"");
+      dev=difftime(blk_desc.then,hdr.startTime)-ts;
+      if ((j==0) || (fabs(dev-dev0)>BLKTIMETOL)) {
+        dev0=dev;
+        strftime(then,MNCN,"block time %Y-%m-%dT%H:%M:%S",localtime(&blk_desc.then));
       }
-      fprintf(fpo,"\n");
-      cnt++;
+      bdf_annot(annot,ts,then);
+      fwrite(rec,1,bdf_record(rec,y,np,nrc,annot),fpb);
+      rec_cnt++;
     }
+    cnt+=np;
     j++;
   }
   
   /* show channel zero sample count to stderr */
+  for (i=0; i<nrc; i++) { chn[i].zeroCnt=zero[i]; }
   fprintf(stderr,"# %9s ","Cnt");
   for (i=0; i<nrc; i++) {
     fprintf(stderr," %6s[%s]",chn[i].signalName,chn[i].unitName);
@@ -305,8 +493,20 @@ int32_t main(int32_t argc, char *argv[]) {
          
   /* close input file */
   fclose(fpi);
-  /* close output file */
-  fclose(fpo); 
+  /* close output files */
+  if (fpo!=NULL) { edf_fmt_free(txt); fclose(fpo); }
+  if (fpf!=NULL) { fclose(fpf); }
+  if (fpb!=NULL) {
+    /* seek to 'NrOfDataRecords' position of BDF file */
+    if (fseek(fpb, 236L, SEEK_SET)==0) { 
+      fprintf(fpb,"%-8d",rec_cnt);
+    } else {
+      fprintf(stderr,"# Error: seek problem to set 'NrOfDataRecords' in BDF file\n");
+    }
+    fclose(fpb);
+  }
+  free(blk); free(y); free(rec);
+  free(size); free(zero); free(ua);
 
   return(0);
 }
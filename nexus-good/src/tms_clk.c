@@ -0,0 +1,281 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file tms_clk.c
+ * Online clock model of a device: the host arrival times of sample blocks 
+ *  are fitted against the index of their last sample. The arrivals lag the
+ *  samples by a latency that is at least the transfer time, so only the 
+ *  earliest arrival of every bin of TMSCLKBIN [s] is kept. A robust linear
+ *  regression (Tukey biweight) over a sliding window of bins is lowered to
+ *  a low quantile of its residuals: the latency floor.
+ *  The slope gives the drift between device and host clock, the line maps
+ *  every sample to host time, which aligns the blocks of several devices.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "tmsi.h"
+#include "tms_clk.h"
+
+/** Get host monotonic time
+ * @return time [s]
+*/
+double tms_clk_now() {
+#ifdef _MSC_VER
+  return(get_time());
+#else
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC,&ts)!=0) {
+    return(get_time());
+  }
+  return(ts.tv_sec+1e-9*ts.tv_nsec);
+#endif
+}
+
+/** Make clock model of a device with sample frequency 'fs' [Hz] that fits the
+ *   last 'nw' arrivals, TMSCLKNW when 'nw'<1.
+ * @return pointer to clock model, NULL on failure
+*/
+tms_clk_t *tms_clk_new(double fs, int32_t nw) {
+
+  tms_clk_t *c;
+
+  if (fs<=0.0) {
+    fprintf(stderr,"# Error: clock model needs a sample frequency > 0 not %f!!!\n",fs);
+    return(NULL);
+  }
+  if (nw<1) { nw=TMSCLKNW; }
+  if ((c=(tms_clk_t *)calloc(1,sizeof(tms_clk_t)))==NULL) {
+    fprintf(stderr,"# Error: can't allocate clock model!!!\n");
+    return(NULL);
+  }
+  c->sc=(int64_t *)calloc(nw,sizeof(int64_t));
+  c->ta=(double *)calloc(3*nw,sizeof(double));
+  if ((c->sc==NULL) || (c->ta==NULL)) {
+    fprintf(stderr,"# Error: can't allocate clock model window of %d arrivals!!!\n",nw);
+    tms_clk_free(c);
+    return(NULL);
+  }
+  c->w=c->ta+nw; c->r=c->w+nw;
+  c->fs=fs; c->nw=nw; c->dt=1.0/fs;
+  return(c);
+}
+
+/** Free clock model 'c'
+*/
+void tms_clk_free(tms_clk_t *c) {
+
+  if (c==NULL) { return; }
+  free(c->sc); free(c->ta);
+  free(c);
+}
+
+/** Forget all arrivals of clock model 'c' after a break in the sample index,
+ *   the drift is kept.
+*/
+void tms_clk_break(tms_clk_t *c) {
+
+  c->n=0; c->i=0; c->bn=0;
+}
+
+/** compare doubles for qsort */
+static int dcmp(const void *a, const void *b) {
+
+  double d=*(const double *)a-*(const double *)b;
+
+  return((d>0.0)-(d<0.0));
+}
+
+/** Get quantile 'q' of the 'n' values 'a', 'tmp' of 'n' values is scratch space
+ * @return quantile
+*/
+static double quantile(const double *a, int32_t n, double q, double *tmp) {
+
+  memcpy(tmp,a,n*sizeof(double));
+  qsort(tmp,n,sizeof(double),dcmp);
+  return(tmp[(int32_t)(q*(n-1)+0.5)]);
+}
+
+/** Weighted least squares line y=a+b*x through the 'n' points of 'c' with 
+ *   'x' the sample index and 'y' the arrival time relative to the reference,
+ *   the slope is fixed to 'b' when 'fit' is 0.
+*/
+static void clk_fit(const tms_clk_t *c, int32_t n, int32_t fit, double *a, double *b) {
+
+  double sw=0.0,sx=0.0,sy=0.0,sxx=0.0,sxy=0.0,x,y,d;
+  int32_t k;
+
+  for (k=0; k<n; k++) {
+    x=(double)(c->sc[k]-c->sc0); y=c->ta[k]-c->t0;
+    sw+=c->w[k]; sx+=c->w[k]*x; sy+=c->w[k]*y;
+    sxx+=c->w[k]*x*x; sxy+=c->w[k]*x*y;
+  }
+  if (sw<=0.0) { *a=0.0; return; }
+  d=sw*sxx-sx*sx;
+  if ((fit) && (d>0.0)) {
+    *b=(sw*sxy-sx*sy)/d;
+  }
+  *a=(sy-(*b)*sx)/sw;
+}
+
+/** Refit clock model 'c' on the bins in its window
+*/
+static void clk_refit(tms_clk_t *c) {
+
+  int32_t k,it,fit;
+  int32_t n=c->n;
+  int64_t scmin,scmax;
+  double  a,b,s,u,m;
+  double *tmp;
+
+  if ((tmp=(double *)malloc(2*n*sizeof(double)))==NULL) { return; }
+  /* fit relative to the newest bin to keep the precision */
+  k=(c->i+c->nw-1)%c->nw;
+  c->sc0=c->sc[k]; c->t0=c->ta[k];
+  scmin=c->sc0; scmax=c->sc0;
+  for (k=0; k<n; k++) { 
+    c->w[k]=1.0; 
+    if (c->sc[k]<scmin) { scmin=c->sc[k]; }
+    if (c->sc[k]>scmax) { scmax=c->sc[k]; }
+  }
+  /* the drift needs a long enough window, until then only the offset is fitted */
+  fit=((scmax-scmin)>=TMSCLKMINSPAN*c->fs);
+  b=c->dt; s=0.0;
+  for (it=0; it<=TMSCLKITER; it++) {
+    clk_fit(c,n,fit,&a,&b);
+    for (k=0; k<n; k++) { c->r[k]=c->ta[k]-c->t0-a-b*(double)(c->sc[k]-c->sc0); }
+    /* robust scale: 1.4826*MAD */
+    m=quantile(c->r,n,0.5,tmp);
+    for (k=0; k<n; k++) { tmp[n+k]=fabs(c->r[k]-m); }
+    s=1.4826*quantile(tmp+n,n,0.5,tmp);
+    if (s<1e-6) { s=1e-6; }
+    for (k=0; k<n; k++) {
+      u=(c->r[k]-m)/(4.685*s);
+      c->w[k]=(fabs(u)<1.0) ? (1.0-u*u)*(1.0-u*u) : 0.0;
+    }
+  }
+  if (fabs(b*c->fs-1.0)>TMSCLKMAXDRIFT) {
+    /* unlikely drift: keep the previous one */
+    b=c->dt;
+    clk_fit(c,n,0,&a,&b);
+    for (k=0; k<n; k++) { c->r[k]=c->ta[k]-c->t0-a-b*(double)(c->sc[k]-c->sc0); }
+  }
+  /* lower the line to the latency floor of the inliers */
+  for (k=0, it=0; k<n; k++) {
+    if (c->w[k]>0.0) { tmp[n+(it++)]=c->r[k]; }
+  }
+  if (it>0) { a+=quantile(tmp+n,it,TMSCLKQUANTILE,tmp); }
+  free(tmp);
+
+  c->t0+=a; c->dt=b; c->jit=s;
+}
+
+/** Add arrival at host monotonic time 't' [s] of a block ending at sample 'sc'
+ *   to clock model 'c', the model is refitted when a bin is complete. Sample 
+ *   indices should increase without gaps other than missed packets.
+ * @return number of bins in the fit window, -1 when 'sc' doesn't increase
+*/
+int32_t tms_clk_add(tms_clk_t *c, int64_t sc, double t) {
+
+  if ((c->bn>0) && (sc<=c->bmsc)) {
+    return(-1);
+  }
+  c->na++;
+  if ((c->bn>0) && (sc-c->bsc>=TMSCLKBIN*c->fs)) {
+    /* bin is complete: its earliest arrival goes into the window */
+    c->sc[c->i]=c->bmsc; c->ta[c->i]=c->bmta;
+    c->i=(c->i+1)%c->nw;
+    if (c->n<c->nw) { c->n++; }
+    clk_refit(c);
+    c->bn=0;
+  }
+  if (c->bn==0) {
+    c->bsc=sc; c->bmsc=sc; c->bmta=t;
+  } else 
+  if (t-c->bmta < (double)(sc-c->bmsc)*c->dt) {
+    /* earlier arrival than the earliest so far */
+    c->bmsc=sc; c->bmta=t;
+  }
+  c->bn++;
+  if (c->n==0) {
+    /* no complete bin yet: follow the earliest arrival */
+    c->sc0=c->bmsc; c->t0=c->bmta;
+  }
+  return(c->n);
+}
+
+/** Get host monotonic time of sample 'sc' of clock model 'c'
+ * @return time [s]
+*/
+double tms_clk_time(const tms_clk_t *c, int64_t sc) {
+
+  return(c->t0+(double)(sc-c->sc0)*c->dt);
+}
+
+/** Get host wall clock time of sample 'sc' of clock model 'c'
+ * @return time [s] since 1970-01-01 00:00:00 UTC
+*/
+double tms_clk_wall(const tms_clk_t *c, int64_t sc) {
+
+  return(tms_clk_time(c,sc)+get_time()-tms_clk_now());
+}
+
+/** Get drift of device clock 'c': positive when the device clock is slow
+ * @return drift [ppm]
+*/
+double tms_clk_drift(const tms_clk_t *c) {
+
+  return(1e6*(c->dt*c->fs-1.0));
+}
+
+/** Get host monotonic time of sample 0 of clock model 'c'
+ * @return offset [s]
+*/
+double tms_clk_offset(const tms_clk_t *c) {
+
+  return(tms_clk_time(c,0));
+}
+
+/** Print clock model 'c' at device time 't' [s] of sample 'sc' as 
+ *   'clock t host drift jitter' into 'msg' of 'size' bytes
+ * @return number of characters in 'msg'
+*/
+int32_t tms_clk_prt(char *msg, int32_t size, const tms_clk_t *c, double t, int64_t sc) {
+
+  return(snprintf(msg,size,"clock %.6f %.6f %.3f %.6f\n",t,tms_clk_wall(c,sc),
+    tms_clk_drift(c),c->jit));
+}
@@ -0,0 +1,374 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file tms_io.c
+ * Transports to a TMSi device behind one interface: the address selects
+ *  the backend, every backend reads without blocking into scattered buffers.
+ *  BtReadBytes()/BtWriteBytes() of tmsi.c find the transport of their file
+ *  descriptor, so the protocol code works the same on every transport.
+ *  RFCOMM needs libbluetooth and is set by tmsi_bluez, TTY, TCP and raw
+ *  capture files are built in. A capture file replays the device bytes,
+ *  requests written to it are dropped.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "tms_io.h"
+
+/** prefixes of explicit transport addresses */
+static const char *tms_io_prefix[TMSIONTYPE] = { "", "rfcomm:", "tty:", "tcp:", "file:" };
+
+static tms_io_t *io_list=NULL;   /**< open transports */
+
+/** Set file descriptor 'fd' non-blocking
+ * @return 0 on success, -1 on failure
+*/
+static int32_t tms_io_nonblock(int32_t fd) {
+
+  int32_t flags;
+
+  if ((flags=fcntl(fd,F_GETFL,0))==-1) { flags=0; }
+  return(fcntl(fd,F_SETFL,flags|O_NONBLOCK));
+}
+
+/** Read into 'n' buffers 'iov' from the file descriptor of 'io'
+ * @return number of bytes read, 0 or <0 when nothing is available
+*/
+static int32_t tms_io_fd_readv(tms_io_t *io, const struct iovec *iov, int32_t n) {
+  return((int32_t)readv(io->fd,iov,n));
+}
+
+/** Write all 'n' bytes of 'buf' to the file descriptor of 'io'
+ * @return number of bytes written, <0 on failure
+*/
+static int32_t tms_io_fd_write(tms_io_t *io, const uint8_t *buf, int32_t n) {
+
+  int32_t bw=0;     /**< bytes written */
+  int32_t k;
+  int32_t rtc=0;    /**< retry counter */
+
+  while (bw<n) {
+    k=(int32_t)write(io->fd,&buf[bw],n-bw);
+    if (k>0) { bw+=k; continue; }
+    if ((k<0) && (errno!=EAGAIN) && (errno!=EINTR)) { return(-1); }
+    /* non-blocking transport is full */
+    if (++rtc>1000) { return(bw); }
+    usleep(1000);
+  }
+  return(bw);
+}
+
+/** Get file descriptor of 'io'
+ * @return file descriptor
+*/
+static int32_t tms_io_fd_fd(const tms_io_t *io) {
+  return(io->fd);
+}
+
+/** Close the file descriptor of 'io'
+*/
+static void tms_io_fd_close(tms_io_t *io) {
+
+  if ((io->fd>=0) && (close(io->fd)!=0)) {
+    perror("# Info: tms_io_close");
+  }
+  io->fd=-1;
+}
+
+/** Open serial port 'addr' as '<device>[@<baud>]', raw and non-blocking
+ * @return 0 on success, -1 on failure
+*/
+static int32_t tms_io_tty_open(tms_io_t *io, const char *addr) {
+
+  char    dev[256];        /**< device name */
+  char   *cp;
+  long    baud=TMSIOBAUD;  /**< serial port speed */
+  speed_t speed;
+  struct  termios tio;
+
+  snprintf(dev,sizeof(dev),"%s",addr);
+  if ((cp=strrchr(dev,'@'))!=NULL) { *cp='\0'; baud=strtol(cp+1,NULL,10); }
+  switch (baud) {
+    case   9600: speed=B9600;   break;
+    case  19200: speed=B19200;  break;
+    case  38400: speed=B38400;  break;
+    case  57600: speed=B57600;  break;
+    case 115200: speed=B115200; break;
+    case 230400: speed=B230400; break;
+    default:
+      fprintf(stderr,"# Error: tms_io_tty_open unsupported speed %ld [baud]!!!\n",baud);
+      return(-1);
+  }
+  if ((io->fd=open(dev,O_RDWR|O_NOCTTY|O_NONBLOCK))<0) {
+    fprintf(stderr,"# Error: can't open serial port %s: %s!!!\n",dev,strerror(errno));
+    return(-1);
+  }
+  /* raw 8N1 without flow control, reads return what is available */
+  if (tcgetattr(io->fd,&tio)==0) {
+    tio.c_iflag&=~(IGNBRK|BRKINT|PARMRK|ISTRIP|INLCR|IGNCR|ICRNL|IXON|IXOFF);
+    tio.c_oflag&=~OPOST;
+    tio.c_lflag&=~(ECHO|ECHONL|ICANON|ISIG|IEXTEN);
+    tio.c_cflag&=~(CSIZE|PARENB|CSTOPB);
+    tio.c_cflag|=CS8|CLOCAL|CREAD;
+    tio.c_cc[VMIN]=0; tio.c_cc[VTIME]=0;
+    cfsetispeed(&tio,speed); cfsetospeed(&tio,speed);
+    if (tcsetattr(io->fd,TCSANOW,&tio)!=0) {
+      fprintf(stderr,"# Warning: can't configure serial port %s\n",dev);
+    }
+    tcflush(io->fd,TCIOFLUSH);
+  }
+  return(0);
+}
+
+/** Connect to TCP address 'addr' as '<host>:<port>' without Nagle delay
+ * @return 0 on success, -1 on failure
+*/
+static int32_t tms_io_tcp_open(tms_io_t *io, const char *addr) {
+
+  char    host[256];        /**< host name */
+  char   *port;             /**< port number */
+  int32_t one=1;
+  struct  addrinfo hints, *res, *ai;
+
+  snprintf(host,sizeof(host),"%s",addr);
+  if ((port=strrchr(host,':'))==NULL) {
+    fprintf(stderr,"# Error: tms_io_tcp_open missing port in %s!!!\n",addr);
+    return(-1);
+  }
+  *port++='\0';
+  memset(&hints,0,sizeof(hints));
+  hints.ai_family=AF_UNSPEC;
+  hints.ai_socktype=SOCK_STREAM;
+  if (getaddrinfo(host,port,&hints,&res)!=0) {
+    fprintf(stderr,"# Error: tms_io_tcp_open unknown host %s!!!\n",host);
+    return(-1);
+  }
+  io->fd=-1;
+  for (ai=res; ai!=NULL; ai=ai->ai_next) {
+    if ((io->fd=socket(ai->ai_family,ai->ai_socktype,ai->ai_protocol))<0) { continue; }
+    if (connect(io->fd,ai->ai_addr,ai->ai_addrlen)==0) { break; }
+    close(io->fd); io->fd=-1;
+  }
+  freeaddrinfo(res);
+  if (io->fd<0) {
+    fprintf(stderr,"# Error: can't connect to %s: %s!!!\n",addr,strerror(errno));
+    return(-1);
+  }
+  setsockopt(io->fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+  return(tms_io_nonblock(io->fd));
+}
+
+/** Open raw capture file 'addr' for replay
+ * @return 0 on success, -1 on failure
+*/
+static int32_t tms_io_file_open(tms_io_t *io, const char *addr) {
+
+  if ((io->fd=open(addr,O_RDONLY|O_NONBLOCK))<0) {
+    fprintf(stderr,"# Error: can't open capture file %s: %s!!!\n",addr,strerror(errno));
+    return(-1);
+  }
+  return(0);
+}
+
+/** Drop the 'n' bytes written to capture file 'io'
+ * @return 'n'
+*/
+static int32_t tms_io_file_write(tms_io_t *io, const uint8_t *buf, int32_t n) {
+
+  (void) io; (void) buf;
+  return(n);
+}
+
+static const tms_io_ops_t tms_io_tty  = { "tty",  tms_io_tty_open,  tms_io_fd_readv,
+  tms_io_fd_write,   tms_io_fd_fd, tms_io_fd_close };
+static const tms_io_ops_t tms_io_tcp  = { "tcp",  tms_io_tcp_open,  tms_io_fd_readv,
+  tms_io_fd_write,   tms_io_fd_fd, tms_io_fd_close };
+static const tms_io_ops_t tms_io_file = { "file", tms_io_file_open, tms_io_fd_readv,
+  tms_io_file_write, tms_io_fd_fd, tms_io_fd_close };
+
+/** backend per transport type, RFCOMM is set by tmsi_bluez */
+static const tms_io_ops_t *io_ops[TMSIONTYPE] = { NULL, NULL, &tms_io_tty, &tms_io_tcp, &tms_io_file };
+
+/** Set backend 'ops' of transport 'type', e.g. the RFCOMM backend of tmsi_bluez.
+ * @return 0 on success, -1 on unknown type
+*/
+int32_t tms_io_set_ops(int32_t type, const tms_io_ops_t *ops) {
+
+  if ((type<=TMSIONONE) || (type>=TMSIONTYPE)) { return(-1); }
+  io_ops[type]=ops;
+  return(0);
+}
+
+/** Check for bluetooth MAC address 'addr' as XX:XX:XX:XX:XX:XX
+ * @return 1 on MAC address, 0 otherwise
+*/
+static int32_t tms_io_is_mac(const char *addr) {
+
+  int32_t i;
+
+  if (strlen(addr)!=17) { return(0); }
+  for (i=0; i<17; i++) {
+    if ((i%3==2) ? (addr[i]!=':') : !isxdigit((unsigned char)addr[i])) { return(0); }
+  }
+  return(1);
+}
+
+/** Get transport type of device address 'addr'
+ * @return TMSIO... type, TMSIONONE when 'addr' isn't a device
+*/
+int32_t tms_io_type(const char *addr) {
+
+  int32_t type;
+
+  if (addr==NULL) { return(TMSIONONE); }
+  for (type=TMSIONONE+1; type<TMSIONTYPE; type++) {
+    if (strncmp(addr,tms_io_prefix[type],strlen(tms_io_prefix[type]))==0) { return(type); }
+  }
+  if (tms_io_is_mac(addr))           { return(TMSIORFCOMM); }
+  if (strncmp(addr,"/dev/",5)==0)    { return(TMSIOTTY); }
+  return(TMSIONONE);
+}
+
+/** Open transport to device address 'addr'
+ * @return pointer to transport, NULL on failure
+*/
+tms_io_t *tms_io_open(const char *addr) {
+
+  tms_io_t *io;
+  int32_t   type;
+  size_t    n;
+
+  if ((type=tms_io_type(addr))==TMSIONONE) {
+    fprintf(stderr,"# Error: %s is no device address!!!\n",addr);
+    return(NULL);
+  }
+  if (io_ops[type]==NULL) {
+    fprintf(stderr,"# Error: no %s transport for %s!!!\n",tms_io_prefix[type],addr);
+    return(NULL);
+  }
+  if ((io=(tms_io_t *)calloc(1,sizeof(tms_io_t)))==NULL) { return(NULL); }
+  io->type=type; io->ops=io_ops[type]; io->fd=-1;
+  /* strip the explicit prefix */
+  n=strlen(tms_io_prefix[type]);
+  if (strncmp(addr,tms_io_prefix[type],n)!=0) { n=0; }
+  if (io->ops->open(io,&addr[n])<0) {
+    free(io);
+    return(NULL);
+  }
+  io->next=io_list; io_list=io;
+  return(io);
+}
+
+/** Get the open transport with file descriptor 'fd'
+ * @return pointer to transport, NULL when 'fd' isn't a transport
+*/
+tms_io_t *tms_io_get(int32_t fd) {
+
+  tms_io_t *io;
+
+  for (io=io_list; io!=NULL; io=io->next) {
+    if (io->fd==fd) { return(io); }
+  }
+  return(NULL);
+}
+
+/** Read at most 'n' bytes into 'buf' from transport 'io' without blocking
+ * @return number of bytes read, 0 or <0 when nothing is available
+*/
+int32_t tms_io_read(tms_io_t *io, uint8_t *buf, int32_t n) {
+
+  struct iovec iov;
+
+  iov.iov_base=buf; iov.iov_len=n;
+  return(io->ops->readv(io,&iov,1));
+}
+
+/** Read into the 'n' buffers 'iov' from transport 'io' without blocking
+ * @return number of bytes read, 0 or <0 when nothing is available
+*/
+int32_t tms_io_readv(tms_io_t *io, const struct iovec *iov, int32_t n) {
+  return(io->ops->readv(io,iov,n));
+}
+
+/** Write 'n' bytes of 'buf' to transport 'io'
+ * @return number of bytes written, <0 on failure
+*/
+int32_t tms_io_write(tms_io_t *io, const uint8_t *buf, int32_t n) {
+  return(io->ops->write(io,buf,n));
+}
+
+/** Get file descriptor to wait for data of transport 'io' with poll()/select()
+ * @return file descriptor, -1 on failure
+*/
+int32_t tms_io_fd(const tms_io_t *io) {
+
+  if (io==NULL) { return(-1); }
+  return(io->ops->fd(io));
+}
+
+/** Close transport 'io' and free it
+*/
+void tms_io_close(tms_io_t *io) {
+
+  tms_io_t **p;
+
+  if (io==NULL) { return; }
+  for (p=&io_list; *p!=NULL; p=&(*p)->next) {
+    if (*p==io) { *p=io->next; break; }
+  }
+  io->ops->close(io);
+  free(io);
+}
+
+/** Close all open transports
+*/
+void tms_io_close_all() {
+
+  while (io_list!=NULL) {
+    tms_io_close(io_list);
+  }
+}
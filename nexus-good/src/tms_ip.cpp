@@ -39,6 +39,8 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <time.h>
 #include <signal.h>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #ifdef _MSC_VER
   #include "win32_compat.h"
@@ -64,6 +66,63 @@ static int32_t vb=0x0000;  /**<  verbose level */
 static Server *server = NULL;
 static Client *client = NULL;
 
+/** pre-rendered labels of one channel layout of tms_ip_send(), only the
+ *   numbers are formatted per packet */
+typedef struct TMS_IP_TPL_T {
+  int32_t n;                 /**< number of channels */
+  int32_t msk;               /**< channel selection */
+  std::vector<int32_t> ns;   /**< number of samples of each channel */
+  std::string lbl;           /**< labels ' A0=' of all fields */
+  std::vector<int32_t> ofs;  /**< start of the label of each field in 'lbl' */
+  std::vector<int32_t> chn;  /**< channel of each field */
+  std::vector<int32_t> smp;  /**< sample of each field */
+  std::vector<char> buf;     /**< message buffer, reused for every packet */
+} tms_ip_tpl_t;
+
+static tms_ip_tpl_t tpl;     /**< layout of the last packet */
+static std::vector<char> abuf; /**< message buffer of tms_ip_send_array() */
+
+/** Check whether template 't' has the layout of 'channel' with 'n' channels and 'msk'
+ * @return 1 on the same layout, 0 otherwise
+*/
+static int32_t tms_ip_tpl_same(const tms_ip_tpl_t *t, const tms_channel_data_t *channel,
+  int32_t n, int32_t msk) {
+
+  int32_t j;
+
+  if ((t->n!=n) || (t->msk!=msk)) { return(0); }
+  for (j=0; j<n; j++) {
+    if (t->ns[j]!=channel[j].ns) { return(0); }
+  }
+  return(1);
+}
+
+/** Render the labels of template 't' for 'channel' with 'n' channels and 'msk'
+*/
+static void tms_ip_tpl_make(tms_ip_tpl_t *t, const tms_channel_data_t *channel,
+  int32_t n, int32_t msk) {
+
+  char    buff[64];        /**< one label */
+  int32_t i,j;             /**< general index */
+
+  t->n=n; t->msk=msk;
+  t->ns.resize(n);
+  t->lbl.clear(); t->ofs.clear(); t->chn.clear(); t->smp.clear();
+  for (j=0; j<n; j++) {
+    t->ns[j]=channel[j].ns;
+    if (!((msk)&(1<<j))) { continue; }
+    for (i=0; i<channel[j].ns; i++) {
+      t->ofs.push_back((int32_t)t->lbl.size());
+      t->chn.push_back(j); t->smp.push_back(i);
+      snprintf(buff,sizeof(buff)," %c%d=",'A'+j,i);
+      t->lbl+=buff;
+    }
+  }
+  t->ofs.push_back((int32_t)t->lbl.size());
+  /* time stamp, labels, numbers and new line */
+  t->buf.resize(4+EDFFMTMAXW+t->lbl.size()+t->chn.size()*EDFFMTMAXW+2);
+}
+
 /** Set verbose level of this module tms_ip
 * @return old verbose level
 */
@@ -98,37 +157,37 @@ int32_t tms_ip_setup_client(char *ipname, int32_t port) {
  */
 int32_t tms_ip_send(double t, tms_channel_data_t *channel, int32_t n, int32_t msk) {
 
-  std::string msg;         /**< message to ip server */
-  char    buff[MNCIPP];    /**< temporary buffer for text */
-  int32_t i,j;             /**< general index */
+  char    *msg;            /**< message to ip server */
+  char    *p;              /**< end of message */
+  int32_t  i,j,k;          /**< general index */
+  int32_t  nl;             /**< label length */
   
-  msg.clear();
-  snprintf(buff,sizeof(buff)-1," t=%.8f",t);
-  msg += buff;
-  /* Check all channels */
-  for (j=0; j<n; j++) {
-    /* is channel 'j' active? */
-    if ((msk)&(1<<j)) {
-      /* write all samples of channel 'j' */
-      for (i=0; i<channel[j].ns; i++) {
-        if (i<channel[j].rs) {
-          /* write value of sample 'i' */
-          snprintf(buff,sizeof(buff)-1," %1C%d=%.4f",('A'+j),i,channel[j].data[i].sample);
-        } else {
-          /* write NaNs of sample 'i' */
-          snprintf(buff,sizeof(buff)-1," %1C%d=NaN",('A'+j),i);
-        }
-        msg += buff;
-      }
+  /* the labels only change with the channel layout */
+  if (!tms_ip_tpl_same(&tpl,channel,n,msk)) {
+    tms_ip_tpl_make(&tpl,channel,n,msk);
+  }
+  msg=&tpl.buf[0]; p=msg;
+  memcpy(p," t=",3); p+=3;
+  p+=edf_fmt_fixed(p,t,0,8);
+  /* copy label and write value of every field */
+  for (k=0; k<(int32_t)tpl.chn.size(); k++) {
+    j=tpl.chn[k]; i=tpl.smp[k];
+    nl=tpl.ofs[k+1]-tpl.ofs[k];
+    memcpy(p,&tpl.lbl[tpl.ofs[k]],nl); p+=nl;
+    if (i<channel[j].rs) {
+      p+=edf_fmt_fixed(p,channel[j].data[i].sample,0,4);
+    } else {
+      /* NaNs for missing sample 'i' */
+      memcpy(p,"NaN",3); p+=3;
     }
   }
-  msg += "\n";
+  *p++='\n';
   if (vb&0x01) {
-    fprintf(stderr,"%s",msg.c_str());
+    fprintf(stderr,"%.*s",(int)(p-msg),msg);
   }
   /* send msg */
-  server->sendMessage(msg.c_str());
-  return(msg.size());
+  server->sendMessage(msg,p-msg);
+  return((int32_t)(p-msg));
 }
 
 /** Send character array 'msg' as server.
@@ -163,26 +222,33 @@ int32_t tms_ip_send_str_client(char *msg) {
  */
 int32_t tms_ip_send_array(int32_t chn, char *name, double t, double dt, int32_t n, float *a) {
 
-  std::string msg;       /**< message to ip server */
-  char    buff[MNCIPP];  /**< temporary buffer for text */
-  int32_t i;             /**< general index */
+  char    *msg;          /**< message to ip server */
+  char    *p;            /**< end of message */
+  int32_t  i;            /**< general index */
+  size_t   size;         /**< needed buffer size */
   
-  msg.clear();
-  snprintf(buff,sizeof(buff)-1,"a %d %.6f %.6f %s %d",chn,t,dt,name,n);
-  msg += buff;
+  size=strlen(name)+(n+5)*(EDFFMTMAXW+1)+8;
+  if (abuf.size()<size) { abuf.resize(size); }
+  msg=&abuf[0]; p=msg;
+  *p++='a'; *p++=' ';
+  p+=edf_fmt_int(p,chn,0);      *p++=' ';
+  p+=edf_fmt_fixed(p,t,0,6);    *p++=' ';
+  p+=edf_fmt_fixed(p,dt,0,6);   *p++=' ';
+  p+=edf_fmt_str(p,name,0);     *p++=' ';
+  p+=edf_fmt_int(p,n,0);
   /* Check all samples */
   for (i=0; i<n; i++) {
     /* write value of sample 'i' */
-    snprintf(buff,sizeof(buff)-1," %.4f",a[i]);
-    msg += buff;
+    *p++=' ';
+    p+=edf_fmt_fixed(p,a[i],0,4);
   }
-  msg += "\n";
+  *p++='\n';
   if (vb&0x01) {
-    fprintf(stderr,"%s",msg.c_str());
+    fprintf(stderr,"%.*s",(int)(p-msg),msg);
   }
   /* send msg */
-  server->sendMessage(msg.c_str());
-  return(msg.size());
+  server->sendMessage(msg,p-msg);
+  return((int32_t)(p-msg));
 }
   
 
@@ -0,0 +1,454 @@
+/** @file tms_offload.c
+ *
+ * @ingroup NEXUS
+ *
+ * $Id:  $
+ *
+ * @brief convert all TMSi measurement files of an SD card to BDF files.
+ *
+** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _XOPEN_SOURCE
+  #define _XOPEN_SOURCE  700 // for strdup(), localtime_r()
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "tmsi.h"
+#include "tms_smp.h"
+
+#define VERSION "$Revision: 0.1 Date 2026-10-19 12:00 $"
+
+#define INDEF     "."              /**< default input directory */
+#define CHNDEF    "ABCDEFGHM"      /**< default channel switch */
+#define IDXDEF    "sessions.txt"   /**< default session index file */
+#define IDXMAGIC  "# tms_offload 1" /**< session index identification */
+
+int32_t lbl  = 2;  /* 1:NFB@UvT 2:NFB@MGGz */
+
+#define NR_OF_CHANNELS   (14)
+char *defName1[NR_OF_CHANNELS] = {"C3-A1","C4-A2", "VEOG", "HEOG","ECG","Disp","GSR","Resp","I","J","K","L","Switch","N"};
+char *defName2[NR_OF_CHANNELS] = { "C3A1", "C4C3", "A2C4", "A1A2","ECG","Resp","GSR","Disp","I","J","K","L","Switch","N"};
+
+char *edfMsg  = NULL;
+char *edfMsg1 = "NFB @ UvT";
+char *edfMsg2 = "NFB @ MGGz";
+char *pid     = "";
+
+const char *edfChnName[NR_OF_CHANNELS];
+
+int32_t dbg = 0x0000;
+int32_t vb  = 0x0000;
+
+/** one measurement session on the card */
+typedef struct OFFLOAD_SESSION_T {
+  char    *iname;            /**< SD-card measurement file */
+  char     bname[MNCN];      /**< BDF output file */
+  tms_config_t cfg;          /**< TMSi config */
+  tms_measurement_hdr_t hdr; /**< TMSi measurement header */
+  char     msg[MNCN];        /**< recording message */
+  char     pid[MNCN];        /**< patient ident */
+  int32_t  status;           /**< 0:todo 1:ok 2:skip -1:error */
+  int32_t  rec_cnt;          /**< records written */
+  double   dur;              /**< duration written [s] */
+} offload_session_t;
+
+/** work shared by the converter threads */
+typedef struct OFFLOAD_WORK_T {
+  offload_session_t *s;      /**< sessions */
+  int32_t         n;         /**< number of sessions */
+  int32_t         next;      /**< next session to convert */
+  int32_t         chn;       /**< channel selection */
+  pthread_mutex_t mutex;     /**< protects 'next' and stderr */
+} offload_work_t;
+
+/** tms_offload usage
+ * @return number of printed characters.
+*/
+int32_t tms_offload_intro(FILE *fp) {
+  
+  int32_t nc=0;
+  int32_t i;
+  
+  nc+=fprintf(fp,"Convert all TMSi measurement files of an SD card to BDF: %s\n",VERSION);
+  nc+=fprintf(fp,"Usage: tms_offload [-i <dir>] [-o <out>] [-x <idx>] [-n <nt>] [-l <lbl>] [-m edfMsg]\n");
+  nc+=fprintf(fp," [-c <chn>] [-A ChA] [-B ChB] .. [-K ChK] [-P <pid>] [-f] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"dir  : mounted SD card or directory with *.SMP files (default=%s)\n",INDEF);
+  nc+=fprintf(fp,"out  : BDF output directory (default=%s)\n",INDEF);
+  nc+=fprintf(fp,"idx  : session index file (default=<out>/%s)\n",IDXDEF);
+  nc+=fprintf(fp,"nt   : number of converter threads (default: 0=number of cpus)\n");
+  nc+=fprintf(fp,"chn  : channel selection string (default=%s)\n",CHNDEF);
+  nc+=fprintf(fp,"lbl  : channel labeling 1:NFB@UvT 2:NFB@MGGz (default: %d)\n",lbl);
+  nc+=fprintf(fp,"        chn %6s %6s\n","UvT","MGGz");
+  for (i=0; i<NR_OF_CHANNELS; i++) {
+    nc+=fprintf(fp,"        %1C %6s %6s\n",'A'+i,defName1[i],defName2[i]);
+  }
+  nc+=fprintf(fp,"A..H : EDF/BDF signal names for channel A..H\n");
+  nc+=fprintf(fp,"M    : EDF/BDF message for the header\n");
+  nc+=fprintf(fp,"pid  : patient ident (default: measurement file name)\n");
+  nc+=fprintf(fp,"f    : overwrite existing BDF files (default: skip them)\n");
+  nc+=fprintf(fp,"h    : show this manual page\n");
+  nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
+  nc+=fprintf(fp,"  0x01 : show sessions found\n");
+  nc+=fprintf(fp,"  0x02 : show each converted session\n");
+  nc+=fprintf(fp,"dbg  : debug value (default=0x%02X)\n",dbg);
+  nc+=fprintf(fp,"A raw card image has to be mounted first, e.g. 'mount -o loop,ro <img> <dir>'\n");
+  return(nc);
+}
+
+/** reads the options from the command line */
+static void parse_cmd(int32_t argc, char *argv[], char *iname, char *oname,
+  char *xname, int32_t *chn, int32_t *nt, int32_t *ovr) {
+
+  int32_t i,j;         /**< general index */
+ 
+  strcpy(iname,INDEF); strcpy(oname,INDEF); strcpy(xname,"");
+  *chn = tms_chn_sel((char *)CHNDEF);
+  *nt = 0; *ovr = 0;
+  
+  switch (lbl) {
+    case 2: 
+      edfMsg=edfMsg2; break;
+    default:
+      edfMsg=edfMsg1; break;
+  }
+
+  for (i=0; i<NR_OF_CHANNELS; i++) {
+    switch (lbl) {
+      case 2:
+        edfChnName[i]=defName2[i]; break;
+      default:
+        edfChnName[i]=defName1[i]; break;
+    }  
+  }
+  
+  for (i=1; i<argc; i++) {
+    if (argv[i][0]!='-') {
+      fprintf(stderr,"missing - in argument %s\n",argv[i]);
+    } else {
+      switch (argv[i][1]) {
+        case 'i': strcpy(iname,argv[++i]); break;
+        case 'o': strcpy(oname,argv[++i]); break;
+        case 'x': strcpy(xname,argv[++i]); break;
+        case 'n': *nt=strtol(argv[++i],NULL,0); break;
+        case 'c': *chn=tms_chn_sel(argv[++i]); break;
+        case 'f': *ovr=1; break;
+        case 'A':
+        case 'B':
+        case 'C':
+        case 'D':
+        case 'E':
+        case 'F':
+        case 'G':
+        case 'H':
+        case 'I': 
+        case 'J': 
+        case 'K': 
+        case 'M': 
+        case 'N': 
+         j=argv[i][1]-'A';
+          if ((j>=0) && (j<NR_OF_CHANNELS)) { 
+            edfChnName[j]=argv[++i];
+          }
+          break;
+        case 'm': edfMsg=argv[++i]; break;
+        case 'P': pid=argv[++i]; break;
+        case 'l': lbl=strtol(argv[++i],NULL,0); break;
+        case 'v': vb=strtol(argv[++i],NULL,0); break;
+        case 'd': dbg=strtol(argv[++i],NULL,0); break;
+        case 'h': tms_offload_intro(stderr); exit(0);
+        default : fprintf(stderr,"can't understand argument %s\n",argv[i]); 
+          exit(0);
+      }
+    }        
+  }
+  
+  if (strlen(xname)<1) {
+    snprintf(xname,MNCN,"%s/%s",oname,IDXDEF);
+  }
+} 
+
+/** Check for a measurement file name ending on .SMP or .smp
+ * @return 1 when 'fname' is a measurement file, 0 otherwise
+*/
+static int32_t is_smp(const char *fname) {
+
+  size_t n=strlen(fname);
+
+  if (n<=4) { return(0); }
+  return((strcmp(&fname[n-4],".SMP")==0) || (strcmp(&fname[n-4],".smp")==0));
+}
+
+/** Add all measurement files in directory 'dir' and its subdirectories to
+ *   the 'n' file names 'fname' of size 'sz'
+ * @return number of file names
+*/
+static int32_t scan_dir(const char *dir, char ***fname, int32_t *sz, int32_t n) {
+
+  DIR    *dp;          /**< directory */
+  struct  dirent *de;  /**< directory entry */
+  struct  stat st;     /**< file status */
+  char    path[MNCN];  /**< full file name */
+  char  **p;
+
+  if ((dp=opendir(dir))==NULL) {
+    fprintf(stderr,"# Error: can't open directory %s: %s!!!\n",dir,strerror(errno));
+    return(n);
+  }
+  while ((de=readdir(dp))!=NULL) {
+    if (de->d_name[0]=='.') { continue; }
+    if (snprintf(path,MNCN,"%s/%s",dir,de->d_name)>=MNCN) { continue; }
+    if (stat(path,&st)!=0) { continue; }
+    if (S_ISDIR(st.st_mode)) {
+      n=scan_dir(path,fname,sz,n);
+      continue;
+    }
+    if (!S_ISREG(st.st_mode) || !is_smp(de->d_name)) { continue; }
+    if (n>=*sz) {
+      if ((p=(char **)realloc(*fname,(*sz*2+16)*sizeof(char *)))==NULL) { break; }
+      *fname=p; *sz=*sz*2+16;
+    }
+    (*fname)[n++]=strdup(path);
+  }
+  closedir(dp);
+  return(n);
+}
+
+/** Compare sessions on start time, then on file name for qsort()
+ * @return <0, 0, >0
+*/
+static int comp_session(const void *ap, const void *bp) {
+
+  const offload_session_t *a=(const offload_session_t *)ap;
+  const offload_session_t *b=(const offload_session_t *)bp;
+
+  if (a->hdr.startTime<b->hdr.startTime) { return(-1); }
+  if (a->hdr.startTime>b->hdr.startTime) { return(1); }
+  return(strcmp(a->iname,b->iname));
+}
+
+/** Converter thread: convert sessions of 'arg' until all are done
+ * @return NULL
+*/
+static void *convert_thread(void *arg) {
+
+  offload_work_t *w=(offload_work_t *)arg;
+  offload_session_t *s;
+  int32_t i;         /**< session index */
+
+  for (;;) {
+    pthread_mutex_lock(&w->mutex);
+    i=w->next++;
+    pthread_mutex_unlock(&w->mutex);
+    if (i>=w->n) { break; }
+    s=&w->s[i];
+    if (s->status!=0) { continue; }
+    s->rec_cnt=tms_smp_cvt(s->iname,s->bname,w->chn,s->pid,s->msg,edfChnName,&s->dur);
+    s->status=(s->rec_cnt<0) ? -1 : 1;
+    if (vb&0x02) {
+      pthread_mutex_lock(&w->mutex);
+      fprintf(stderr,"# %s -> %s %d records %.1f [s]\n",s->iname,s->bname,s->rec_cnt,s->dur);
+      pthread_mutex_unlock(&w->mutex);
+    }
+  }
+  return(NULL);
+}
+
+/** Convert the 'n' sessions 's' with 'nt' threads and channel selection 'chn'
+*/
+static void convert(offload_session_t *s, int32_t n, int32_t nt, int32_t chn) {
+
+  offload_work_t w;  /**< shared work */
+  pthread_t *tid;    /**< thread ids */
+  int32_t i;         /**< thread index */
+  int32_t nstarted=0;/**< number of started threads */
+
+  w.s=s; w.n=n; w.next=0; w.chn=chn;
+  pthread_mutex_init(&w.mutex,NULL);
+
+  if (nt<=0) { nt=(int32_t)sysconf(_SC_NPROCESSORS_ONLN); }
+  if (nt>n)  { nt=n; }
+  /* the calling thread helps, so start one thread less */
+  if ((nt>1) && ((tid=(pthread_t *)calloc(nt-1,sizeof(pthread_t)))!=NULL)) {
+    for (i=0; i<nt-1; i++) {
+      if (pthread_create(&tid[i],NULL,convert_thread,&w)!=0) { break; }
+      nstarted++;
+    }
+  } else {
+    tid=NULL;
+  }
+  convert_thread(&w);
+  for (i=0; i<nstarted; i++) {
+    pthread_join(tid[i],NULL);
+  }
+  if (tid!=NULL) free(tid);
+  pthread_mutex_destroy(&w.mutex);
+}
+
+/** Write the session index of the 'n' sessions 's' to file 'xname'
+ * @return 0 on success, -1 on failure
+*/
+static int32_t write_index(const char *xname, const offload_session_t *s, int32_t n) {
+
+  FILE   *fp;
+  char    stime[MNCN];  /**< start time */
+  struct  tm tm;
+  int32_t i;
+  const char *status;
+
+  if ((fp=fopen(xname,"w"))==NULL) {
+    fprintf(stderr,"Can't open filename `%s': %s\n",xname,strerror(errno)); 
+    return(-1);
+  }
+  fprintf(fp,"%s\n",IDXMAGIC);
+  fprintf(fp,"#%-18s %8s %8s %10s %6s %s %s\n","start","serial","records","dur[s]","status","smp","bdf");
+  for (i=0; i<n; i++) {
+    strftime(stime,MNCN,"%Y-%m-%dT%H:%M:%S",localtime_r(&s[i].hdr.startTime,&tm));
+    switch (s[i].status) {
+      case 1:  status="ok"; break;
+      case 2:  status="skip"; break;
+      default: status="error"; break;
+    }
+    fprintf(fp,"%-19s %8d %8d %10.3f %6s %s %s\n",stime,s[i].hdr.frontendSerialNr,
+      s[i].rec_cnt,s[i].dur,status,s[i].iname,s[i].bname);
+  }
+  fclose(fp);
+  return(0);
+}
+
+/** main */
+int32_t main(int32_t argc, char *argv[]) {
+
+  char iname[MNCN];          /**< input directory */
+  char oname[MNCN];          /**< output directory */
+  char xname[MNCN];          /**< session index file name */
+  char stime[MNCN];          /**< start time */
+  char path[MNCN];           /**< temp path name */
+  char **fname=NULL;         /**< measurement file names */
+  int32_t sz=0;              /**< size of 'fname' */
+  int32_t nf;                /**< number of measurement files */
+  offload_session_t *s;      /**< sessions */
+  int32_t n=0;               /**< number of sessions */
+  int32_t chn;               /**< channel selection */
+  int32_t nt;                /**< number of converter threads */
+  int32_t ovr;               /**< overwrite existing BDF files */
+  int32_t i,j,k;             /**< general index */
+  int32_t nerr=0;            /**< number of failed sessions */
+  char   *cp;                /**< character pointer */
+  struct  tm tm;
+  struct  stat st;
+  
+  parse_cmd(argc, argv, iname, oname, xname, &chn, &nt, &ovr);
+  
+  nf=scan_dir(iname,&fname,&sz,0);
+  fprintf(stderr,"# Found %d measurement files in %s\n",nf,iname);
+  if (nf<=0) { return(0); }
+  if ((s=(offload_session_t *)calloc(nf,sizeof(offload_session_t)))==NULL) {
+    fprintf(stderr,"# Error: can't allocate sessions!!!\n");
+    return(-1);
+  }
+  
+  /* read all headers first, sessions without a valid config are left out */
+  for (i=0; i<nf; i++) {
+    if (tms_smp_rd_hdr(fname[i],&s[n].cfg,&s[n].hdr)<0) {
+      free(fname[i]);
+      continue;
+    }
+    s[n].iname=fname[i];
+    n++;
+  }
+  free(fname);
+  qsort(s,n,sizeof(offload_session_t),comp_session);
+  
+  for (i=0; i<n; i++) {
+    /* patient ident is the measurement file name without extension */
+    if (strlen(pid)>0) {
+      snprintf(s[i].pid,MNCN,"%s",pid);
+    } else {
+      strcpy(path,s[i].iname);
+      snprintf(s[i].pid,MNCN,"%s",(char *)basename(path));
+      if ((cp=strstr(s[i].pid,".SMP"))!=NULL) {*cp='\0'; } else
+      if ((cp=strstr(s[i].pid,".smp"))!=NULL) {*cp='\0'; }
+    }
+    snprintf(s[i].msg,MNCN,"%s Nexus-10: SerialNr %d HWNr 0x%04X SWNr 0x%04X",edfMsg,
+      s[i].hdr.frontendSerialNr,s[i].hdr.frontendHWNr,s[i].hdr.frontendSWNr); 
+    
+    /* Added person info and start time to BDF file name, unique per run */
+    strftime(stime,MNCN,"%Y%m%dT%H%M%S",localtime_r(&s[i].hdr.startTime,&tm));
+    if (snprintf(s[i].bname,MNCN,"%s/%s_%s.bdf",oname,s[i].pid,stime)>=MNCN) {
+      s[i].status=-1;
+    }
+    for (k=1; s[i].status==0; k++) {
+      for (j=0; j<i; j++) {
+        if (strcmp(s[j].bname,s[i].bname)==0) { break; }
+      }
+      if (j>=i) { break; }
+      if (snprintf(s[i].bname,MNCN,"%s/%s_%s_%d.bdf",oname,s[i].pid,stime,k)>=MNCN) {
+        s[i].status=-1;
+      }
+    }
+    if (s[i].status<0) {
+      /* a truncated name isn't unique */
+      fprintf(stderr,"# Error: BDF file name for %s too long!!!\n",s[i].iname);
+      continue;
+    }
+    if (!ovr && (stat(s[i].bname,&st)==0)) { s[i].status=2; }
+    if (vb&0x01) {
+      fprintf(stderr,"# %s %s serial %d -> %s%s\n",stime,s[i].iname,
+        s[i].hdr.frontendSerialNr,s[i].bname,(s[i].status==2) ? " (exists)" : "");
+    }
+  }
+  
+  convert(s,n,nt,chn);
+  
+  for (i=0; i<n; i++) {
+    if (s[i].status<0) { nerr++; }
+  }
+  fprintf(stderr,"# Converted %d sessions, %d failed\n",n-nerr,nerr);
+  write_index(xname,s,n);
+  
+  for (i=0; i<n; i++) { free(s[i].iname); }
+  free(s);
+  
+  return((nerr>0) ? -1 : 0);
+}
@@ -49,6 +49,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <errno.h>
 
 #include "tmsi.h"
+#include "tms_smp.h"
 
 #define VERSION "$Revision: 0.4 Date 2014-03-15 17:20 $"
 
@@ -211,6 +212,63 @@ int32_t prt_chn(FILE *fp, tms_channel_data_t *chd) {
   return(nc);
 }
 
+/** Print the 'nt' time ticks in 'chd' from tick 'tc' on, of decoder 's' with
+ *   'fs' ticks per second, one line per tick to 'fp'.
+ * @return number of printed characters.
+ */
+static int32_t prt_ticks(FILE *fp, const tms_smp_t *s, const tms_channel_data_t *chd,
+  int64_t tc, int32_t nt, double fs) {
+
+  int32_t nc=0;
+  int32_t t,j;
+  const tms_data_t *d;
+
+  for (t=0; t<nt; t++) {
+    nc+=fprintf(fp," %10.4f %9d",(double)(tc+t)/fs,(int32_t)(tc+t));
+    for (j=0; j<s->nchn; j++) {
+      if (s->per[j]<=0) { continue; }
+      if ((t%s->per[j])==0) {
+        d=&chd[j].data[t/s->per[j]];
+        if (d->flag==0x00) {
+          nc+=fprintf(fp," %8d",d->isample);
+        } else {
+          /* map overflow to NAN */
+          nc+=fprintf(fp," %8s","nan");
+        }
+      } else {
+        /* no sample of channel 'j' on this tick */
+        nc+=fprintf(fp," %8s","nan");
+      }
+    }
+    nc+=fprintf(fp,"\n");
+  }
+  return(nc);
+}
+
+/** what is printed of every decoded record */
+typedef struct PRT_REC_T {
+  FILE   *fpo;              /**< text output file, NULL when not wanted */
+  double  fs;               /**< sample frequency of quickest channel */
+  int32_t rt;               /**< time ticks per EDF/BDF record */
+  int32_t cs;               /**< channel selection */
+  int32_t nchn;             /**< number of channels */
+} prt_rec_t;
+
+/** Record callback of tms_smp_rd_records(): print the 'nt' time ticks in 'chd'
+ *   from tick 'tc' on to the text output file, complete records also to stderr
+*/
+static void prt_record(void *arg, const tms_smp_t *s, tms_channel_data_t *chd,
+  int64_t tc, int32_t nt) {
+
+  prt_rec_t *p=(prt_rec_t *)arg;
+
+  if (p->fpo!=NULL) { prt_ticks(p->fpo,s,chd,tc,nt,p->fs); }
+  if ((vb&0x08) && (nt==p->rt)) {
+    /* write samples to TEXT output file */
+    tms_prt_samples(stderr,chd,p->cs,p->cs,p->nchn);
+  }
+}
+
 /** main */
 int32_t main(int32_t argc, char *argv[]) {
 
@@ -225,27 +283,20 @@ int32_t main(int32_t argc, char *argv[]) {
   int32_t bidx=0;            /**< byte index */
   tms_config_t cfg;          /**< TMSi config */
   tms_measurement_hdr_t hdr; /**< TMSi measurement header */
-  int32_t i,j,k;             /**< general index */
-  int32_t sample;            /**< sample */
-  int32_t tc;                /**< time counter */
-  uint8_t buf[4096];         /**< byte buffer */
-  int32_t cnt[64];           /**< sample counter per channel */
-  int32_t overflow[64];      /**< overflow counter per channel */
-  int32_t ba;                /**< bytes available */
-  int32_t value[64];         /**< current value per channel */
+  int32_t j,k;               /**< general index */
   int32_t chnsel;            /**< channel selection */
-  int32_t max_period;        /**< maximum period over all channels */
+  tms_smp_t *smp;            /**< measurement decoder */
   tms_channel_data_t *chd;   /**< channel data block pointer */
   int32_t rec_cnt=0;         /**< EDF/BDF record counter */
-  int32_t ns_max;            /**< maximum number of samples per channel over all channels */
+  int32_t rt;                /**< time ticks per EDF/BDF record */
+  int32_t nchn;              /**< number of channels in a record */
+  prt_rec_t prt;             /**< what is printed of every record */
 //char    id[MNCN];          /**< init Id number */
   char    stime[MNCN];       /**< start time */
   char    bname[MNCN];       /**< full EDF/BDF output file name */
   char    msg[MNCN];         /**< recording message */
 //int32_t min_deci;          /**< smallest decimation of quickest channel */
   float   fs;                /**< sample frequency of quickest channel */
-  int32_t blk_cnt=1;         /**< block counter to block duration above 0.5 [s] */
-  int32_t ok=0;              /**< EDF/BDF block is full */
   int32_t chnedf = 0xFFFF;   /**< write all channels to edf file */
   
   parse_cmd(argc, argv, iname, &chnedf, ename, tname);
@@ -306,54 +357,33 @@ int32_t main(int32_t argc, char *argv[]) {
     fprintf(stderr,"# initId 0x%08X\n",cfg.initId);
   }
   
-  /* calculate maximum period over all channels */
-  max_period=0; chnsel=0;
+  /* channel schedule of the measurement data */
+  if ((smp=tms_smp_new(&cfg))==NULL) {
+    return(-1);
+  }
+  chnsel=0;
   for (j=0; j<cfg.nrOfChannels; j++) {
     /* channel 'j' active and needed */
-    if (cfg.storageType[j].delta>0) {
-      chnsel|=(1<<j);
-      if (max_period < cfg.storageType[j].period) {
-        max_period = cfg.storageType[j].period;
-      }
-    }
+    if (cfg.storageType[j].delta>0) { chnsel|=(1<<j); }
   }
-  fprintf(stderr,"# chnsel 0x%04X max_period %d\n",chnsel,max_period);
+  fprintf(stderr,"# chnsel 0x%04X period %d bytes %d\n",chnsel,smp->period,smp->pbytes);
   
-  ns_max=0;
-  /* allocate space for all channels overhead */
-  chd=(tms_channel_data_t *)calloc(cfg.nrOfChannels,sizeof(tms_channel_data_t));
-  for (j=0; j<cfg.nrOfChannels; j++) {
-    /* channel 'j' active */
-    if (cfg.storageType[j].delta>0) {
-      chd[j].rs=0;
-      chd[j].ns=max_period / cfg.storageType[j].period;
-      if (ns_max < chd[j].ns) { ns_max = chd[j].ns; }
-      /* reset sample counter so that it will start after first packet with '0' */
-      chd[j].sc=-chd[j].ns;
-      /* set clock tick duration per channel */
-      chd[j].td=ns_max/(chd[j].ns*1.0*fs);
-    }
-    /* reset overflow counter per channel */
-    overflow[j]=0; cnt[j]=0; 
-    /* current value */
-    value[j]=0;
+  /* one record of whole schedule periods and at least 0.5 [s] */
+  chd=tms_smp_alloc_channel_data(smp,fs,&rt);
+  if (chd==NULL) {
+    fprintf(stderr,"# Error: can't allocate channel data!!!\n");
+    return(-1);
   }
-  
-  blk_cnt=1;
-  while (blk_cnt * (ns_max/fs)< 0.5) { blk_cnt *=2; }
-  fprintf(stderr,"# blk_cnt %d\n",blk_cnt);
-  
-  /* allocate space for all channels sample data */
+  fprintf(stderr,"# blk_cnt %d\n",rt/smp->period);
   if (vb&0x04) {
     fprintf(stderr,"# %3s %4s %2s %4s %8s\n","chn","ns","rs","sc","td [s]");
-  }
-  for (j=0; j<cfg.nrOfChannels; j++) {
-    chd[j].ns *= blk_cnt;
-    chd[j].data=(tms_data_t *)calloc(chd[j].ns,sizeof(tms_data_t));
-    if (vb&0x04) {
+    for (j=0; j<cfg.nrOfChannels; j++) {
       fprintf(stderr,"  %3d %4d %2d %4d %8.6f\n",j,chd[j].ns,chd[j].rs,chd[j].sc,chd[j].td);
     }
   } 
+  /* a record holds the same channels as edfWriteSamples() writes */
+  nchn=cfg.nrOfChannels;
+  if (nchn>tms_get_number_of_channels()) { nchn=tms_get_number_of_channels(); }
     
   /* Added person info and start time to BDF file name */
   if ( strchr(ename,'/')==NULL 
@@ -380,7 +410,7 @@ int32_t main(int32_t argc, char *argv[]) {
  
   /* write EDF/BDF headers */
   edfWriteHdr(fpe, chd, cfg.nrOfChannels, chnsel&chnedf, pid, msg, &hdr.startTime,
-   blk_cnt*(ns_max/fs), edfChnName);
+   rt/fs, edfChnName);
   fflush(fpe);
   
   if (fpo!=NULL) {
@@ -395,87 +425,14 @@ int32_t main(int32_t argc, char *argv[]) {
     fprintf(fpo,"\n");
   }
    
-  /* start at channel 0, time tick 0 and empty byte buffer */
-  j=0; tc=0; i=sizeof(buf); ba=i;  
-  /* parse measurement data */
-  while (!feof(fpi)) {
-    if ((j==0) && (fpo!=NULL)) {
-      fprintf(fpo," %10.4f %9d",(1.0*tc*(cfg.mindecimation+1)/cfg.sampleRate),tc);
-    }
-    if (cfg.storageType[j].delta>0) {
-      /* used channel */
-      if ((tc%cfg.storageType[j].period)==0) {
-        /* one extra sample in channel 'j' */
-        cnt[j]++;
-        /* byte length of this sample */
-        br=cfg.storageType[j].delta;
-        /* fetch sample for buffer */
-#if 0
-        if (i+br>sizeof(buf)) {
-          /* buffer hasn't enough measurement bytes */
-          if (i<sizeof(buf)) {
-            /* shift last unparsed bytes to begin of buffer */
-            memmove(&buf[0],&buf[i],sizeof(buf)-i);
-          }
-          i=sizeof(buf)-i;
-          /* fill buffer to the last byte */
-          ba=i+fread(&buf[i],1,(sizeof(buf)-i),fpi);
-          i=0;
-        }
-#else
-        i=0; ba=fread(&buf[i],1,br,fpi);
-#endif
-        /* convert to integer and print it */
-        sample=tms_get_int(buf,&i,br);
-        /* sign extension */    
-        sample=(sample<<(32-8*br))>>(32-8*br);
-        /* check storage delta */
-        if (cfg.storageType[j].delta<3) {
-          /* sum successive delta's to get orginal value back */
-          value[j]+=sample;
-        } else {
-          /* no differentation of this sample, sample is orginal value */
-          value[j]=sample;
-        }
-
-        /* overflow check */
-        if (sample!=cfg.storageType[j].overflow) {
-          /* print current value */
-          if (fpo!=NULL) { fprintf(fpo," %8d",value[j]); }
-        } else {
-          chd[j].data[chd[j].rs].flag=0x01; 
-          overflow[j]++;
-          /* map overflow to NAN */
-          if (fpo!=NULL) { fprintf(fpo," %8s","nan"); }
-        }
-        /* fill chn with data samples */
-        chd[j].data[chd[j].rs].isample=value[j]; 
-        chd[j].rs++; chd[j].sc++;
-      } else { 
-        /* skip this sample */
-        if (fpo!=NULL) { fprintf(fpo," %8s","nan"); }
-      }
-    }
-    /* next channel */
-    j++;
-    if (j==cfg.nrOfChannels) { 
-      /* next time tick */
-      j=0; tc++;
-      ok=1; for (k=0; k<cfg.nrOfChannels; k++) { ok = ok && chd[k].rs==chd[k].ns; }
-      if (ok==1) {
-        if (vb&0x08) {
-          /* write samples to TEXT output file */
-          tms_prt_samples(stderr, chd, chnsel&chnedf, chnsel&chnedf, cfg.nrOfChannels);
-        }
-        edfWriteSamples(fpe, 1, chd, chnsel&chnedf, 0);
-        rec_cnt++; 
-        /* reset sample counters */
-        for (k=0; k<cfg.nrOfChannels; k++) { chd[k].rs=0; }
-      }
-      if (fpo!=NULL) { fprintf(fpo,"\n"); }
-    }
+  /* decode the measurement data record by record, the last incomplete record is only printed */
+  prt.fpo=fpo; prt.fs=fs; prt.rt=rt; prt.cs=chnsel&chnedf; prt.nchn=cfg.nrOfChannels;
+  if ((rec_cnt=tms_smp_rd_records(smp,fpi,chd,rt,fpe,nchn,chnsel&chnedf,prt_record,&prt))<0) {
+    /* the BDF header keeps -1: unknown number of records */
+    fprintf(stderr,"# Error: read or write problem!!!\n");
+  } else {
+    fprintf(stderr,"# %d EDF/BDF records written\n",rec_cnt);
   }
-  fprintf(stderr,"# %d EDF/BDF records written\n",rec_cnt);
 
   /* overview per channel */
   for (k=0; k<4; k++) {
@@ -502,13 +459,13 @@ int32_t main(int32_t argc, char *argv[]) {
             fprintf(stderr," %8s",edfChnName[j]);
             break;
           case 1: 
-            fprintf(stderr," %8d",cnt[j]);
+            fprintf(stderr," %8d",smp->cnt[j]);
             break;
           case 2: 
-            fprintf(stderr," %8d",overflow[j]);
+            fprintf(stderr," %8d",smp->overflow[j]);
             break;
           case 3: 
-            fprintf(stderr," %8.3f",(100.0*overflow[j]/cnt[j]));
+            fprintf(stderr," %8.3f",(100.0*smp->overflow[j]/smp->cnt[j]));
             break;
         }    
       }
@@ -531,5 +488,8 @@ int32_t main(int32_t argc, char *argv[]) {
   /* close BDF file */
   fclose(fpe);
 
+  tms_smp_free_channel_data(smp,chd);
+  tms_smp_free(smp);
+
   return(0);
 }
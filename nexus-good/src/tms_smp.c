@@ -0,0 +1,422 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file tms_smp.c
+ * Bulk decoder of Mobi8/Nexus-10 SD-card measurement data: the channel
+ *  schedule of one storage period is computed once from the config, after 
+ *  which the interleaved delta and raw samples are decoded straight from a
+ *  byte buffer and packed into whole EDF/BDF records.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tms_smp.h"
+
+#define TMSSMPBUFSIZE  (1<<20)  /**< measurement bytes read at once */
+
+/** edfWriteHdr() uses localtime(): one header at a time */
+static pthread_mutex_t hdr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** greatest common divisor of 'a' and 'b'
+ * @return gcd
+*/
+static int32_t gcd(int32_t a, int32_t b) {
+
+  int32_t c;
+  
+  while (b!=0) { c=a%b; a=b; b=c; }
+  return(a);
+}
+
+/** Make decoder for the measurement data described by config 'cfg'.
+ * @return pointer to decoder, NULL on failure
+*/
+tms_smp_t *tms_smp_new(const tms_config_t *cfg) {
+
+  tms_smp_t *s;
+  int32_t    j,t,e;    /**< channel, tick and entry index */
+  int32_t    nent;     /**< number of entries */
+
+  if ((cfg->nrOfChannels<1) || (cfg->nrOfChannels>TMSSMPNCHN)) {
+    fprintf(stderr,"# Error: %d channels in config!!!\n",cfg->nrOfChannels);
+    return(NULL);
+  }
+  s=(tms_smp_t *)calloc(1,sizeof(tms_smp_t));
+  if (s==NULL) { return(NULL); }
+  s->nchn=cfg->nrOfChannels;
+
+  /* the schedule repeats after the least common multiple of all periods */
+  s->period=1;
+  for (j=0; j<s->nchn; j++) {
+    if (cfg->storageType[j].delta<=0) { continue; }
+    if ((cfg->storageType[j].delta>3) || (cfg->storageType[j].period<1)) {
+      fprintf(stderr,"# Error: channel %d delta %d period %d!!!\n",j,
+        cfg->storageType[j].delta,cfg->storageType[j].period);
+      free(s); return(NULL);
+    }
+    s->per[j]=cfg->storageType[j].period;
+    s->delta[j]=cfg->storageType[j].delta;
+    s->ovf[j]=cfg->storageType[j].overflow;
+    s->period=s->period/gcd(s->period,s->per[j])*s->per[j];
+    if (s->period>TMSSMPMAXPERIOD) {
+      fprintf(stderr,"# Error: schedule period %d > %d!!!\n",s->period,TMSSMPMAXPERIOD);
+      free(s); return(NULL);
+    }
+  }
+
+  /* one entry per sample in a schedule period, in file order */
+  nent=0;
+  for (j=0; j<s->nchn; j++) {
+    if (s->per[j]>0) { nent+=s->period/s->per[j]; }
+  }
+  s->tick=(int32_t *)calloc(s->period+1,sizeof(int32_t));
+  s->tbytes=(int32_t *)calloc(s->period,sizeof(int32_t));
+  s->chn=(uint8_t *)calloc(nent+1,sizeof(uint8_t));
+  s->size=(uint8_t *)calloc(nent+1,sizeof(uint8_t));
+  if ((s->tick==NULL) || (s->tbytes==NULL) || (s->chn==NULL) || (s->size==NULL)) {
+    tms_smp_free(s); return(NULL);
+  }
+  e=0; s->pbytes=0;
+  for (t=0; t<s->period; t++) {
+    s->tick[t]=e;
+    for (j=0; j<s->nchn; j++) {
+      if ((s->per[j]>0) && ((t%s->per[j])==0)) {
+        s->chn[e]=j; s->size[e]=s->delta[j]; e++;
+        s->tbytes[t]+=s->delta[j];
+      }
+    }
+    s->pbytes+=s->tbytes[t];
+  }
+  s->tick[s->period]=e;
+  return(s);
+}
+
+/** Free decoder 's'
+*/
+void tms_smp_free(tms_smp_t *s) {
+
+  if (s==NULL) { return; }
+  free(s->tick); free(s->tbytes);
+  free(s->chn); free(s->size);
+  free(s);
+}
+
+/** Allocate channel data with one BDF record of at least TMSSMPRECDUR [s] for
+ *   decoder 's' with sample frequency 'fs' of the quickest channel. The record
+ *   has 'rt' time ticks, a multiple of the schedule period.
+ * @return pointer to channel data of s->nchn channels, NULL on failure
+*/
+tms_channel_data_t *tms_smp_alloc_channel_data(const tms_smp_t *s, float fs, int32_t *rt) {
+
+  tms_channel_data_t *chd;
+  int32_t j;
+  int32_t blk=1;     /**< schedule periods per record */
+
+  while (blk*s->period/fs < TMSSMPRECDUR) { blk*=2; }
+  *rt=blk*s->period;
+
+  chd=(tms_channel_data_t *)calloc(s->nchn,sizeof(tms_channel_data_t));
+  if (chd==NULL) { return(NULL); }
+  for (j=0; j<s->nchn; j++) {
+    if (s->per[j]>0) {
+      chd[j].ns=(*rt)/s->per[j];
+      chd[j].td=s->per[j]/fs;
+      chd[j].data=(tms_data_t *)calloc(chd[j].ns,sizeof(tms_data_t));
+      if (chd[j].data==NULL) {
+        tms_smp_free_channel_data(s,chd); return(NULL);
+      }
+    }
+  }
+  return(chd);
+}
+
+/** Free channel data 'chd' of decoder 's'
+*/
+void tms_smp_free_channel_data(const tms_smp_t *s, tms_channel_data_t *chd) {
+
+  int32_t j;
+
+  if (chd==NULL) { return; }
+  for (j=0; j<s->nchn; j++) { free(chd[j].data); }
+  free(chd);
+}
+
+/** Decode entries 'e0' up to 'e1' of decoder 's' from 'b' into 'chd'.
+ * @return pointer behind the decoded bytes
+*/
+static const uint8_t *smp_entries(tms_smp_t *s, const uint8_t *b, int32_t e0, int32_t e1,
+  tms_channel_data_t *chd) {
+
+  int32_t e,j;
+  int32_t v;         /**< sign extended sample */
+  tms_data_t *d;
+
+  for (e=e0; e<e1; e++) {
+    j=s->chn[e];
+    /* little endian, sign extended */
+    switch (s->size[e]) {
+      case 1:  v=(int8_t)b[0]; b+=1; break;
+      case 2:  v=(int16_t)(b[0] | (b[1]<<8)); b+=2; break;
+      default: v=(int32_t)((uint32_t)(b[0] | (b[1]<<8) | (b[2]<<16))<<8)>>8; b+=3; break;
+    }
+    /* 8 and 16 bit samples are differences, 24 bit samples are values */
+    if (s->delta[j]<3) { s->value[j]+=v; } else { s->value[j]=v; }
+    d=&chd[j].data[chd[j].rs++];
+    d->isample=s->value[j];
+    if (v!=s->ovf[j]) {
+      d->flag=0x00;
+    } else {
+      d->flag=0x01; s->overflow[j]++;
+    }
+    s->cnt[j]++; chd[j].sc++;
+  }
+  return(b);
+}
+
+/** Decode at most 'nt' time ticks from the 'n' bytes of 'b' and append their
+ *   samples to channel data 'chd'; only complete ticks are decoded.
+ *  @return number of decoded ticks, 'used' is set to the number of used bytes
+*/
+int32_t tms_smp_run(tms_smp_t *s, const uint8_t *b, int32_t n, tms_channel_data_t *chd,
+  int32_t nt, int32_t *used) {
+
+  const uint8_t *p=b;     /**< decode position */
+  const uint8_t *e=b+n;   /**< end of 'b' */
+  int32_t t;              /**< tick in schedule period */
+  int32_t k=0;            /**< decoded ticks */
+
+  t=(int32_t)(s->tc%s->period);
+  while (k<nt) {
+    if ((t==0) && (nt-k>=s->period) && (e-p>=s->pbytes)) {
+      /* whole schedule period in one go */
+      p=smp_entries(s,p,0,s->tick[s->period],chd);
+      k+=s->period; s->tc+=s->period;
+      continue;
+    }
+    if (e-p<s->tbytes[t]) { break; }
+    p=smp_entries(s,p,s->tick[t],s->tick[t+1],chd);
+    k++; s->tc++;
+    if (++t==s->period) { t=0; }
+  }
+  *used=(int32_t)(p-b);
+  return(k);
+}
+
+/** Pack the samples in 'chd' of the channels selected in 'cs' of the 'nchn' 
+ *   channels as one EDF (bdf==0) or BDF (bdf==1) record in 'rec', like
+ *   edfWriteSamples() writes them.
+ *  @return number of bytes in 'rec'
+*/
+int32_t tms_smp_pack_record(uint8_t *rec, int32_t bdf, const tms_channel_data_t *chd,
+  int32_t nchn, int32_t cs) {
+
+  uint8_t *p=rec;
+  int32_t  i,j;
+  int32_t  sample=0;
+
+  for (j=0; j<nchn; j++) {
+    if ((cs&(1<<j))==0) { continue; }
+    for (i=0; i<chd[j].ns; i++) {
+      /* missing samples repeat the last one */
+      if (i<chd[j].rs) { sample=chd[j].data[i].isample; }
+      *p++=(uint8_t)(sample);
+      *p++=(uint8_t)(sample>>8);
+      if (bdf==1) { *p++=(uint8_t)(sample>>16); }
+    }
+  }
+  return((int32_t)(p-rec));
+}
+
+/** Decode the measurement data of 'fpi' from its current position with decoder
+ *   's' into records of 'rt' time ticks in 'chd' and write every complete record
+ *   of the channels selected in 'cs' of the first 'nchn' channels to BDF file 
+ *   'fpe'. When not NULL, 'cb' gets every complete record before it is written
+ *   and at last the incomplete record, which isn't written.
+ * @return number of BDF records written, <0 on failure
+*/
+int32_t tms_smp_rd_records(tms_smp_t *s, FILE *fpi, tms_channel_data_t *chd, int32_t rt,
+  FILE *fpe, int32_t nchn, int32_t cs, tms_smp_rec_t cb, void *arg) {
+
+  uint8_t *buf;              /**< measurement bytes */
+  uint8_t *rec;              /**< BDF record */
+  int32_t  ba=0;             /**< bytes available in 'buf' */
+  int32_t  bu;               /**< bytes used by the decoder */
+  int32_t  bidx;             /**< byte index */
+  int32_t  nt=0;             /**< time ticks in current record */
+  int64_t  tc=s->tc;         /**< time tick of current record */
+  int32_t  eof=0;            /**< end of input file */
+  int32_t  rec_cnt=0;        /**< records written */
+  int32_t  j,k;
+
+  buf=(uint8_t *)malloc(TMSSMPBUFSIZE);
+  rec=(uint8_t *)malloc(3*rt*nchn);
+  if ((buf==NULL) || (rec==NULL)) {
+    fprintf(stderr,"# Error: can't allocate buffers!!!\n");
+    free(buf); free(rec);
+    return(-1);
+  }
+
+  /* decode the measurement data in large blocks, record by record */
+  while (!eof) {
+    /* top up the buffer, keep the undecoded bytes */
+    k=(int32_t)fread(&buf[ba],1,TMSSMPBUFSIZE-ba,fpi);
+    if (k<TMSSMPBUFSIZE-ba) { eof=1; }
+    ba+=k;
+    bidx=0;
+    while (1) {
+      k=tms_smp_run(s,&buf[bidx],ba-bidx,chd,rt-nt,&bu);
+      bidx+=bu; nt+=k;
+      if (nt<rt) { break; }
+      /* record complete */
+      if (cb!=NULL) { cb(arg,s,chd,tc,nt); }
+      fwrite(rec,1,tms_smp_pack_record(rec,1,chd,nchn,cs),fpe);
+      rec_cnt++; 
+      /* reset sample counters */
+      for (j=0; j<s->nchn; j++) { chd[j].rs=0; }
+      tc+=nt; nt=0;
+    }
+    memmove(&buf[0],&buf[bidx],ba-bidx);
+    ba-=bidx;
+  }
+  if ((cb!=NULL) && (nt>0)) { cb(arg,s,chd,tc,nt); }
+  free(buf); free(rec);
+  if (ferror(fpi) || ferror(fpe)) { return(-1); }
+  return(rec_cnt);
+}
+
+/** Read config and measurement header of SD-card measurement file 'iname' 
+ *   into 'cfg' and 'hdr', the sample rate is corrected for its divider.
+ * @return 0 on success, <0 on failure
+*/
+int32_t tms_smp_rd_hdr(const char *iname, tms_config_t *cfg, tms_measurement_hdr_t *hdr) {
+
+  uint8_t header[0x600];     /**< config and measurement header */
+  FILE   *fp;
+  int32_t br;                /**< bytes read */
+  int32_t bidx;              /**< byte index */
+
+  memset(hdr,0,sizeof(tms_measurement_hdr_t));
+  if ((fp=fopen(iname,"rb"))==NULL) {
+    perror(iname);
+    return(-1);
+  }
+  br=(int32_t)fread(header,1,sizeof(header),fp);
+  fclose(fp);
+  if (br<1024) {
+    fprintf(stderr,"# Error: %s config size %d < 1024\n",iname,br);
+    return(-1);
+  }
+  bidx=0;
+  tms_get_cfg(header,&bidx,cfg);
+  if (cfg->version!=0x0314) {
+    fprintf(stderr,"# Error: %s missing version number 0x0314\n",iname);
+    return(-1);
+  }
+  if (abs(2048/(1<<cfg->sampleRateDiv) - cfg->sampleRate)>1) {
+    cfg->sampleRate=2048/(1<<cfg->sampleRateDiv);
+  }
+  if (br>=0x600) {
+    bidx=0x400;
+    tms_get_measurement_hdr(header,&bidx,hdr);
+  }
+  return(0);
+}
+
+/** Convert SD-card measurement file 'iname' into BDF file 'bname' with the
+ *   channels selected in 'cs', patient 'pid', message 'msg' and signal names
+ *   'chn_name', like tms_rd does. The duration [s] written is returned in 'dur'.
+ *   The BDF file is written as '<bname>.tmp' and renamed to 'bname' on success.
+ * @return number of BDF records written, <0 on failure
+*/
+int32_t tms_smp_cvt(const char *iname, const char *bname, int32_t cs, const char *pid,
+  const char *msg, const char **chn_name, double *dur) {
+
+  tms_config_t cfg;          /**< TMSi config */
+  tms_measurement_hdr_t hdr; /**< TMSi measurement header */
+  FILE    *fpi=NULL;         /**< measurement file */
+  FILE    *fpe=NULL;         /**< BDF file */
+  tms_smp_t *smp=NULL;       /**< measurement decoder */
+  tms_channel_data_t *chd=NULL; /**< one record of channel data */
+  char     tname[FILENAME_MAX]; /**< BDF file while it is written */
+  int32_t  rt;               /**< time ticks per record */
+  int32_t  nchn;             /**< number of channels in a record */
+  int32_t  chnsel=0;         /**< stored channels */
+  int32_t  rec_cnt=-1;       /**< records written */
+  int32_t  j;
+  float    fs;               /**< sample frequency of quickest channel */
+
+  *dur=0.0;
+  if (snprintf(tname,sizeof(tname),"%s.tmp",bname)>=(int)sizeof(tname)) {
+    fprintf(stderr,"# Error: file name %s too long!!!\n",bname);
+    return(-1);
+  }
+  if (tms_smp_rd_hdr(iname,&cfg,&hdr)<0) { return(-1); }
+  fs=1.0f*cfg.sampleRate/(cfg.mindecimation+1);
+  if ((smp=tms_smp_new(&cfg))==NULL) { return(-1); }
+  for (j=0; j<cfg.nrOfChannels; j++) {
+    if (cfg.storageType[j].delta>0) { chnsel|=(1<<j); }
+  }
+  nchn=cfg.nrOfChannels;
+  if (nchn>tms_get_number_of_channels()) { nchn=tms_get_number_of_channels(); }
+  if ((chd=tms_smp_alloc_channel_data(smp,fs,&rt))==NULL) {
+    fprintf(stderr,"# Error: %s can't allocate channel data!!!\n",iname);
+    goto done;
+  }
+  if ((fpi=fopen(iname,"rb"))==NULL) { perror(iname); goto done; }
+  if ((fpe=fopen(tname,"wb"))==NULL) { perror(tname); goto done; }
+  
+  /* measurement data follows the config and measurement header */
+  fseek(fpi,0x600,SEEK_SET);
+  pthread_mutex_lock(&hdr_lock);
+  edfWriteHdr(fpe,chd,cfg.nrOfChannels,chnsel&cs,pid,msg,&hdr.startTime,rt/fs,chn_name);
+  pthread_mutex_unlock(&hdr_lock);
+
+  if ((rec_cnt=tms_smp_rd_records(smp,fpi,chd,rt,fpe,nchn,chnsel&cs,NULL,NULL))>=0) {
+    edf_set_record_cnt(fpe,rec_cnt);
+    if (ferror(fpe)) { rec_cnt=-1; }
+  }
+  if (rec_cnt<0) { fprintf(stderr,"# Error: %s write problem!!!\n",tname); }
+
+done:
+  if ((fpe!=NULL) && (fclose(fpe)!=0) && (rec_cnt>=0)) { perror(tname); rec_cnt=-1; }
+  if (fpi!=NULL) { fclose(fpi); }
+  /* only a complete BDF file gets its name, so an interrupted run is redone */
+  if ((rec_cnt>=0) && (rename(tname,bname)!=0)) { perror(bname); rec_cnt=-1; }
+  if ((rec_cnt<0) && (fpe!=NULL)) { remove(tname); }
+  if (rec_cnt>0) { *dur=rec_cnt*rt/fs; }
+  if (chd!=NULL) { tms_smp_free_channel_data(smp,chd); }
+  tms_smp_free(smp);
+  return(rec_cnt);
+}
@@ -0,0 +1,490 @@
+/** @Copyright
+
+This software and associated documentation files (the "Software") are 
+copyright   2010 Koninklijke Philips Electronics N.V. All Rights Reserved.
+
+A copyright license is hereby granted for redistribution and use of the 
+Software in source and binary forms, with or without modification, provided 
+that the following conditions are met:
+ 1. Redistributions of source code must retain the above copyright notice, 
+    this copyright license and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice, 
+    this copyright license and the following disclaimer in the documentation 
+    and/or other materials provided with the distribution.
+ 3. Neither the name of Koninklijke Philips Electronics N.V. nor the names 
+    of its subsidiaries may be used to endorse or promote products derived 
+    from the Software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/** \file tms_spectrum.c
+ * Streaming spectral analysis of TMS channel data: windowed, overlapping
+ *  real FFT segments averaged into a Welch power spectral density, band
+ *  powers and a worker thread to keep it out of the acquisition loop.
+ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "tms_spectrum.h"
+
+/** default EEG bands plus an EMG band */
+const tms_band_t tms_eeg_bands[TMSSPECNBAND] = {
+  { "delta",  1.0,   4.0 },
+  { "theta",  4.0,   8.0 },
+  { "alpha",  8.0,  13.0 },
+  { "beta",  13.0,  30.0 },
+  { "gamma", 30.0,  45.0 },
+  { "emg",   45.0, 250.0 }
+};
+
+/** block of samples of one channel in the worker queue */
+typedef struct TMS_SPECTRUM_BLK_T {
+  int32_t chn;               /**< channel number */
+  int32_t n;                 /**< number of samples */
+  double  t;                 /**< time of first sample [s] */
+  float   x[TMSSPECBLK];     /**< samples */
+} tms_spectrum_blk_t;
+
+/** spectrum worker */
+struct TMS_SPECTRUM_WORKER_T {
+  int32_t             nchn;  /**< number of channels */
+  tms_spectrum_t    **s;     /**< spectrum per channel, NULL: disabled */
+  tms_spectrum_cb_t   cb;    /**< new PSD call back */
+  void               *arg;   /**< call back argument */
+  tms_spectrum_blk_t *q;     /**< single producer single consumer queue */
+  uint32_t            head;  /**< next block to write, owned by producer */
+  uint32_t            tail;  /**< next block to read, owned by worker */
+  int32_t             drop;  /**< number of dropped samples */
+  volatile int32_t    stop;  /**< stop request */
+  sem_t               sem;   /**< wakes up the worker */
+  pthread_t           tid;   /**< worker thread */
+};
+
+/** Make real FFT of 'n' samples, 'n' should be a power of 2 >= 4
+ * @return pointer to FFT, NULL on failure
+*/
+tms_fft_t *tms_fft_new(int32_t n) {
+
+  tms_fft_t *f;
+  int32_t m=n/2;   /**< complex FFT length */
+  int32_t i,j,b;   /**< general index and bit counter */
+
+  if ((n<4) || ((n&(n-1))!=0)) {
+    fprintf(stderr,"# Error: tms_fft_new length %d is no power of 2\n",n);
+    return(NULL);
+  }
+  if ((f=(tms_fft_t *)calloc(1,sizeof(tms_fft_t)))==NULL) { return(NULL); }
+  f->n  =n;
+  f->rev=(int32_t *)calloc(m,sizeof(int32_t));
+  f->cs =(float *)calloc(m+1,sizeof(float));
+  f->sn =(float *)calloc(m+1,sizeof(float));
+  f->re =(float *)calloc(m+1,sizeof(float));
+  f->im =(float *)calloc(m+1,sizeof(float));
+  if ((f->rev==NULL) || (f->cs==NULL) || (f->sn==NULL) || (f->re==NULL) || (f->im==NULL)) {
+    tms_fft_free(f);
+    return(NULL);
+  }
+  for (i=0; i<m; i++) {
+    for (j=0, b=1; b<m; b<<=1) {
+      j<<=1;
+      if (i&b) { j|=1; }
+    }
+    f->rev[i]=j;
+  }
+  for (i=0; i<=m; i++) {
+    f->cs[i]=(float)cos(2.0*M_PI*i/n);
+    f->sn[i]=(float)sin(2.0*M_PI*i/n);
+  }
+  return(f);
+}
+
+/** Free real FFT 'f'
+*/
+void tms_fft_free(tms_fft_t *f) {
+
+  if (f==NULL) return;
+  if (f->rev!=NULL) free(f->rev);
+  if (f->cs !=NULL) free(f->cs);
+  if (f->sn !=NULL) free(f->sn);
+  if (f->re !=NULL) free(f->re);
+  if (f->im !=NULL) free(f->im);
+  free(f);
+}
+
+/** In place radix-2 complex FFT of the n/2 points in f->re and f->im
+*/
+static void tms_cfft(tms_fft_t *f) {
+
+  int32_t m=f->n/2;    /**< complex FFT length */
+  int32_t len,half;    /**< butterfly span */
+  int32_t step;        /**< twiddle step in 'cs' and 'sn' */
+  int32_t i,j,k;       /**< general index */
+  float  *re=f->re, *im=f->im;
+  float   tr,ti,wr,wi; /**< temporary and twiddle */
+
+  for (i=0; i<m; i++) {
+    j=f->rev[i];
+    if (j>i) {
+      tr=re[i]; re[i]=re[j]; re[j]=tr;
+      ti=im[i]; im[i]=im[j]; im[j]=ti;
+    }
+  }
+  for (len=2; len<=m; len<<=1) {
+    half=len/2; step=f->n/len;
+    for (i=0; i<m; i+=len) {
+      for (k=0; k<half; k++) {
+        /* exp(-2*pi*i*k/len) */
+        wr=f->cs[k*step]; wi=-f->sn[k*step];
+        j=i+k+half;
+        tr=re[j]*wr - im[j]*wi;
+        ti=re[j]*wi + im[j]*wr;
+        re[j]=re[i+k]-tr; im[j]=im[i+k]-ti;
+        re[i+k]+=tr;      im[i+k]+=ti;
+      }
+    }
+  }
+}
+
+/** Real FFT of 'n' samples 'x' into 'n'/2+1 bins 're' and 'im'
+*/
+void tms_rfft(tms_fft_t *f, const float *x, float *re, float *im) {
+
+  int32_t m=f->n/2;    /**< complex FFT length */
+  int32_t k;           /**< bin index */
+  float   zr,zi,ar,ai; /**< Z[k] and Z[m-k] */
+  float   er,ei,odr,odi; /**< even and odd sample spectra */
+
+  /* even samples as real, odd samples as imaginary part */
+  for (k=0; k<m; k++) {
+    f->re[k]=x[2*k]; f->im[k]=x[2*k+1];
+  }
+  tms_cfft(f);
+  f->re[m]=f->re[0]; f->im[m]=f->im[0];
+
+  /* split into the spectrum of the real signal */
+  for (k=0; k<=m; k++) {
+    zr=f->re[k];   zi=f->im[k];
+    ar=f->re[m-k]; ai=f->im[m-k];
+    er=0.5f*(zr+ar); ei=0.5f*(zi-ai);
+    odr=0.5f*(zi+ai); odi=-0.5f*(zr-ar);
+    re[k]=er + f->cs[k]*odr + f->sn[k]*odi;
+    im[k]=ei + f->cs[k]*odi - f->sn[k]*odr;
+  }
+}
+
+/** Make streaming Welch spectrum of segments of 'nfft' samples that start
+ *   every 'hop' samples, averaged over 'navg' segments at sample frequency 'fs'.
+ * @return pointer to spectrum, NULL on failure
+*/
+tms_spectrum_t *tms_spectrum_new(double fs, int32_t nfft, int32_t hop, int32_t navg) {
+
+  tms_spectrum_t *s;
+  double  wss=0.0;   /**< window sum of squares */
+  int32_t i;
+
+  if ((fs<=0.0) || (hop<1) || (hop>nfft) || (navg<1)) {
+    fprintf(stderr,"# Error: tms_spectrum_new fs %.1f nfft %d hop %d navg %d\n",fs,nfft,hop,navg);
+    return(NULL);
+  }
+  if ((s=(tms_spectrum_t *)calloc(1,sizeof(tms_spectrum_t)))==NULL) { return(NULL); }
+  s->fs=fs; s->nfft=nfft; s->hop=hop; s->navg=navg; s->nbin=nfft/2+1;
+  s->fft =tms_fft_new(nfft);
+  s->win =(float *)calloc(nfft,sizeof(float));
+  s->x   =(float *)calloc(nfft,sizeof(float));
+  s->seg =(float *)calloc(navg*s->nbin,sizeof(float));
+  s->sum =(double *)calloc(s->nbin,sizeof(double));
+  s->psd =(float *)calloc(s->nbin,sizeof(float));
+  /* windowed segment followed by real and imaginary FFT output */
+  s->work=(float *)calloc(nfft+2*s->nbin,sizeof(float));
+  if ((s->fft==NULL) || (s->win==NULL) || (s->x==NULL) || (s->seg==NULL) ||
+      (s->sum==NULL) || (s->psd==NULL) || (s->work==NULL)) {
+    tms_spectrum_free(s);
+    return(NULL);
+  }
+  /* periodic Hann window */
+  for (i=0; i<nfft; i++) {
+    s->win[i]=(float)(0.5-0.5*cos(2.0*M_PI*i/nfft));
+    wss+=s->win[i]*s->win[i];
+  }
+  s->scale=(float)(1.0/(fs*wss));
+  return(s);
+}
+
+/** Free spectrum 's'
+*/
+void tms_spectrum_free(tms_spectrum_t *s) {
+
+  if (s==NULL) return;
+  tms_fft_free(s->fft);
+  if (s->win !=NULL) free(s->win);
+  if (s->x   !=NULL) free(s->x);
+  if (s->seg !=NULL) free(s->seg);
+  if (s->sum !=NULL) free(s->sum);
+  if (s->psd !=NULL) free(s->psd);
+  if (s->work!=NULL) free(s->work);
+  free(s);
+}
+
+/** Add periodogram of the last 'nfft' samples to the Welch average of 's'
+*/
+static void tms_spectrum_segment(tms_spectrum_t *s) {
+
+  float  *re=&s->work[s->nfft];  /**< FFT real part */
+  float  *im=&re[s->nbin];       /**< FFT imaginary part */
+  float  *p =&s->seg[s->si*s->nbin]; /**< periodogram slot */
+  float   scale;                 /**< one sided scale */
+  int32_t k;
+
+  /* oldest sample first */
+  for (k=0; k<s->nfft; k++) {
+    s->work[k]=s->win[k]*s->x[(s->xi+k)&(s->nfft-1)];
+  }
+  tms_rfft(s->fft,s->work,re,im);
+
+  for (k=0; k<s->nbin; k++) {
+    /* one sided: double all bins except DC and Nyquist */
+    scale=((k==0) || (k==s->nbin-1)) ? s->scale : 2.0f*s->scale;
+    if (s->sn==s->navg) { s->sum[k]-=p[k]; }
+    p[k]=scale*(re[k]*re[k]+im[k]*im[k]);
+    s->sum[k]+=p[k];
+  }
+  if (s->sn<s->navg) { s->sn++; }
+  if (++s->si==s->navg) { s->si=0; }
+
+  for (k=0; k<s->nbin; k++) {
+    s->psd[k]=(s->sum[k]>0.0) ? (float)(s->sum[k]/s->sn) : 0.0f;
+  }
+  s->nspec++;
+}
+
+/** Add 'n' samples 'x' to spectrum 's', NaN samples repeat the previous sample
+ * @return number of new Welch PSDs in s->psd
+*/
+int32_t tms_spectrum_add(tms_spectrum_t *s, const float *x, int32_t n) {
+
+  int32_t i;
+  int32_t cnt=0;     /**< number of new PSDs */
+
+  for (i=0; i<n; i++) {
+    if (!isnan(x[i])) { s->last=x[i]; }
+    s->x[s->xi]=s->last;
+    s->xi=(s->xi+1)&(s->nfft-1);
+    if (s->xn<s->nfft) { s->xn++; }
+    s->cnt++;
+    if ((s->xn==s->nfft) && (s->cnt>=s->hop)) {
+      tms_spectrum_segment(s);
+      s->cnt=0; cnt++;
+    }
+  }
+  return(cnt);
+}
+
+/** Add the received samples of channel 'chn' to spectrum 's'
+ * @return number of new Welch PSDs in s->psd
+*/
+int32_t tms_spectrum_add_chn(tms_spectrum_t *s, const tms_channel_data_t *chn) {
+
+  int32_t i;
+  int32_t cnt=0;     /**< number of new PSDs */
+
+  for (i=0; i<chn->rs; i++) {
+    cnt+=tms_spectrum_add(s,&chn->data[i].sample,1);
+  }
+  return(cnt);
+}
+
+/** Get power of spectrum 's' in band 'f0' up to 'f1' [Hz]
+ * @return band power [unit^2]
+*/
+float tms_spectrum_band(const tms_spectrum_t *s, float f0, float f1) {
+
+  double  df=s->fs/s->nfft;  /**< bin width [Hz] */
+  int32_t k0,k1,k;           /**< bin range */
+  double  pwr=0.0;           /**< band power */
+
+  k0=(int32_t)ceil(f0/df);
+  k1=(int32_t)ceil(f1/df);
+  if (k0<0) { k0=0; }
+  if (k1>s->nbin) { k1=s->nbin; }
+  for (k=k0; k<k1; k++) {
+    pwr+=s->psd[k];
+  }
+  return((float)(pwr*df));
+}
+
+/** Get power 'pwr' of spectrum 's' in all 'nb' bands 'band'
+ * @return number of bands
+*/
+int32_t tms_spectrum_bands(const tms_spectrum_t *s, const tms_band_t *band, int32_t nb, float *pwr) {
+
+  int32_t i;
+
+  for (i=0; i<nb; i++) {
+    pwr[i]=tms_spectrum_band(s,band[i].f0,band[i].f1);
+  }
+  return(nb);
+}
+
+/** Print 'nb' band powers 'pwr' of channel 'chn' at time 't' and 'dt' steps
+ *   into 'msg' of 'size' characters as 'bands chn t dt nb pwr[0] ... pwr[nb-1]'
+ *   like tms_ip_send_array().
+ * @return number of characters printed
+*/
+int32_t tms_spectrum_prt_bands(char *msg, int32_t size, int32_t chn, double t, double dt,
+  const float *pwr, int32_t nb) {
+
+  int32_t nc=0;
+  int32_t i;
+
+  nc+=snprintf(&msg[nc],size-nc,"bands %d %.8f %.6f %d",chn,t,dt,nb);
+  for (i=0; (i<nb) && (nc<size); i++) {
+    nc+=snprintf(&msg[nc],size-nc," %.6g",pwr[i]);
+  }
+  if (nc<size) {
+    nc+=snprintf(&msg[nc],size-nc,"\n");
+  }
+  return(nc<size ? nc : size-1);
+}
+
+/** Spectrum worker thread: process queued blocks until stopped
+ * @return NULL
+*/
+static void *tms_spectrum_worker(void *arg) {
+
+  tms_spectrum_worker_t *w=(tms_spectrum_worker_t *)arg;
+  tms_spectrum_blk_t *b;   /**< current block */
+  tms_spectrum_t *s;       /**< spectrum of block channel */
+  uint32_t head;           /**< producer position */
+
+  for (;;) {
+    sem_wait(&w->sem);
+    head=__atomic_load_n(&w->head,__ATOMIC_ACQUIRE);
+    if ((head==w->tail) && w->stop) { break; }
+    while (w->tail!=head) {
+      b=&w->q[w->tail&(TMSSPECQ-1)];
+      s=w->s[b->chn];
+      if ((s!=NULL) && (tms_spectrum_add(s,b->x,b->n)>0) && (w->cb!=NULL)) {
+        w->cb(w->arg,b->chn,b->t+(b->n-1)/s->fs,s);
+      }
+      __atomic_store_n(&w->tail,w->tail+1,__ATOMIC_RELEASE);
+    }
+  }
+  return(NULL);
+}
+
+/** Make spectrum worker for 'nchn' channels calling 'cb' with 'arg' for every new PSD
+ * @return pointer to worker, NULL on failure
+*/
+tms_spectrum_worker_t *tms_spectrum_worker_new(int32_t nchn, tms_spectrum_cb_t cb, void *arg) {
+
+  tms_spectrum_worker_t *w;
+
+  if ((w=(tms_spectrum_worker_t *)calloc(1,sizeof(tms_spectrum_worker_t)))==NULL) { 
+    return(NULL); 
+  }
+  w->nchn=nchn; w->cb=cb; w->arg=arg;
+  w->s=(tms_spectrum_t **)calloc(nchn,sizeof(tms_spectrum_t *));
+  w->q=(tms_spectrum_blk_t *)calloc(TMSSPECQ,sizeof(tms_spectrum_blk_t));
+  if ((w->s==NULL) || (w->q==NULL) || (sem_init(&w->sem,0,0)!=0)) {
+    fprintf(stderr,"# Error: tms_spectrum_worker_new allocation problem\n");
+    if (w->s!=NULL) free(w->s);
+    if (w->q!=NULL) free(w->q);
+    free(w);
+    return(NULL);
+  }
+  if (pthread_create(&w->tid,NULL,tms_spectrum_worker,w)!=0) {
+    fprintf(stderr,"# Error: tms_spectrum_worker_new can't start thread\n");
+    sem_destroy(&w->sem);
+    free(w->s); free(w->q); free(w);
+    return(NULL);
+  }
+  return(w);
+}
+
+/** Enable spectrum 'nfft', 'hop', 'navg' of channel 'chn' with sample frequency 'fs'
+ *   in worker 'w', before its first block is pushed.
+ * @return 0 on success, <0 on failure
+*/
+int32_t tms_spectrum_worker_chn(tms_spectrum_worker_t *w, int32_t chn, double fs,
+  int32_t nfft, int32_t hop, int32_t navg) {
+
+  if ((chn<0) || (chn>=w->nchn)) { return(-1); }
+  if (w->s[chn]!=NULL) { return(0); }
+  if ((w->s[chn]=tms_spectrum_new(fs,nfft,hop,navg))==NULL) { return(-2); }
+  return(0);
+}
+
+/** Queue the received samples of channel data 'c' of channel 'chn', starting 
+ *   at time 't' for worker 'w', never waits: one producer thread only.
+ * @return number of queued samples, less than c->rs when the queue is full
+*/
+int32_t tms_spectrum_worker_push(tms_spectrum_worker_t *w, int32_t chn, double t,
+  const tms_channel_data_t *c) {
+
+  tms_spectrum_blk_t *b;   /**< block to fill */
+  int32_t i=0,k;           /**< sample index */
+
+  if ((chn<0) || (chn>=w->nchn) || (w->s[chn]==NULL)) { return(0); }
+
+  while (i<c->rs) {
+    if (w->head-__atomic_load_n(&w->tail,__ATOMIC_ACQUIRE)>=TMSSPECQ) {
+      /* worker is behind: drop samples instead of waiting */
+      if (w->drop==0) {
+        fprintf(stderr,"# Warning: spectrum queue full, dropping samples\n");
+      }
+      w->drop+=c->rs-i;
+      break;
+    }
+    b=&w->q[w->head&(TMSSPECQ-1)];
+    b->chn=chn;
+    b->t=t+i*c->td;
+    for (k=0; (k<TMSSPECBLK) && (i<c->rs); k++, i++) {
+      b->x[k]=c->data[i].sample;
+    }
+    b->n=k;
+    __atomic_store_n(&w->head,w->head+1,__ATOMIC_RELEASE);
+    sem_post(&w->sem);
+  }
+  return(i);
+}
+
+/** Stop and free worker 'w' and its spectra
+*/
+void tms_spectrum_worker_free(tms_spectrum_worker_t *w) {
+
+  int32_t j;
+
+  if (w==NULL) return;
+  w->stop=1;
+  sem_post(&w->sem);
+  pthread_join(w->tid,NULL);
+  sem_destroy(&w->sem);
+  for (j=0; j<w->nchn; j++) {
+    tms_spectrum_free(w->s[j]);
+  }
+  free(w->s);
+  free(w->q);
+  free(w);
+}
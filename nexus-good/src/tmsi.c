@@ -60,6 +60,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <malloc.h>
 
 #include "tmsi.h"
+#include "tms_io.h"
 
 #define VERSION "$Revision: 0.1 $"
 
@@ -622,6 +623,8 @@ int32_t tms_cvt_date(int32_t *wrd, time_t *t) {
     cal.tm_min =wrd[5];
     /* seconds since the minute [0,59] */
     cal.tm_sec =wrd[6];
+    /* let mktime decide on daylight saving time */
+    cal.tm_isdst=-1;
     /* convert to broken calendar to calendar */
     (*t)=mktime(&cal);
     return(0);
@@ -2144,17 +2147,19 @@ int32_t tms_flag_samples(tms_channel_data_t *chn, int32_t chn_cnt, int32_t flg)
  *            A: 0x01 B: 0x02 C: 0x04 ...
  * @param cs: channel selector A: 0x01 B: 0x02 C: 0x04 ...
  * @param nchn: number of channels: i.e. tms_get_number_of_channels()
+ * @note samples are formatted into a text buffer of this call, so threads
+ *   may print concurrently
  * @return number of characters printed.
  */
 int32_t tms_prt_samples(FILE *fp, tms_channel_data_t *chd, int32_t cs, int32_t md, int32_t nchn)
 {
   int32_t nc=0;                 /**< number of characters printed */ 
-  static int32_t maxns=0;       /**< maximum number of samples over all channels */
-  int32_t mns;                  /**< current maxns */
+  edf_fmt_t *out;               /**< text buffer */
+  int32_t mns;                  /**< maximum number of samples over all channels */
   int32_t cnt;                  /**< number of channels with equal number of samples */
   int32_t i,j,jm,idx;           /**< general index */
   int32_t ssf;                  /**< sub-sample factor */
-  static tms_data_t *prt=NULL;  /**< printer storage for all samples over all channels */
+  tms_data_t *prt;              /**< printer storage for all samples over all channels */
 
   /* print output file header */
   if (chd[0].sc==0) {
@@ -2173,37 +2178,37 @@ int32_t tms_prt_samples(FILE *fp, tms_channel_data_t *chd, int32_t cs, int32_t m
     if (chd[j].ns==chd[0].ns) { cnt++; }
     if (mns<chd[j].ns)  { mns=chd[j].ns; }
   }
+
+  /* text buffer for the rows of this call, about 10 characters per number */
+  if ((out=edf_fmt_new(fp,(mns+1)*(nchn+2)*10))==NULL) { return(nc); }
   
   /* trival print when all channels have equal number of samples */
   if (cnt==nchn) {
     for (i=0; i<chd[0].ns; i++) {
-      nc+=fprintf(fp," %9.4f",(chd[0].sc+i)*chd[0].td);
+      edf_fmt_put_chr(out,' '); edf_fmt_put_fixed(out,(chd[0].sc+i)*chd[0].td,9,4);
       for (j=0; j<nchn; j++) {
         if (cs&(1<<j)) {
+          edf_fmt_put_chr(out,' ');
           if (chd[j].data[i].flag > 0) {
-             nc+=fprintf(fp," %9s","NaN");
+            edf_fmt_put_str(out,"NaN",9);
           } else {
             if (md&(1<<j)) {
-              nc+=fprintf(fp," %9.3f",chd[j].data[i].sample);
+              edf_fmt_put_fixed(out,chd[j].data[i].sample,9,3);
             } else {
-              nc+=fprintf(fp," %9d",chd[j].data[i].isample);
+              edf_fmt_put_int(out,chd[j].data[i].isample,9);
             }
           }
         }
       }
-      nc+=fprintf(fp," %d\n",(chd[0].sc+i));
+      edf_fmt_put_chr(out,' '); edf_fmt_put_int(out,chd[0].sc+i,0); edf_fmt_put_chr(out,'\n');
     }
-    return(nc); 
+    return(nc+(int32_t)edf_fmt_free(out)); 
   }
   
-  if (mns>maxns) {
-    maxns=mns;
-    if (prt!=NULL) { 
-      /* free previous printer storage space */
-      free(prt); 
-    }
-    /* malloc storage space for rectangle print data array */
-    prt=(tms_data_t *)calloc(maxns*nchn,sizeof(tms_data_t));
+  /* malloc storage space for rectangle print data array */
+  if ((prt=(tms_data_t *)calloc(mns*nchn,sizeof(tms_data_t)))==NULL) {
+    fprintf(stderr,"# Error: can't allocate print storage!!!\n");
+    return(nc+(int32_t)edf_fmt_free(out));
   }
 
   /* search for channel 'jm' with maximum number of samples over all wanted channels */
@@ -2222,7 +2227,7 @@ int32_t tms_prt_samples(FILE *fp, tms_channel_data_t *chd, int32_t cs, int32_t m
     if (cs&(1<<j)) {
       ssf=mns/chd[j].ns;
       for (i=0; i<mns; i++) {
-        idx=maxns*j+i;
+        idx=mns*j+i;
         if ((i % ssf)==0) {
           /* copy samples into rectanglar array 'ptr' */
           prt[idx]=chd[j].data[i/ssf];
@@ -2236,25 +2241,27 @@ int32_t tms_prt_samples(FILE *fp, tms_channel_data_t *chd, int32_t cs, int32_t m
 
   /* print all wanted channels */
   for (i=0; i<mns; i++) {
-    nc+=fprintf(fp," %9.4f",(chd[jm].sc+i)*chd[jm].td);
+    edf_fmt_put_chr(out,' '); edf_fmt_put_fixed(out,(chd[jm].sc+i)*chd[jm].td,9,4);
     for (j=0; j<nchn; j++) {
       if (cs&(1<<j)) {
-        idx=maxns*j+i;
+        idx=mns*j+i;
+        edf_fmt_put_chr(out,' ');
         if (prt[idx].flag!=0) {
           /* all overflows and not availables are mapped to "NaN" */
-          nc+=fprintf(fp," %9s","NaN");
+          edf_fmt_put_str(out,"NaN",9);
         } else {
           if (md&(1<<j)) {
-            nc+=fprintf(fp," %9.3f",prt[idx].sample);
+            edf_fmt_put_fixed(out,prt[idx].sample,9,3);
           } else {
-              nc+=fprintf(fp," %9d",prt[idx].isample);
+            edf_fmt_put_int(out,prt[idx].isample,9);
           } 
         }
       }
     }
-    nc+=fprintf(fp," %8d\n",chd[jm].sc+i);
+    edf_fmt_put_chr(out,' '); edf_fmt_put_int(out,chd[jm].sc+i,8); edf_fmt_put_chr(out,'\n');
   }
-  return(nc);
+  free(prt);
+  return(nc+(int32_t)edf_fmt_free(out));
 }
 
 /** Send VLDeltaInfo request to file descriptor 'fd'
@@ -2614,6 +2621,178 @@ int32_t get_saw_len_from_input_device(tms_input_device_t *dev) {
 static int32_t state=0;   /**< State machine */
 static int32_t fd=0;      /**< File descriptor of bluetooth socket */
 
+#define TMSPRFMAGIC "TMSIPRF1"  /**< device profile file identification */
+
+/** Device profile: ID data and VLDelta info of one frontend */
+typedef struct TMS_PROFILE_T {
+  uint32_t serialnumber;     /**< frontend serial number */
+  uint16_t hwversion;        /**< frontend hardware version number */
+  uint16_t swversion;        /**< frontend software version number */
+  uint16_t nrofswchannels;   /**< total nr of channels in frontend */
+  uint16_t basesamplerate;   /**< base sample frequency [Hz] */
+  int32_t  srd;              /**< sample rate divider of 'vldmsg', -1: none */
+  uint8_t *idmsg;            /**< raw ID data message */
+  int32_t  nid;              /**< bytes in 'idmsg' */
+  uint8_t *vldmsg;           /**< raw VLDelta info message */
+  int32_t  nvld;             /**< bytes in 'vldmsg' */
+  tms_input_device_t dev;    /**< parsed ID data */
+  tms_vldelta_info_t vld;    /**< parsed VLDelta info */
+  struct TMS_PROFILE_T *next;/**< next cached profile */
+} tms_profile_t;
+
+static tms_profile_t *prf_list=NULL; /**< profiles of all devices seen */
+static char *prf_dir=NULL;           /**< profile directory, NULL: memory only */
+
+/** Keep device profiles also in files in directory 'dir', NULL: memory only.
+ * @return 0 on success, -1 on failure
+*/
+int32_t tms_set_profile_dir(const char *dir) {
+
+  free(prf_dir); prf_dir=NULL;
+  if ((dir==NULL) || (strlen(dir)<1)) { return(0); }
+  if ((prf_dir=strdup(dir))==NULL) { return(-1); }
+#ifndef _MSC_VER
+  /* create it when needed, an existing directory is fine */
+  mkdir(prf_dir,0755);
+#endif
+  return(0);
+}
+
+/** Check whether profile 'p' belongs to frontend info 'f'
+ * @return 1 on match, 0 otherwise
+*/
+static int32_t tms_prf_match(const tms_profile_t *p, const tms_frontendinfo_t *f) {
+
+  return((p->serialnumber==f->serialnumber) && (p->hwversion==f->hwversion) &&
+    (p->swversion==f->swversion) && (p->nrofswchannels==f->nrofswchannels) &&
+    (p->basesamplerate==f->basesamplerate));
+}
+
+/** Write profile 'p' to the profile directory
+ * @return 0 on success, -1 on failure
+*/
+static int32_t tms_prf_save(const tms_profile_t *p) {
+
+  char    fname[MNCN];  /**< profile file name */
+  char    tname[MNCN];  /**< temporary file name */
+  int32_t hdr[8];       /**< profile fields */
+  FILE   *fp;
+  int32_t ok;
+
+  if ((prf_dir==NULL) || (p->idmsg==NULL)) { return(0); }
+  snprintf(fname,MNCN,"%s/tmsi_%u.prf",prf_dir,p->serialnumber);
+  snprintf(tname,MNCN,"%s.tmp",fname);
+  if ((fp=fopen(tname,"wb"))==NULL) {
+    fprintf(stderr,"# Warning: can't write device profile %s\n",tname);
+    return(-1);
+  }
+  hdr[0]=p->serialnumber; hdr[1]=p->hwversion; hdr[2]=p->swversion;
+  hdr[3]=p->nrofswchannels; hdr[4]=p->basesamplerate; hdr[5]=p->srd;
+  hdr[6]=p->nid; hdr[7]=(p->vldmsg!=NULL) ? p->nvld : 0;
+  ok=(fwrite(TMSPRFMAGIC,1,8,fp)==8) && (fwrite(hdr,sizeof(int32_t),8,fp)==8) &&
+    (fwrite(p->idmsg,1,hdr[6],fp)==(size_t)hdr[6]) &&
+    (fwrite(p->vldmsg,1,hdr[7],fp)==(size_t)hdr[7]);
+  if ((fclose(fp)!=0) || !ok || (rename(tname,fname)!=0)) {
+    remove(tname);
+    return(-1);
+  }
+  return(0);
+}
+
+/** Read the profile of frontend 'f' from the profile directory
+ * @return pointer to new profile, NULL when not available
+*/
+static tms_profile_t *tms_prf_load(const tms_frontendinfo_t *f) {
+
+  char    fname[MNCN];  /**< profile file name */
+  char    magic[8];     /**< file identification */
+  int32_t hdr[8];       /**< profile fields */
+  FILE   *fp;
+  tms_profile_t *p;
+
+  if (prf_dir==NULL) { return(NULL); }
+  snprintf(fname,MNCN,"%s/tmsi_%u.prf",prf_dir,f->serialnumber);
+  if ((fp=fopen(fname,"rb"))==NULL) { return(NULL); }
+  if ((fread(magic,1,8,fp)!=8) || (memcmp(magic,TMSPRFMAGIC,8)!=0) ||
+      (fread(hdr,sizeof(int32_t),8,fp)!=8) || (hdr[6]<=0) || (hdr[6]>0x10000) ||
+      (hdr[7]<0) || (hdr[7]>0x10000)) {
+    fclose(fp);
+    return(NULL);
+  }
+  p=(tms_profile_t *)calloc(1,sizeof(tms_profile_t));
+  if (p!=NULL) {
+    p->serialnumber=hdr[0]; p->hwversion=hdr[1]; p->swversion=hdr[2];
+    p->nrofswchannels=hdr[3]; p->basesamplerate=hdr[4]; p->srd=hdr[5];
+    p->nid=hdr[6]; p->nvld=hdr[7];
+    p->idmsg=(uint8_t *)malloc(p->nid);
+    p->vldmsg=(uint8_t *)malloc(p->nvld+1);
+  }
+  if ((p==NULL) || (p->idmsg==NULL) || (p->vldmsg==NULL) ||
+      (fread(p->idmsg,1,p->nid,fp)!=(size_t)p->nid) ||
+      (fread(p->vldmsg,1,p->nvld,fp)!=(size_t)p->nvld) ||
+      !tms_prf_match(p,f) || (tms_chk_msg(p->idmsg,p->nid)!=0) ||
+      (tms_get_iddata(p->idmsg,p->nid,&p->dev)!=0)) {
+    fprintf(stderr,"# Warning: ignore device profile %s\n",fname);
+    if (p!=NULL) { free(p->idmsg); free(p->vldmsg); free(p); }
+    fclose(fp);
+    return(NULL);
+  }
+  fclose(fp);
+  if ((p->nvld<=0) || (tms_chk_msg(p->vldmsg,p->nvld)!=0) ||
+      (tms_get_vldelta_info(p->vldmsg,p->nvld,p->dev.NrOfChannels,&p->vld)<0)) {
+    /* ID data is fine, VLDelta info will be requested again */
+    p->srd=-1;
+  }
+  return(p);
+}
+
+/** Find the profile of frontend 'f' in memory or in the profile directory
+ * @return pointer to profile, NULL when not available
+*/
+static tms_profile_t *tms_prf_find(const tms_frontendinfo_t *f) {
+
+  tms_profile_t *p;
+
+  for (p=prf_list; p!=NULL; p=p->next) {
+    if (tms_prf_match(p,f)) { return(p); }
+  }
+  if ((p=tms_prf_load(f))!=NULL) {
+    p->next=prf_list; prf_list=p;
+  }
+  return(p);
+}
+
+/** Store ID data message 'msg' of 'n' bytes of frontend 'f' in a new profile
+ * @return pointer to profile, NULL on failure
+*/
+static tms_profile_t *tms_prf_new(const tms_frontendinfo_t *f, const uint8_t *msg, int32_t n) {
+
+  tms_profile_t *p;
+
+  if ((p=(tms_profile_t *)calloc(1,sizeof(tms_profile_t)))==NULL) { return(NULL); }
+  if ((p->idmsg=(uint8_t *)malloc(n))==NULL) { free(p); return(NULL); }
+  memcpy(p->idmsg,msg,n); p->nid=n;
+  p->serialnumber=f->serialnumber; p->hwversion=f->hwversion; p->swversion=f->swversion;
+  p->nrofswchannels=f->nrofswchannels; p->basesamplerate=f->basesamplerate;
+  p->srd=-1;
+  p->next=prf_list; prf_list=p;
+  return(p);
+}
+
+/** Store VLDelta info message 'msg' of 'n' bytes for sample rate divider 'srd'
+ *   in profile 'p' and save the profile.
+ * @return 0 on success, -1 on failure
+*/
+static int32_t tms_prf_set_vld(tms_profile_t *p, const uint8_t *msg, int32_t n, int32_t srd) {
+
+  uint8_t *m;
+
+  if ((m=(uint8_t *)realloc(p->vldmsg,n))==NULL) { return(-1); }
+  memcpy(m,msg,n);
+  p->vldmsg=m; p->nvld=n; p->srd=srd;
+  return(tms_prf_save(p));
+}
+
 /** Initialize TMSi device with Bluetooth address 'fname' and
  *   sample rate divider 'sample_rate_div'.
  * @note no timeout implemented yet.
@@ -2631,10 +2810,15 @@ int32_t tms_init(int32_t fdd, int32_t sample_rate_div) {
   int32_t transmit=1;            /**< retransmit last request */
   
   tms_acknowledge_t  ack;        /**< TMS acknowlegde */
+  tms_profile_t *prf=NULL;       /**< cached profile of this device */
   
-  fei = (tms_frontendinfo_t *)malloc(sizeof(tms_frontendinfo_t));
-  vld = (tms_vldelta_info_t *)malloc(sizeof(tms_vldelta_info_t));
-  in_dev = (tms_input_device_t *)malloc(sizeof(tms_input_device_t));
+  /* ID data and VLDelta info live in the device profile */
+  if (fei==NULL) {
+    fei = (tms_frontendinfo_t *)malloc(sizeof(tms_frontendinfo_t));
+  }
+  if (fei==NULL) {
+    return(-1);
+  }
 
   if (fdd<0) {
     return(-1);
@@ -2729,6 +2913,8 @@ int32_t tms_init(int32_t fdd, int32_t sample_rate_div) {
             if (tms_vb&0x02) {
               tms_prt_frontendinfo(stderr,fei,0,(0==0));
             }
+            /* a known device doesn't need its ID data again */
+            prf=tms_prf_find(fei);
             state++;
             send=0; received=0; transmit=1;
           }
@@ -2745,16 +2931,40 @@ int32_t tms_init(int32_t fdd, int32_t sample_rate_div) {
             }
             state++;
             send=0; received=0; transmit=1;
+            if (prf!=NULL) {
+              fprintf(stderr,"# Info: use device profile of serial number %u\n",prf->serialnumber);
+              in_dev=&prf->dev;
+              get_saw_len_from_input_device(in_dev);
+              state=3;
+              if (prf->srd==sample_rate_div) {
+                vld=&prf->vld;
+                state=4;
+              }
+            }
           }
           break;
         case TMSVLDELTAINFO:
-          tms_get_vldelta_info(resp,br,in_dev->NrOfChannels,vld);
+          if ((prf==NULL) || (state!=3)) { break; }
+          if (prf->vldmsg!=NULL) {
+            /* VLDelta info of another sample rate divider */
+            free(prf->vld.SampDiv);
+            memset(&prf->vld,0,sizeof(tms_vldelta_info_t));
+          }
+          tms_get_vldelta_info(resp,br,in_dev->NrOfChannels,&prf->vld);
+          vld=&prf->vld;
           if (tms_vb&0x02) {
             tms_prt_vldelta_info(stderr,vld,0,0==0);
           }
+          tms_prf_set_vld(prf,resp,br,sample_rate_div);
           state++;
           break;
         case TMSIDDATA:
+          if (state!=2) { break; }
+          if ((prf=tms_prf_new(fei,resp,br))==NULL) {
+            fprintf(stderr,"# Error: can't allocate device profile!!!\n");
+            return(-1);
+          }
+          in_dev=&prf->dev;
           tms_get_iddata(resp,br,in_dev);
           if (tms_vb&0x02) {
             tms_prt_iddata(stderr,in_dev);
@@ -2949,9 +3159,7 @@ int32_t tms_shutdown()
 
   state=0;
 
-  free(fei);
-  free(vld);
-  free(in_dev);
+  /* frontend info and device profiles are kept for the next tms_init() */
   return(state);
 }
 
@@ -3160,14 +3368,20 @@ int32_t edfWriteHeaders(FILE *fp, edfMainHdr_t *mHdr, edfSignalHdr_t *sHdr,
 /** write BDF (=EDF with 24 iso 16 bits samples) headers to file 'fp'
  *   for continues ExG recording with maximum of 'nch' channel definitions in 'chd', 
  *   channel selection 'cs', person 'id', message 'record', channel names 'chn_name' 
- *   and record duration 'dt' [s].
+ *   and record duration 'dt' [s], with a time keeping annotation signal when 'tal'.
  * @return bytes written to 'fp'
 */
-int32_t edfWriteHdr(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
- const char *id, const char *record, time_t *t, double dt, const char **chn_name) {
+static int32_t edf_wr_tms_hdr(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
+ const char *id, const char *record, time_t *t, double dt, const char **chn_name, int32_t tal) {
 
+  static const char *mon[12]={"JAN","FEB","MAR","APR","MAY","JUN",
+                              "JUL","AUG","SEP","OCT","NOV","DEC"};
   edfMainHdr_t   mHdr;
-  edfSignalHdr_t sHdr[9];    /**< maximum of channels + switch channel */
+  edfSignalHdr_t sHdr[14];   /**< maximum of channels + switch channel + annotations */
+  char     tmp[MNCN];
+  char     pid[MNCN];        /**< EDF+ patient identification */
+  char     rid[MNCN];        /**< EDF+ recording identification */
+  struct tm t0;              /**< start date */
   int32_t  ach=0;            /**< number of active channels */ 
   int32_t  j;                /**< channel index */
   double   uVpb =0.0122150;  /**< uV per bit channel A,B,C and D */
@@ -3179,7 +3393,16 @@ int32_t edfWriteHdr(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
     if (cs&(1<<j)) { ach++; }
   }
   
-  edfFillMainHdr(&mHdr,1,id,record,"TMSi",t,-1,dt,ach);
+  if (tal) {
+    /* EDF+ subfields: unknown patient code, sex, birthdate and name, then the
+       start date and unknown admin code, technician and equipment */
+    localtime_r(t,&t0);
+    snprintf(pid,sizeof(pid),"X X X X %.72s",id);
+    snprintf(rid,sizeof(rid),"Startdate %02d-%s-%04d X X X %.46s",
+      t0.tm_mday,mon[t0.tm_mon],t0.tm_year+1900,record);
+    id=pid; record=rid;
+  }
+  edfFillMainHdr(&mHdr,1,id,record,"TMSi",t,-1,dt,ach+(tal!=0));
   /* make all signal header for all active channels */
   j=0;
   if (cs&0x01) {
@@ -3248,17 +3471,62 @@ int32_t edfWriteHdr(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
     j++;
   }
 
+  if (tal) {
+    /* BDF+ with a time keeping annotation per record, records may have gaps */
+    edfFillSignalHdr(&sHdr[j],"BDF Annotations","","",-1,1,-digMax,digMax-1,"",ANNOTRECSIZE/3);
+    j++;
+    sprintf(tmp,"%-44s","BDF+D"); memcpy(mHdr.DataFormatVersion,tmp,44);
+  }
+
   /* write EDF/BDF main and 'j' signal headers */
   return(edfWriteHeaders(fp,&mHdr,sHdr,j));
 }
 
+/** write BDF (=EDF with 24 iso 16 bits samples) headers to file 'fp'
+ *   for continues ExG recording with maximum of 'nch' channel definitions in 'chd', 
+ *   channel selection 'cs', person 'id', message 'record', channel names 'chn_name' 
+ *   and record duration 'dt' [s].
+ * @return bytes written to 'fp'
+*/
+int32_t edfWriteHdr(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
+ const char *id, const char *record, time_t *t, double dt, const char **chn_name) {
+
+  return(edf_wr_tms_hdr(fp,chd,nch,cs,id,record,t,dt,chn_name,0));
+}
+
+/** write BDF+D headers to file 'fp' like edfWriteHdr() with an extra "BDF Annotations"
+ *   signal for the time keeping annotation of every record, see edfWriteSamplesPlus().
+ *   'id' follows the EDF+ patient subfields "X X X X", 'record' the recording 
+ *   subfields "Startdate dd-MMM-yyyy X X X".
+ * @return bytes written to 'fp'
+*/
+int32_t edfWriteHdrPlus(FILE *fp, tms_channel_data_t *chd, int32_t nch, int32_t cs,
+ const char *id, const char *record, time_t *t, double dt, const char **chn_name) {
+
+  return(edf_wr_tms_hdr(fp,chd,nch,cs,id,record,t,dt,chn_name,1));
+}
+
+
+/** Write time keeping annotation with 'onset' [s] of ANNOTRECSIZE bytes to file 'fp'
+ * @return number of bytes written
+*/
+static int32_t edf_wr_tal(FILE *fp, double onset) {
+
+  char tal[ANNOTRECSIZE];
+
+  memset(tal,0,ANNOTRECSIZE);
+  snprintf(tal,ANNOTRECSIZE,"%+.6f%c%c",onset,20,20);
+  return((int32_t)fwrite(tal,1,ANNOTRECSIZE,fp));
+}
 
 /** write samples in 'chd' to EDF (bdf==0) or BDF (bdf==1) file 'fp' with
- *   channel selection switch 'cs' and 'mpc' missed packets before this 'chd'.
+ *   channel selection switch 'cs' and 'mpc' missed packets before this 'chd',
+ *   each record ends with a time keeping annotation when 'tal': 'onset' [s] for 
+ *   'chd' and 'dur' [s] less for every missed packet before it.
  * @return number of bytes written
 */
-int32_t edfWriteSamples(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
- int32_t cs, int32_t mpc) {
+static int32_t edf_wr_tms_samples(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
+ int32_t cs, int32_t mpc, int32_t tal, double onset, double dur) {
 
   int32_t i,j,k;
   int32_t nc=0;
@@ -3278,6 +3546,7 @@ int32_t edfWriteSamples(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
         }
       }
     }
+    if (tal) { nc+=edf_wr_tal(fp,onset-k*dur); }
   }
   
   /* Check all active channels (0x00FF) and switch channel (0x1000) */
@@ -3291,9 +3560,85 @@ int32_t edfWriteSamples(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
       }
     }
   }
+  if (tal) { nc+=edf_wr_tal(fp,onset); }
   return(nc);
 }
 
+/** write samples in 'chd' to EDF (bdf==0) or BDF (bdf==1) file 'fp' with
+ *   channel selection switch 'cs' and 'mpc' missed packets before this 'chd'.
+ * @return number of bytes written
+*/
+int32_t edfWriteSamples(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
+ int32_t cs, int32_t mpc) {
+
+  return(edf_wr_tms_samples(fp,bdf,chd,cs,mpc,0,0.0,0.0));
+}
+
+/** write samples in 'chd' like edfWriteSamples() to a file with headers of 
+ *   edfWriteHdrPlus(): every record ends with its time keeping annotation, 
+ *   'onset' [s] since the start time for 'chd' and 'dur' [s] less for every 
+ *   missed packet before it.
+ * @return number of bytes written
+*/
+int32_t edfWriteSamplesPlus(FILE *fp, int32_t bdf, tms_channel_data_t *chd,
+ int32_t cs, int32_t mpc, double onset, double dur) {
+
+  return(edf_wr_tms_samples(fp,bdf,chd,cs,mpc,1,onset,dur));
+}
+
+/** Add summary of samples in 'chd' with channel selection switch 'cs' and 'mpc'
+ *   missed packets before this 'chd' to summary index 'si', like edfWriteSamples()
+ *   writes them: one record per packet. Flagged and missed samples count as overflow.
+ * @return number of records in 'si', <0 on failure
+*/
+int32_t edfSumSamples(edf_sum_idx_t *si, tms_channel_data_t *chd,
+ int32_t cs, int32_t mpc) {
+
+  int32_t i,j,k,n;
+  int32_t sample=0;
+  int32_t len=0;
+  double  sum;
+  edf_sum_t *rec = alloca(si->ns*sizeof(edf_sum_t));
+  int32_t rv=0;
+
+  for (k=mpc; k>=0; k--) {
+    n=0;
+    /* Check all active channels (0x00FF) and switch channel (0x1000) */
+    for (j=0; (j<tms_get_number_of_channels()) && (n<si->ns); j++) {
+      /* is channel 'j' active? */
+      if (cs&(1<<j)) {
+        if (k>0) {
+          /* missed packet is filled with first sample */
+          sample=chd[j].data[0].isample;
+          rec[n].min=sample; rec[n].max=sample; rec[n].mean=(float)sample; 
+          rec[n].ovf=chd[j].ns; rec[n].flat=chd[j].ns;
+        } else {
+          rec[n].min=INT32_MAX; rec[n].max=INT32_MIN; rec[n].ovf=0; sum=0.0;
+          rec[n].flat=0; len=0;
+          for (i=0; i<chd[j].ns; i++) {
+            if (i<chd[j].rs) { 
+              len = ((i>0) && (chd[j].data[i].isample==sample)) ? len+1 : 1;
+              sample=chd[j].data[i].isample; 
+              if (chd[j].data[i].flag!=0) { rec[n].ovf++; }
+            } else {
+              len++;
+            }
+            if (len>rec[n].flat) { rec[n].flat=len; }
+            if (sample<rec[n].min) { rec[n].min=sample; }
+            if (sample>rec[n].max) { rec[n].max=sample; }
+            sum+=sample;
+          }
+          rec[n].mean=(chd[j].ns>0) ? (float)(sum/chd[j].ns) : 0.0f;
+        }
+        n++;
+      }
+    }
+    if ((rv=edf_sum_add_rec(si,rec))<0) { break; }
+  }
+  if (si->fp!=NULL) { fflush(si->fp); }
+  return(rv);
+}
+
 /** Construct tms_channel_data_t out of 'edf' header info.
  * @return pointer to channel_data_t struct, NULL on failure.
  */
@@ -3325,7 +3670,8 @@ tms_channel_data_t *edf_alloc_channel_data(edf_t *edf) {
 }
 
 /** Read one block of channel data from EDF/BDF data structure 'edf'
- *   into tms channel data structure 'chn'.
+ *   into tms channel data structure 'chn'. Missing packets are the gaps in
+ *   the record time stamps 'edf->rts' of EDF+D/BDF+D or flat blocks otherwise.
  * @return number of samples read, 0 on failure.
  */
 int32_t edf_rd_chn(edf_t *edf, tms_channel_data_t *chn) {
@@ -3333,21 +3679,34 @@ int32_t edf_rd_chn(edf_t *edf, tms_channel_data_t *chn) {
   int32_t i,j;               /**< general index */
   int32_t cnt=0;             /**< total sample counter */
   int32_t isample;           /**< integer sample value */
-  int32_t *dc_cnt;           /**< DC counter per channel */
+  int32_t flat=1;            /**< all signals are flat in this packet */
   int32_t missing=0;         /**< missing packet detected */
   static int32_t pre_miss=0; /**< previous packet was missing */
   static int32_t miss_cnt=0; /**< missing packet counter */
   static double ts=0.0;      /**< start time of missing packets */
   static double dt=0.0;      /**< duration of missing packets */
-
-  dc_cnt = alloca( edf->NrOfSignals * sizeof(dc_cnt[0]) );
+  int32_t k;                 /**< record index of this block */
+  double  gap=0.0;           /**< gap [s] before this block */
+
+  /* a block at the start of a record may follow a gap in the time stamps */
+  if ((edf->rts!=NULL) && (edf->signal[0].NrOfSamplesPerRecord>0) &&
+      (chn[0].sc % edf->signal[0].NrOfSamplesPerRecord == 0)) {
+    k=chn[0].sc / edf->signal[0].NrOfSamplesPerRecord;
+    if ((gap=edf_rts_gap(edf,k)) > 0.0) {
+      miss_cnt++;
+      fprintf(stderr,"# Warning %d : missing packet(s) at %9.3f [s] duration %6.3f [s]\n",
+               miss_cnt,edf->rts[k]-gap,gap);
+    }
+  }
 
   /* read edf samples for all signals */
   for (i=0; i<edf->NrOfSignals; i++) {
     chn[i].rs=0;
     if (chn[i].sc < edf->signal[i].NrOfSamples) {
-      /* reset DC counter of signal 'i' */
-      dc_cnt[i]=0;
+      /* a missing packet is flat in all signals */
+      if (edf_flat_len(&edf->signal[i].data[chn[i].sc], chn[i].ns) != chn[i].ns) {
+        flat=0;
+      }
       /* read all samples of signal 'i' */
       for (j=0; j<chn[i].ns; j++) {
         /* get current integer sample value of signal 'i'*/
@@ -3358,10 +3717,6 @@ int32_t edf_rd_chn(edf_t *edf, tms_channel_data_t *chn) {
           (edf->signal[i].PhysicalMax - edf->signal[i].PhysicalMin) /
           (edf->signal[i].DigitalMax - edf->signal[i].DigitalMin)
 		  );
-        /* count number of times first sample equals all other samples */
-        if (isample==chn[i].data[0].isample) {
-          dc_cnt[i]++;
-        }
       }
       /* admin converted isamples */
       chn[i].rs=chn[i].ns;
@@ -3371,11 +3726,7 @@ int32_t edf_rd_chn(edf_t *edf, tms_channel_data_t *chn) {
   }
 
   /* check if all channels have equal samples */
-  if (dc_cnt[0]>1) { missing=0x02; } else { missing=0x00; }
-  for (i=0; i<edf->NrOfSignals; i++) {
-    /* check channel 'i' */
-    if (dc_cnt[i]!=chn[i].ns) { missing=0; }
-  }
+  if ((flat==1) && (chn[0].ns>1) && (edf->rts==NULL)) { missing=0x02; } else { missing=0x00; }
 
   /* print timing of missing packets */
   if (pre_miss) {
@@ -3406,6 +3757,11 @@ int32_t edf_rd_chn(edf_t *edf, tms_channel_data_t *chn) {
 
 int32_t BtWriteBytes( int32_t fd, const uint8_t * buf, int32_t count )
 {
+  tms_io_t *io=tms_io_get(fd);  /**< transport of 'fd' */
+
+  if (io!=NULL) {
+    return(tms_io_write(io,buf,count));
+  }
 #ifdef _MSC_VER
   count=send(fd,(const char *)buf,count,0);
 #else
@@ -3416,6 +3772,11 @@ int32_t BtWriteBytes( int32_t fd, const uint8_t * buf, int32_t count )
 
 int32_t BtReadBytes( int fd, uint8_t * buf, int count )
 {
+  tms_io_t *io=tms_io_get(fd);  /**< transport of 'fd' */
+
+  if (io!=NULL) {
+    return(tms_io_read(io,buf,count));
+  }
 #ifdef _MSC_VER
   count=recv(fd,(char *)buf,count,0);
 #else
@@ -62,8 +62,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "tmsi_bluez.h"
 #include "tmsi.h"
-
-static int32_t socket_fd = -1;
+#include "tms_io.h"
 
 /* To catch Ctrl-C
  */
@@ -71,8 +70,8 @@ void signal_handler(int sig) {
   
   (void) sig;    // Avoid warning about unused parameter
 
-  fprintf(stderr, "# Info: Caught Ctrl-C, closing file descriptor to socket %d\n", socket_fd);
-  tms_close_port();
+  fprintf(stderr, "# Info: Caught Ctrl-C, closing all device transports\n");
+  tms_close_port(-1);
 //  signal(SIGINT, SIG_DFL);
 #ifdef _MSC_VER
   abort();
@@ -81,74 +80,61 @@ void signal_handler(int sig) {
 #endif
 }
 
-/** Open bluetooth device 'fname' to TMSi aquisition device
- *  Nexus-10 or Mobi-8.
- * @return socket >0 on success <0 on failure
+/** Open bluetooth RFCOMM socket of transport 'io' to MAC address 'fname'
+ * @return 0 on success <0 on failure
  */
-int32_t tms_open_port(char *fname) {
+static int32_t tms_rfcomm_open(tms_io_t *io, const char *fname) {
  
-  uint8_t    msg[8];   /**< BT message buffer */
-  int32_t    br=0;     /**< bytes read */
-  int32_t    cnt=0;    /**< byte counter */
-
 #ifdef _MSC_VER
-  /* set sig handler to catch ^c */
-  //signal(SIGINT, signal_handler);
-
   SOCKADDR_BTH addr = {0, 0, 0, 0};
   int iAddrLen      = sizeof(addr);
   u_long iMode      = 0;
 
   /* allocate a socket */
-  socket_fd = socket(AF_BTH, SOCK_STREAM, BTHPROTO_RFCOMM);
-  if ( INVALID_SOCKET == socket_fd ) {
+  io->fd = socket(AF_BTH, SOCK_STREAM, BTHPROTO_RFCOMM);
+  if ( INVALID_SOCKET == io->fd ) {
     fprintf(stderr,"# Error socket() call failed. WSAGetLastError = [%d]\n", WSAGetLastError());
-    socket_fd = -1;
-    return socket_fd; 
+    io->fd = -1;
+    return -1; 
   }
 
   fprintf(stderr,"# Info: Try to open bluetooth socket to MAC address %s\n",fname);
 
   /* set the connection parameters (who to connect to) */
-  if ( 0 != WSAStringToAddress(fname, AF_BTH, NULL, (LPSOCKADDR)&addr, &iAddrLen) ) {
+  if ( 0 != WSAStringToAddress((char *)fname, AF_BTH, NULL, (LPSOCKADDR)&addr, &iAddrLen) ) {
     fprintf(stderr,"# Error unable to get address of the remote radio having name %s\n", fname);	
-    closesocket (socket_fd);
-    socket_fd = -1;
-    return socket_fd; 
+    closesocket (io->fd);
+    io->fd = -1;
+    return -1; 
   }
 
   /* open connection to TMSi hardware */
   addr.port = 1;   // Or BT_PORT_ANY ??
-  if ( SOCKET_ERROR == connect(socket_fd, (struct sockaddr *) &addr,  sizeof(SOCKADDR_BTH))) {
+  if ( SOCKET_ERROR == connect(io->fd, (struct sockaddr *) &addr,  sizeof(SOCKADDR_BTH))) {
     fprintf(stderr,"# Error  connect() call failed. WSAGetLastError=[%d]\n", WSAGetLastError());
-    closesocket (socket_fd);
-    socket_fd = -1;
-    return socket_fd; 
+    closesocket (io->fd);
+    io->fd = -1;
+    return -1; 
   }
 
   /* make connection non blocking */
   iMode = 1;
-  if (NO_ERROR != ioctlsocket(socket_fd, FIONBIO, &iMode)){
+  if (NO_ERROR != ioctlsocket(io->fd, FIONBIO, &iMode)){
     fprintf(stderr,"# Error set non-blocking call failed. WSAGetLastError=[%d]\n", WSAGetLastError());
-    close (socket_fd);
-    socket_fd = -1;
-    return socket_fd; 
+    closesocket (io->fd);
+    io->fd = -1;
+    return -1; 
   }
 
-  fprintf(stderr,"# Successfully opened non-blocking socket %d\n",socket_fd);
-
 #else
 
-   /* set sig handler to catch ^c */
-  //signal(SIGINT, signal_handler);
-
   struct  sockaddr_rc addr = { 0 };
   int32_t status;
   int32_t flags;
 
   /* allocate a socket */
-  socket_fd = socket(AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
-  if (socket_fd < 0) {
+  io->fd = socket(AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+  if (io->fd < 0) {
     fprintf(stderr,"# Error: Build Bluetooth socket error!\n");
     return(-2);
   }
@@ -160,28 +146,105 @@ int32_t tms_open_port(char *fname) {
   str2ba(fname, &addr.rc_bdaddr );
 
   /* open connection to TMSi hardware */
-  status = connect(socket_fd, (struct sockaddr *)&addr, sizeof(addr));
+  status = connect(io->fd, (struct sockaddr *)&addr, sizeof(addr));
   if (status<0) { 
     fprintf(stderr,"# Error: socket connection failed %d\n",status);
-    close(socket_fd); 
-    socket_fd = -1;
+    close(io->fd); 
+    io->fd = -1;
     return(-1); 
   }
 
   /* make connection non blocking */
-  if (-1 == (flags = fcntl(socket_fd, F_GETFL, 0))){
+  if (-1 == (flags = fcntl(io->fd, F_GETFL, 0))){
     flags = 0;
   }
-  fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK);
+  fcntl(io->fd, F_SETFL, flags | O_NONBLOCK);
+
+#endif
+  return(0);
+}
+
+/** Read into the 'n' buffers 'iov' from RFCOMM transport 'io' without blocking
+ * @return number of bytes read, 0 or <0 when nothing is available
+ */
+static int32_t tms_rfcomm_readv(tms_io_t *io, const struct iovec *iov, int32_t n) {
 
-  fprintf(stderr,"# Successfully opened non-blocking socket %d\n",socket_fd);
+#ifdef _MSC_VER
+  int32_t i;
+  int32_t br;        /**< bytes read */
+  int32_t tbr=0;     /**< total bytes read */
+
+  for (i=0; i<n; i++) {
+    br=recv(io->fd,(char *)iov[i].iov_base,(int)iov[i].iov_len,0);
+    if (br<=0) { return((tbr>0) ? tbr : br); }
+    tbr+=br;
+    if (br<(int32_t)iov[i].iov_len) { break; }
+  }
+  return(tbr);
+#else
+  return((int32_t)readv(io->fd,iov,n));
+#endif
+}
 
+/** Write 'n' bytes of 'buf' to RFCOMM transport 'io'
+ * @return number of bytes written, <0 on failure
+ */
+static int32_t tms_rfcomm_write(tms_io_t *io, const uint8_t *buf, int32_t n) {
 
+#ifdef _MSC_VER
+  return(send(io->fd,(const char *)buf,n,0));
+#else
+  return((int32_t)write(io->fd,buf,n));
 #endif
+}
+
+/** Get socket of RFCOMM transport 'io'
+ * @return socket
+ */
+static int32_t tms_rfcomm_fd(const tms_io_t *io) {
+  return(io->fd);
+}
 
-  /* read all bytes available in bluetooth buffer */
+/** Close socket of RFCOMM transport 'io'
+ */
+static void tms_rfcomm_close(tms_io_t *io) {
+
+#ifdef  _MSC_VER
+  if (closesocket(io->fd) != 0){
+    fprintf(stderr, "# Info: close_port: Error closing port - %d", WSAGetLastError());
+  }
+#else
+  if (close(io->fd) == -1) {
+    perror("# Info: close_port: Error closing port - ");
+  }
+#endif
+  io->fd = -1;
+}
+
+/** bluetooth RFCOMM transport */
+static const tms_io_ops_t tms_rfcomm = { "rfcomm", tms_rfcomm_open, tms_rfcomm_readv,
+  tms_rfcomm_write, tms_rfcomm_fd, tms_rfcomm_close };
+
+/** Open device 'fname' to TMSi aquisition device Nexus-10 or Mobi-8 on a
+ *  bluetooth MAC address, serial port, TCP bridge or capture file.
+ * @return file descriptor >0 on success <0 on failure
+ */
+int32_t tms_open_port(char *fname) {
+ 
+  tms_io_t  *io;       /**< device transport */
+  uint8_t    msg[64];  /**< BT message buffer */
+  int32_t    br=0;     /**< bytes read */
+  int32_t    cnt=0;    /**< byte counter */
+
+  tms_io_set_ops(TMSIORFCOMM,&tms_rfcomm);
+  if ((io=tms_io_open(fname))==NULL) {
+    return(-1);
+  }
+  fprintf(stderr,"# Successfully opened non-blocking %s transport %d\n",io->ops->name,io->fd);
+
+  /* read all bytes available in bluetooth buffer, a capture file is replayed */
   cnt=0;
-  while ((br=BtReadBytes(socket_fd,msg,1))>0) { 
+  while ((io->type!=TMSIOFILE) && ((br=tms_io_read(io,msg,sizeof(msg)))>0)) { 
     cnt+=br; usleep(100);
   } 
 
@@ -189,28 +252,26 @@ int32_t tms_open_port(char *fname) {
     fprintf(stderr,"# Info: found %d bytes in bluetooth buffer\n",cnt);
   }
   
-  /* return socket */
-  return(socket_fd);
+  /* return file descriptor */
+  return(io->fd);
 }
 
 
-/** Close socket file descriptor 'socket_fd'.
- * @return 0 on successm, errno on failure.
+/** Close device transport with file descriptor 'fd', all transports when 'fd'<0.
+ * @return 0 on success, -1 on failure.
  */
-int32_t tms_close_port() {
+int32_t tms_close_port(int32_t fd) {
 
-#ifdef  _MSC_VER
-  if (closesocket(socket_fd) != 0){
-    int sockError = WSAGetLastError();
-    fprintf(stderr, "# Info: close_port: Error closing port - %d", sockError);
-    return sockError;
+  tms_io_t *io;
+
+  if (fd<0) {
+    tms_io_close_all();
+    return(0);
   }
-#else
-  if (close(socket_fd) == -1) {
-    perror("# Info: close_port: Error closing port - ");
-    return errno;
+  if ((io=tms_io_get(fd))==NULL) {
+    fprintf(stderr,"# Info: close_port: no transport %d\n",fd);
+    return(-1);
   }
-#endif
-  socket_fd = -1;
+  tms_io_close(io);
   return(0);
-}
\ No newline at end of file
+}
@@ -173,12 +173,13 @@ int32_t tms_open_port(char *fname) {
 }
 
 
-/** Close socket file descriptor 'socket_fd'.
+/** Close socket file descriptor 'fd', the opened socket when 'fd'<0.
  * @return 0 on successm, errno on failure.
  */
-int32_t tms_close_port() {
+int32_t tms_close_port(int32_t fd) {
 
-  if (close(socket_fd) == -1) {
+  if (fd<0) { fd=socket_fd; }
+  if (close(fd) == -1) {
     perror("# Info: close_port: Error closing port - ");
     return errno;
   }
@@ -40,6 +40,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <signal.h>
 #include <iostream>
 #include <cstdio>
+#include <vector>
 
 #ifdef _MSC_VER
   #include "win32_compat.h"
@@ -49,6 +50,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include <tmsi.h>
+#include "tms_spectrum.h"
 #include "Client.h"
 #include "Message.h"
 
@@ -63,6 +65,8 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <QLabel>
 
 #include "CBioPlot.h"
+#include "CSpectrumPlot.h"
+#include "CStripChart.h"
 
 #define MNCIPP               (1536)  /**< Maximum number of characters in IP Packet */
 
@@ -88,11 +92,17 @@ char    *edfChnName[NR_OF_CHANNELS];
 char     ipname[MNCIPP];           /**< IP address to listen to */
 int32_t  port;                     /**< port number */
 int32_t  chn;                      /**< channel selection switch */
+int32_t  spc;                      /**< spectrogram channel selection switch */
+int32_t  strip=0;                  /**< strip chart switch */
 float    window_len[NR_OF_CHANNELS]= { 4.0 };  /**< default window length [s] */
 
 tms_channel_data_t  channel[NR_OF_CHANNELS];   /**< channel data */
 
 static CBioPlot     *plot[NR_OF_CHANNELS] = { NULL };
+static CSpectrumPlot *spec[NR_OF_CHANNELS] = { NULL };
+static CStripChart  *strip_chart = NULL;       /**< all channels in one chart */
+static int32_t       lane[NR_OF_CHANNELS];     /**< strip chart lane per channel */
+static tms_spectrum_worker_t *specw = NULL;   /**< spectrum worker thread */
 static QMainWindow  *main_window = NULL;
 static QApplication *main_app = NULL;
 
@@ -105,12 +115,14 @@ int32_t tmsi_client_intro(FILE *fp) {
   int32_t i,nc=0;
   
   nc+=fprintf(fp,"tmsi_client: %s\n",VERSION); 
-  nc+=fprintf(fp,"Usage: tmsi_client [-i <ip>] [-p <port] [-c <CHN>] [-t <sd>] [-l <lbl>] [-v <vb>] [-d <dbg>]\n");
+  nc+=fprintf(fp,"Usage: tmsi_client [-i <ip>] [-p <port] [-c <CHN>] [-f <SPC>] [-s <sc>] [-t <sd>] [-l <lbl>] [-v <vb>] [-d <dbg>]\n");
   nc+=fprintf(fp,"   [-A <A,wl>] [-B <B,wl>] ... [-h]\n");
   nc+=fprintf(fp,"  Press CTRL+c to stop capturing bio-data\n");
   nc+=fprintf(fp,"ip   : ip address (default=%s)\n",IPDEF);
   nc+=fprintf(fp,"port : port number (default=%d)\n",PORTDEF);
   nc+=fprintf(fp,"CHN  : channel selection string (default=%s)\n",CHNDEF);
+  nc+=fprintf(fp,"SPC  : spectrogram channel selection string (default=none)\n");
+  nc+=fprintf(fp,"sc   : strip chart switch, 1 = all channels in one chart (default=%d)\n",strip);
   nc+=fprintf(fp,"lbl  : channel label (default=%d)\n",lbl);
   nc+=fprintf(fp," chn  name1  name2  wl[s]  wl = window length [s]\n");
   for (i=0; i<NR_OF_CHANNELS; i++) {
@@ -157,7 +169,7 @@ void parse_cmd(int32_t argc, char *argv[]) {
   char    wl[MNCN];       /**< window length [s] */
   char  **cp;             /**< parsing character pointer */
   
-  strcpy(ipname,IPDEF); port=PORTDEF; chn=tms_chn_sel((char *)CHNDEF);
+  strcpy(ipname,IPDEF); port=PORTDEF; chn=tms_chn_sel((char *)CHNDEF); spc=0;
   
   /* copy default channel names */
   for (idx=0; idx<NR_OF_CHANNELS; idx++) {
@@ -177,6 +189,8 @@ void parse_cmd(int32_t argc, char *argv[]) {
       switch (argv[i][1]) {
         case 'i': strcpy(ipname,argv[++i]); break;
         case 'c': chn=tms_chn_sel(argv[++i]); break;
+        case 'f': spc=tms_chn_sel(argv[++i]); break;
+        case 's': strip=strtol(argv[++i],NULL,0); break;
         case 'p': port=strtol(argv[++i],NULL,0); break;
         case 'v': vb=strtol(argv[++i],NULL,0); break;
         case 'd': dbg=strtol(argv[++i],NULL,0); break;
@@ -241,92 +255,196 @@ void sig_handler(int32_t sig)
 #endif
 }
 
-/** Initialize tms channel data array from 'msg'
- * @return timestamp
+#define MAXSAMPLES   (1<<16)  /**< maximum samples per channel in one packet */
+
+static int32_t cap[NR_OF_CHANNELS] = { 0 };  /**< allocated samples per channel */
+static double  tp=0.0;                       /**< packet duration [s] */
+
+/** Make room for sample 'k' of channel 'j', the data array grows and keeps
+ *   its samples when a packet has more samples than it has room for, the
+ *   samples per packet 'ns' of channel 'j' follow the highest sample index.
+ * @return 0 on success, -1 on failure
  */
-double init_tms_data(char *msg) {
-  
-  int32_t  i,j,k;
-  char    *token;
-  double   t;      /**< timestamp of this packet */
-  
-  /* parse 'msg' string */
-  token=strtok(msg," ="); i=0;
-  while (token!=NULL) {
-    if (vb&0x04) { fprintf(stderr,"%d %s\n",i,token); }
-    if (i%2==0) {
-      /* label */
-      if (token[0]=='t') { 
-        j=-1; /* time */ 
-      } else { 
-        /* channel A ... N */
-        j=token[0]-'A';
-        if (j>=NR_OF_CHANNELS) {
-          fprintf(stderr,"# Warning: channel %c is out of range A...N\n",token[0]);
-        }
-        k=strtol(&token[1],NULL,0);
-        if (vb&0x04) { fprintf(stderr,"j %d k %d\n",j,k); }
-        channel[j].ns=k+1;
-      }
-    } else {      
-      /* value */
-      if (j==-1) { 
-        t=strtof(token,NULL); 
-      }
+static int32_t grow_channel(int32_t j, int32_t k) {
+
+  int32_t     n;     /**< new capacity */
+  tms_data_t *data;  /**< new data array */
+
+  if ((k<0) || (k>=MAXSAMPLES)) { return(-1); }
+  if (k>=cap[j]) {
+    for (n=(cap[j]>0 ? cap[j] : 16); n<=k; n*=2) { ; }
+    data=(tms_data_t *)realloc(channel[j].data,n*sizeof(tms_data_t));
+    if (data==NULL) {
+      fprintf(stderr,"# Error: can't allocate %d samples of channel %c!!!\n",n,'A'+j);
+      return(-1);
     }
-    token=strtok(NULL," ="); i++;
+    memset(&data[cap[j]],0,(n-cap[j])*sizeof(tms_data_t));
+    channel[j].data=data; cap[j]=n;
   }
-  
-  /* allocate storage space for all values per channel */
-  for (j=0; j<NR_OF_CHANNELS; j++) {
-    channel[j].rs=0; channel[j].sc=0; channel[j].td=1.0;
-    channel[j].data=(tms_data_t *)calloc(channel[j].ns,sizeof(tms_data_t));
+  if (k>=channel[j].ns) { channel[j].ns=k+1; }
+  return(0);
+}
+
+/** Parse a number from 'p' up to 'e': decimal with optional exponent, 'NaN' or 'inf'.
+ *   Exact up to 15 significant digits, within 1 ulp beyond; never allocates.
+ * @return pointer behind the number, 'p' when there is no number
+ */
+static const char *parse_num(const char *p, const char *e, double *v) {
+
+  static const double p10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char *s=p;        /**< start of the number */
+  uint64_t    m=0;        /**< mantissa */
+  int32_t     nd=0;       /**< number of digits */
+  int32_t     nm=0;       /**< digits in mantissa */
+  int32_t     ex=0;       /**< decimal exponent */
+  int32_t     xe=0;       /**< written exponent */
+  int32_t     neg=0;      /**< negative */
+  int32_t     xneg=0;     /**< negative exponent */
+  double      x;
+
+  if ((p<e) && ((*p=='-') || (*p=='+'))) { neg=(*p=='-'); p++; }
+  /* 'NaN', 'nan', 'inf' or 'Inf' */
+  if ((e-p>=3) && ((p[0]|0x20)=='n') && ((p[1]|0x20)=='a') && ((p[2]|0x20)=='n')) { 
+    *v=NAN; return(p+3); 
   }
-  
-  return(t);
+  if ((e-p>=3) && ((p[0]|0x20)=='i') && ((p[1]|0x20)=='n') && ((p[2]|0x20)=='f')) { 
+    *v=(neg ? -INFINITY : INFINITY); return(p+3); 
+  }
+  for (; (p<e) && (*p>='0') && (*p<='9'); p++, nd++) {
+    if (nm<19) { 
+      m=10*m+(*p-'0'); if (m>0) { nm++; }
+    } else { 
+      ex++; 
+    }
+  }
+  if ((p<e) && (*p=='.')) {
+    for (p++; (p<e) && (*p>='0') && (*p<='9'); p++, nd++) {
+      if (nm<19) { m=10*m+(*p-'0'); ex--; if (m>0) { nm++; } }
+    }
+  }
+  if (nd==0) { return(s); }
+  if ((p+1<e) && ((*p=='e') || (*p=='E'))) {
+    const char *q=p+1;
+    if ((*q=='-') || (*q=='+')) { xneg=(*q=='-'); q++; }
+    if ((q<e) && (*q>='0') && (*q<='9')) {
+      for (; (q<e) && (*q>='0') && (*q<='9'); q++) { if (xe<10000) { xe=10*xe+(*q-'0'); } }
+      ex+=(xneg ? -xe : xe); p=q;
+    }
+  }
+  x=(double)m;
+  if (m==0) {
+    /* zero */
+  } else if ((ex>=0) && (ex<=22)) {
+    x*=p10[ex];
+  } else if ((ex<0) && (ex>=-22)) {
+    x/=p10[-ex];
+  } else {
+    x*=pow(10.0,ex);
+  }
+  *v=(neg ? -x : x);
+  return(p);
 }
 
-/** Get tms channel data array from 'msg'
- * @return timestamp
+/** Parse a non negative integer from 'p' up to 'e'.
+ * @return pointer behind the integer, 'p' when there is none
  */
-double get_tms_data(char *msg) {
-  
-  int32_t  i,j,k;
-  char    *token;
-  double   t;      /**< timestamp of this packet */
-  
-  /* reset received symbol counter of all channels */
-  for (j=0; j<NR_OF_CHANNELS; j++) { channel[j].rs=0; }
+static const char *parse_int(const char *p, const char *e, int32_t *k) {
+
+  int32_t n=0;
   
-  /* parse 'msg' string */
-  token=strtok(msg," ="); i=0;
-  while (token!=NULL) {
-    if (vb&0x04) { fprintf(stderr,"%d %s\n",i,token); }
-    if (i%2==0) {
-      /* label */
-      if (token[0]=='t') { 
-        j=-1; /* time */ 
-      } else { 
-        /* channel A...N */
-        j=token[0]-'A';
-        k=strtol(&token[1],NULL,0);
-        if (vb&0x04) { fprintf(stderr,"j %d k %d\n",j,k); }
+  for (*k=0; (p<e) && (*p>='0') && (*p<='9') && (n<9); p++, n++) { *k=10*(*k)+(*p-'0'); }
+  return(p);
+}
+
+/** Store sample 'k' of channel 'j' with value 'v'.
+ * @return 0 on success, -1 on failure
+ */
+static int32_t put_sample(int32_t j, int32_t k, double v) {
+
+  if (grow_channel(j,k)<0) { return(-1); }
+  channel[j].data[k].sample=v;
+  if (k>=channel[j].rs) { channel[j].rs=k+1; }
+  channel[j].sc++;
+  return(0);
+}
+
+/** Parse tms channel data from packet 'msg' of 'n' characters in place: the
+ *   packet isn't copied nor modified. It has the form ' t=<t> A0=<v> A1=<v> ...'
+ *   or ' t <t> A:<n> <v> ... <v> B:<n> ...', unknown fields are skipped.
+ *   The channel data arrays grow when a channel has more samples than before,
+ *   the samples per packet of each channel are those of this packet.
+ * @return number of channels with another number of samples than in the previous
+ *   packet, -1 if 'msg' isn't a packet
+ */
+int32_t parse_tms_data(const char *msg, size_t n, double *t) {
+
+  const char *p=msg;      /**< parse position */
+  const char *e=msg+n;    /**< end of 'msg' */
+  const char *q;
+  int32_t     i,j,k,m;
+  int32_t     nc=0;       /**< changed channel count */
+  int32_t     ns[NR_OF_CHANNELS]; /**< samples per packet of the previous packet */
+  double      v;
+
+  /* reset received symbol counter and samples per packet of all channels */
+  for (j=0; j<NR_OF_CHANNELS; j++) { ns[j]=channel[j].ns; channel[j].rs=0; channel[j].ns=0; }
+
+  /* time stamp */
+  while ((p<e) && (*p==' ')) { p++; }
+  if ((p>=e) || (*p!='t')) { return(-1); }
+  p++;
+  if ((p<e) && ((*p=='=') || (*p==' '))) { p++; }
+  q=parse_num(p,e,t);
+  if (q==p) { return(-1); }
+  p=q;
+
+  while (p<e) {
+    if ((*p==' ') || (*p=='\t') || (*p=='\r') || (*p=='\n')) { p++; continue; }
+    j=*p-'A';
+    if ((j<0) || (j>=NR_OF_CHANNELS)) {
+      /* skip unknown field */
+      while ((p<e) && (*p!=' ')) { p++; }
+      continue;
+    }
+    p++;
+    if ((p<e) && (*p==':')) {
+      /* sample count and samples */
+      p=parse_int(p+1,e,&m);
+      for (k=0; k<m; k++) {
+        while ((p<e) && (*p==' ')) { p++; }
+        q=parse_num(p,e,&v);
+        if (q==p) { break; }
+        p=q;
+        if (put_sample(j,k,v)<0) { return(-1); }
       }
-    } else {      
-      /* value */
-      if (j==-1) { 
-        t=strtod(token,NULL); 
-      } else {
-        if ((j>=0) && (j<NR_OF_CHANNELS) && (k>=0) && (k<channel[j].ns)) {
-          channel[j].data[k].sample=strtof(token,NULL);
-          channel[j].rs=k+1; channel[j].sc++;
-        }
+    } else {
+      /* sample index and sample */
+      q=parse_int(p,e,&k);
+      if ((q==p) || (q>=e) || (*q!='=')) {
+        if (vb&0x04) { fprintf(stderr,"# Warning: can't parse field of channel %c\n",'A'+j); }
+        while ((p<e) && (*p!=' ')) { p++; }
+        continue;
+      }
+      p=q+1;
+      q=parse_num(p,e,&v);
+      if (q==p) {
+        while ((p<e) && (*p!=' ')) { p++; }
+        continue;
       }
+      p=q;
+      if (put_sample(j,k,v)<0) { return(-1); }
     }
-    token=strtok(NULL," ="); i++;
   }
-  
-  return(t);
+  for (j=0; j<NR_OF_CHANNELS; j++) {
+    if (channel[j].ns!=ns[j]) { nc++; }
+  }
+  if (vb&0x04) { 
+    for (i=0; i<NR_OF_CHANNELS; i++) {
+      if (channel[i].rs>0) { fprintf(stderr,"# Info: chn %c rs %d ns %d\n",'A'+i,channel[i].rs,channel[i].ns); }
+    }
+  }
+  return(nc);
 }
 
 /** Set tick duration per channel from packet duration 'dt'
@@ -338,19 +456,34 @@ int32_t set_tick_duration(double dt) {
   
   /* set tick duraction for channel 'j' */
   for (j=0; j<NR_OF_CHANNELS; j++) {
-    channel[j].td=dt/channel[j].ns;
+    channel[j].td=(channel[j].ns>0 ? dt/channel[j].ns : dt);
   }
   return(0);
 }
 
 
+/** Spectrum worker call back: add Welch PSD 's' of channel 'chn' at time 't'
+ *   to its spectrogram.
+*/
+static void add_spectrum(void *arg, int32_t chn, double t, const tms_spectrum_t *s) {
+
+  (void) arg;
+  if ((chn>=0) && (chn<NR_OF_CHANNELS) && (spec[chn]!=NULL)) {
+    spec[chn]->AddSpectrum( t, s->psd, s->nbin, s->fs/s->nfft );
+  }
+}
+
 int32_t plot_samples(int32_t argc, char *argv[]) {
 
   int32_t  lc=0;             /**< line counter */
-  char     msg[MNCIPP];      /**< IP address to listen to */
-  double   t0,t1,t;          /**< (start) timestamp */
+  const char *msg;           /**< received packet, in the receive buffer of 'client' */
+  size_t   len;              /**< length of 'msg' */
+  int32_t  changed;          /**< number of channels with another number of samples */
+  double   t0=0.0,t1=0.0,t=0.0; /**< (start) timestamp */
   int32_t  i,j;              /**< general indexs */
+  int32_t  nfft;             /**< spectrum segment length */
   float    sample;           /**< current sample */
+  std::vector<float> samples;/**< samples of one channel to plot */
   
   /* don't start right away, but give the UI some time to build */
   usleep( 500*1000);
@@ -358,40 +491,73 @@ int32_t plot_samples(int32_t argc, char *argv[]) {
   Client client(ipname,port);
 
   while (!pressed_CtrlC) {
-    strncpy(msg,client.getMessage().c_str(),sizeof(msg)-1);
+    len=client.getMessage(&msg);
     if (vb&0x01) { /* show IP traffic */
-      fprintf(stderr,"%s",msg);
+      fprintf(stderr,"%.*s",(int)len,msg);
     }
-    if (msg[1]!='t') { continue; } 
+    if ((len<2) || (msg[1]!='t')) { continue; } 
+    changed=parse_tms_data(msg,len,&t);
+    if (changed<0) { continue; }
     if (lc==0) { 
-      /* init tms data structure with first IP packet and get start timestamp */
-      t0=init_tms_data(msg); 
+      /* first IP packet gives the start timestamp */
+      t0=t;
       fprintf(stderr,"# Info: start time %lf [s]\n",t0);
+      /* its samples have no tick duration yet */
+      lc++; t1=t;
+      continue;
     } else {
-      t=get_tms_data(msg);
       if (vb&0x08) { fprintf(stderr,"# Info: t %lf [s] dt %lf [s]\n",t,t-t1); }
       if (lc==1) { 
         fprintf(stderr,"# Info: packet frequency %lf [Hz]\n",1.0/(t-t0));
+        tp=t-t0;
+      } else if (changed>0) {
+        fprintf(stderr,"# Info: channel layout changed\n");
+      }
+      if ((lc==1) || (changed>0)) {
         /* set tick duration per channel */
-        set_tick_duration(t-t0); 
+        set_tick_duration(tp); 
+        /* size plot buffers for the channel sample rates, the strip chart 
+           sizes its lanes on the GUI thread from the queued sample blocks */
+        for (j=0; (!strip) && (j<NR_OF_CHANNELS); j++) {
+          if ((chn&(1<<j)) && (channel[j].td>0.0)) {
+            plot[j]->SetSampleRate(1.0/channel[j].td);
+          }
+        }
+        /* spectrum segments of about 1 [s] with 50% overlap */
+        for (j=0; j<NR_OF_CHANNELS; j++) {
+          if ((specw!=NULL) && (spc&(1<<j)) && (channel[j].td>0.0)) {
+            for (nfft=TMSSPECNFFT; nfft*channel[j].td<1.0; nfft*=2) { ; }
+            tms_spectrum_worker_chn(specw,j,1.0/channel[j].td,nfft,nfft/2,TMSSPECNAVG);
+          }
+        }
       }
     }
     
     if (vb&0x08) { tms_prt_channel_data(stderr,channel,NR_OF_CHANNELS,1); }
     
-    /* plot all received samples */
+    /* plot all received samples: queue them per channel, NaN samples are skipped */
     for (j=0; j<NR_OF_CHANNELS; j++) {
       if (chn&(1<<j)) {
+        if ((int32_t)samples.size()<channel[j].rs) { samples.resize(channel[j].rs); }
         for (i=0; i<channel[j].rs; i++) {
           sample=channel[j].data[i].sample;
-          if (!isnan(sample)) { 
-            if (vb&0x10) {
-              fprintf(stderr,"# Info: chn %d i %d t %.6f dt\n",j,i,t+i*channel[j].td);
-            }
-            plot[j]->AddSample( t+i*channel[j].td, sample,  0 );
+          if ((vb&0x10) && (!isnan(sample))) {
+            fprintf(stderr,"# Info: chn %d i %d t %.6f dt\n",j,i,t+i*channel[j].td);
           }
+          samples[i]=sample;
+        }
+        if (channel[j].rs<=0) {
+          /* nothing received */
+        } else if (strip) {
+          strip_chart->AddSamples( t, channel[j].td, &samples[0], channel[j].rs, lane[j] );
+        } else {
+          plot[j]->AddSamples( t, channel[j].td, &samples[0], channel[j].rs, 0 );
         }
       }
+      /* the spectra are computed on the worker thread, never blocks */
+      if ((specw!=NULL) && (lc>0) && (spc&(1<<j))) {
+        tms_spectrum_worker_push(specw,j,t,&channel[j]);
+      }
     }
      
     lc++; t1=t;
@@ -408,8 +574,22 @@ int32_t main(int32_t argc, char *argv[]) {
   int32_t  i,j,k;
   int32_t  chn_cnt=0;        /**< active channel count */
   int32_t  plot_per_row=3;   /**< number of plots per row */
+  int32_t  spc_cnt=0;        /**< spectrogram count */
+  float    strip_len=0.0;    /**< strip chart window length [s] */
   
   parse_cmd(argc,argv);
+  spc &= chn;
+  /* strip chart lanes in channel order, with the longest window length */
+  for (j=0; j<NR_OF_CHANNELS; j++) {
+    lane[j]=chn_cnt;
+    if (chn&(1<<j)) {
+      chn_cnt++;
+      if (window_len[j]>strip_len) { strip_len=window_len[j]; }
+    }
+  }
+  if (spc!=0) {
+    specw=tms_spectrum_worker_new(NR_OF_CHANNELS,add_spectrum,NULL);
+  }
 
   // start the biodata collection in a separate thread
   boost::thread thread_data( boost::bind(plot_samples, argc, argv) );
@@ -418,8 +598,20 @@ int32_t main(int32_t argc, char *argv[]) {
   main_app = new QApplication(argc,argv);
  
   /* Build UI */
+  if (strip) {
+    /* one widget draws all channels, instead of a plot per channel */
+    strip_chart = new CStripChart( chn_cnt, strip_len, 60.0 );
+  }
   for (j=0; j<NR_OF_CHANNELS; j++) {
-    plot[j] = new CBioPlot( 1, window_len[j], edfChnName[j] );
+    if (strip_chart!=NULL) {
+      strip_chart->SetTitle( lane[j], edfChnName[j] );
+    } else {
+      plot[j] = new CBioPlot( 1, window_len[j], edfChnName[j] );
+    }
+    if ((specw!=NULL) && (spc&(1<<j))) {
+      spec[j] = new CSpectrumPlot( edfChnName[j], 1, 45 );
+      spc_cnt++;
+    }
   }
 
   QGridLayout *myLayout = new QGridLayout;
@@ -437,16 +629,38 @@ int32_t main(int32_t argc, char *argv[]) {
   if (chn_cnt<5) { plot_per_row=2; } else { plot_per_row=3; }
   /* Add only wanted channel to myLayout */
   i=0; k=0;
+  if (strip_chart!=NULL) {
+    myLayout->addWidget( strip_chart, k, i, 1, plot_per_row );
+    k++;
+  }
   for (j=0; j<NR_OF_CHANNELS; j++) {
-    if (chn&(1<<j)) {
+    if ((strip_chart==NULL) && (chn&(1<<j))) {
       myLayout->addWidget( plot[j], k, i );
       i++; if (i==plot_per_row) { i=0; k++; }
     }
   } 
+  /* spectrograms on the rows below the signals */
+  if (i>0) { i=0; k++; }
+  for (j=0; j<NR_OF_CHANNELS; j++) {
+    if (spec[j]!=NULL) {
+      myLayout->addWidget( spec[j], k, i );
+      i++; if (i==plot_per_row) { i=0; k++; }
+    }
+  } 
 
-  myLayout->setRowStretch( 0, 1 );
-  if (chn_cnt>3) { myLayout->setRowStretch( 1, 1 ); }
-  if (chn_cnt>6) { myLayout->setRowStretch( 2, 1 ); }
+  if (strip_chart!=NULL) {
+    /* the strip chart gets the room of the plots it replaces */
+    k=1;
+    myLayout->setRowStretch( 0, (chn_cnt+plot_per_row-1)/plot_per_row );
+  } else {
+    k=(chn_cnt+plot_per_row-1)/plot_per_row;
+    myLayout->setRowStretch( 0, 1 );
+    if (chn_cnt>3) { myLayout->setRowStretch( 1, 1 ); }
+    if (chn_cnt>6) { myLayout->setRowStretch( 2, 1 ); }
+  }
+  for (j=0; j<(spc_cnt+plot_per_row-1)/plot_per_row; j++) {
+    myLayout->setRowStretch( k+j, 1 );
+  }
 
   QFrame * my_frame = new QFrame();
   my_frame->setLayout( myLayout );
@@ -468,6 +682,7 @@ int32_t main(int32_t argc, char *argv[]) {
   pressed_CtrlC = 1;
 
   thread_data.join();
+  tms_spectrum_worker_free(specw);
 
   return(0);
 }
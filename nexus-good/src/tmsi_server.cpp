@@ -39,7 +39,11 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include <math.h>
 #include <time.h>
 #include <signal.h>
+#include <pthread.h>
 #include <iostream>
+#include <vector>
+#include <map>
+#include <set>
 
 #ifdef _MSC_VER
   #include "win32_compat.h"
@@ -50,6 +54,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "tmsi.h"
 #include "tmsi_bluez.h"
+#include "tms_io.h"
+#include "tms_spectrum.h"
+#include "tms_clk.h"
 #include "edf.h"
 
 #include "Server.h"
@@ -69,6 +76,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #define SDDEF                 (0.0)  /**< default sample time [s] 0.0 == forever */
 #define SRDDEF                  (0)  /**< default log2 of sample rate divider */
 #define MDDEF                   (0)  /**< default print switch 0: float 1: integer */
+#define PRFDEF           "$HOME/.tmsi"  /**< default device profile directory */
 
 #define VERSION "$Revision: 0.5 $ $Date: 2012/08/03 16:40:00 $"
 
@@ -80,6 +88,8 @@ FILE   *fpe=NULL;       /**< EDF file pointer */
 FILE   *fpl=NULL;       /**< log file pointer */
 int32_t battery_low=0;  /**< battery low counter */
 int32_t rec_cnt=0;      /**< EDF/BDF record counter */
+std::string bands_msg;  /**< band power messages of spectrum worker */
+pthread_mutex_t bands_lock = PTHREAD_MUTEX_INITIALIZER; /**< protects 'bands_msg' */
 
 volatile int pressed_CtrlC = 0;
 
@@ -87,6 +97,7 @@ volatile int pressed_CtrlC = 0;
 static const char *chndef_str=CHNDEF;
 static const char *DefName[NR_OF_CHANNELS] = {"A","B","C","D","E","F","G","H","I","J","K","L","M","N"};
 const char *edfChnName[NR_OF_CHANNELS]; 
+char prfdir[MNCN];      /**< device profile directory */
 
 /** Print usage to file 'fp'.
  *  @return number of printed characters.
@@ -97,9 +108,10 @@ int32_t tmsi_server_intro(FILE *fp) {
   
   nc+=fprintf(fp,"tmsi_server: %s\n",VERSION); 
   nc+=fprintf(fp,"Usage: tmsi_server [-a <in>] [-p <port>] [-i <id>] [-o <out>] [-b <bdf>] [-m <md>] [-c <CHN>]\n");
-  nc+=fprintf(fp,"   [-A <A>] [-B <B>] ... [-t <sd>] [-s <srd>] [-v <vb>] [-d <dbg>] [-h]\n");
+  nc+=fprintf(fp,"   [-A <A>] [-B <B>] ... [-t <sd>] [-s <srd>] [-w <BPC>] [-f <flt>] [-r <R>] [-e <E>] [-P <prf>] [-v <vb>] [-d <dbg>] [-h]\n");
   nc+=fprintf(fp,"  Press CTRL+c to stop capturing bio-data\n");
-  nc+=fprintf(fp,"in   : bluetooth address (default=%s)\n",BTDEF);
+  nc+=fprintf(fp,"in   : bluetooth address (default=%s), serial port /dev/... or tty:<dev>[@<baud>],\n",BTDEF);
+  nc+=fprintf(fp,"       TCP bridge tcp:<host>:<port>, capture file file:<name> or EDF/BDF file\n");
   nc+=fprintf(fp,"port : port number (default=%d)\n",PORTDEF);
   nc+=fprintf(fp,"id   : measurement id (default=%s)\n",IDDEF);
   nc+=fprintf(fp,"sd   : sampling duration [s] (0.0 == forever) (default=%6.3f)\n",SDDEF);
@@ -111,6 +123,23 @@ int32_t tmsi_server_intro(FILE *fp) {
     nc+=fprintf(fp," %1c  : signal name of channel %1C (default=%s)\n",chndef_str[i],chndef_str[i],DefName[i]);
   }
   nc+=fprintf(fp,"md   : print switch 0:float 1:integer samples (default=%d)\n",MDDEF);
+  nc+=fprintf(fp,"BPC  : send EEG/EMG band powers of these channels (default=none)\n");
+  nc+=fprintf(fp,"       as 'bands chn t dt n delta theta alpha beta gamma emg'\n");
+  nc+=fprintf(fp,"flt  : filter the sent samples with stages separated by '+' (default=none)\n");
+  nc+=fprintf(fp,"       n<f0> notch at f0 [Hz] and harmonics, lp<fc> low-pass, hp<fc> high-pass,\n");
+  nc+=fprintf(fp,"       bp<f0>,<f1> band-pass, e.g. n50+bp0.5,40\n");
+  nc+=fprintf(fp,"       the BDF file and the R and E detectors get the unfiltered samples\n");
+  nc+=fprintf(fp,"R    : send respiration extremes of channel R (default=none)\n");
+  nc+=fprintf(fp,"E    : send heart beats of ECG channel E (default=none)\n");
+  nc+=fprintf(fp,"       as '<maxRSP|minRSP|unkRSP|beat> chn t level period rate'\n");
+  nc+=fprintf(fp,"prf  : device profile directory, reconnects skip the ID data (default=%s, '' memory only)\n",PRFDEF);
+  nc+=fprintf(fp,"  Live input sends 'clock t host drift jitter' lines: host wall clock time [s]\n");
+  nc+=fprintf(fp,"  of device time t [s], device clock drift [ppm] and arrival jitter [s].\n");
+  nc+=fprintf(fp,"  The BDF file is BDF+D with the host time of every record.\n");
+  nc+=fprintf(fp,"  A subscriber may send 'rate <X><hz> ...' to get channel X decimated to\n");
+  nc+=fprintf(fp,"  about <hz> [Hz] as ' t X:n x1 ... xn Y:n ...' lines, e.g. 'rate F32 G32'\n");
+  nc+=fprintf(fp,"  Decimated samples lag t by the anti-alias filter delay of 4 samples per\n");
+  nc+=fprintf(fp,"  decimation step (4*m/fs [s] for factor m), which isn't compensated.\n");
   nc+=fprintf(fp,"h    : show this manual page\n");
   nc+=fprintf(fp,"vb   : verbose switch (default=0x%02X)\n",vb);
   nc+=fprintf(fp,"        0x01 : show all IP traffic\n");
@@ -123,7 +152,8 @@ int32_t tmsi_server_intro(FILE *fp) {
 }
 
 void parse_cmd(int32_t argc, char *argv[], char *btname, int32_t *port, int32_t* md,
- int32_t *chn, double *sd, int32_t *srd, char *id, char *bname, char *oname) {
+ int32_t *chn, double *sd, int32_t *srd, char *id, char *bname, char *oname, int32_t *bpc, char *flt,
+ int32_t *rsp, int32_t *ecg) {
 
   int32_t i,idx;          /**< general index */
   time_t now;
@@ -131,7 +161,8 @@ void parse_cmd(int32_t argc, char *argv[], char *btname, int32_t *port, int32_t*
   char   name[MNCN];
   
   strcpy(btname,BTDEF); strcpy(id,IDDEF); strcpy(bname,"DEFAULT"); strcpy(oname,"");
-  *chn=tms_chn_sel((char *)CHNDEF); *sd=SDDEF; *srd=SRDDEF; *port=PORTDEF;
+  if (getenv("HOME")!=NULL) { snprintf(prfdir,MNCN,"%s/.tmsi",getenv("HOME")); } else { prfdir[0]='\0'; }
+  *chn=tms_chn_sel((char *)CHNDEF); *sd=SDDEF; *srd=SRDDEF; *port=PORTDEF; *bpc=0; flt[0]='\0'; *rsp=-1; *ecg=-1;
   
   /* copy default channel names */
   for (idx=0; idx<NR_OF_CHANNELS; idx++) {
@@ -152,6 +183,18 @@ void parse_cmd(int32_t argc, char *argv[], char *btname, int32_t *port, int32_t*
         case 'm': *md=strtol(argv[++i],NULL,0); break;
         case 't': *sd=strtod(argv[++i],NULL); break;
         case 's': *srd=strtol(argv[++i],NULL,0); break;
+        case 'w': *bpc=tms_chn_sel(argv[++i]); break;
+        case 'f': strcpy(flt,argv[++i]); break;
+        case 'r':
+        case 'e':
+          if ((i+1<argc) && (argv[i+1][0]>='A') && (argv[i+1][0]<'A'+NR_OF_CHANNELS)) {
+            *((argv[i][1]=='r') ? rsp : ecg)=(int32_t)(argv[i+1][0]-'A');
+          } else {
+            printf("can't understand channel of argument %s\n",argv[i]);
+          }
+          i++;
+          break;
+        case 'P': strcpy(prfdir,argv[++i]); break;
         case 'v': vb=strtol(argv[++i],NULL,0); break;
         case 'd': dbg=strtol(argv[++i],NULL,0); break;
         case 'h': tmsi_server_intro(stderr); exit(0); break;
@@ -217,9 +260,236 @@ void sig_handler(int sig)
 #endif
 }
 
+/** Spectrum worker call back: queue band powers of channel 'chn' at time 't'
+ *   for the next IP message.
+ */
+static void bands_cb(void *arg, int32_t chn, double t, const tms_spectrum_t *s) {
+
+  float pwr[TMSSPECNBAND];  /**< band powers */
+  char  buf[MNCN];          /**< band power message */
+
+  (void) arg;
+  /* only the last PSD of a queued block is reported */
+  tms_spectrum_bands(s,tms_eeg_bands,TMSSPECNBAND,pwr);
+  tms_spectrum_prt_bands(buf,sizeof(buf),chn,t,s->hop/s->fs,pwr,TMSSPECNBAND);
+  pthread_mutex_lock(&bands_lock);
+  bands_msg += buf;
+  pthread_mutex_unlock(&bands_lock);
+}
+
+/** Feed received samples of channel 'c' to respiration detector 'r' or heart beat
+ *   detector 'q' and append the found events of channel 'chn' to 'msg'.
+ * @return number of found events
+*/
+static int32_t detect_events(std::string &msg, edf_rsp_t *r, edf_ecg_t *q, int32_t chn,
+ const tms_channel_data_t *c) {
+
+  static std::vector<float>     x;  /**< samples of channel 'c' */
+  static std::vector<edf_evt_t> e;  /**< found events */
+  char    buf[MNCN];                /**< event message */
+  int32_t i,n=0;
+
+  if (c->rs<1) { return(0); }
+  if ((int32_t)x.size()<c->rs) { x.resize(c->rs); e.resize(c->rs); }
+  for (i=0; i<c->rs; i++) { x[i]=c->data[i].sample; }
+  if (r!=NULL) { n=edf_rsp_run(r,c->sc,&x[0],c->rs,&e[0],c->rs); }
+  if (q!=NULL) { n=edf_ecg_run(q,c->sc,&x[0],c->rs,&e[0],c->rs); }
+  for (i=0; i<n; i++) {
+    edf_evt_prt(buf,sizeof(buf),chn,0.0,&e[i]);
+    msg += buf;
+  }
+  return(n);
+}
+
+/** decimated stream of one channel, shared by all subscribers of its rate */
+typedef struct DEC_STREAM_T {
+  edf_dec_t *dec;             /**< anti-alias FIR decimator */
+  float      last;            /**< last valid sample, replaces missing samples */
+  std::vector<float> y;       /**< decimated samples of the current packet */
+} dec_stream_t;
+
+/** decimated streams on channel and decimation factor */
+typedef std::map<std::pair<int32_t,int32_t>, dec_stream_t> dec_map_t;
+
+/** filter stage of all selected channels with the same sample rate */
+typedef struct FLT_GROUP_T {
+  edf_filt_t *flt;            /**< filter with the state of every channel in 'chn' */
+  std::vector<int32_t> chn;   /**< channels of this group */
+  std::vector<float> last;    /**< last valid sample per channel, replaces missing samples */
+  std::vector<float> x;       /**< frames of the current packet */
+} flt_group_t;
+
+/** Make filter groups 'fg' with filter specification 'spec' for the selected 
+ *   channels 'chn' of 'n' channels: one filter per sample rate for all its channels.
+ * @return 0 on success, -1 on failure
+ */
+static int32_t new_filter_groups(std::vector<flt_group_t> &fg, const char *spec,
+ tms_channel_data_t *channel, int32_t n, int32_t chn) {
+
+  size_t  g;
+  int32_t j;
+
+  for (j=0; j<n; j++) {
+    if (((chn&(1<<j))==0) || (channel[j].td<=0.0)) { continue; }
+    for (g=0; (g<fg.size()) && (channel[fg[g].chn[0]].td!=channel[j].td); g++) { ; }
+    if (g==fg.size()) { fg.push_back(flt_group_t()); fg[g].flt=NULL; }
+    fg[g].chn.push_back(j);
+  }
+  for (g=0; g<fg.size(); g++) {
+    fg[g].last.assign(fg[g].chn.size(),0.0);
+    if (((fg[g].flt=edf_filt_new((int32_t)fg[g].chn.size()))==NULL) ||
+        (edf_filt_add_spec(fg[g].flt,spec,1.0/channel[fg[g].chn[0]].td)<0)) {
+      return(-1);
+    }
+  }
+  return(0);
+}
+
+/** Filter the current packet of 'channel' in place with filter groups 'fg',
+ *   all channels of a group in one run; missing samples (NaN) stay missing, 
+ *   the filter holds the last valid sample of their channel instead.
+ */
+static void filter_channels(std::vector<flt_group_t> &fg, tms_channel_data_t *channel) {
+
+  size_t  g,c,nc;
+  int32_t i,j,ns;
+
+  for (g=0; g<fg.size(); g++) {
+    flt_group_t &f=fg[g];
+    nc=f.chn.size();
+    for (ns=0, c=0; c<nc; c++) {
+      if (channel[f.chn[c]].rs>ns) { ns=channel[f.chn[c]].rs; }
+    }
+    if (ns==0) { continue; }
+    f.x.resize(ns*nc);
+    for (c=0; c<nc; c++) {
+      j=f.chn[c];
+      for (i=0; i<ns; i++) {
+        if ((i<channel[j].rs) && isfinite(channel[j].data[i].sample)) { f.last[c]=channel[j].data[i].sample; }
+        f.x[i*nc+c]=f.last[c];
+      }
+    }
+    edf_filt_run(f.flt,&f.x[0],ns);
+    for (c=0; c<nc; c++) {
+      j=f.chn[c];
+      for (i=0; i<channel[j].rs; i++) {
+        if (isfinite(channel[j].data[i].sample)) { channel[j].data[i].sample=f.x[i*nc+c]; }
+      }
+    }
+  }
+}
+
+/** Get the decimation factor per channel of 'n' channels in 'm' out of 
+ *   subscriber 'request' ('X<hz> ...'), 1 is full rate.
+ */
+static void request_factors(const std::string &request, tms_channel_data_t *channel,
+ int32_t n, int32_t *m) {
+
+  int32_t j;
+  double  hz;               /**< requested rate [Hz] */
+  const char *cp=request.c_str();
+  char   *ep;
+
+  for (j=0; j<n; j++) { m[j]=1; }
+  while (*cp!='\0') {
+    j=cp[0]-'A';
+    hz=strtod(cp+1,&ep);
+    if ((j>=0) && (j<n) && (hz>0.0) && (channel[j].td>0.0)) {
+      m[j]=(int32_t)round(1.0/(channel[j].td*hz));
+      if (m[j]<1) { m[j]=1; }
+    }
+    cp=ep; while (*cp==' ') { cp++; }
+  }
+}
+
+/** Run the decimators of all distinct channel rates in 'requests' once on the
+ *   current packet of 'channel' with 'n' channels, unused decimators are freed.
+ */
+static void decimate_channels(dec_map_t &dm, const std::set<std::string> &requests,
+ tms_channel_data_t *channel, int32_t n) {
+
+  std::set< std::pair<int32_t,int32_t> > used;  /**< channel and factor in use */
+  std::vector<int32_t> m(n);                    /**< decimation factor per channel */
+  std::vector<float> x;                         /**< valid samples of a channel */
+  std::set<std::string>::const_iterator r;
+  dec_map_t::iterator d;
+  int32_t i,j;
+
+  for (r=requests.begin(); r!=requests.end(); ++r) {
+    request_factors(*r,channel,n,&m[0]);
+    for (j=0; j<n; j++) {
+      if (m[j]>1) { used.insert(std::make_pair(j,m[j])); }
+    }
+  }
+  /* free decimators nobody asks for anymore */
+  for (d=dm.begin(); d!=dm.end(); ) {
+    if (used.count(d->first)==0) {
+      edf_dec_free(d->second.dec); dm.erase(d++);
+    } else {
+      ++d;
+    }
+  }
+  /* run each decimator once: the FIR delays the samples by half its length,
+     4*m input samples, the time stamps of the subscribers aren't shifted */
+  for (std::set< std::pair<int32_t,int32_t> >::iterator u=used.begin(); u!=used.end(); ++u) {
+    j=u->first;
+    dec_stream_t &ds=dm[*u];
+    if (ds.dec==NULL) {
+      if ((ds.dec=edf_dec_new(1,u->second,8*u->second+1))==NULL) { continue; }
+      ds.last=0.0;
+    }
+    x.resize(channel[j].rs);
+    for (i=0; i<channel[j].rs; i++) {
+      if (isfinite(channel[j].data[i].sample)) { ds.last=channel[j].data[i].sample; }
+      x[i]=ds.last;
+    }
+    ds.y.resize(channel[j].rs/u->second+1);
+    ds.y.resize(edf_dec_run(ds.dec,x.empty() ? NULL : &x[0],channel[j].rs,&ds.y[0]));
+  }
+}
+
+/** Make message of subscriber 'request' at time 't' of the selected channels 'chn'
+ *   of 'n' channels, decimated channels out of 'dm', and 'extra' lines.
+ * @return message
+ */
+static std::string request_message(const std::string &request, double t, 
+ tms_channel_data_t *channel, int32_t n, int32_t chn, dec_map_t &dm, const std::string &extra) {
+
+  std::string msg;
+  std::vector<int32_t> m(n);   /**< decimation factor per channel */
+  char    buff[MNCN];
+  int32_t i,j;
+
+  request_factors(request,channel,n,&m[0]);
+  snprintf(buff,sizeof(buff)-1," %.8f",t);
+  msg += buff;
+  for (j=0; j<n; j++) {
+    if ((chn&(1<<j))==0) { continue; }
+    if (m[j]>1) {
+      const std::vector<float> &y=dm[std::make_pair(j,m[j])].y;
+      snprintf(buff,sizeof(buff)-1," %c:%d",'A'+j,(int32_t)y.size());
+      msg += buff;
+      for (i=0; i<(int32_t)y.size(); i++) {
+        snprintf(buff,sizeof(buff)-1," %.4f",y[i]);
+        msg += buff;
+      }
+    } else {
+      snprintf(buff,sizeof(buff)-1," %c:%d",'A'+j,channel[j].rs);
+      msg += buff;
+      for (i=0; i<channel[j].rs; i++) {
+        snprintf(buff,sizeof(buff)-1," %.4f",channel[j].data[i].sample);
+        msg += buff;
+      }
+    }
+  }
+  msg += "\n";
+  msg += extra;
+  return(msg);
+}
+
 int32_t main(int32_t argc, char *argv[]) {
 
-  int32_t fd;                    /**< bluetooth socket file descriptor */
+  int32_t fd=-1;                 /**< bluetooth socket file descriptor */
   char    btname[MNCN];          /**< bluetooth address */
   char    id[MNCN];              /**< measurement id */
   char    oname[MNCN];           /**< text output file name */
@@ -235,6 +505,7 @@ int32_t main(int32_t argc, char *argv[]) {
   double t;                      /**< current time */
   FILE   *fp =NULL;              /**< text log file */
   FILE   *fpe=NULL;              /**< EDF/BDF log file */
+  edf_sum_idx_t *si=NULL;        /**< EDF/BDF summary sidecar index */
   int32_t md;                    /**< print switch 0: float 1: integer */
   time_t  now;                   /**< now */
   char buff[MNCN];               /**< temporary buffer for text */
@@ -245,6 +516,24 @@ int32_t main(int32_t argc, char *argv[]) {
   double  wct,wct0,wct1,wct2;    /**< wall clock time */ 
   int32_t sw_chn=12;             /**< switch channel number */  
   int32_t chn_cnt=8;             /**< total number of channels */
+  int32_t bpc;                   /**< band power channel switch */
+  tms_spectrum_worker_t *sw=NULL;/**< spectrum worker for band powers */
+  int32_t nfft;                  /**< spectrum segment length */
+  char    flt[MNCN];             /**< filter specification */
+  std::vector<flt_group_t> fg;   /**< filter stage per sample rate of the selected channels */
+  int32_t rsp_chn,ecg_chn;       /**< respiration and ECG channel, <0: none */
+  edf_rsp_t *rsp=NULL;           /**< respiration detector */
+  edf_ecg_t *ecg=NULL;           /**< heart beat detector */
+  std::string evt_msg;           /**< detector events of this packet */
+  std::string extra;             /**< event and band power lines of this packet */
+  std::set<std::string> requests;/**< distinct subscriber requests */
+  std::set<std::string>::const_iterator req;
+  dec_map_t dm;                  /**< decimated streams shared by the subscribers */
+  tms_clk_t *clk=NULL;           /**< device to host clock model */
+  int64_t sc=0;                  /**< device sample index of this packet */
+  int64_t pkt_cnt=0;             /**< received and missed packets */
+  double  onset=0.0;             /**< BDF+ onset of the last record [s] */
+  double  tal;                   /**< BDF+ onset of this record [s] since start time */
   
 #ifdef _MSC_VER
   if (SetConsoleCtrlHandler( (PHANDLER_ROUTINE) sig_handler,TRUE)<=0) {
@@ -256,14 +545,11 @@ int32_t main(int32_t argc, char *argv[]) {
 #endif
 
   /* parse command line arguments */
-  parse_cmd(argc,argv,btname,&port,&md,&chn,&sd,&srd,id,bname,oname);
+  parse_cmd(argc,argv,btname,&port,&md,&chn,&sd,&srd,id,bname,oname,&bpc,flt,&rsp_chn,&ecg_chn);
 
   Server server(port);
 
-  if (strstr(btname,"/dev/tty.")!=NULL) { dev=1; /* Nexus */    } else
-  if (strchr(btname,'/'        )!=NULL) { dev=3; /* filename */ } else
-  if (strchr(btname,'\\'       )!=NULL) { dev=3; /* filename */ } else
-  if (strstr(btname,":"        )!=NULL) { dev=1; /* Nexus */    } else
+  if (tms_io_type(btname)!=TMSIONONE)  { dev=1; /* Nexus */    } else
   if (strstr(btname,"USB"      )!=NULL) { dev=2; /* Holst */    } else {
                                           dev=3; /* EDF/BDF input */
   }
@@ -272,6 +558,8 @@ int32_t main(int32_t argc, char *argv[]) {
     case 1: /* Live Nexus input */
       /* set debug level in tms module */
       tms_set_vb(vb>>8);
+      /* known devices skip the ID data, also after a reconnect */
+      tms_set_profile_dir(prfdir);
 
       fprintf(stderr,"# Opening bluetooth port on MAC address %s\n",btname);
       if ((fd=tms_open_port(btname))<0) {
@@ -311,6 +599,8 @@ int32_t main(int32_t argc, char *argv[]) {
       // edf_prt_hdr(stderr,&edf);
       /* read EDF/BDF samples */
       edf_rd_samples(fpi,&edf);
+      /* get record time stamps of EDF+D/BDF+D files */
+      edf_get_rts(&edf);
       /* close input file */
       fclose(fpi);
       fprintf(stderr,"# %d EDF/BDF datarecord read\n",edf.NrOfDataRecords);
@@ -342,7 +632,32 @@ int32_t main(int32_t argc, char *argv[]) {
       break;
   }
   fprintf(stderr,"# Info: channel count %d chn 0x%04X\n",chn_cnt,chn);
+
+  /* band powers are computed on a worker thread: segments of about 1 [s] */
+  bpc &= chn;
+  if ((bpc!=0) && ((sw=tms_spectrum_worker_new(chn_cnt,bands_cb,NULL))!=NULL)) {
+    for (j=0; j<chn_cnt; j++) {
+      if ((bpc&(1<<j)) && (channel[j].td>0.0)) {
+        for (nfft=TMSSPECNFFT; nfft*channel[j].td<1.0; nfft*=2) { ; }
+        tms_spectrum_worker_chn(sw,j,1.0/channel[j].td,nfft,nfft/2,TMSSPECNAVG);
+      }
+    }
+  }
   
+  /* streaming respiration and heart beat detectors */
+  if ((rsp_chn>=0) && (rsp_chn<chn_cnt) && (channel[rsp_chn].td>0.0)) {
+    rsp=edf_rsp_new(1.0/channel[rsp_chn].td,0.0,1);
+  }
+  if ((ecg_chn>=0) && (ecg_chn<chn_cnt) && (channel[ecg_chn].td>0.0)) {
+    ecg=edf_ecg_new(1.0/channel[ecg_chn].td);
+  }
+
+  /* streaming filter stage of the selected channels, only for the sent samples */
+  if ((strlen(flt)>0) && (new_filter_groups(fg,flt,channel,chn_cnt,chn)<0)) {
+    fprintf(stderr,"# Error: can't use filter specification '%s'!!!\n",flt);
+    exit(-1);
+  }
+
   if (strlen(oname)>1) {
     fprintf(stderr,"# write data to text file: %s\n",oname);
     if ((fp=fopen(oname,"w"))==NULL) {
@@ -350,6 +665,13 @@ int32_t main(int32_t argc, char *argv[]) {
     }
   }
 
+  /* align device sample clock to host clock with live recording */
+  if ((dev==1) || (dev==2)) {
+    if ((clk=tms_clk_new(fs,0))==NULL) {
+      fprintf(stderr,"# Warning: no device clock alignment!\n");
+    }
+  }
+
   /* only with live recording a BDF output file is needed */
   if (((dev==1) || (dev==2)) && (strlen(bname)>1)) {
     fprintf(stderr,"# write data to BDF file: %s\n",bname);
@@ -362,9 +684,22 @@ int32_t main(int32_t argc, char *argv[]) {
       fprintf(stderr,"# Info: fpe %p channel %p chn_cnt %d chn 0x%04X bname %s dt %.5f edfname %s\n",
        fpe,channel,chn_cnt,chn,bname,(channel[0].ns/fs),edfChnName[0]);
     }
-    /* write EDF/BDF headers */
-    edfWriteHdr(fpe,channel,chn_cnt,chn,bname,"Nexus-10 via tmsi_server",
-        &now,(channel[0].ns/fs),edfChnName);
+    /* write EDF/BDF headers, BDF+D to time stamp every record */
+    if (clk!=NULL) {
+      edfWriteHdrPlus(fpe,channel,chn_cnt,chn,bname,"Nexus-10 via tmsi_server",
+          &now,(channel[0].ns/fs),edfChnName);
+    } else {
+      edfWriteHdr(fpe,channel,chn_cnt,chn,bname,"Nexus-10 via tmsi_server",
+          &now,(channel[0].ns/fs),edfChnName);
+    }
+    /* write min/max/mean summary sidecar file along with the BDF file */
+    for (i=0,j=0; i<tms_get_number_of_channels(); i++) {
+      if (chn&(1<<i)) { j++; }
+    }
+    if ((si=edf_sum_new(j,(channel[0].ns/fs)))!=NULL) {
+      edf_sum_name(buff,bname);
+      if (edf_sum_wr(si,buff)<0) { edf_sum_free(si); si=NULL; }
+    }
   }
   
   /* start timestamp wall clock time [s] since 1-1-1970 00:00:00 */
@@ -387,16 +722,18 @@ int32_t main(int32_t argc, char *argv[]) {
           usleep(100*1000);
           /* insert gap to indicate missing packets */
           mpc = (int32_t)round((get_time() - wct1)*fs/channel[0].ns);
+          /* the gap is only estimated: refit the clock on the next arrivals */
+          if (clk!=NULL) { tms_clk_break(clk); }
  
           if (lost>7) {
              //pressed_CtrlC = 1; continue;
-            fprintf(stderr,"# Error: connection reset, wait 5 [s]\n");
+            fprintf(stderr,"# Error: connection reset, wait 1 [s]\n");
             /* shutdown bluetooth capture */
             tms_shutdown();  
-            /* wait 5 [s] */
-            usleep(5000*1000);
+            /* wait 1 [s] */
+            usleep(1000*1000);
             /* close bluetooth socket */
-            tms_close_port();
+            tms_close_port(fd);
             
             fprintf(stderr,"# Reopening bluetooth port on MAC address %s\n",btname);
             while ((fd=tms_open_port(btname))<0) {
@@ -404,7 +741,7 @@ int32_t main(int32_t argc, char *argv[]) {
                if (pressed_CtrlC == 1) { continue; }
                usleep(5000*1000);
             }
-            /* initialize tms data capture */
+            /* initialize tms data capture, the device profile is cached */
             tms_init(fd,srd);
             lost = 0;
             
@@ -412,19 +749,40 @@ int32_t main(int32_t argc, char *argv[]) {
             mpc = (int32_t)round((get_time() - wct1)*fs/channel[0].ns);
           }
         }
+        /* last sample of this packet arrived now */
+        sc=(pkt_cnt+mpc)*channel[0].ns;
+        pkt_cnt+=mpc+1;
+        if (clk!=NULL) {
+          tms_clk_add(clk,sc+channel[0].ns-1,tms_clk_now());
+        }
         /* check if we missed packets */
         if (mpc>0) {
-          fprintf(stderr,"# Info: inserted %d packets after connection loss!!\n",mpc);
+          fprintf(stderr,"# Info: missed %d packets!!\n",mpc);
           /* flag all samples in this packet with 'dynamic overflow' */
           tms_flag_samples(channel,chn_cnt,0x02);
         }
         if (fpe!=NULL) {
           /* write samples to BDF output file */
-          edfWriteSamples(fpe,1,channel,chn,mpc);
+          if (clk!=NULL) {
+            /* BDF+D: missed packets are a gap in the record time stamps */
+            tal=tms_clk_wall(clk,sc)-now;
+            /* keep records in order while the clock model settles,
+               and none before the start time in the header */
+            if ((rec_cnt>0) && (tal<onset+channel[0].ns*clk->dt)) {
+              tal=onset+channel[0].ns*clk->dt;
+            }
+            if (tal<0.0) { tal=0.0; }
+            edfWriteSamplesPlus(fpe,1,channel,chn,0,tal,channel[0].ns*clk->dt);
+            onset=tal;
+          } else {
+            edfWriteSamples(fpe,1,channel,chn,mpc);
+          }
+          /* append record summary to sidecar file */
+          if (si!=NULL) { edfSumSamples(si,channel,chn,(clk!=NULL) ? 0 : mpc); }
           /* flush BDF output file to see progress and spread NFS load */
           fflush(fpe);
         }
-        rec_cnt+=mpc+1;
+        rec_cnt+=(clk!=NULL) ? 1 : mpc+1;
         break;
 
       case 3: /* get next block of EDF/BDF samples */
@@ -462,6 +820,14 @@ int32_t main(int32_t argc, char *argv[]) {
       battery_low++;
     }
 
+    /* detectors run on the unfiltered samples */
+    evt_msg.clear();
+    if (rsp!=NULL) { detect_events(evt_msg,rsp,NULL,rsp_chn,&channel[rsp_chn]); }
+    if (ecg!=NULL) { detect_events(evt_msg,NULL,ecg,ecg_chn,&channel[ecg_chn]); }
+
+    /* filter the samples to send, the BDF file keeps the unfiltered samples */
+    filter_channels(fg,channel);
+
     msg.clear();
     snprintf(buff,sizeof(buff)-1," %.8f",t);
     msg += buff;
@@ -479,11 +845,38 @@ int32_t main(int32_t argc, char *argv[]) {
       }
     }
     msg += "\n";
+    extra = evt_msg;
+    /* queue samples for band powers and add the band powers found so far */
+    if (sw!=NULL) {
+      for (j=0; j<chn_cnt; j++) {
+        if ((bpc&(1<<j)) && (channel[j].td>0.0)) {
+          tms_spectrum_worker_push(sw,j,t,&channel[j]);
+        }
+      }
+      pthread_mutex_lock(&bands_lock);
+      extra += bands_msg;
+      bands_msg.clear();
+      pthread_mutex_unlock(&bands_lock);
+    }
+    if (clk!=NULL) {
+      tms_clk_prt(buff,sizeof(buff),clk,t,sc);
+      extra += buff;
+    }
+    msg += extra;
     if (vb&0x01) {
       fprintf(stderr,"%s",msg.c_str());
     }
-    /* send msg */
-    server.sendMessage(msg.c_str());
+    /* send msg to full rate subscribers, decimated streams to the others */
+    server.poll();
+    requests = server.requests();
+    decimate_channels(dm,requests,channel,chn_cnt);
+    for (req=requests.begin(); req!=requests.end(); ++req) {
+      if (req->empty()) {
+        server.sendMessage(*req,msg);
+      } else {
+        server.sendMessage(*req,request_message(*req,t,channel,chn_cnt,chn,dm,extra));
+      }
+    }
   }
 
   if (battery_low>0) {
@@ -499,13 +892,27 @@ int32_t main(int32_t argc, char *argv[]) {
     /* set record counter in BDF output file */
     edf_set_record_cnt(fpe,rec_cnt);
     fclose(fpe); 
+    /* stamp summary with the finished BDF file, so readers can detect later changes */
+    if (si!=NULL) { edf_sum_stamp(si,bname,rec_cnt); }
   }
+  /* close summary sidecar file */
+  edf_sum_free(si);
+  /* stop band power worker */
+  tms_spectrum_worker_free(sw);
+  tms_clk_free(clk);
+  /* free decimated streams */
+  for (dec_map_t::iterator d=dm.begin(); d!=dm.end(); ++d) { edf_dec_free(d->second.dec); }
+  /* free detectors */
+  edf_rsp_free(rsp);
+  edf_ecg_free(ecg);
+  /* free filter stage */
+  for (size_t g=0; g<fg.size(); g++) { edf_filt_free(fg[g].flt); }
   
   if (dev==1) {
     /* shutdown bluetooth capture */
     tms_shutdown();  
     /* close bluetooth socket */
-    tms_close_port();
+    tms_close_port(fd);
   }
 
   return(0);
@@ -43,6 +43,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "tmsi.h"
 #include "tmsi_bluez.h"
+#include "tms_io.h"
 #include "tmsi_wrapper.h"
 #include "tms_ip.h"
 #include "edf.h"
@@ -88,6 +89,10 @@ static CallbackIntDouble _callback_function_response=NULL;
 
 static int port = -1;
 static tms_channel_data_t *channel = NULL;
+static edf_rsp_t *rsp = NULL;         /**< respiration detector */
+static edf_ecg_t *ecg = NULL;         /**< heart beat detector */
+static int32_t  rsp_chn_nr       = -1; /**< respiration channel */
+static int32_t  ecg_chn_nr       = -1; /**< ECG channel */
 
 int tmsw_close() {
 
@@ -97,6 +102,8 @@ int tmsw_close() {
     tms_close_port(port);
     fclose(fpe);
   }
+  edf_rsp_free(rsp); rsp=NULL;
+  edf_ecg_free(ecg); ecg=NULL;
   
   return(0);
 }
@@ -131,7 +138,7 @@ int32_t tmsw_open(char* bt_addr, int32_t sample_rate_div, char* filename, char*
   
   tms_set_vb(tms_vb);
   
-  if (strstr(bt_addr,":")!=NULL)   { 
+  if (tms_io_type(bt_addr)!=TMSIONONE) { 
     dev=1; /* Nexus */ 
   } else 
   if (strstr(bt_addr,"USB")!=NULL) { 
@@ -216,6 +223,8 @@ int32_t tmsw_open(char* bt_addr, int32_t sample_rate_div, char* filename, char*
     edf_rd_hdr(fpi,&edf);
     /* read EDF/BDF samples */
     edf_rd_samples(fpi,&edf);
+    /* get record time stamps of EDF+D/BDF+D files */
+    edf_get_rts(&edf);
     /* close input file */
     fclose(fpi);
     
@@ -511,6 +520,60 @@ void tmsw_check_for_stimuli(tms_channel_data_t *channel) {
   }
 }
 
+/** Enable respiration detector on channel 'rsp_chn' and heart beat detector
+ *   on ECG channel 'ecg_chn' (<0: none) of the opened device.
+ * @return 0 on success, -1 on failure
+*/
+int32_t tmsw_set_detectors(int32_t rsp_chn, int32_t ecg_chn) {
+
+  if (channel==NULL) {
+    fprintf(stderr,"# Error: detectors need an opened device!!!\n");
+    return(-1);
+  }
+  edf_rsp_free(rsp); rsp=NULL; rsp_chn_nr=-1;
+  edf_ecg_free(ecg); ecg=NULL; ecg_chn_nr=-1;
+  if ((rsp_chn>=0) && (rsp_chn<tms_chn_cnt) && (channel[rsp_chn].td>0.0)) {
+    if ((rsp=edf_rsp_new(1.0/channel[rsp_chn].td,0.0,1))==NULL) { return(-1); }
+    rsp_chn_nr=rsp_chn;
+  }
+  if ((ecg_chn>=0) && (ecg_chn<tms_chn_cnt) && (channel[ecg_chn].td>0.0)) {
+    if ((ecg=edf_ecg_new(1.0/channel[ecg_chn].td))==NULL) { return(-1); }
+    ecg_chn_nr=ecg_chn;
+  }
+  return(0);
+}
+
+/** Feed the received samples of channel 'chn' to respiration detector 'r' or 
+ *   heart beat detector 'q' and send the found events.
+ * @return number of found events
+*/
+static int32_t tmsw_detect(edf_rsp_t *r, edf_ecg_t *q, int32_t chn) {
+
+  static float     *x=NULL;   /**< samples of channel 'chn' */
+  static edf_evt_t *e=NULL;   /**< found events */
+  static int32_t    size=0;   /**< allocated samples in 'x' and events in 'e' */
+  tms_channel_data_t *c=&channel[chn];
+  char    msg[MNCN];          /**< event message */
+  int32_t i,n=0;
+
+  if (c->rs>size) {
+    free(x); free(e); size=0;
+    x=(float *)malloc(c->rs*sizeof(float));
+    e=(edf_evt_t *)malloc(c->rs*sizeof(edf_evt_t));
+    if ((x==NULL) || (e==NULL)) { return(0); }
+    size=c->rs;
+  }
+  for (i=0; i<c->rs; i++) { x[i]=c->data[i].sample; }
+  if (r!=NULL) { n=edf_rsp_run(r,c->sc,x,c->rs,e,size); }
+  if (q!=NULL) { n=edf_ecg_run(q,c->sc,x,c->rs,e,size); }
+  for (i=0; i<n; i++) {
+    edf_evt_prt(msg,sizeof(msg),chn,0.0,&e[i]);
+    if (vb&0x02) { fprintf(stderr,"# Info: %s",msg); }
+    if (tms_ip_port>0) { tms_ip_send_str(msg); }
+  }
+  return(n);
+}
+
 void tmsw_notify_on_switch() {
 
   int32_t mpc=0;
@@ -555,6 +618,10 @@ void tmsw_notify_on_switch() {
 
     tmsw_check_for_stimuli(channel);
 
+    /* respiration and heart beat events */
+    if (rsp!=NULL) { tmsw_detect(rsp,NULL,rsp_chn_nr); }
+    if (ecg!=NULL) { tmsw_detect(NULL,ecg,ecg_chn_nr); }
+
   }
   
   if (format==1) {